@@ -30,6 +30,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -66,11 +68,17 @@ typedef struct
     /* Configuration */
     char* filename;
     unsigned snaplen;
+    bool use_mmap;
 
     /* State */
     DAQ_ModuleInstance_h modinst;
     FileMsgPool pool;
     int fid;
+
+    /* mmap mode; messages point into the map */
+    uint8_t* map;
+    size_t map_len;
+    size_t map_off;
     volatile bool interrupted;
 
     bool sof;
@@ -80,6 +88,10 @@ typedef struct
     DAQ_Stats_t stats;
 } FileContext;
 
+static DAQ_VariableDesc_t file_variable_descriptions[] = {
+    { "mmap", "Map the input file and pass messages that point into it instead of reading into buffers", DAQ_VAR_DESC_FORBIDS_ARGUMENT },
+};
+
 static DAQ_BaseAPI_t daq_base_api;
 
 //-------------------------------------------------------------------------
@@ -114,16 +126,8 @@ static int create_message_pool(FileContext* fc, unsigned size)
     pool->info.mem_size = sizeof(FileMsgDesc) * size;
     while (pool->info.size < size)
     {
-        /* Allocate packet data and set up descriptor */
+        /* Set up descriptor; packet data is allocated by alloc_message_buffers() */
         FileMsgDesc *desc = &pool->pool[pool->info.size];
-        desc->data = malloc(fc->snaplen);
-        if (!desc->data)
-        {
-            SET_ERROR(fc->modinst, "%s: Could not allocate %d bytes for a packet descriptor message buffer!",
-                    __func__, fc->snaplen);
-            return DAQ_ERROR_NOMEM;
-        }
-        pool->info.mem_size += fc->snaplen;
 
         /* Initialize non-zero invariant packet header fields. */
         DAQ_PktHdr_t *pkthdr = &desc->pkthdr;
@@ -147,10 +151,58 @@ static int create_message_pool(FileContext* fc, unsigned size)
     return DAQ_SUCCESS;
 }
 
+/* Mapped messages need no buffer so in mmap mode the pool costs only
+   descriptors until the input turns out to be unmappable. */
+static int alloc_message_buffers(FileContext* fc)
+{
+    FileMsgPool* pool = &fc->pool;
+
+    for (unsigned i = 0; i < pool->info.size; i++)
+    {
+        FileMsgDesc *desc = &pool->pool[i];
+
+        if (desc->data)
+            continue;
+
+        desc->data = malloc(fc->snaplen);
+        if (!desc->data)
+        {
+            SET_ERROR(fc->modinst, "%s: Could not allocate %d bytes for a packet descriptor message buffer!",
+                    __func__, fc->snaplen);
+            return DAQ_ERROR_NOMEM;
+        }
+        pool->info.mem_size += fc->snaplen;
+    }
+    return DAQ_SUCCESS;
+}
+
 //-------------------------------------------------------------------------
 // file functions
 //-------------------------------------------------------------------------
 
+// anything that can't be mapped, such as a tty, a pipe, or an empty file,
+// is read as usual; the map is writable copy on write since packet data may
+// be modified in place
+static void file_map(FileContext* fc)
+{
+    struct stat sb;
+
+    if ( fstat(fc->fid, &sb) || !S_ISREG(sb.st_mode) || !sb.st_size )
+        return;
+
+    void* map = mmap(NULL, sb.st_size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fc->fid, 0);
+
+    if ( map == MAP_FAILED )
+        return;
+
+    madvise(map, sb.st_size, MADV_SEQUENTIAL);
+    posix_fadvise(fc->fid, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    fc->map = (uint8_t*) map;
+    fc->map_len = sb.st_size;
+    fc->map_off = 0;
+}
+
 static int file_setup(FileContext* fc)
 {
     if ( !strcmp(fc->filename, "tty") )
@@ -170,11 +222,20 @@ static int file_setup(FileContext* fc)
     fc->sof = true;
     fc->eof = false;
 
+    if ( fc->use_mmap )
+        file_map(fc);
+
     return 0;
 }
 
 static void file_cleanup(FileContext* fc)
 {
+    if ( fc->map )
+    {
+        munmap(fc->map, fc->map_len);
+        fc->map = NULL;
+    }
+
     if ( fc->fid > STDIN_FILENO )
         close(fc->fid);
 
@@ -212,9 +273,24 @@ static void init_packet_message(FileContext* fc, FileMsgDesc* desc)
 static DAQ_RecvStatus file_read_message(FileContext* fc, FileMsgDesc* desc)
 {
     desc->msg.data = NULL;
-    int n = read(fc->fid, desc->data, fc->snaplen);
+    int n;
+
+    if ( fc->map )
+    {
+        size_t avail = fc->map_len - fc->map_off;
+        n = avail < fc->snaplen ? (int) avail : (int) fc->snaplen;
+    }
+    else
+        n = read(fc->fid, desc->data, fc->snaplen);
 
-    if ( n )
+    if ( n > 0 && fc->map )
+    {
+        init_packet_message(fc, desc);
+        desc->msg.data = fc->map + fc->map_off;
+        desc->msg.data_len = n;
+        fc->map_off += n;
+    }
+    else if ( n )
     {
         init_packet_message(fc, desc);
         desc->msg.data_len = n;
@@ -261,6 +337,13 @@ static int file_daq_module_load(const DAQ_BaseAPI_t* base_api)
     return DAQ_SUCCESS;
 }
 
+static int file_daq_get_variable_descs(const DAQ_VariableDesc_t** var_desc_table)
+{
+    *var_desc_table = file_variable_descriptions;
+
+    return sizeof(file_variable_descriptions) / sizeof(DAQ_VariableDesc_t);
+}
+
 static int file_daq_instantiate(const DAQ_ModuleConfig_h modcfg, DAQ_ModuleInstance_h modinst, void** ctxt_ptr)
 {
     FileContext* fc;
@@ -278,6 +361,22 @@ static int file_daq_instantiate(const DAQ_ModuleConfig_h modcfg, DAQ_ModuleInsta
     fc->snaplen = daq_base_api.config_get_snaplen(modcfg) ? daq_base_api.config_get_snaplen(modcfg) : FILE_BUF_SZ;
     fc->fid = -1;
 
+    const char* varKey, * varValue;
+    daq_base_api.config_first_variable(modcfg, &varKey, &varValue);
+    while (varKey)
+    {
+        if (!strcmp(varKey, "mmap"))
+            fc->use_mmap = true;
+        else
+        {
+            SET_ERROR(modinst, "%s: Unknown variable name: '%s'", DAQ_NAME, varKey);
+            rval = DAQ_ERROR_INVAL;
+            goto err;
+        }
+
+        daq_base_api.config_next_variable(modcfg, &varKey, &varValue);
+    }
+
     const char* filename = daq_base_api.config_get_input(modcfg);
     if (filename)
     {
@@ -294,6 +393,13 @@ static int file_daq_instantiate(const DAQ_ModuleConfig_h modcfg, DAQ_ModuleInsta
     if (rval != DAQ_SUCCESS)
         goto err;
 
+    if (!fc->use_mmap)
+    {
+        rval = alloc_message_buffers(fc);
+        if (rval != DAQ_SUCCESS)
+            goto err;
+    }
+
     *ctxt_ptr = fc;
 
     return DAQ_SUCCESS;
@@ -326,6 +432,17 @@ static int file_daq_start(void* handle)
     if (file_setup(fc))
         return DAQ_ERROR;
 
+    /* fall back to reading if the input couldn't be mapped */
+    if (!fc->map)
+    {
+        int rval = alloc_message_buffers(fc);
+        if (rval != DAQ_SUCCESS)
+        {
+            file_cleanup(fc);
+            return rval;
+        }
+    }
+
     return DAQ_SUCCESS;
 }
 
@@ -478,7 +595,7 @@ const DAQ_ModuleAPI_t file_daq_module_data =
     /* .type = */ DAQ_TYPE,
     /* .load = */ file_daq_module_load,
     /* .unload = */ NULL,
-    /* .get_variable_descs = */ NULL,
+    /* .get_variable_descs = */ file_daq_get_variable_descs,
     /* .instantiate = */ file_daq_instantiate,
     /* .destroy = */ file_daq_destroy,
     /* .set_filter = */ NULL,
@@ -0,0 +1,196 @@
+/*--------------------------------------------------------------------------
+// Copyright (C) 2023-2023 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+*/
+/* daq_flow.h */
+/* this is a C include, not C++ */
+
+/* Finding the IP header and the flow of a packet for the DAQ modules here
+   that look into packets: pcap_split, rss, offload, and replay.  Each module
+   is built on its own, so everything is static inline.  This header is not
+   installed. */
+
+#ifndef DAQ_FLOW_H
+#define DAQ_FLOW_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* pcap link types; only raw differs from the DLT reported to the
+   application, and either is accepted */
+#define LINKTYPE_NULL 0
+#define LINKTYPE_ETHERNET 1
+#define LINKTYPE_RAW 101
+#define LINKTYPE_LINUX_SLL 113
+#define LINKTYPE_IPV4 228
+#define LINKTYPE_IPV6 229
+#define DLT_RAW_IP 12
+
+typedef struct
+{
+    uint32_t l3;        /* offsets from the start of the packet */
+    uint32_t src;       /* the destination address follows the source */
+    uint32_t l4;
+    uint32_t l4_len;    /* bytes captured from l4 on */
+    uint16_t frag;      /* ip4 MF flag and fragment offset, 0 for ip6 */
+    uint8_t addr_len;   /* 4 or 16 */
+    uint8_t proto;      /* ip6 extension headers aren't walked */
+} FlowL3;
+
+static inline uint32_t flow_get16(const uint8_t* p)
+{
+    return ((uint32_t)p[0] << 8) | p[1];
+}
+
+static inline uint32_t flow_get32(const uint8_t* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline uint32_t flow_mix32(uint32_t h)
+{
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+static inline bool flow_has_ports(uint8_t proto)
+{
+    return proto == 6 || proto == 17 || proto == 132;
+}
+
+/* skips the link layer, any VLAN tags, and finds the IP header; false for
+   anything else and for headers that aren't all captured */
+static inline bool flow_get_l3(int dlt, const uint8_t* p, uint32_t len, FlowL3* f)
+{
+    uint32_t off;
+    uint32_t type;
+
+    switch (dlt)
+    {
+    case LINKTYPE_ETHERNET:
+        if (len < 14)
+            return false;
+        type = flow_get16(p + 12);
+        off = 14;
+
+        while (type == 0x8100 || type == 0x88a8 || type == 0x9100)
+        {
+            if (len < off + 4)
+                return false;
+            type = flow_get16(p + off + 2);
+            off += 4;
+        }
+        break;
+
+    case LINKTYPE_LINUX_SLL:
+        if (len < 16)
+            return false;
+        type = flow_get16(p + 14);
+        off = 16;
+        break;
+
+    case LINKTYPE_NULL:
+    case DLT_RAW_IP:
+    case LINKTYPE_RAW:
+    case LINKTYPE_IPV4:
+    case LINKTYPE_IPV6:
+        off = dlt == LINKTYPE_NULL ? 4 : 0;
+        if (len < off + 1)
+            return false;
+        type = (p[off] >> 4) == 4 ? 0x0800 : ((p[off] >> 4) == 6 ? 0x86dd : 0);
+        break;
+
+    default:
+        return false;
+    }
+
+    p += off;
+    len -= off;
+    f->l3 = off;
+
+    if (type == 0x0800)
+    {
+        unsigned hlen = (p[0] & 0x0f) * 4;
+
+        if (len < 20 || hlen < 20 || len < hlen)
+            return false;
+
+        f->src = off + 12;
+        f->addr_len = 4;
+        f->proto = p[9];
+        f->frag = flow_get16(p + 6) & 0x3fff;
+        f->l4 = off + hlen;
+        f->l4_len = len - hlen;
+    }
+    else if (type == 0x86dd)
+    {
+        if (len < 40)
+            return false;
+
+        f->src = off + 8;
+        f->addr_len = 16;
+        f->proto = p[6];
+        f->frag = 0;
+        f->l4 = off + 40;
+        f->l4_len = len - 40;
+    }
+    else
+        return false;
+
+    return true;
+}
+
+/* Both directions of a flow hash alike since each pair of addresses and
+   ports is combined with xor.  Ports are in host order and aren't hashed
+   when proto is 0. */
+static inline uint32_t flow_hash_tuple(const uint8_t* src, const uint8_t* dst, unsigned addr_len,
+    uint8_t proto, uint16_t sport, uint16_t dport)
+{
+    uint32_t h = 0;
+
+    for (unsigned i = 0; i < addr_len; i += 4)
+        h ^= flow_get32(src + i) ^ flow_get32(dst + i);
+
+    if (proto)
+        h ^= ((uint32_t)proto << 16) ^ sport ^ dport;
+
+    return flow_mix32(h);
+}
+
+/* Fragments hash by their addresses, and non-IP and anything that can't be
+   parsed hash to 0. */
+static inline uint32_t flow_hash(int dlt, const uint8_t* p, uint32_t len, bool hash_ports)
+{
+    FlowL3 f;
+
+    if (!flow_get_l3(dlt, p, len, &f))
+        return 0;
+
+    const uint8_t* src = p + f.src;
+    const uint8_t* dst = src + f.addr_len;
+
+    if (hash_ports && !f.frag && f.l4_len >= 4 && flow_has_ports(f.proto))
+        return flow_hash_tuple(src, dst, f.addr_len, f.proto, flow_get16(p + f.l4), flow_get16(p + f.l4 + 2));
+
+    return flow_hash_tuple(src, dst, f.addr_len, 0, 0, 0);
+}
+
+#endif
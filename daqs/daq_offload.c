@@ -0,0 +1,469 @@
+/*--------------------------------------------------------------------------
+// Copyright (C) 2023-2023 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+*/
+/* daq_offload.c */
+
+/* A wrapper module standing in for hardware flow offload.  Flows offloaded
+   with DIOCTL_SET_FLOW_OFFLOAD are kept in a table and packets received from
+   the module below that belong to one are passed or blocked right here
+   instead of being returned to the application.  An offload ends once its
+   flow is idle, by packet time, for the requested timeout.  Everything else
+   goes straight through to the module below. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include <daq_module_api.h>
+
+#include "daq_flow.h"
+#include "daq_user.h"
+
+#define DAQ_MOD_VERSION 0
+#define DAQ_NAME "offload"
+#define DAQ_TYPE (DAQ_TYPE_WRAPPER|DAQ_TYPE_INLINE_CAPABLE)
+
+#define OFFLOAD_DEFAULT_FLOWS 65536
+#define OFFLOAD_DEFAULT_TIMEOUT 300
+#define OFFLOAD_WAYS 4
+
+#define SET_ERROR(modinst, ...)    daq_base_api.set_errbuf(modinst, __VA_ARGS__)
+
+#define CALL_SUBAPI_NOARGS(ctxt, fname) \
+    ctxt->subapi.fname.func(ctxt->subapi.fname.context)
+
+#define CALL_SUBAPI(ctxt, fname, ...) \
+    ctxt->subapi.fname.func(ctxt->subapi.fname.context, __VA_ARGS__)
+
+/* both directions of a flow have the same key: the lower address and port
+   go first */
+typedef struct
+{
+    uint32_t addr[2][4];
+    uint16_t port[2];
+    uint8_t proto;
+    uint8_t pad[3];
+} OffloadKey;
+
+typedef struct
+{
+    OffloadKey key;
+    time_t expire;
+    uint32_t timeout;
+    uint8_t action;
+    bool used;
+} OffloadEntry;
+
+typedef struct
+{
+    /* Configuration */
+    unsigned num_sets;
+    unsigned timeout;
+
+    /* State */
+    DAQ_ModuleInstance_h modinst;
+    DAQ_InstanceAPI_t subapi;
+    OffloadEntry* table;
+    unsigned active;
+    int dlt;
+
+    /* packets consumed here and never returned to the application */
+    uint64_t offloaded;
+} OffloadContext;
+
+static DAQ_VariableDesc_t offload_variable_descriptions[] = {
+    { "flows", "Maximum number of offloaded flows, rounded up to a power of 2 (default 65536)", DAQ_VAR_DESC_REQUIRES_ARGUMENT },
+    { "timeout", "Idle seconds before an offload ends when none is requested (default 300)", DAQ_VAR_DESC_REQUIRES_ARGUMENT },
+};
+
+static DAQ_BaseAPI_t daq_base_api;
+
+//-------------------------------------------------------------------------
+// flow key
+//-------------------------------------------------------------------------
+
+/* Only unfragmented IP can be offloaded since the ports of later fragments
+   aren't known; IPv6 extension headers aren't walked, so those packets are
+   keyed by the extension header and are offloaded only with their flow. */
+static bool offload_get_key(int dlt, const uint8_t* p, uint32_t len, OffloadKey* key)
+{
+    FlowL3 f;
+
+    if (!flow_get_l3(dlt, p, len, &f) || f.frag)
+        return false;
+
+    memset(key, 0, sizeof(*key));
+
+    /* ip4 goes in the last word, as when mapped into ip6 */
+    unsigned word = f.addr_len == 4 ? 3 : 0;
+    memcpy(&key->addr[0][word], p + f.src, f.addr_len);
+    memcpy(&key->addr[1][word], p + f.src + f.addr_len, f.addr_len);
+    key->proto = f.proto;
+
+    if (flow_has_ports(key->proto))
+    {
+        if (f.l4_len < 4)
+            return false;
+
+        key->port[0] = flow_get16(p + f.l4);
+        key->port[1] = flow_get16(p + f.l4 + 2);
+    }
+
+    int c = memcmp(key->addr[0], key->addr[1], sizeof(key->addr[0]));
+
+    if (c > 0 || (c == 0 && key->port[0] > key->port[1]))
+    {
+        uint32_t a[4];
+        memcpy(a, key->addr[0], sizeof(a));
+        memcpy(key->addr[0], key->addr[1], sizeof(a));
+        memcpy(key->addr[1], a, sizeof(a));
+
+        uint16_t port = key->port[0];
+        key->port[0] = key->port[1];
+        key->port[1] = port;
+    }
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// flow table
+//-------------------------------------------------------------------------
+
+static OffloadEntry* offload_set(OffloadContext* oc, const OffloadKey* key)
+{
+    const uint32_t* w = (const uint32_t*) key;
+    uint32_t h = 0;
+
+    for (unsigned i = 0; i < sizeof(*key) / sizeof(*w); i++)
+        h = (h ^ w[i]) * 0x9e3779b1;
+
+    return oc->table + (flow_mix32(h) & (oc->num_sets - 1)) * OFFLOAD_WAYS;
+}
+
+/* finding a flow refreshes its expiration; expired flows are released */
+static const OffloadEntry* offload_find(OffloadContext* oc, const OffloadKey* key, time_t now)
+{
+    OffloadEntry* set = offload_set(oc, key);
+
+    for (unsigned i = 0; i < OFFLOAD_WAYS; i++)
+    {
+        OffloadEntry* e = set + i;
+
+        if (!e->used || memcmp(&e->key, key, sizeof(*key)))
+            continue;
+
+        if (e->expire < now)
+        {
+            e->used = false;
+            oc->active--;
+            return NULL;
+        }
+        e->expire = now + e->timeout;
+        return e;
+    }
+    return NULL;
+}
+
+/* a full set gives up the flow closest to expiring */
+static void offload_add(OffloadContext* oc, const OffloadKey* key, time_t now, uint32_t timeout, uint8_t action)
+{
+    OffloadEntry* set = offload_set(oc, key);
+    OffloadEntry* slot = NULL;
+
+    for (unsigned i = 0; i < OFFLOAD_WAYS; i++)
+    {
+        OffloadEntry* e = set + i;
+
+        if (e->used && !memcmp(&e->key, key, sizeof(*key)))
+        {
+            slot = e;
+            break;
+        }
+        if (!e->used)
+        {
+            if (!slot || slot->used)
+                slot = e;
+        }
+        else if (!slot || (slot->used && e->expire < slot->expire))
+            slot = e;
+    }
+
+    if (!slot->used)
+        oc->active++;
+
+    slot->key = *key;
+    slot->timeout = timeout;
+    slot->expire = now + timeout;
+    slot->action = action;
+    slot->used = true;
+}
+
+//-------------------------------------------------------------------------
+// daq
+//-------------------------------------------------------------------------
+
+static int offload_daq_module_load(const DAQ_BaseAPI_t* base_api)
+{
+    if (base_api->api_version != DAQ_BASE_API_VERSION || base_api->api_size != sizeof(DAQ_BaseAPI_t))
+        return DAQ_ERROR;
+
+    daq_base_api = *base_api;
+
+    return DAQ_SUCCESS;
+}
+
+static int offload_daq_get_variable_descs(const DAQ_VariableDesc_t** var_desc_table)
+{
+    *var_desc_table = offload_variable_descriptions;
+
+    return sizeof(offload_variable_descriptions) / sizeof(DAQ_VariableDesc_t);
+}
+
+static int offload_daq_instantiate(const DAQ_ModuleConfig_h modcfg, DAQ_ModuleInstance_h modinst, void** ctxt_ptr)
+{
+    OffloadContext* oc;
+    int rval = DAQ_ERROR;
+
+    oc = calloc(1, sizeof(*oc));
+    if (!oc)
+    {
+        SET_ERROR(modinst, "%s: Couldn't allocate memory for the new Offload context!", DAQ_NAME);
+        rval = DAQ_ERROR_NOMEM;
+        goto err;
+    }
+    oc->modinst = modinst;
+    oc->dlt = -1;
+
+    if (daq_base_api.resolve_subapi(modinst, &oc->subapi) != DAQ_SUCCESS)
+    {
+        SET_ERROR(modinst, "%s: Couldn't resolve subapi. No submodule?", DAQ_NAME);
+        goto err;
+    }
+
+    unsigned long flows = OFFLOAD_DEFAULT_FLOWS;
+    oc->timeout = OFFLOAD_DEFAULT_TIMEOUT;
+
+    const char* varKey, * varValue;
+    daq_base_api.config_first_variable(modcfg, &varKey, &varValue);
+    while (varKey)
+    {
+        if (!strcmp(varKey, "flows"))
+        {
+            flows = strtoul(varValue, NULL, 10);
+            if (!flows || flows > (1u << 24))
+            {
+                SET_ERROR(modinst, "%s: Invalid flows: '%s'", DAQ_NAME, varValue);
+                rval = DAQ_ERROR_INVAL;
+                goto err;
+            }
+        }
+        else if (!strcmp(varKey, "timeout"))
+        {
+            unsigned long n = strtoul(varValue, NULL, 10);
+            if (!n || n > 86400)
+            {
+                SET_ERROR(modinst, "%s: Invalid timeout: '%s'", DAQ_NAME, varValue);
+                rval = DAQ_ERROR_INVAL;
+                goto err;
+            }
+            oc->timeout = n;
+        }
+        else
+        {
+            SET_ERROR(modinst, "%s: Unknown variable name: '%s'", DAQ_NAME, varKey);
+            rval = DAQ_ERROR_INVAL;
+            goto err;
+        }
+
+        daq_base_api.config_next_variable(modcfg, &varKey, &varValue);
+    }
+
+    oc->num_sets = 1;
+    while (oc->num_sets * OFFLOAD_WAYS < flows)
+        oc->num_sets <<= 1;
+
+    oc->table = calloc(oc->num_sets * OFFLOAD_WAYS, sizeof(OffloadEntry));
+    if (!oc->table)
+    {
+        SET_ERROR(modinst, "%s: Couldn't allocate memory for the flow table!", DAQ_NAME);
+        rval = DAQ_ERROR_NOMEM;
+        goto err;
+    }
+
+    *ctxt_ptr = oc;
+
+    return DAQ_SUCCESS;
+
+err:
+    if (oc)
+    {
+        if (oc->table)
+            free(oc->table);
+        free(oc);
+    }
+    return rval;
+}
+
+static void offload_daq_destroy(void* handle)
+{
+    OffloadContext* oc = (OffloadContext*) handle;
+
+    free(oc->table);
+    free(oc);
+}
+
+static int offload_daq_ioctl(void* handle, DAQ_IoctlCmd cmd, void* arg, size_t arglen)
+{
+    OffloadContext* oc = (OffloadContext*) handle;
+
+    if (cmd != DIOCTL_SET_FLOW_OFFLOAD)
+        return CALL_SUBAPI(oc, ioctl, cmd, arg, arglen);
+
+    if (arglen != sizeof(DIOCTL_SetFlowOffload))
+        return DAQ_ERROR_INVAL;
+
+    const DIOCTL_SetFlowOffload* sfo = (const DIOCTL_SetFlowOffload*) arg;
+    const DAQ_Msg_t* msg = sfo->msg;
+
+    if (!msg || msg->type != DAQ_MSG_TYPE_PACKET || sfo->action > DAQ_OFFLOAD_DROP)
+        return DAQ_ERROR_INVAL;
+
+    if (oc->dlt < 0)
+        oc->dlt = CALL_SUBAPI_NOARGS(oc, get_datalink_type);
+
+    OffloadKey key;
+
+    if (!offload_get_key(oc->dlt, msg->data, msg->data_len, &key))
+        return DAQ_ERROR_INVAL;
+
+    const DAQ_PktHdr_t* hdr = (const DAQ_PktHdr_t*) msg->hdr;
+    offload_add(oc, &key, hdr->ts.tv_sec, sfo->timeout ? sfo->timeout : oc->timeout, sfo->action);
+
+    return DAQ_SUCCESS;
+}
+
+static int offload_daq_get_stats(void* handle, DAQ_Stats_t* stats)
+{
+    OffloadContext* oc = (OffloadContext*) handle;
+    int rval = CALL_SUBAPI(oc, get_stats, stats);
+
+    /* offloaded packets were received below but filtered here */
+    if (rval == DAQ_SUCCESS)
+    {
+        stats->packets_received -= oc->offloaded;
+        stats->packets_filtered += oc->offloaded;
+    }
+    return rval;
+}
+
+static void offload_daq_reset_stats(void* handle)
+{
+    OffloadContext* oc = (OffloadContext*) handle;
+
+    CALL_SUBAPI_NOARGS(oc, reset_stats);
+    oc->offloaded = 0;
+}
+
+static unsigned offload_daq_msg_receive(void* handle, const unsigned max_recv, const DAQ_Msg_t* msgs[], DAQ_RecvStatus* rstat)
+{
+    OffloadContext* oc = (OffloadContext*) handle;
+
+    while (true)
+    {
+        unsigned num = CALL_SUBAPI(oc, msg_receive, max_recv, msgs, rstat);
+
+        if (!oc->active || !num)
+            return num;
+
+        if (oc->dlt < 0)
+            oc->dlt = CALL_SUBAPI_NOARGS(oc, get_datalink_type);
+
+        unsigned kept = 0;
+
+        for (unsigned i = 0; i < num; i++)
+        {
+            const DAQ_Msg_t* msg = msgs[i];
+            const OffloadEntry* e = NULL;
+            OffloadKey key;
+
+            if (msg->type == DAQ_MSG_TYPE_PACKET &&
+                offload_get_key(oc->dlt, msg->data, msg->data_len, &key))
+            {
+                const DAQ_PktHdr_t* hdr = (const DAQ_PktHdr_t*) msg->hdr;
+                e = offload_find(oc, &key, hdr->ts.tv_sec);
+            }
+
+            if (!e)
+            {
+                msgs[kept++] = msg;
+                continue;
+            }
+
+            CALL_SUBAPI(oc, msg_finalize, msg,
+                e->action == DAQ_OFFLOAD_DROP ? DAQ_VERDICT_BLOCK : DAQ_VERDICT_PASS);
+            oc->offloaded++;
+        }
+
+        /* don't return an empty batch while there may be more to read */
+        if (kept || *rstat != DAQ_RSTAT_OK)
+            return kept;
+    }
+}
+
+//-------------------------------------------------------------------------
+
+#ifdef BUILDING_SO
+DAQ_SO_PUBLIC const DAQ_ModuleAPI_t DAQ_MODULE_DATA =
+#else
+const DAQ_ModuleAPI_t offload_daq_module_data =
+#endif
+{
+    /* .api_version = */ DAQ_MODULE_API_VERSION,
+    /* .api_size = */ sizeof(DAQ_ModuleAPI_t),
+    /* .module_version = */ DAQ_MOD_VERSION,
+    /* .name = */ DAQ_NAME,
+    /* .type = */ DAQ_TYPE,
+    /* .load = */ offload_daq_module_load,
+    /* .unload = */ NULL,
+    /* .get_variable_descs = */ offload_daq_get_variable_descs,
+    /* .instantiate = */ offload_daq_instantiate,
+    /* .destroy = */ offload_daq_destroy,
+    /* .set_filter = */ NULL,
+    /* .start = */ NULL,
+    /* .inject = */ NULL,
+    /* .inject_relative = */ NULL,
+    /* .interrupt = */ NULL,
+    /* .stop = */ NULL,
+    /* .ioctl = */ offload_daq_ioctl,
+    /* .get_stats = */ offload_daq_get_stats,
+    /* .reset_stats = */ offload_daq_reset_stats,
+    /* .get_snaplen = */ NULL,
+    /* .get_capabilities = */ NULL,
+    /* .get_datalink_type = */ NULL,
+    /* .config_load = */ NULL,
+    /* .config_swap = */ NULL,
+    /* .config_free = */ NULL,
+    /* .msg_receive = */ offload_daq_msg_receive,
+    /* .msg_finalize = */ NULL,
+    /* .get_msg_pool_info = */ NULL,
+};
@@ -0,0 +1,777 @@
+/*--------------------------------------------------------------------------
+// Copyright (C) 2023-2023 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+*/
+/* daq_pcap_split.c */
+
+/* Reads one pcap with all packet threads.  Every instance given the same
+   file attaches to a shared reader which maps the file and dispatches each
+   packet by a symmetric flow hash to the ring of one instance, so both
+   directions of a flow are processed in order by the same thread.  Packet
+   data is not copied: messages point into the mapped file. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <daq_module_api.h>
+
+#include "daq_flow.h"
+
+#define DAQ_MOD_VERSION 0
+#define DAQ_NAME "pcap_split"
+#define DAQ_TYPE (DAQ_TYPE_FILE_CAPABLE|DAQ_TYPE_MULTI_INSTANCE)
+
+#define SPLIT_DEFAULT_POOL_SIZE 16
+#define SPLIT_DEFAULT_RING_SIZE 4096
+#define SPLIT_DEFAULT_SNAPLEN 1518
+#define SPLIT_IDLE_NSEC 50000
+
+#define PCAP_MAGIC_USEC 0xa1b2c3d4
+#define PCAP_MAGIC_NSEC 0xa1b23c4d
+#define PCAP_FILE_HDR_LEN 24
+#define PCAP_REC_HDR_LEN 16
+
+#define SET_ERROR(modinst, ...)    daq_base_api.set_errbuf(modinst, __VA_ARGS__)
+
+typedef struct
+{
+    const uint8_t* data;
+    uint32_t caplen;
+    uint32_t pktlen;
+    struct timeval ts;
+} SplitPkt;
+
+/* single producer (the reader), single consumer (the instance) */
+typedef struct
+{
+    SplitPkt* pkts;
+    unsigned mask;
+    atomic_uint head;
+    atomic_uint tail;
+    atomic_bool closed;
+} SplitRing;
+
+typedef struct _split_reader
+{
+    char* filename;
+    const uint8_t* map;
+    size_t map_len;
+    bool swapped;
+    bool nsec;
+    bool hash_ports;
+    uint32_t linktype;
+
+    SplitRing* rings;
+    unsigned num_rings;
+    unsigned attached;
+    unsigned detached;
+
+    pthread_t thread;
+    atomic_bool done;
+    atomic_bool abort;
+
+    struct _split_reader* next;
+} SplitReader;
+
+typedef struct _split_msg_desc
+{
+    DAQ_Msg_t msg;
+    DAQ_PktHdr_t pkthdr;
+    struct _split_msg_desc* next;
+} SplitMsgDesc;
+
+typedef struct
+{
+    SplitMsgDesc* pool;
+    SplitMsgDesc* freelist;
+    DAQ_MsgPoolInfo_t info;
+} SplitMsgPool;
+
+typedef struct
+{
+    /* Configuration */
+    char* filename;
+    unsigned snaplen;
+    unsigned timeout;
+    unsigned num_rings;
+    unsigned ring_size;
+    bool hash_ports;
+
+    /* State */
+    DAQ_ModuleInstance_h modinst;
+    SplitMsgPool pool;
+    SplitReader* reader;
+    SplitRing* ring;
+    volatile bool interrupted;
+
+    DAQ_Stats_t stats;
+} SplitContext;
+
+static DAQ_VariableDesc_t split_variable_descriptions[] = {
+    { "ring_size", "Packets queued to each packet thread, rounded up to a power of 2 (default 4096)", DAQ_VAR_DESC_REQUIRES_ARGUMENT },
+    { "hash", "Flow hash: 'ip' for addresses only (default) or '5tuple' to include protocol and ports", DAQ_VAR_DESC_REQUIRES_ARGUMENT },
+};
+
+static DAQ_BaseAPI_t daq_base_api;
+
+/* readers are shared by the instances of a file and found by name */
+static pthread_mutex_t readers_lock = PTHREAD_MUTEX_INITIALIZER;
+static SplitReader* readers = NULL;
+
+//-------------------------------------------------------------------------
+// utility functions
+//-------------------------------------------------------------------------
+
+static void destroy_message_pool(SplitContext* sc)
+{
+    SplitMsgPool* pool = &sc->pool;
+    if (pool->pool)
+    {
+        free(pool->pool);
+        pool->pool = NULL;
+    }
+    pool->freelist = NULL;
+    pool->info.size = 0;
+    pool->info.available = 0;
+    pool->info.mem_size = 0;
+}
+
+static int create_message_pool(SplitContext* sc, unsigned size)
+{
+    SplitMsgPool* pool = &sc->pool;
+    pool->pool = calloc(sizeof(SplitMsgDesc), size);
+    if (!pool->pool)
+    {
+        SET_ERROR(sc->modinst, "%s: Could not allocate %zu bytes for a packet descriptor pool!",
+                __func__, sizeof(SplitMsgDesc) * size);
+        return DAQ_ERROR_NOMEM;
+    }
+    pool->info.mem_size = sizeof(SplitMsgDesc) * size;
+    while (pool->info.size < size)
+    {
+        SplitMsgDesc *desc = &pool->pool[pool->info.size];
+
+        /* Initialize non-zero invariant packet header fields. */
+        DAQ_PktHdr_t *pkthdr = &desc->pkthdr;
+        pkthdr->ingress_index = DAQ_PKTHDR_UNKNOWN;
+        pkthdr->ingress_group = DAQ_PKTHDR_UNKNOWN;
+        pkthdr->egress_index = DAQ_PKTHDR_UNKNOWN;
+        pkthdr->egress_group = DAQ_PKTHDR_UNKNOWN;
+
+        /* Initialize non-zero invariant message header fields. */
+        DAQ_Msg_t *msg = &desc->msg;
+        msg->type = DAQ_MSG_TYPE_PACKET;
+        msg->hdr_len = sizeof(*pkthdr);
+        msg->hdr = pkthdr;
+        msg->owner = sc->modinst;
+        msg->priv = desc;
+
+        /* Place it on the free list */
+        desc->next = pool->freelist;
+        pool->freelist = desc;
+
+        pool->info.size++;
+    }
+    pool->info.available = pool->info.size;
+    return DAQ_SUCCESS;
+}
+
+static void split_sleep(void)
+{
+    struct timespec ts = { 0, SPLIT_IDLE_NSEC };
+    nanosleep(&ts, NULL);
+}
+
+//-------------------------------------------------------------------------
+// reader
+//-------------------------------------------------------------------------
+
+static inline uint32_t rec32(const SplitReader* r, const uint8_t* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return r->swapped ? __builtin_bswap32(v) : v;
+}
+
+static void split_push(SplitReader* r, SplitRing* ring, const SplitPkt* pkt)
+{
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    /* wait for space; packets for an instance that has gone are dropped */
+    while (head - atomic_load_explicit(&ring->tail, memory_order_acquire) > ring->mask)
+    {
+        if (atomic_load(&ring->closed) || atomic_load(&r->abort))
+            return;
+        split_sleep();
+    }
+
+    ring->pkts[head & ring->mask] = *pkt;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+static void* split_reader_run(void* arg)
+{
+    SplitReader* r = (SplitReader*) arg;
+    size_t off = PCAP_FILE_HDR_LEN;
+
+    while (off + PCAP_REC_HDR_LEN <= r->map_len && !atomic_load(&r->abort))
+    {
+        const uint8_t* rec = r->map + off;
+        SplitPkt pkt;
+
+        pkt.caplen = rec32(r, rec + 8);
+        pkt.pktlen = rec32(r, rec + 12);
+
+        /* a truncated last record ends the file */
+        if (pkt.caplen > r->map_len - off - PCAP_REC_HDR_LEN)
+            break;
+
+        pkt.data = rec + PCAP_REC_HDR_LEN;
+        pkt.ts.tv_sec = rec32(r, rec);
+        pkt.ts.tv_usec = r->nsec ? rec32(r, rec + 4) / 1000 : rec32(r, rec + 4);
+
+        unsigned idx = flow_hash(r->linktype, pkt.data, pkt.caplen, r->hash_ports) % r->num_rings;
+        split_push(r, &r->rings[idx], &pkt);
+
+        off += PCAP_REC_HDR_LEN + pkt.caplen;
+    }
+
+    atomic_store(&r->done, true);
+    return NULL;
+}
+
+static void split_reader_free(SplitReader* r)
+{
+    if (r->map)
+        munmap((void*) r->map, r->map_len);
+
+    if (r->rings)
+    {
+        for (unsigned i = 0; i < r->num_rings; i++)
+            free(r->rings[i].pkts);
+        free(r->rings);
+    }
+    free(r->filename);
+    free(r);
+}
+
+static int split_reader_open(SplitContext* sc, SplitReader* r)
+{
+    int fd = open(sc->filename, O_RDONLY);
+    if (fd < 0)
+    {
+        SET_ERROR(sc->modinst, "%s: can't open file (%s)", DAQ_NAME, strerror(errno));
+        return DAQ_ERROR;
+    }
+
+    struct stat sb;
+    if (fstat(fd, &sb) || sb.st_size < PCAP_FILE_HDR_LEN)
+    {
+        SET_ERROR(sc->modinst, "%s: %s is not a pcap file", DAQ_NAME, sc->filename);
+        close(fd);
+        return DAQ_ERROR;
+    }
+
+    /* writable copy on write since snort may modify packet data in place */
+    void* map = mmap(NULL, sb.st_size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED)
+    {
+        SET_ERROR(sc->modinst, "%s: can't map file (%s)", DAQ_NAME, strerror(errno));
+        return DAQ_ERROR;
+    }
+    madvise(map, sb.st_size, MADV_SEQUENTIAL);
+
+    r->map = (const uint8_t*) map;
+    r->map_len = sb.st_size;
+
+    uint32_t magic;
+    memcpy(&magic, r->map, sizeof(magic));
+
+    if (magic == PCAP_MAGIC_USEC || magic == PCAP_MAGIC_NSEC)
+        r->swapped = false;
+
+    else if (magic == __builtin_bswap32(PCAP_MAGIC_USEC) || magic == __builtin_bswap32(PCAP_MAGIC_NSEC))
+        r->swapped = true;
+
+    else
+    {
+        SET_ERROR(sc->modinst, "%s: %s is not a pcap file", DAQ_NAME, sc->filename);
+        return DAQ_ERROR;
+    }
+
+    r->nsec = rec32(r, r->map) == PCAP_MAGIC_NSEC;
+    r->linktype = rec32(r, r->map + 20) & 0xffff;
+
+    return DAQ_SUCCESS;
+}
+
+static SplitReader* split_reader_new(SplitContext* sc)
+{
+    SplitReader* r = calloc(1, sizeof(*r));
+    if (!r || !(r->filename = strdup(sc->filename)))
+    {
+        SET_ERROR(sc->modinst, "%s: Couldn't allocate memory for the reader!", DAQ_NAME);
+        free(r);
+        return NULL;
+    }
+    r->hash_ports = sc->hash_ports;
+    r->num_rings = sc->num_rings;
+
+    if (split_reader_open(sc, r) != DAQ_SUCCESS)
+    {
+        split_reader_free(r);
+        return NULL;
+    }
+
+    r->rings = calloc(r->num_rings, sizeof(*r->rings));
+    if (!r->rings)
+    {
+        SET_ERROR(sc->modinst, "%s: Couldn't allocate memory for the rings!", DAQ_NAME);
+        split_reader_free(r);
+        return NULL;
+    }
+
+    for (unsigned i = 0; i < r->num_rings; i++)
+    {
+        SplitRing* ring = &r->rings[i];
+        ring->mask = sc->ring_size - 1;
+        ring->pkts = calloc(sc->ring_size, sizeof(*ring->pkts));
+        atomic_init(&ring->head, 0);
+        atomic_init(&ring->tail, 0);
+        atomic_init(&ring->closed, false);
+
+        if (!ring->pkts)
+        {
+            SET_ERROR(sc->modinst, "%s: Couldn't allocate memory for the rings!", DAQ_NAME);
+            split_reader_free(r);
+            return NULL;
+        }
+    }
+    atomic_init(&r->done, false);
+    atomic_init(&r->abort, false);
+
+    if (pthread_create(&r->thread, NULL, split_reader_run, r))
+    {
+        SET_ERROR(sc->modinst, "%s: Couldn't start the reader thread!", DAQ_NAME);
+        split_reader_free(r);
+        return NULL;
+    }
+
+    return r;
+}
+
+/* Instances take the rings of a reader in the order they start; each file
+   is started by as many instances as there are rings. */
+static int split_attach(SplitContext* sc)
+{
+    pthread_mutex_lock(&readers_lock);
+
+    SplitReader* r = readers;
+
+    while (r && (r->attached == r->num_rings || strcmp(r->filename, sc->filename)))
+        r = r->next;
+
+    if (!r)
+    {
+        if (!(r = split_reader_new(sc)))
+        {
+            pthread_mutex_unlock(&readers_lock);
+            return DAQ_ERROR;
+        }
+        r->next = readers;
+        readers = r;
+    }
+
+    sc->reader = r;
+    sc->ring = &r->rings[r->attached++];
+
+    pthread_mutex_unlock(&readers_lock);
+    return DAQ_SUCCESS;
+}
+
+/* The last instance to stop frees the reader. */
+static void split_detach(SplitContext* sc)
+{
+    SplitReader* r = sc->reader;
+
+    if (!r)
+        return;
+
+    atomic_store(&sc->ring->closed, true);
+    sc->reader = NULL;
+    sc->ring = NULL;
+
+    pthread_mutex_lock(&readers_lock);
+
+    if (++r->detached < r->num_rings)
+    {
+        pthread_mutex_unlock(&readers_lock);
+        return;
+    }
+
+    SplitReader** pr = &readers;
+    while (*pr != r)
+        pr = &(*pr)->next;
+    *pr = r->next;
+
+    pthread_mutex_unlock(&readers_lock);
+
+    atomic_store(&r->abort, true);
+    pthread_join(r->thread, NULL);
+    split_reader_free(r);
+}
+
+//-------------------------------------------------------------------------
+// daq
+//-------------------------------------------------------------------------
+
+static int split_daq_module_load(const DAQ_BaseAPI_t* base_api)
+{
+    if (base_api->api_version != DAQ_BASE_API_VERSION || base_api->api_size != sizeof(DAQ_BaseAPI_t))
+        return DAQ_ERROR;
+
+    daq_base_api = *base_api;
+
+    return DAQ_SUCCESS;
+}
+
+static int split_daq_get_variable_descs(const DAQ_VariableDesc_t** var_desc_table)
+{
+    *var_desc_table = split_variable_descriptions;
+
+    return sizeof(split_variable_descriptions) / sizeof(DAQ_VariableDesc_t);
+}
+
+static int split_daq_instantiate(const DAQ_ModuleConfig_h modcfg, DAQ_ModuleInstance_h modinst, void** ctxt_ptr)
+{
+    SplitContext* sc;
+    int rval = DAQ_ERROR;
+
+    sc = calloc(1, sizeof(*sc));
+    if (!sc)
+    {
+        SET_ERROR(modinst, "%s: Couldn't allocate memory for the new Split context!", DAQ_NAME);
+        rval = DAQ_ERROR_NOMEM;
+        goto err;
+    }
+    sc->modinst = modinst;
+
+    sc->snaplen = daq_base_api.config_get_snaplen(modcfg) ? daq_base_api.config_get_snaplen(modcfg) : SPLIT_DEFAULT_SNAPLEN;
+    sc->timeout = daq_base_api.config_get_timeout(modcfg);
+    sc->num_rings = daq_base_api.config_get_total_instances(modcfg) ? daq_base_api.config_get_total_instances(modcfg) : 1;
+    sc->ring_size = SPLIT_DEFAULT_RING_SIZE;
+
+    const char* varKey, * varValue;
+    daq_base_api.config_first_variable(modcfg, &varKey, &varValue);
+    while (varKey)
+    {
+        if (!strcmp(varKey, "ring_size"))
+        {
+            unsigned long n = strtoul(varValue, NULL, 10);
+            if (!n || n > (1u << 24))
+            {
+                SET_ERROR(modinst, "%s: Invalid ring size: '%s'", DAQ_NAME, varValue);
+                rval = DAQ_ERROR_INVAL;
+                goto err;
+            }
+            sc->ring_size = 1;
+            while (sc->ring_size < n)
+                sc->ring_size <<= 1;
+        }
+        else if (!strcmp(varKey, "hash"))
+        {
+            if (!strcmp(varValue, "5tuple"))
+                sc->hash_ports = true;
+            else if (strcmp(varValue, "ip"))
+            {
+                SET_ERROR(modinst, "%s: Invalid hash: '%s'", DAQ_NAME, varValue);
+                rval = DAQ_ERROR_INVAL;
+                goto err;
+            }
+        }
+        else
+        {
+            SET_ERROR(modinst, "%s: Unknown variable name: '%s'", DAQ_NAME, varKey);
+            rval = DAQ_ERROR_INVAL;
+            goto err;
+        }
+
+        daq_base_api.config_next_variable(modcfg, &varKey, &varValue);
+    }
+
+    const char* filename = daq_base_api.config_get_input(modcfg);
+    if (!filename || !(sc->filename = strdup(filename)))
+    {
+        SET_ERROR(modinst, "%s: Couldn't allocate memory for the filename!", DAQ_NAME);
+        rval = DAQ_ERROR_NOMEM;
+        goto err;
+    }
+
+    uint32_t pool_size = daq_base_api.config_get_msg_pool_size(modcfg);
+    rval = create_message_pool(sc, pool_size ? pool_size : SPLIT_DEFAULT_POOL_SIZE);
+    if (rval != DAQ_SUCCESS)
+        goto err;
+
+    *ctxt_ptr = sc;
+
+    return DAQ_SUCCESS;
+
+err:
+    if (sc)
+    {
+        if (sc->filename)
+            free(sc->filename);
+        destroy_message_pool(sc);
+        free(sc);
+    }
+    return rval;
+}
+
+static void split_daq_destroy(void* handle)
+{
+    SplitContext* sc = (SplitContext*) handle;
+
+    split_detach(sc);
+
+    if (sc->filename)
+        free(sc->filename);
+    destroy_message_pool(sc);
+    free(sc);
+}
+
+static int split_daq_start(void* handle)
+{
+    SplitContext* sc = (SplitContext*) handle;
+
+    if (split_attach(sc))
+        return DAQ_ERROR;
+
+    return DAQ_SUCCESS;
+}
+
+static int split_daq_interrupt(void* handle)
+{
+    SplitContext* sc = (SplitContext*) handle;
+    sc->interrupted = true;
+    return DAQ_SUCCESS;
+}
+
+static int split_daq_stop(void* handle)
+{
+    SplitContext* sc = (SplitContext*) handle;
+    split_detach(sc);
+    return DAQ_SUCCESS;
+}
+
+static int split_daq_get_stats(void* handle, DAQ_Stats_t* stats)
+{
+    SplitContext* sc = (SplitContext*) handle;
+    memcpy(stats, &sc->stats, sizeof(DAQ_Stats_t));
+    return DAQ_SUCCESS;
+}
+
+static void split_daq_reset_stats(void* handle)
+{
+    SplitContext* sc = (SplitContext*) handle;
+    memset(&sc->stats, 0, sizeof(sc->stats));
+}
+
+static int split_daq_get_snaplen(void* handle)
+{
+    SplitContext* sc = (SplitContext*) handle;
+    return sc->snaplen;
+}
+
+static uint32_t split_daq_get_capabilities(void* handle)
+{
+    (void) handle;
+    return DAQ_CAPA_BLOCK | DAQ_CAPA_REPLACE | DAQ_CAPA_INTERRUPT | DAQ_CAPA_UNPRIV_START;
+}
+
+static int split_daq_get_datalink_type(void* handle)
+{
+    SplitContext* sc = (SplitContext*) handle;
+
+    if (!sc->reader)
+        return DAQ_ERROR;
+
+    return sc->reader->linktype == LINKTYPE_RAW ? DLT_RAW_IP : (int) sc->reader->linktype;
+}
+
+static unsigned split_daq_msg_receive(void* handle, const unsigned max_recv, const DAQ_Msg_t* msgs[], DAQ_RecvStatus* rstat)
+{
+    SplitContext* sc = (SplitContext*) handle;
+    SplitRing* ring = sc->ring;
+    DAQ_RecvStatus status = DAQ_RSTAT_OK;
+    unsigned idx = 0;
+    uint64_t waited = 0;
+
+    while (idx < max_recv)
+    {
+        /* Check to see if the receive has been canceled.  If so, reset it and return appropriately. */
+        if (sc->interrupted)
+        {
+            sc->interrupted = false;
+            status = DAQ_RSTAT_INTERRUPTED;
+            break;
+        }
+
+        /* Make sure that we have a message descriptor available to populate. */
+        SplitMsgDesc* desc = sc->pool.freelist;
+        if (!desc)
+        {
+            status = DAQ_RSTAT_NOBUF;
+            break;
+        }
+
+        unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+        if (tail == atomic_load_explicit(&ring->head, memory_order_acquire))
+        {
+            /* return what we have rather than wait for more */
+            if (idx)
+                break;
+
+            /* the reader pushes its last packet before it is done */
+            if (atomic_load(&sc->reader->done) &&
+                tail == atomic_load_explicit(&ring->head, memory_order_acquire))
+            {
+                status = DAQ_RSTAT_EOF;
+                break;
+            }
+
+            if (sc->timeout && waited >= (uint64_t) sc->timeout * 1000000)
+            {
+                status = DAQ_RSTAT_TIMEOUT;
+                break;
+            }
+
+            split_sleep();
+            waited += SPLIT_IDLE_NSEC;
+            continue;
+        }
+
+        const SplitPkt* pkt = &ring->pkts[tail & ring->mask];
+        DAQ_PktHdr_t* pkthdr = &desc->pkthdr;
+
+        pkthdr->ts = pkt->ts;
+        pkthdr->pktlen = pkt->pktlen;
+        desc->msg.data = (uint8_t*) pkt->data;
+        desc->msg.data_len = pkt->caplen < sc->snaplen ? pkt->caplen : sc->snaplen;
+
+        atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+
+        sc->stats.hw_packets_received++;
+        sc->stats.packets_received++;
+
+        /* Last, but not least, extract this descriptor from the free list and
+           place the message in the return vector. */
+        sc->pool.freelist = desc->next;
+        desc->next = NULL;
+        sc->pool.info.available--;
+        msgs[idx] = &desc->msg;
+
+        idx++;
+    }
+
+    *rstat = status;
+
+    return idx;
+}
+
+static int split_daq_msg_finalize(void* handle, const DAQ_Msg_t* msg, DAQ_Verdict verdict)
+{
+    SplitContext* sc = (SplitContext*) handle;
+    SplitMsgDesc* desc = (SplitMsgDesc *) msg->priv;
+
+    if (verdict >= MAX_DAQ_VERDICT)
+        verdict = DAQ_VERDICT_PASS;
+    sc->stats.verdicts[verdict]++;
+
+    /* Toss the descriptor back on the free list for reuse. */
+    desc->next = sc->pool.freelist;
+    sc->pool.freelist = desc;
+    sc->pool.info.available++;
+
+    return DAQ_SUCCESS;
+}
+
+static int split_daq_get_msg_pool_info(void* handle, DAQ_MsgPoolInfo_t* info)
+{
+    SplitContext* sc = (SplitContext*) handle;
+
+    *info = sc->pool.info;
+
+    return DAQ_SUCCESS;
+}
+
+//-------------------------------------------------------------------------
+
+#ifdef BUILDING_SO
+DAQ_SO_PUBLIC const DAQ_ModuleAPI_t DAQ_MODULE_DATA =
+#else
+const DAQ_ModuleAPI_t pcap_split_daq_module_data =
+#endif
+{
+    /* .api_version = */ DAQ_MODULE_API_VERSION,
+    /* .api_size = */ sizeof(DAQ_ModuleAPI_t),
+    /* .module_version = */ DAQ_MOD_VERSION,
+    /* .name = */ DAQ_NAME,
+    /* .type = */ DAQ_TYPE,
+    /* .load = */ split_daq_module_load,
+    /* .unload = */ NULL,
+    /* .get_variable_descs = */ split_daq_get_variable_descs,
+    /* .instantiate = */ split_daq_instantiate,
+    /* .destroy = */ split_daq_destroy,
+    /* .set_filter = */ NULL,
+    /* .start = */ split_daq_start,
+    /* .inject = */ NULL,
+    /* .inject_relative = */ NULL,
+    /* .interrupt = */ split_daq_interrupt,
+    /* .stop = */ split_daq_stop,
+    /* .ioctl = */ NULL,
+    /* .get_stats = */ split_daq_get_stats,
+    /* .reset_stats = */ split_daq_reset_stats,
+    /* .get_snaplen = */ split_daq_get_snaplen,
+    /* .get_capabilities = */ split_daq_get_capabilities,
+    /* .get_datalink_type = */ split_daq_get_datalink_type,
+    /* .config_load = */ NULL,
+    /* .config_swap = */ NULL,
+    /* .config_free = */ NULL,
+    /* .msg_receive = */ split_daq_msg_receive,
+    /* .msg_finalize = */ split_daq_msg_finalize,
+    /* .get_msg_pool_info = */ split_daq_get_msg_pool_info,
+};
+
@@ -0,0 +1,1039 @@
+/*--------------------------------------------------------------------------
+// Copyright (C) 2023-2023 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+*/
+/* daq_replay.c */
+
+/* Replays a pcap or pcapng from memory for benchmarking.  The file is
+   loaded once and shared by all instances.  Each instance replays all of
+   it, as many times as configured, as fast as possible or at a given rate.
+   Addresses are rewritten for each instance and loop so that every replay
+   creates distinct flows. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <daq_module_api.h>
+
+#include "daq_flow.h"
+
+#define DAQ_MOD_VERSION 0
+#define DAQ_NAME "replay"
+#define DAQ_TYPE (DAQ_TYPE_FILE_CAPABLE|DAQ_TYPE_MULTI_INSTANCE)
+
+#define REPLAY_DEFAULT_POOL_SIZE 16
+#define REPLAY_DEFAULT_SNAPLEN 1518
+#define REPLAY_MAX_SLEEP_NSEC 1000000
+
+#define PCAP_MAGIC_USEC 0xa1b2c3d4
+#define PCAP_MAGIC_NSEC 0xa1b23c4d
+#define PCAP_FILE_HDR_LEN 24
+#define PCAP_REC_HDR_LEN 16
+
+#define PCAPNG_SHB 0x0a0d0d0a
+#define PCAPNG_IDB 1
+#define PCAPNG_SPB 3
+#define PCAPNG_EPB 6
+#define PCAPNG_BOM 0x1a2b3c4d
+#define PCAPNG_OPT_TSRESOL 9
+
+#define SET_ERROR(modinst, ...)    daq_base_api.set_errbuf(modinst, __VA_ARGS__)
+
+typedef struct
+{
+    const uint8_t* data;
+    uint32_t caplen;
+    uint32_t pktlen;
+    uint64_t usecs;
+} ReplayPkt;
+
+/* the loaded file, shared read only by the instances replaying it */
+typedef struct _replay_image
+{
+    char* filename;
+    uint8_t* buf;
+    ReplayPkt* pkts;
+    unsigned num_pkts;
+    uint32_t linktype;
+    uint64_t span;
+    unsigned refs;
+    struct _replay_image* next;
+} ReplayImage;
+
+typedef struct _replay_msg_desc
+{
+    DAQ_Msg_t msg;
+    DAQ_PktHdr_t pkthdr;
+    uint8_t* data;
+    struct _replay_msg_desc* next;
+} ReplayMsgDesc;
+
+typedef struct
+{
+    ReplayMsgDesc* pool;
+    ReplayMsgDesc* freelist;
+    DAQ_MsgPoolInfo_t info;
+} ReplayMsgPool;
+
+typedef struct
+{
+    /* Configuration */
+    char* filename;
+    unsigned snaplen;
+    unsigned instance;
+    unsigned total_instances;
+    unsigned loops;
+    uint64_t pps;
+    uint64_t mbps;
+    bool rewrite;
+
+    /* State */
+    DAQ_ModuleInstance_h modinst;
+    ReplayMsgPool pool;
+    ReplayImage* image;
+    unsigned next_pkt;
+    unsigned loop;
+    volatile bool interrupted;
+
+    struct timespec start;
+    uint64_t sent_pkts;
+    uint64_t sent_bits;
+
+    DAQ_Stats_t stats;
+} ReplayContext;
+
+static DAQ_VariableDesc_t replay_variable_descriptions[] = {
+    { "loops", "Number of times each instance replays the file, 0 to replay until stopped (default 1)", DAQ_VAR_DESC_REQUIRES_ARGUMENT },
+    { "pps", "Packets per second replayed by each instance (default unlimited)", DAQ_VAR_DESC_REQUIRES_ARGUMENT },
+    { "mbps", "Megabits per second replayed by each instance (default unlimited)", DAQ_VAR_DESC_REQUIRES_ARGUMENT },
+    { "no_rewrite", "Replay addresses unchanged instead of making distinct flows for each instance and loop", DAQ_VAR_DESC_FORBIDS_ARGUMENT },
+};
+
+static DAQ_BaseAPI_t daq_base_api;
+
+static pthread_mutex_t images_lock = PTHREAD_MUTEX_INITIALIZER;
+static ReplayImage* images = NULL;
+
+//-------------------------------------------------------------------------
+// utility functions
+//-------------------------------------------------------------------------
+
+static void destroy_message_pool(ReplayContext* rc)
+{
+    ReplayMsgPool* pool = &rc->pool;
+    if (pool->pool)
+    {
+        while (pool->info.size > 0)
+            free(pool->pool[--pool->info.size].data);
+        free(pool->pool);
+        pool->pool = NULL;
+    }
+    pool->freelist = NULL;
+    pool->info.available = 0;
+    pool->info.mem_size = 0;
+}
+
+static int create_message_pool(ReplayContext* rc, unsigned size)
+{
+    ReplayMsgPool* pool = &rc->pool;
+    pool->pool = calloc(sizeof(ReplayMsgDesc), size);
+    if (!pool->pool)
+    {
+        SET_ERROR(rc->modinst, "%s: Could not allocate %zu bytes for a packet descriptor pool!",
+                __func__, sizeof(ReplayMsgDesc) * size);
+        return DAQ_ERROR_NOMEM;
+    }
+    pool->info.mem_size = sizeof(ReplayMsgDesc) * size;
+    while (pool->info.size < size)
+    {
+        /* Allocate packet data and set up descriptor */
+        ReplayMsgDesc *desc = &pool->pool[pool->info.size];
+        desc->data = malloc(rc->snaplen);
+        if (!desc->data)
+        {
+            SET_ERROR(rc->modinst, "%s: Could not allocate %d bytes for a packet descriptor message buffer!",
+                    __func__, rc->snaplen);
+            return DAQ_ERROR_NOMEM;
+        }
+        pool->info.mem_size += rc->snaplen;
+
+        /* Initialize non-zero invariant packet header fields. */
+        DAQ_PktHdr_t *pkthdr = &desc->pkthdr;
+        pkthdr->ingress_index = DAQ_PKTHDR_UNKNOWN;
+        pkthdr->ingress_group = DAQ_PKTHDR_UNKNOWN;
+        pkthdr->egress_index = DAQ_PKTHDR_UNKNOWN;
+        pkthdr->egress_group = DAQ_PKTHDR_UNKNOWN;
+
+        /* Initialize non-zero invariant message header fields. */
+        DAQ_Msg_t *msg = &desc->msg;
+        msg->type = DAQ_MSG_TYPE_PACKET;
+        msg->hdr_len = sizeof(*pkthdr);
+        msg->hdr = pkthdr;
+        msg->data = desc->data;
+        msg->owner = rc->modinst;
+        msg->priv = desc;
+
+        /* Place it on the free list */
+        desc->next = pool->freelist;
+        pool->freelist = desc;
+
+        pool->info.size++;
+    }
+    pool->info.available = pool->info.size;
+    return DAQ_SUCCESS;
+}
+
+static int parse_count(const char* s, uint64_t* val)
+{
+    char* end;
+    errno = 0;
+    unsigned long long n = strtoull(s, &end, 10);
+
+    if (errno || end == s || *end)
+        return -1;
+
+    *val = n;
+    return 0;
+}
+
+static inline uint64_t elapsed_nsec(const struct timespec* start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)(now.tv_sec - start->tv_sec) * 1000000000 + now.tv_nsec - start->tv_nsec;
+}
+
+//-------------------------------------------------------------------------
+// loading
+//-------------------------------------------------------------------------
+
+static inline uint32_t load32(const uint8_t* p, bool swapped)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return swapped ? __builtin_bswap32(v) : v;
+}
+
+static inline uint16_t load16(const uint8_t* p, bool swapped)
+{
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return swapped ? __builtin_bswap16(v) : v;
+}
+
+static int add_packet(ReplayImage* img, unsigned* max, const uint8_t* data,
+    uint32_t caplen, uint32_t pktlen, uint64_t usecs)
+{
+    if (img->num_pkts == *max)
+    {
+        unsigned n = *max ? *max * 2 : 1024;
+        ReplayPkt* pkts = realloc(img->pkts, n * sizeof(*pkts));
+
+        if (!pkts)
+            return -1;
+
+        img->pkts = pkts;
+        *max = n;
+    }
+    ReplayPkt* pkt = &img->pkts[img->num_pkts++];
+    pkt->data = data;
+    pkt->caplen = caplen;
+    pkt->pktlen = pktlen;
+    pkt->usecs = usecs;
+    return 0;
+}
+
+static int load_pcap(ReplayImage* img, size_t len)
+{
+    const uint8_t* buf = img->buf;
+    uint32_t magic = load32(buf, false);
+    bool swapped = magic == __builtin_bswap32(PCAP_MAGIC_USEC) || magic == __builtin_bswap32(PCAP_MAGIC_NSEC);
+    bool nsec = load32(buf, swapped) == PCAP_MAGIC_NSEC;
+    unsigned max = 0;
+
+    img->linktype = load32(buf + 20, swapped) & 0xffff;
+
+    /* a truncated last record ends the file */
+    for (size_t off = PCAP_FILE_HDR_LEN; off + PCAP_REC_HDR_LEN <= len; )
+    {
+        const uint8_t* rec = buf + off;
+        uint32_t caplen = load32(rec + 8, swapped);
+
+        if (caplen > len - off - PCAP_REC_HDR_LEN)
+            break;
+
+        uint64_t frac = load32(rec + 4, swapped);
+        uint64_t usecs = (uint64_t)load32(rec, swapped) * 1000000 + (nsec ? frac / 1000 : frac);
+
+        if (add_packet(img, &max, rec + PCAP_REC_HDR_LEN, caplen, load32(rec + 12, swapped), usecs))
+            return -1;
+
+        off += PCAP_REC_HDR_LEN + caplen;
+    }
+    return 0;
+}
+
+/* Packets of interfaces with a link type other than the first are skipped.
+   Timestamps are converted to microseconds per interface resolution. */
+static int load_pcapng(ReplayImage* img, size_t len)
+{
+    const uint8_t* buf = img->buf;
+    bool swapped = false;
+    bool have_link = false;
+    unsigned max = 0;
+
+    uint32_t num_ifs = 0;
+    uint32_t if_snaplen[256];
+    uint64_t if_units[256];
+    bool if_ok[256];
+
+    for (size_t off = 0; off + 12 <= len; )
+    {
+        const uint8_t* blk = buf + off;
+        uint32_t type = load32(blk, false);
+
+        if (type == PCAPNG_SHB)
+        {
+            swapped = load32(blk + 8, false) != PCAPNG_BOM;
+            num_ifs = 0;
+        }
+        else
+            type = load32(blk, swapped);
+
+        uint32_t blen = load32(blk + 4, swapped);
+
+        if (blen < 12 || blen % 4 || blen > len - off)
+            break;
+
+        const uint8_t* body = blk + 8;
+        uint32_t body_len = blen - 12;
+
+        if (type == PCAPNG_IDB && body_len >= 8)
+        {
+            if (num_ifs == sizeof(if_ok) / sizeof(*if_ok))
+                return -1;
+
+            uint32_t link = load16(body, swapped);
+
+            if (!have_link)
+            {
+                img->linktype = link;
+                have_link = true;
+            }
+            if_ok[num_ifs] = link == img->linktype;
+            if_snaplen[num_ifs] = load32(body + 4, swapped);
+            if_units[num_ifs] = 1000000;
+
+            for (uint32_t o = 8; o + 4 <= body_len; )
+            {
+                uint16_t code = load16(body + o, swapped);
+                uint16_t olen = load16(body + o + 2, swapped);
+
+                if (!code || o + 4 + olen > body_len)
+                    break;
+
+                if (code == PCAPNG_OPT_TSRESOL && olen >= 1)
+                {
+                    uint8_t res = body[o + 4];
+                    uint64_t units = 1;
+
+                    for (unsigned i = 0; i < (res & 0x7f) && units < UINT64_MAX / 10; i++)
+                        units *= (res & 0x80) ? 2 : 10;
+                    if_units[num_ifs] = units;
+                }
+                o += 4 + ((olen + 3) & ~3u);
+            }
+            num_ifs++;
+        }
+        else if (type == PCAPNG_EPB && body_len >= 20)
+        {
+            uint32_t ifx = load32(body, swapped);
+            uint32_t caplen = load32(body + 12, swapped);
+
+            if (ifx < num_ifs && if_ok[ifx] && caplen <= body_len - 20)
+            {
+                uint64_t ts = ((uint64_t)load32(body + 4, swapped) << 32) | load32(body + 8, swapped);
+                uint64_t units = if_units[ifx];
+                uint64_t usecs = units == 1000000 ? ts :
+                    (ts / units) * 1000000 + (ts % units) * 1000000 / units;
+
+                if (add_packet(img, &max, body + 20, caplen, load32(body + 16, swapped), usecs))
+                    return -1;
+            }
+        }
+        else if (type == PCAPNG_SPB && body_len >= 4 && num_ifs && if_ok[0])
+        {
+            uint32_t pktlen = load32(body, swapped);
+            uint32_t caplen = pktlen;
+
+            if (if_snaplen[0] && caplen > if_snaplen[0])
+                caplen = if_snaplen[0];
+            if (caplen > body_len - 4)
+                caplen = body_len - 4;
+
+            /* simple packets have no timestamp; space them a microsecond apart */
+            uint64_t usecs = img->num_pkts ? img->pkts[img->num_pkts - 1].usecs + 1 : 0;
+
+            if (add_packet(img, &max, body + 4, caplen, pktlen, usecs))
+                return -1;
+        }
+        off += blen;
+    }
+    return 0;
+}
+
+static void image_free(ReplayImage* img)
+{
+    free(img->pkts);
+    free(img->buf);
+    free(img->filename);
+    free(img);
+}
+
+static ReplayImage* image_load(ReplayContext* rc)
+{
+    ReplayImage* img = calloc(1, sizeof(*img));
+
+    if (!img || !(img->filename = strdup(rc->filename)))
+    {
+        SET_ERROR(rc->modinst, "%s: Couldn't allocate memory for the file!", DAQ_NAME);
+        free(img);
+        return NULL;
+    }
+
+    int fd = open(rc->filename, O_RDONLY);
+    struct stat sb;
+
+    if (fd < 0 || fstat(fd, &sb))
+    {
+        SET_ERROR(rc->modinst, "%s: can't open file (%s)", DAQ_NAME, strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        image_free(img);
+        return NULL;
+    }
+
+    size_t len = sb.st_size;
+    img->buf = malloc(len ? len : 1);
+    size_t got = 0;
+
+    while (img->buf && got < len)
+    {
+        ssize_t n = read(fd, img->buf + got, len - got);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        got += n;
+    }
+    close(fd);
+
+    if (!img->buf || got < len)
+    {
+        SET_ERROR(rc->modinst, "%s: can't read file %s", DAQ_NAME, rc->filename);
+        image_free(img);
+        return NULL;
+    }
+
+    int ret = -1;
+
+    if (len >= PCAP_FILE_HDR_LEN)
+    {
+        uint32_t magic = load32(img->buf, false);
+
+        if (magic == PCAPNG_SHB)
+            ret = load_pcapng(img, len);
+
+        else if (magic == PCAP_MAGIC_USEC || magic == PCAP_MAGIC_NSEC ||
+            magic == __builtin_bswap32(PCAP_MAGIC_USEC) || magic == __builtin_bswap32(PCAP_MAGIC_NSEC))
+            ret = load_pcap(img, len);
+    }
+
+    if (ret || !img->num_pkts)
+    {
+        SET_ERROR(rc->modinst, "%s: %s is not a pcap or pcapng file with packets", DAQ_NAME, rc->filename);
+        image_free(img);
+        return NULL;
+    }
+
+    /* later loops are offset by the span of the file to keep time moving forward */
+    uint64_t first = img->pkts[0].usecs, last = first;
+
+    for (unsigned i = 0; i < img->num_pkts; i++)
+        if (img->pkts[i].usecs > last)
+            last = img->pkts[i].usecs;
+
+    img->span = last - first + 1;
+
+    return img;
+}
+
+static int image_attach(ReplayContext* rc)
+{
+    pthread_mutex_lock(&images_lock);
+
+    ReplayImage* img = images;
+
+    while (img && strcmp(img->filename, rc->filename))
+        img = img->next;
+
+    if (!img)
+    {
+        if (!(img = image_load(rc)))
+        {
+            pthread_mutex_unlock(&images_lock);
+            return DAQ_ERROR;
+        }
+        img->next = images;
+        images = img;
+    }
+    img->refs++;
+    rc->image = img;
+
+    pthread_mutex_unlock(&images_lock);
+    return DAQ_SUCCESS;
+}
+
+static void image_detach(ReplayContext* rc)
+{
+    ReplayImage* img = rc->image;
+
+    if (!img)
+        return;
+
+    rc->image = NULL;
+    pthread_mutex_lock(&images_lock);
+
+    if (!--img->refs)
+    {
+        ReplayImage** pi = &images;
+        while (*pi != img)
+            pi = &(*pi)->next;
+        *pi = img->next;
+        image_free(img);
+    }
+    pthread_mutex_unlock(&images_lock);
+}
+
+//-------------------------------------------------------------------------
+// rewriting
+//-------------------------------------------------------------------------
+
+static inline uint16_t get16(const uint8_t* p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static inline void put16(uint8_t* p, uint16_t v)
+{
+    p[0] = v >> 8;
+    p[1] = v & 0xff;
+}
+
+/* RFC 1624 eqn. 3: HC' = ~(~HC + ~m + m') */
+static inline void cksum_adjust(uint8_t* cksum, uint16_t old_word, uint16_t new_word)
+{
+    uint32_t sum = (uint16_t)~get16(cksum) + (uint16_t)~old_word + new_word;
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
+    put16(cksum, (uint16_t)~sum);
+}
+
+/* xor a 16 bit address word and fix up the checksums covering it */
+static inline void rewrite_word(uint8_t* word, uint16_t key, uint8_t* ip_cksum, uint8_t* l4_cksum)
+{
+    uint16_t old_word = get16(word);
+    uint16_t new_word = old_word ^ key;
+
+    put16(word, new_word);
+
+    if (ip_cksum)
+        cksum_adjust(ip_cksum, old_word, new_word);
+
+    if (l4_cksum)
+        cksum_adjust(l4_cksum, old_word, new_word);
+}
+
+static uint8_t* get_l4_cksum(uint8_t proto, uint8_t* l4, uint32_t len, bool ip4)
+{
+    switch (proto)
+    {
+    case 6:
+        return len >= 18 ? l4 + 16 : NULL;
+
+    case 17:
+        /* a zero udp checksum over ip4 means there is none */
+        if (len < 8 || (ip4 && !get16(l4 + 6)))
+            return NULL;
+        return l4 + 6;
+
+    case 58:
+        return len >= 4 ? l4 + 2 : NULL;
+    }
+    return NULL;
+}
+
+/* Each instance and loop gets its own replay number, in the order the
+   instances take turns.  The key for number n skips those whose low 16
+   bits are 0 since those would leave the low address bits of an IPv4
+   replay as captured.  Only number 0, the first pass of the first
+   instance, keeps its addresses.  IPv4 uses 24 bits of the key so those
+   flows start to repeat after 256 * 65535 replays; IPv6 uses all 32. */
+static inline uint32_t replay_key(const ReplayContext* rc)
+{
+    uint32_t n = rc->loop * rc->total_instances + rc->instance;
+    return n ? n + (n - 1) / 0xffff : 0;
+}
+
+/* Both addresses are xored with the same key so the directions of a flow
+   stay paired.  Only the low order address bits change, and for IPv4 the
+   second octet, keeping the first octet and so the class of each address.
+   Ports are left alone so services are still identified.  L4 checksums
+   are updated when the header follows the IP header directly. */
+static void rewrite_packet(uint32_t linktype, uint8_t* pkt, uint32_t len, uint32_t key)
+{
+    FlowL3 f;
+
+    if (!flow_get_l3(linktype, pkt, len, &f))
+        return;
+
+    uint8_t* p = pkt + f.l3;
+
+    if (f.addr_len == 4)
+    {
+        uint16_t hi = (key >> 16) & 0xff;
+        uint16_t lo = key & 0xffff;
+        bool first_frag = !(f.frag & 0x1fff);
+        uint8_t* l4_cksum = first_frag ? get_l4_cksum(p[9], pkt + f.l4, f.l4_len, true) : NULL;
+
+        if (l4_cksum && p[9] != 6 && p[9] != 17)
+            l4_cksum = NULL;
+
+        rewrite_word(p + 12, hi, p + 10, l4_cksum);
+        rewrite_word(p + 14, lo, p + 10, l4_cksum);
+        rewrite_word(p + 16, hi, p + 10, l4_cksum);
+        rewrite_word(p + 18, lo, p + 10, l4_cksum);
+
+        /* zero is reserved for no checksum */
+        if (l4_cksum && p[9] == 17 && !get16(l4_cksum))
+            put16(l4_cksum, 0xffff);
+    }
+    else
+    {
+        uint8_t* l4_cksum = get_l4_cksum(p[6], pkt + f.l4, f.l4_len, false);
+
+        rewrite_word(p + 20, key >> 16, NULL, l4_cksum);
+        rewrite_word(p + 22, key & 0xffff, NULL, l4_cksum);
+        rewrite_word(p + 36, key >> 16, NULL, l4_cksum);
+        rewrite_word(p + 38, key & 0xffff, NULL, l4_cksum);
+
+        if (l4_cksum && p[6] == 17 && !get16(l4_cksum))
+            put16(l4_cksum, 0xffff);
+    }
+}
+
+//-------------------------------------------------------------------------
+// replay
+//-------------------------------------------------------------------------
+
+/* nanoseconds from the start of the replay at which the next packet is due */
+static uint64_t next_due(const ReplayContext* rc)
+{
+    uint64_t due = 0;
+
+    if (rc->pps)
+        due = rc->sent_pkts * 1000000000 / rc->pps;
+
+    if (rc->mbps)
+    {
+        uint64_t bits_due = rc->sent_bits * 1000 / rc->mbps;
+        if (bits_due > due)
+            due = bits_due;
+    }
+    return due;
+}
+
+/* returns false if the packet isn't due before the caller should return */
+static bool pace(ReplayContext* rc, bool have_batch)
+{
+    uint64_t due = next_due(rc);
+
+    while (true)
+    {
+        uint64_t now = elapsed_nsec(&rc->start);
+
+        if (now >= due)
+            return true;
+
+        if (have_batch || rc->interrupted)
+            return false;
+
+        uint64_t wait = due - now;
+        struct timespec ts = { 0, wait < REPLAY_MAX_SLEEP_NSEC ? (long)wait : REPLAY_MAX_SLEEP_NSEC };
+        nanosleep(&ts, NULL);
+    }
+}
+
+static void replay_packet(ReplayContext* rc, ReplayMsgDesc* desc)
+{
+    const ReplayImage* img = rc->image;
+    const ReplayPkt* pkt = &img->pkts[rc->next_pkt];
+    DAQ_PktHdr_t* pkthdr = &desc->pkthdr;
+
+    /* packets are copied since they may be rewritten or modified in place */
+    uint32_t len = pkt->caplen < rc->snaplen ? pkt->caplen : rc->snaplen;
+    memcpy(desc->data, pkt->data, len);
+    desc->msg.data_len = len;
+
+    uint32_t key = replay_key(rc);
+
+    if (rc->rewrite && key)
+        rewrite_packet(img->linktype, desc->data, len, key);
+
+    uint64_t usecs = pkt->usecs + rc->loop * img->span;
+    pkthdr->ts.tv_sec = usecs / 1000000;
+    pkthdr->ts.tv_usec = usecs % 1000000;
+    pkthdr->pktlen = pkt->pktlen;
+
+    rc->sent_pkts++;
+    rc->sent_bits += (uint64_t)pkt->pktlen * 8;
+
+    if (++rc->next_pkt == img->num_pkts)
+    {
+        rc->next_pkt = 0;
+        rc->loop++;
+    }
+}
+
+//-------------------------------------------------------------------------
+// daq
+//-------------------------------------------------------------------------
+
+static int replay_daq_module_load(const DAQ_BaseAPI_t* base_api)
+{
+    if (base_api->api_version != DAQ_BASE_API_VERSION || base_api->api_size != sizeof(DAQ_BaseAPI_t))
+        return DAQ_ERROR;
+
+    daq_base_api = *base_api;
+
+    return DAQ_SUCCESS;
+}
+
+static int replay_daq_get_variable_descs(const DAQ_VariableDesc_t** var_desc_table)
+{
+    *var_desc_table = replay_variable_descriptions;
+
+    return sizeof(replay_variable_descriptions) / sizeof(DAQ_VariableDesc_t);
+}
+
+static int replay_daq_instantiate(const DAQ_ModuleConfig_h modcfg, DAQ_ModuleInstance_h modinst, void** ctxt_ptr)
+{
+    ReplayContext* rc;
+    int rval = DAQ_ERROR;
+
+    rc = calloc(1, sizeof(*rc));
+    if (!rc)
+    {
+        SET_ERROR(modinst, "%s: Couldn't allocate memory for the new Replay context!", DAQ_NAME);
+        rval = DAQ_ERROR_NOMEM;
+        goto err;
+    }
+    rc->modinst = modinst;
+
+    rc->snaplen = daq_base_api.config_get_snaplen(modcfg) ? daq_base_api.config_get_snaplen(modcfg) : REPLAY_DEFAULT_SNAPLEN;
+    rc->total_instances = daq_base_api.config_get_total_instances(modcfg) ? daq_base_api.config_get_total_instances(modcfg) : 1;
+    rc->instance = daq_base_api.config_get_instance_id(modcfg) ? daq_base_api.config_get_instance_id(modcfg) - 1 : 0;
+    rc->loops = 1;
+    rc->rewrite = true;
+
+    const char* varKey, * varValue;
+    daq_base_api.config_first_variable(modcfg, &varKey, &varValue);
+    while (varKey)
+    {
+        uint64_t n = 0;
+
+        if (!strcmp(varKey, "no_rewrite"))
+            rc->rewrite = false;
+
+        else if (!varValue || parse_count(varValue, &n))
+        {
+            SET_ERROR(modinst, "%s: Invalid value for %s: '%s'", DAQ_NAME, varKey, varValue ? varValue : "");
+            rval = DAQ_ERROR_INVAL;
+            goto err;
+        }
+        else if (!strcmp(varKey, "loops") && n <= UINT32_MAX)
+            rc->loops = (unsigned) n;
+
+        else if (!strcmp(varKey, "pps"))
+            rc->pps = n;
+
+        else if (!strcmp(varKey, "mbps"))
+            rc->mbps = n;
+
+        else
+        {
+            SET_ERROR(modinst, "%s: Unknown variable name or bad value: '%s'", DAQ_NAME, varKey);
+            rval = DAQ_ERROR_INVAL;
+            goto err;
+        }
+
+        daq_base_api.config_next_variable(modcfg, &varKey, &varValue);
+    }
+
+    const char* filename = daq_base_api.config_get_input(modcfg);
+    if (!filename || !(rc->filename = strdup(filename)))
+    {
+        SET_ERROR(modinst, "%s: Couldn't allocate memory for the filename!", DAQ_NAME);
+        rval = DAQ_ERROR_NOMEM;
+        goto err;
+    }
+
+    uint32_t pool_size = daq_base_api.config_get_msg_pool_size(modcfg);
+    rval = create_message_pool(rc, pool_size ? pool_size : REPLAY_DEFAULT_POOL_SIZE);
+    if (rval != DAQ_SUCCESS)
+        goto err;
+
+    *ctxt_ptr = rc;
+
+    return DAQ_SUCCESS;
+
+err:
+    if (rc)
+    {
+        if (rc->filename)
+            free(rc->filename);
+        destroy_message_pool(rc);
+        free(rc);
+    }
+    return rval;
+}
+
+static void replay_daq_destroy(void* handle)
+{
+    ReplayContext* rc = (ReplayContext*) handle;
+
+    image_detach(rc);
+
+    if (rc->filename)
+        free(rc->filename);
+    destroy_message_pool(rc);
+    free(rc);
+}
+
+static int replay_daq_start(void* handle)
+{
+    ReplayContext* rc = (ReplayContext*) handle;
+
+    if (image_attach(rc))
+        return DAQ_ERROR;
+
+    rc->next_pkt = 0;
+    rc->loop = 0;
+    rc->sent_pkts = 0;
+    rc->sent_bits = 0;
+    clock_gettime(CLOCK_MONOTONIC, &rc->start);
+
+    return DAQ_SUCCESS;
+}
+
+static int replay_daq_interrupt(void* handle)
+{
+    ReplayContext* rc = (ReplayContext*) handle;
+    rc->interrupted = true;
+    return DAQ_SUCCESS;
+}
+
+static int replay_daq_stop(void* handle)
+{
+    ReplayContext* rc = (ReplayContext*) handle;
+    image_detach(rc);
+    return DAQ_SUCCESS;
+}
+
+static int replay_daq_get_stats(void* handle, DAQ_Stats_t* stats)
+{
+    ReplayContext* rc = (ReplayContext*) handle;
+    memcpy(stats, &rc->stats, sizeof(DAQ_Stats_t));
+    return DAQ_SUCCESS;
+}
+
+static void replay_daq_reset_stats(void* handle)
+{
+    ReplayContext* rc = (ReplayContext*) handle;
+    memset(&rc->stats, 0, sizeof(rc->stats));
+}
+
+static int replay_daq_get_snaplen(void* handle)
+{
+    ReplayContext* rc = (ReplayContext*) handle;
+    return rc->snaplen;
+}
+
+static uint32_t replay_daq_get_capabilities(void* handle)
+{
+    (void) handle;
+    return DAQ_CAPA_BLOCK | DAQ_CAPA_REPLACE | DAQ_CAPA_INTERRUPT | DAQ_CAPA_UNPRIV_START;
+}
+
+static int replay_daq_get_datalink_type(void* handle)
+{
+    ReplayContext* rc = (ReplayContext*) handle;
+
+    if (!rc->image)
+        return DAQ_ERROR;
+
+    return rc->image->linktype == LINKTYPE_RAW ? DLT_RAW_IP : (int) rc->image->linktype;
+}
+
+static unsigned replay_daq_msg_receive(void* handle, const unsigned max_recv, const DAQ_Msg_t* msgs[], DAQ_RecvStatus* rstat)
+{
+    ReplayContext* rc = (ReplayContext*) handle;
+    DAQ_RecvStatus status = DAQ_RSTAT_OK;
+    bool paced = rc->pps || rc->mbps;
+    unsigned idx = 0;
+
+    while (idx < max_recv)
+    {
+        /* Check to see if the receive has been canceled.  If so, reset it and return appropriately. */
+        if (rc->interrupted)
+        {
+            rc->interrupted = false;
+            status = DAQ_RSTAT_INTERRUPTED;
+            break;
+        }
+
+        if (rc->loops && rc->loop >= rc->loops)
+        {
+            status = DAQ_RSTAT_EOF;
+            break;
+        }
+
+        /* Make sure that we have a message descriptor available to populate. */
+        ReplayMsgDesc* desc = rc->pool.freelist;
+        if (!desc)
+        {
+            status = DAQ_RSTAT_NOBUF;
+            break;
+        }
+
+        /* return what we have rather than wait for the next packet */
+        if (paced && !pace(rc, idx > 0))
+        {
+            if (rc->interrupted)
+                continue;
+            break;
+        }
+
+        replay_packet(rc, desc);
+
+        rc->stats.hw_packets_received++;
+        rc->stats.packets_received++;
+
+        /* Last, but not least, extract this descriptor from the free list and
+           place the message in the return vector. */
+        rc->pool.freelist = desc->next;
+        desc->next = NULL;
+        rc->pool.info.available--;
+        msgs[idx] = &desc->msg;
+
+        idx++;
+    }
+
+    *rstat = status;
+
+    return idx;
+}
+
+static int replay_daq_msg_finalize(void* handle, const DAQ_Msg_t* msg, DAQ_Verdict verdict)
+{
+    ReplayContext* rc = (ReplayContext*) handle;
+    ReplayMsgDesc* desc = (ReplayMsgDesc *) msg->priv;
+
+    if (verdict >= MAX_DAQ_VERDICT)
+        verdict = DAQ_VERDICT_PASS;
+    rc->stats.verdicts[verdict]++;
+
+    /* Toss the descriptor back on the free list for reuse. */
+    desc->next = rc->pool.freelist;
+    rc->pool.freelist = desc;
+    rc->pool.info.available++;
+
+    return DAQ_SUCCESS;
+}
+
+static int replay_daq_get_msg_pool_info(void* handle, DAQ_MsgPoolInfo_t* info)
+{
+    ReplayContext* rc = (ReplayContext*) handle;
+
+    *info = rc->pool.info;
+
+    return DAQ_SUCCESS;
+}
+
+//-------------------------------------------------------------------------
+
+#ifdef BUILDING_SO
+DAQ_SO_PUBLIC const DAQ_ModuleAPI_t DAQ_MODULE_DATA =
+#else
+const DAQ_ModuleAPI_t replay_daq_module_data =
+#endif
+{
+    /* .api_version = */ DAQ_MODULE_API_VERSION,
+    /* .api_size = */ sizeof(DAQ_ModuleAPI_t),
+    /* .module_version = */ DAQ_MOD_VERSION,
+    /* .name = */ DAQ_NAME,
+    /* .type = */ DAQ_TYPE,
+    /* .load = */ replay_daq_module_load,
+    /* .unload = */ NULL,
+    /* .get_variable_descs = */ replay_daq_get_variable_descs,
+    /* .instantiate = */ replay_daq_instantiate,
+    /* .destroy = */ replay_daq_destroy,
+    /* .set_filter = */ NULL,
+    /* .start = */ replay_daq_start,
+    /* .inject = */ NULL,
+    /* .inject_relative = */ NULL,
+    /* .interrupt = */ replay_daq_interrupt,
+    /* .stop = */ replay_daq_stop,
+    /* .ioctl = */ NULL,
+    /* .get_stats = */ replay_daq_get_stats,
+    /* .reset_stats = */ replay_daq_reset_stats,
+    /* .get_snaplen = */ replay_daq_get_snaplen,
+    /* .get_capabilities = */ replay_daq_get_capabilities,
+    /* .get_datalink_type = */ replay_daq_get_datalink_type,
+    /* .config_load = */ NULL,
+    /* .config_swap = */ NULL,
+    /* .config_free = */ NULL,
+    /* .msg_receive = */ replay_daq_msg_receive,
+    /* .msg_finalize = */ replay_daq_msg_finalize,
+    /* .get_msg_pool_info = */ replay_daq_get_msg_pool_info,
+};
+
@@ -0,0 +1,910 @@
+/*--------------------------------------------------------------------------
+// Copyright (C) 2023-2023 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+*/
+/* daq_rss.c */
+
+/* A wrapper module that spreads one input over all packet threads, like RSS
+   in a NIC.  The first instance of an input to start is the only one to
+   start the module below it.  A distributor thread receives from that module
+   and dispatches each message by a symmetric flow hash to the ring of one
+   instance, so both directions of a flow are processed by the same thread;
+   SOF and EOF messages are hashed from their flow stats to the same ring.
+   Verdicts go back to the distributor on a second ring per instance since
+   only the distributor may call the module below.  By default a message for
+   a full ring is held, and nothing more is received, until the ring has
+   room.  Otherwise, and for the ring of an instance that has stopped or not
+   yet started, it is finalized right away and counted as a ring drop. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <arpa/inet.h>
+#include <daq_module_api.h>
+
+#include "daq_flow.h"
+#include "daq_user.h"
+
+#define DAQ_MOD_VERSION 0
+#define DAQ_NAME "rss"
+#define DAQ_TYPE (DAQ_TYPE_WRAPPER|DAQ_TYPE_INLINE_CAPABLE)
+
+#define RSS_DEFAULT_RING_SIZE 4096
+#define RSS_BATCH_SIZE 64
+#define RSS_IDLE_NSEC 50000
+
+#define SET_ERROR(modinst, ...)    daq_base_api.set_errbuf(modinst, __VA_ARGS__)
+
+#define CALL_SUBAPI_NOARGS(ctxt, fname) \
+    ctxt->subapi.fname.func(ctxt->subapi.fname.context)
+
+#define CALL_SUBAPI(ctxt, fname, ...) \
+    ctxt->subapi.fname.func(ctxt->subapi.fname.context, __VA_ARGS__)
+
+/* what is done with a message for a full ring */
+typedef enum
+{
+    RSS_OVERFLOW_WAIT,
+    RSS_OVERFLOW_PASS,
+    RSS_OVERFLOW_BLOCK
+} RssOverflow;
+
+typedef struct
+{
+    const DAQ_Msg_t* msg;
+    DAQ_Verdict verdict;
+} RssEntry;
+
+/* single producer, single consumer */
+typedef struct
+{
+    RssEntry* ents;
+    unsigned mask;
+    atomic_uint head;
+    atomic_uint tail;
+} RssRing;
+
+/* to_inst is filled by the distributor and emptied by the instance; verdicts
+   go the other way on to_dist */
+typedef struct
+{
+    RssRing to_inst;
+    RssRing to_dist;
+    atomic_bool closed;
+    _Atomic uint64_t dispatched;
+    _Atomic uint64_t drops;
+} RssQueue;
+
+typedef struct _rss_distributor
+{
+    char* input;
+    RssQueue* queues;
+    unsigned num_queues;
+    unsigned attached;
+    unsigned detached;
+    bool hash_ports;
+    RssOverflow overflow;
+    int dlt;
+
+    /* the instance that started the module below */
+    struct _rss_context* owner;
+
+    pthread_t thread;
+    bool running;
+    atomic_bool stop;
+    atomic_bool done;
+    atomic_bool stopped;
+
+    struct _rss_distributor* next;
+} RssDistributor;
+
+typedef struct _rss_context
+{
+    /* Configuration */
+    char* input;
+    unsigned timeout;
+    unsigned num_queues;
+    unsigned ring_size;
+    bool hash_ports;
+    RssOverflow overflow;
+
+    /* State */
+    DAQ_ModuleInstance_h modinst;
+    DAQ_InstanceAPI_t subapi;
+    RssDistributor* dist;
+    RssQueue* queue;
+    unsigned outstanding;
+    volatile bool interrupted;
+
+    DAQ_Stats_t stats;
+} RssContext;
+
+static DAQ_VariableDesc_t rss_variable_descriptions[] = {
+    { "ring_size", "Messages queued to each packet thread, rounded up to a power of 2 (default 4096)", DAQ_VAR_DESC_REQUIRES_ARGUMENT },
+    { "hash", "Flow hash: 'ip' for addresses only (default) or '5tuple' to include protocol and ports", DAQ_VAR_DESC_REQUIRES_ARGUMENT },
+    { "overflow", "For a full ring: 'wait' to stop receiving until it has room (default), 'pass' or 'block' to finalize the message with that verdict", DAQ_VAR_DESC_REQUIRES_ARGUMENT },
+};
+
+static DAQ_BaseAPI_t daq_base_api;
+
+/* distributors are shared by the instances of an input and found by name */
+static pthread_mutex_t dists_lock = PTHREAD_MUTEX_INITIALIZER;
+static RssDistributor* dists = NULL;
+
+//-------------------------------------------------------------------------
+// utility functions
+//-------------------------------------------------------------------------
+
+static void rss_sleep(void)
+{
+    struct timespec ts = { 0, RSS_IDLE_NSEC };
+    nanosleep(&ts, NULL);
+}
+
+static bool rss_ring_init(RssRing* ring, unsigned size)
+{
+    ring->mask = size - 1;
+    ring->ents = calloc(size, sizeof(*ring->ents));
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    return ring->ents != NULL;
+}
+
+static bool rss_ring_push(RssRing* ring, const DAQ_Msg_t* msg, DAQ_Verdict verdict)
+{
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    if (head - atomic_load_explicit(&ring->tail, memory_order_acquire) > ring->mask)
+        return false;
+
+    RssEntry* e = &ring->ents[head & ring->mask];
+    e->msg = msg;
+    e->verdict = verdict;
+
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return true;
+}
+
+static bool rss_ring_pop(RssRing* ring, RssEntry* e)
+{
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+    if (tail == atomic_load_explicit(&ring->head, memory_order_acquire))
+        return false;
+
+    *e = ring->ents[tail & ring->mask];
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// distributor
+//-------------------------------------------------------------------------
+
+/* returns the number of verdicts submitted */
+static unsigned rss_drain(RssDistributor* d)
+{
+    RssContext* oc = d->owner;
+    unsigned n = 0;
+
+    for (unsigned i = 0; i < d->num_queues; i++)
+    {
+        RssEntry e;
+
+        while (rss_ring_pop(&d->queues[i].to_dist, &e))
+        {
+            CALL_SUBAPI(oc, msg_finalize, e.msg, e.verdict);
+            n++;
+        }
+    }
+    return n;
+}
+
+/* SOF and EOF carry the addresses, ports, and protocol of their flow, with
+   IPv4 addresses mapped into IPv6, and hash as its packets do */
+static uint32_t rss_flow_stats_hash(const DAQ_Msg_t* msg, bool hash_ports)
+{
+    if (msg->hdr_len < sizeof(DAQ_FlowStats_t))
+        return 0;
+
+    const DAQ_FlowStats_t* fs = (const DAQ_FlowStats_t*) msg->hdr;
+    const uint8_t* src = (const uint8_t*) &fs->initiator_ip;
+    const uint8_t* dst = (const uint8_t*) &fs->responder_ip;
+    static const uint8_t mapped[12] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff };
+    unsigned addr_len = 16;
+
+    if (!memcmp(src, mapped, sizeof(mapped)) && !memcmp(dst, mapped, sizeof(mapped)))
+    {
+        src += sizeof(mapped);
+        dst += sizeof(mapped);
+        addr_len = 4;
+    }
+
+    if (hash_ports && flow_has_ports(fs->protocol))
+        return flow_hash_tuple(src, dst, addr_len, fs->protocol,
+            ntohs(fs->initiator_port), ntohs(fs->responder_port));
+
+    return flow_hash_tuple(src, dst, addr_len, 0, 0, 0);
+}
+
+static unsigned rss_queue_index(const RssDistributor* d, const DAQ_Msg_t* msg)
+{
+    switch (msg->type)
+    {
+    case DAQ_MSG_TYPE_PACKET:
+        return flow_hash(d->dlt, msg->data, msg->data_len, d->hash_ports) % d->num_queues;
+
+    case DAQ_MSG_TYPE_SOF:
+    case DAQ_MSG_TYPE_EOF:
+        return rss_flow_stats_hash(msg, d->hash_ports) % d->num_queues;
+
+    default:
+        return 0;
+    }
+}
+
+static unsigned rss_attached(RssDistributor* d)
+{
+    pthread_mutex_lock(&dists_lock);
+    unsigned n = d->attached;
+    pthread_mutex_unlock(&dists_lock);
+    return n;
+}
+
+static void rss_drop(RssDistributor* d, RssQueue* q, const DAQ_Msg_t* msg, DAQ_Verdict verdict)
+{
+    atomic_fetch_add_explicit(&q->drops, 1, memory_order_relaxed);
+    CALL_SUBAPI(d->owner, msg_finalize, msg, verdict);
+}
+
+/* false if the message must wait for room in its ring; only an instance
+   that has started and not stopped can make room */
+static bool rss_dispatch(RssDistributor* d, const DAQ_Msg_t* msg)
+{
+    RssQueue* q = &d->queues[rss_queue_index(d, msg)];
+
+    if (atomic_load(&q->closed))
+    {
+        rss_drop(d, q, msg, DAQ_VERDICT_PASS);
+        return true;
+    }
+
+    if (rss_ring_push(&q->to_inst, msg, DAQ_VERDICT_PASS))
+    {
+        atomic_fetch_add_explicit(&q->dispatched, 1, memory_order_relaxed);
+        return true;
+    }
+
+    if (d->overflow == RSS_OVERFLOW_WAIT && (unsigned) (q - d->queues) < rss_attached(d))
+        return false;
+
+    rss_drop(d, q, msg, d->overflow == RSS_OVERFLOW_BLOCK ? DAQ_VERDICT_BLOCK : DAQ_VERDICT_PASS);
+    return true;
+}
+
+/* A message that must wait holds back the rest of its batch, which keeps
+   each flow in order, and nothing more is received until it is dispatched.
+   Verdicts are passed down meanwhile so the module below can go on. */
+static void* rss_run(void* arg)
+{
+    RssDistributor* d = (RssDistributor*) arg;
+    RssContext* oc = d->owner;
+    const DAQ_Msg_t* msgs[RSS_BATCH_SIZE];
+    unsigned num = 0;
+    unsigned next = 0;
+    bool eof = false;
+
+    while (!atomic_load(&d->stop))
+    {
+        unsigned drained = rss_drain(d);
+
+        if (next == num)
+        {
+            if (eof)
+                break;
+
+            DAQ_RecvStatus rstat;
+            num = CALL_SUBAPI(oc, msg_receive, RSS_BATCH_SIZE, msgs, &rstat);
+            next = 0;
+
+            if (rstat == DAQ_RSTAT_EOF || rstat == DAQ_RSTAT_ERROR)
+                eof = true;
+
+            /* the pool below is held by the packet threads; wait for verdicts */
+            else if (rstat == DAQ_RSTAT_NOBUF && !num && !drained)
+                rss_sleep();
+        }
+
+        while (next < num && rss_dispatch(d, msgs[next]))
+            next++;
+
+        if (next < num && !drained)
+            rss_sleep();
+    }
+
+    /* stopping; messages held back are passed */
+    for (; next < num; next++)
+        rss_drop(d, &d->queues[rss_queue_index(d, msgs[next])], msgs[next], DAQ_VERDICT_PASS);
+
+    atomic_store(&d->done, true);
+    return NULL;
+}
+
+static void rss_distributor_free(RssDistributor* d)
+{
+    if (d->queues)
+    {
+        for (unsigned i = 0; i < d->num_queues; i++)
+        {
+            free(d->queues[i].to_inst.ents);
+            free(d->queues[i].to_dist.ents);
+        }
+        free(d->queues);
+    }
+    free(d->input);
+    free(d);
+}
+
+static RssDistributor* rss_distributor_new(RssContext* rc)
+{
+    RssDistributor* d = calloc(1, sizeof(*d));
+    if (!d || !(d->input = strdup(rc->input)))
+    {
+        SET_ERROR(rc->modinst, "%s: Couldn't allocate memory for the distributor!", DAQ_NAME);
+        free(d);
+        return NULL;
+    }
+    d->hash_ports = rc->hash_ports;
+    d->overflow = rc->overflow;
+    d->num_queues = rc->num_queues;
+
+    d->queues = calloc(d->num_queues, sizeof(*d->queues));
+    if (!d->queues)
+    {
+        SET_ERROR(rc->modinst, "%s: Couldn't allocate memory for the rings!", DAQ_NAME);
+        rss_distributor_free(d);
+        return NULL;
+    }
+
+    for (unsigned i = 0; i < d->num_queues; i++)
+    {
+        RssQueue* q = &d->queues[i];
+        atomic_init(&q->closed, false);
+        atomic_init(&q->dispatched, 0);
+        atomic_init(&q->drops, 0);
+
+        /* verdicts can't outnumber the messages dispatched */
+        if (!rss_ring_init(&q->to_inst, rc->ring_size) || !rss_ring_init(&q->to_dist, rc->ring_size))
+        {
+            SET_ERROR(rc->modinst, "%s: Couldn't allocate memory for the rings!", DAQ_NAME);
+            rss_distributor_free(d);
+            return NULL;
+        }
+    }
+    atomic_init(&d->stop, false);
+    atomic_init(&d->done, false);
+    atomic_init(&d->stopped, false);
+
+    return d;
+}
+
+/* The first instance to start owns the distributor: it starts the module
+   below and the distributor thread.  Instances take the rings in the order
+   they start.  A distributor that is stopping takes no more instances. */
+static int rss_attach(RssContext* rc)
+{
+    pthread_mutex_lock(&dists_lock);
+
+    RssDistributor* d = dists;
+
+    while (d && (d->attached == d->num_queues || atomic_load(&d->stop) || strcmp(d->input, rc->input)))
+        d = d->next;
+
+    if (!d)
+    {
+        if (!(d = rss_distributor_new(rc)))
+        {
+            pthread_mutex_unlock(&dists_lock);
+            return DAQ_ERROR;
+        }
+
+        d->owner = rc;
+
+        if (CALL_SUBAPI_NOARGS(rc, start) != DAQ_SUCCESS)
+        {
+            pthread_mutex_unlock(&dists_lock);
+            rss_distributor_free(d);
+            return DAQ_ERROR;
+        }
+        d->dlt = CALL_SUBAPI_NOARGS(rc, get_datalink_type);
+
+        if (pthread_create(&d->thread, NULL, rss_run, d))
+        {
+            SET_ERROR(rc->modinst, "%s: Couldn't start the distributor thread!", DAQ_NAME);
+            CALL_SUBAPI_NOARGS(rc, stop);
+            pthread_mutex_unlock(&dists_lock);
+            rss_distributor_free(d);
+            return DAQ_ERROR;
+        }
+        d->running = true;
+        d->next = dists;
+        dists = d;
+    }
+
+    rc->dist = d;
+    rc->queue = &d->queues[d->attached++];
+
+    pthread_mutex_unlock(&dists_lock);
+    return DAQ_SUCCESS;
+}
+
+/* The owner stops the distributor thread and then passes verdicts along
+   until every other instance that started has stopped.  There is no time
+   limit: their messages point into the pool of the module below, so it
+   can't be stopped (and the owner's instance can't be destroyed) while any
+   of them is outstanding.  Messages queued for instances that have stopped,
+   or that never started, are passed. */
+static void rss_stop_owner(RssContext* rc)
+{
+    RssDistributor* d = rc->dist;
+
+    /* no instance attaches once stop is set so attached is final */
+    pthread_mutex_lock(&dists_lock);
+    atomic_store(&d->stop, true);
+    unsigned attached = d->attached;
+    pthread_mutex_unlock(&dists_lock);
+
+    CALL_SUBAPI_NOARGS(rc, interrupt);
+    pthread_join(d->thread, NULL);
+    d->running = false;
+
+    while (true)
+    {
+        bool open = false;
+
+        for (unsigned i = 0; i < d->num_queues; i++)
+        {
+            RssQueue* q = &d->queues[i];
+            RssEntry e;
+
+            if (i < attached && q != rc->queue && !atomic_load(&q->closed))
+            {
+                open = true;
+                continue;
+            }
+
+            while (rss_ring_pop(&q->to_inst, &e))
+                CALL_SUBAPI(rc, msg_finalize, e.msg, DAQ_VERDICT_PASS);
+        }
+
+        /* an instance closes after its last verdict is queued */
+        unsigned drained = rss_drain(d);
+
+        if (!open)
+            break;
+
+        if (!drained)
+            rss_sleep();
+    }
+
+    atomic_store(&d->stopped, true);
+    CALL_SUBAPI_NOARGS(rc, stop);
+}
+
+/* The last instance to stop frees the distributor. */
+static void rss_detach(RssContext* rc)
+{
+    RssDistributor* d = rc->dist;
+
+    if (!d)
+        return;
+
+    if (d->owner == rc)
+        rss_stop_owner(rc);
+
+    atomic_store(&rc->queue->closed, true);
+    rc->dist = NULL;
+    rc->queue = NULL;
+
+    pthread_mutex_lock(&dists_lock);
+
+    if (++d->detached < d->attached)
+    {
+        pthread_mutex_unlock(&dists_lock);
+        return;
+    }
+
+    RssDistributor** pd = &dists;
+    while (*pd != d)
+        pd = &(*pd)->next;
+    *pd = d->next;
+
+    pthread_mutex_unlock(&dists_lock);
+
+    rss_distributor_free(d);
+}
+
+//-------------------------------------------------------------------------
+// daq
+//-------------------------------------------------------------------------
+
+static int rss_daq_module_load(const DAQ_BaseAPI_t* base_api)
+{
+    if (base_api->api_version != DAQ_BASE_API_VERSION || base_api->api_size != sizeof(DAQ_BaseAPI_t))
+        return DAQ_ERROR;
+
+    daq_base_api = *base_api;
+
+    return DAQ_SUCCESS;
+}
+
+static int rss_daq_get_variable_descs(const DAQ_VariableDesc_t** var_desc_table)
+{
+    *var_desc_table = rss_variable_descriptions;
+
+    return sizeof(rss_variable_descriptions) / sizeof(DAQ_VariableDesc_t);
+}
+
+static int rss_daq_instantiate(const DAQ_ModuleConfig_h modcfg, DAQ_ModuleInstance_h modinst, void** ctxt_ptr)
+{
+    RssContext* rc;
+    int rval = DAQ_ERROR;
+
+    rc = calloc(1, sizeof(*rc));
+    if (!rc)
+    {
+        SET_ERROR(modinst, "%s: Couldn't allocate memory for the new RSS context!", DAQ_NAME);
+        rval = DAQ_ERROR_NOMEM;
+        goto err;
+    }
+    rc->modinst = modinst;
+
+    if (daq_base_api.resolve_subapi(modinst, &rc->subapi) != DAQ_SUCCESS)
+    {
+        SET_ERROR(modinst, "%s: Couldn't resolve subapi. No submodule?", DAQ_NAME);
+        goto err;
+    }
+
+    rc->timeout = daq_base_api.config_get_timeout(modcfg);
+    rc->num_queues = daq_base_api.config_get_total_instances(modcfg) ? daq_base_api.config_get_total_instances(modcfg) : 1;
+    rc->ring_size = RSS_DEFAULT_RING_SIZE;
+
+    const char* varKey, * varValue;
+    daq_base_api.config_first_variable(modcfg, &varKey, &varValue);
+    while (varKey)
+    {
+        if (!strcmp(varKey, "ring_size"))
+        {
+            unsigned long n = strtoul(varValue, NULL, 10);
+            if (!n || n > (1u << 24))
+            {
+                SET_ERROR(modinst, "%s: Invalid ring size: '%s'", DAQ_NAME, varValue);
+                rval = DAQ_ERROR_INVAL;
+                goto err;
+            }
+            rc->ring_size = 1;
+            while (rc->ring_size < n)
+                rc->ring_size <<= 1;
+        }
+        else if (!strcmp(varKey, "overflow"))
+        {
+            if (!strcmp(varValue, "wait"))
+                rc->overflow = RSS_OVERFLOW_WAIT;
+            else if (!strcmp(varValue, "pass"))
+                rc->overflow = RSS_OVERFLOW_PASS;
+            else if (!strcmp(varValue, "block"))
+                rc->overflow = RSS_OVERFLOW_BLOCK;
+            else
+            {
+                SET_ERROR(modinst, "%s: Invalid overflow: '%s'", DAQ_NAME, varValue);
+                rval = DAQ_ERROR_INVAL;
+                goto err;
+            }
+        }
+        else if (!strcmp(varKey, "hash"))
+        {
+            if (!strcmp(varValue, "5tuple"))
+                rc->hash_ports = true;
+            else if (strcmp(varValue, "ip"))
+            {
+                SET_ERROR(modinst, "%s: Invalid hash: '%s'", DAQ_NAME, varValue);
+                rval = DAQ_ERROR_INVAL;
+                goto err;
+            }
+        }
+        else
+        {
+            SET_ERROR(modinst, "%s: Unknown variable name: '%s'", DAQ_NAME, varKey);
+            rval = DAQ_ERROR_INVAL;
+            goto err;
+        }
+
+        daq_base_api.config_next_variable(modcfg, &varKey, &varValue);
+    }
+
+    const char* input = daq_base_api.config_get_input(modcfg);
+    if (!(rc->input = strdup(input ? input : "")))
+    {
+        SET_ERROR(modinst, "%s: Couldn't allocate memory for the input!", DAQ_NAME);
+        rval = DAQ_ERROR_NOMEM;
+        goto err;
+    }
+
+    *ctxt_ptr = rc;
+
+    return DAQ_SUCCESS;
+
+err:
+    if (rc)
+    {
+        if (rc->input)
+            free(rc->input);
+        free(rc);
+    }
+    return rval;
+}
+
+static void rss_daq_destroy(void* handle)
+{
+    RssContext* rc = (RssContext*) handle;
+
+    rss_detach(rc);
+
+    free(rc->input);
+    free(rc);
+}
+
+static int rss_daq_start(void* handle)
+{
+    RssContext* rc = (RssContext*) handle;
+
+    if (rss_attach(rc))
+        return DAQ_ERROR;
+
+    return DAQ_SUCCESS;
+}
+
+static int rss_daq_interrupt(void* handle)
+{
+    RssContext* rc = (RssContext*) handle;
+    rc->interrupted = true;
+    return DAQ_SUCCESS;
+}
+
+static int rss_daq_stop(void* handle)
+{
+    RssContext* rc = (RssContext*) handle;
+    rss_detach(rc);
+    return DAQ_SUCCESS;
+}
+
+/* Only the distributor may call the module below, so ioctls other than the
+   stats aren't supported. */
+static int rss_daq_ioctl(void* handle, DAQ_IoctlCmd cmd, void* arg, size_t arglen)
+{
+    RssContext* rc = (RssContext*) handle;
+
+    if (cmd != DIOCTL_GET_RSS_STATS)
+        return DAQ_ERROR_NOTSUP;
+
+    if (arglen != sizeof(DIOCTL_GetRssStats))
+        return DAQ_ERROR_INVAL;
+
+    DIOCTL_GetRssStats* grs = (DIOCTL_GetRssStats*) arg;
+    RssDistributor* d = rc->dist;
+
+    memset(grs, 0, sizeof(*grs));
+
+    if (!d)
+        return DAQ_SUCCESS;
+
+    grs->ring_drops = atomic_load_explicit(&rc->queue->drops, memory_order_relaxed);
+
+    uint64_t total = 0, max = 0;
+
+    for (unsigned i = 0; i < d->num_queues; i++)
+    {
+        uint64_t n = atomic_load_explicit(&d->queues[i].dispatched, memory_order_relaxed);
+        total += n;
+        if (n > max)
+            max = n;
+    }
+
+    /* how far the busiest ring is above the mean */
+    if (total)
+        grs->imbalance = (uint32_t) ((max * d->num_queues - total) * 100 / total);
+
+    return DAQ_SUCCESS;
+}
+
+static int rss_daq_get_stats(void* handle, DAQ_Stats_t* stats)
+{
+    RssContext* rc = (RssContext*) handle;
+
+    if (rc->queue)
+        rc->stats.hw_packets_received = atomic_load_explicit(&rc->queue->dispatched, memory_order_relaxed);
+
+    memcpy(stats, &rc->stats, sizeof(DAQ_Stats_t));
+    return DAQ_SUCCESS;
+}
+
+static void rss_daq_reset_stats(void* handle)
+{
+    RssContext* rc = (RssContext*) handle;
+    memset(&rc->stats, 0, sizeof(rc->stats));
+}
+
+/* injection from the packet threads would race with the distributor */
+static uint32_t rss_daq_get_capabilities(void* handle)
+{
+    RssContext* rc = (RssContext*) handle;
+    uint32_t caps = CALL_SUBAPI_NOARGS(rc, get_capabilities);
+    return (caps & ~(DAQ_CAPA_INJECT | DAQ_CAPA_INJECT_RAW)) | DAQ_CAPA_INTERRUPT;
+}
+
+static int rss_daq_get_datalink_type(void* handle)
+{
+    RssContext* rc = (RssContext*) handle;
+
+    if (!rc->dist)
+        return DAQ_ERROR;
+
+    return rc->dist->dlt;
+}
+
+static unsigned rss_daq_msg_receive(void* handle, const unsigned max_recv, const DAQ_Msg_t* msgs[], DAQ_RecvStatus* rstat)
+{
+    RssContext* rc = (RssContext*) handle;
+    RssRing* ring = &rc->queue->to_inst;
+    DAQ_RecvStatus status = DAQ_RSTAT_OK;
+    unsigned idx = 0;
+    uint64_t waited = 0;
+
+    while (idx < max_recv)
+    {
+        /* Check to see if the receive has been canceled.  If so, reset it and return appropriately. */
+        if (rc->interrupted)
+        {
+            rc->interrupted = false;
+            status = DAQ_RSTAT_INTERRUPTED;
+            break;
+        }
+
+        if (rc->outstanding == rc->ring_size)
+        {
+            status = DAQ_RSTAT_NOBUF;
+            break;
+        }
+
+        RssEntry e;
+
+        if (!rss_ring_pop(ring, &e))
+        {
+            /* return what we have rather than wait for more */
+            if (idx)
+                break;
+
+            if (!atomic_load(&rc->dist->done))
+            {
+                if (rc->timeout && waited >= (uint64_t) rc->timeout * 1000000)
+                {
+                    status = DAQ_RSTAT_TIMEOUT;
+                    break;
+                }
+
+                rss_sleep();
+                waited += RSS_IDLE_NSEC;
+                continue;
+            }
+
+            /* the distributor pushes its last message before it is done */
+            if (!rss_ring_pop(ring, &e))
+            {
+                status = DAQ_RSTAT_EOF;
+                break;
+            }
+        }
+
+        rc->stats.packets_received++;
+        rc->outstanding++;
+        msgs[idx++] = e.msg;
+    }
+
+    *rstat = status;
+
+    return idx;
+}
+
+static int rss_daq_msg_finalize(void* handle, const DAQ_Msg_t* msg, DAQ_Verdict verdict)
+{
+    RssContext* rc = (RssContext*) handle;
+    RssDistributor* d = rc->dist;
+
+    if (verdict >= MAX_DAQ_VERDICT)
+        verdict = DAQ_VERDICT_PASS;
+    rc->stats.verdicts[verdict]++;
+    rc->outstanding--;
+
+    /* the ring has room for every outstanding message unless the owner is
+       stopping; once the module below is stopped its messages are gone */
+    while (!rss_ring_push(&rc->queue->to_dist, msg, verdict))
+    {
+        if (atomic_load(&d->stopped))
+            break;
+        rss_sleep();
+    }
+
+    return DAQ_SUCCESS;
+}
+
+static int rss_daq_get_msg_pool_info(void* handle, DAQ_MsgPoolInfo_t* info)
+{
+    RssContext* rc = (RssContext*) handle;
+
+    info->size = rc->ring_size;
+    info->available = rc->ring_size - rc->outstanding;
+    info->mem_size = 0;
+
+    return DAQ_SUCCESS;
+}
+
+//-------------------------------------------------------------------------
+
+#ifdef BUILDING_SO
+DAQ_SO_PUBLIC const DAQ_ModuleAPI_t DAQ_MODULE_DATA =
+#else
+const DAQ_ModuleAPI_t rss_daq_module_data =
+#endif
+{
+    /* .api_version = */ DAQ_MODULE_API_VERSION,
+    /* .api_size = */ sizeof(DAQ_ModuleAPI_t),
+    /* .module_version = */ DAQ_MOD_VERSION,
+    /* .name = */ DAQ_NAME,
+    /* .type = */ DAQ_TYPE,
+    /* .load = */ rss_daq_module_load,
+    /* .unload = */ NULL,
+    /* .get_variable_descs = */ rss_daq_get_variable_descs,
+    /* .instantiate = */ rss_daq_instantiate,
+    /* .destroy = */ rss_daq_destroy,
+    /* .set_filter = */ NULL,
+    /* .start = */ rss_daq_start,
+    /* .inject = */ NULL,
+    /* .inject_relative = */ NULL,
+    /* .interrupt = */ rss_daq_interrupt,
+    /* .stop = */ rss_daq_stop,
+    /* .ioctl = */ rss_daq_ioctl,
+    /* .get_stats = */ rss_daq_get_stats,
+    /* .reset_stats = */ rss_daq_reset_stats,
+    /* .get_snaplen = */ NULL,
+    /* .get_capabilities = */ rss_daq_get_capabilities,
+    /* .get_datalink_type = */ rss_daq_get_datalink_type,
+    /* .config_load = */ NULL,
+    /* .config_swap = */ NULL,
+    /* .config_free = */ NULL,
+    /* .msg_receive = */ rss_daq_msg_receive,
+    /* .msg_finalize = */ rss_daq_msg_finalize,
+    /* .get_msg_pool_info = */ rss_daq_get_msg_pool_info,
+};
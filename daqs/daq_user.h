@@ -50,5 +50,32 @@ typedef struct
     DAQ_UsrHdr_t* pci;
 } DIOCTL_QueryUsrPCI;
 
+/* ask the DAQ to handle the rest of the flow of msg itself, either passing
+   or dropping its packets without delivering them, until the flow is idle
+   for timeout seconds (0 for the DAQ default).  DAQs without the support
+   return DAQ_ERROR_NOTSUP. */
+#define DIOCTL_SET_FLOW_OFFLOAD (DAQ_IoctlCmd) 2049
+
+#define DAQ_OFFLOAD_BYPASS 0
+#define DAQ_OFFLOAD_DROP   1
+
+typedef struct
+{
+    DAQ_Msg_h msg;
+    uint8_t action;
+    uint32_t timeout;
+} DIOCTL_SetFlowOffload;
+
+/* counts for this instance's ring from the rss module: messages passed
+   without inspection because the ring was full or closed, and how far the
+   busiest ring of the input is above the mean, in percent */
+#define DIOCTL_GET_RSS_STATS (DAQ_IoctlCmd) 2050
+
+typedef struct
+{
+    uint64_t ring_drops;
+    uint32_t imbalance;
+} DIOCTL_GetRssStats;
+
 #endif
 
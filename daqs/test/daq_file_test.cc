@@ -0,0 +1,209 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2023-2023 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+// daq_file_test.cc
+// unit test main
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+#include <daq_module_api.h>
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness.h>
+
+extern "C" const DAQ_ModuleAPI_t file_daq_module_data;
+
+//-------------------------------------------------------------------------
+// base api stubs
+//-------------------------------------------------------------------------
+
+static const char* s_input = nullptr;
+static bool s_mmap = false;
+static bool s_mmap_given = false;
+
+static void set_errbuf(DAQ_ModuleInstance_h, const char*, ...) { }
+
+// templates so the stubs match the base api return types
+template<typename R>
+static R get_zero(DAQ_ModuleConfig_h)
+{ return R(); }
+
+template<typename R>
+static R get_input(DAQ_ModuleConfig_h)
+{ return s_input; }
+
+template<typename R>
+static R next_variable(DAQ_ModuleConfig_h, const char** key, const char** value)
+{
+    *key = nullptr;
+    *value = nullptr;
+
+    if ( s_mmap and !s_mmap_given )
+    {
+        *key = "mmap";
+        s_mmap_given = true;
+    }
+    return R();
+}
+
+template<typename R>
+static R first_variable(DAQ_ModuleConfig_h cfg, const char** key, const char** value)
+{
+    s_mmap_given = false;
+    return next_variable<R>(cfg, key, value);
+}
+
+//-------------------------------------------------------------------------
+// tests
+//-------------------------------------------------------------------------
+
+#define DATA "the quick brown fox jumps over the lazy dog"
+
+TEST_GROUP(daq_file_test)
+{
+    const DAQ_ModuleAPI_t* api = &file_daq_module_data;
+    void* handle = nullptr;
+    int saved_stdin = -1;
+    char path[32] = "/tmp/daq_file_testXXXXXX";
+
+    void setup() override
+    {
+        DAQ_BaseAPI_t base;
+        memset(&base, 0, sizeof(base));
+
+        base.api_version = DAQ_BASE_API_VERSION;
+        base.api_size = sizeof(base);
+        base.set_errbuf = set_errbuf;
+        base.config_get_input = get_input;
+        base.config_get_snaplen = get_zero;
+        base.config_get_msg_pool_size = get_zero;
+        base.config_first_variable = first_variable;
+        base.config_next_variable = next_variable;
+
+        CHECK(api->load(&base) == DAQ_SUCCESS);
+        s_mmap = false;
+    }
+
+    void teardown() override
+    {
+        if ( handle )
+        {
+            api->stop(handle);
+            api->destroy(handle);
+        }
+
+        if ( saved_stdin >= 0 )
+        {
+            dup2(saved_stdin, STDIN_FILENO);
+            close(saved_stdin);
+        }
+    }
+
+    // tty is the file daq's name for stdin; a pipe can't be mapped
+    void pipe_stdin(const char* data)
+    {
+        int fds[2];
+        CHECK(pipe(fds) == 0);
+        CHECK(write(fds[1], data, strlen(data)) == (ssize_t)strlen(data));
+        close(fds[1]);
+
+        saved_stdin = dup(STDIN_FILENO);
+        dup2(fds[0], STDIN_FILENO);
+        close(fds[0]);
+
+        s_input = "tty";
+    }
+
+    void temp_file(const char* data)
+    {
+        int fd = mkstemp(path);
+        CHECK(fd >= 0);
+        CHECK(write(fd, data, strlen(data)) == (ssize_t)strlen(data));
+        close(fd);
+
+        s_input = path;
+    }
+
+    void start()
+    {
+        CHECK(api->instantiate(nullptr, nullptr, &handle) == DAQ_SUCCESS);
+        CHECK(api->start(handle) == DAQ_SUCCESS);
+    }
+
+    void check_receive(const char* data)
+    {
+        const DAQ_Msg_t* msgs[4];
+        DAQ_RecvStatus rstat;
+
+        unsigned n = api->msg_receive(handle, 4, msgs, &rstat);
+        CHECK(n == 1);
+        CHECK(rstat == DAQ_RSTAT_EOF);
+        CHECK(msgs[0]->data_len == strlen(data));
+        MEMCMP_EQUAL(data, msgs[0]->data, strlen(data));
+        CHECK(api->msg_finalize(handle, msgs[0], DAQ_VERDICT_PASS) == DAQ_SUCCESS);
+    }
+};
+
+TEST(daq_file_test, read_pipe)
+{
+    pipe_stdin(DATA);
+    start();
+    check_receive(DATA);
+}
+
+TEST(daq_file_test, mmap_pipe_reads)
+{
+    s_mmap = true;
+    pipe_stdin(DATA);
+    start();
+    check_receive(DATA);
+}
+
+TEST(daq_file_test, mmap_file)
+{
+    s_mmap = true;
+    temp_file(DATA);
+    start();
+    check_receive(DATA);
+    unlink(path);
+}
+
+TEST(daq_file_test, mmap_empty_file_reads)
+{
+    s_mmap = true;
+    temp_file("");
+    start();
+
+    const DAQ_Msg_t* msgs[4];
+    DAQ_RecvStatus rstat;
+
+    CHECK(api->msg_receive(handle, 4, msgs, &rstat) == 0);
+    CHECK(rstat == DAQ_RSTAT_EOF);
+    unlink(path);
+}
+
+int main(int argc, char** argv)
+{
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -67,7 +67,10 @@ static void Replace_ModifyPacket(Packet* p)
     }
 
     if ( modified )
+    {
+        p->clear_cksums_adjusted();
         p->packet_flags |= PKT_MODIFIED;
+    }
 
     DetectionEngine::clear_replacement();
 }
@@ -21,6 +21,13 @@
 #define CODECS_CHECKSUM_H
 
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define CKSUM_SIMD
+#endif
 
 #include <protocols/protocol_ids.h>
 
@@ -64,6 +71,15 @@ inline uint16_t icmp_cksum(const uint16_t* buf, std::size_t len, const Pseudohea
 inline uint16_t icmp_cksum(const uint16_t* buf, std::size_t len);
 inline uint16_t ip_cksum(const uint16_t* buf, std::size_t len);
 
+//  RFC 1624 incremental update of a checksum for changed 16 bit words.
+//  the words are as read from memory, like the checksum itself.
+inline void update_cksum(uint16_t& cksum, uint16_t old_word, uint16_t new_word);
+
+//  as above for len bytes of the summed data which changed from old to
+//  cur; both must be at an even offset from the start of the summed data
+//  and an odd len is padded with zero like the sum itself.
+inline void update_cksum(uint16_t& cksum, const void* old, const void* cur, std::size_t len);
+
 /*
  *  NOTE: Since multiple dynamic libraries use checksums, the choice
  *          is to either include all of the checksum details in a header,
@@ -79,10 +95,108 @@ inline uint16_t ip_cksum(const uint16_t* buf, std::size_t len);
  */
 namespace detail
 {
+#ifdef CKSUM_SIMD
+// shorter buffers aren't worth the setup
+constexpr std::size_t CKSUM_SIMD_MIN = 128;
+
+// the 16 bit words of each 32 bit lane are summed separately into 32 bit
+// lanes.  each pass adds at most 2 * 0xffff per lane so lanes are folded
+// into the total often enough that they can't overflow.
+constexpr std::size_t CKSUM_SIMD_PASSES = 16384;
+
+inline uint64_t fold_lanes(const uint32_t* lanes, unsigned n)
+{
+    uint64_t sum = 0;
+
+    for ( unsigned i = 0; i < n; ++i )
+        sum += lanes[i];
+
+    return sum;
+}
+
+__attribute__((target("avx2")))
+inline uint64_t sum_words_avx2(const uint8_t*& p, std::size_t& len)
+{
+    const __m256i mask = _mm256_set1_epi32(0xffff);
+    uint64_t sum = 0;
+
+    while ( len >= 32 )
+    {
+        std::size_t n = len / 32 < CKSUM_SIMD_PASSES ? len / 32 : CKSUM_SIMD_PASSES;
+        __m256i acc = _mm256_setzero_si256();
+
+        for ( std::size_t i = 0; i < n; ++i, p += 32 )
+        {
+            __m256i v = _mm256_loadu_si256((const __m256i*)p);
+            acc = _mm256_add_epi32(acc, _mm256_and_si256(v, mask));
+            acc = _mm256_add_epi32(acc, _mm256_srli_epi32(v, 16));
+        }
+        len -= n * 32;
+
+        uint32_t lanes[8];
+        _mm256_storeu_si256((__m256i*)lanes, acc);
+        sum += fold_lanes(lanes, 8);
+    }
+    return sum;
+}
+
+// sse2 is always available on x86_64
+inline uint64_t sum_words_sse2(const uint8_t*& p, std::size_t& len)
+{
+    const __m128i mask = _mm_set1_epi32(0xffff);
+    uint64_t sum = 0;
+
+    while ( len >= 16 )
+    {
+        std::size_t n = len / 16 < CKSUM_SIMD_PASSES ? len / 16 : CKSUM_SIMD_PASSES;
+        __m128i acc = _mm_setzero_si128();
+
+        for ( std::size_t i = 0; i < n; ++i, p += 16 )
+        {
+            __m128i v = _mm_loadu_si128((const __m128i*)p);
+            acc = _mm_add_epi32(acc, _mm_and_si128(v, mask));
+            acc = _mm_add_epi32(acc, _mm_srli_epi32(v, 16));
+        }
+        len -= n * 16;
+
+        uint32_t lanes[4];
+        _mm_storeu_si128((__m128i*)lanes, acc);
+        sum += fold_lanes(lanes, 4);
+    }
+    return sum;
+}
+
+inline bool cksum_use_avx2()
+{
+    static const bool avx2 = (__builtin_cpu_init(), __builtin_cpu_supports("avx2"));
+    return avx2;
+}
+
+// sum the leading whole vectors of buf and return the sum folded to 16
+// bits; buf and len are advanced past what was summed
+inline uint32_t sum_words_vector(const uint16_t*& buf, std::size_t& len)
+{
+    const uint8_t* p = (const uint8_t*)buf;
+    uint64_t sum = cksum_use_avx2() ? sum_words_avx2(p, len) : sum_words_sse2(p, len);
+    buf = (const uint16_t*)p;
+
+    while ( sum >> 16 )
+        sum = (sum & 0xffff) + (sum >> 16);
+
+    return (uint32_t)sum;
+}
+#endif
+
 inline uint16_t cksum_add(const uint16_t* buf, std::size_t len, uint32_t cksum)
 {
     const uint16_t* sp = buf;
 
+#ifdef CKSUM_SIMD
+    // vectors sum the same words as the loops below, at any alignment
+    if ( len >= CKSUM_SIMD_MIN )
+        cksum += sum_words_vector(sp, len);
+#endif
+
     // if pointer is 16 bit aligned calculate checksum in tight loop...
     // gcc 5.4 -O3 generates unaligned quadword instructions that crash; fixed in gcc 8.0.1
     if ( !( reinterpret_cast<std::uintptr_t>(sp) & 0x01 ) )
@@ -328,6 +442,37 @@ inline uint16_t ip_cksum(const uint16_t* buf, std::size_t len)
 
 inline uint16_t cksum_add(const uint16_t* buf, std::size_t len)
 { return detail::cksum_add(buf, len, 0); }
+
+inline void update_cksum(uint16_t& cksum, uint16_t old_word, uint16_t new_word)
+{
+    // HC' = ~(~HC + ~m + m')
+    uint32_t sum = (uint16_t)~cksum;
+    sum += (uint16_t)~old_word;
+    sum += new_word;
+
+    sum = (sum >> 16) + (sum & 0x0000ffff);
+    sum += (sum >> 16);
+
+    cksum = (uint16_t)~sum;
+}
+
+inline void update_cksum(uint16_t& cksum, const void* old, const void* cur, std::size_t len)
+{
+    const uint8_t* op = (const uint8_t*)old;
+    const uint8_t* cp = (const uint8_t*)cur;
+
+    for ( std::size_t i = 0; i < len; i += 2 )
+    {
+        uint16_t old_word = 0, new_word = 0;
+        std::size_t n = len - i < 2 ? 1 : 2;
+
+        memcpy(&old_word, op + i, n);
+        memcpy(&new_word, cp + i, n);
+
+        if ( old_word != new_word )
+            update_cksum(cksum, old_word, new_word);
+    }
+}
 } // namespace checksum
 
 #endif  /* CODECS_CHECKSUM_H */
@@ -0,0 +1,220 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2023-2023 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// checksum_test.cc author Cisco
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "../checksum.h"
+
+#include <vector>
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness.h>
+
+using namespace checksum;
+
+// the plain one's complement sum of the words as read from memory
+static uint16_t ref_cksum(const uint8_t* p, std::size_t len)
+{
+    uint64_t sum = 0;
+
+    for ( ; len > 1; p += 2, len -= 2 )
+    {
+        uint16_t w;
+        memcpy(&w, p, sizeof(w));
+        sum += w;
+    }
+    if ( len )
+        sum += *p;
+
+    while ( sum >> 16 )
+        sum = (sum & 0xffff) + (sum >> 16);
+
+    return (uint16_t)~sum;
+}
+
+static std::vector<uint8_t> make_buf(std::size_t len, uint32_t seed)
+{
+    std::vector<uint8_t> buf(len);
+
+    for ( auto& b : buf )
+    {
+        seed = seed * 1103515245 + 12345;
+        b = seed >> 16;
+    }
+    return buf;
+}
+
+TEST_GROUP(checksum) { };
+
+TEST(checksum, short_lengths_any_alignment)
+{
+    std::vector<uint8_t> buf = make_buf(300 + 3, 1);
+
+    for ( unsigned start = 0; start < 4; ++start )
+    {
+        for ( std::size_t len = 0; len <= 300; ++len )
+        {
+            const uint8_t* p = buf.data() + start;
+            CHECK_EQUAL(ref_cksum(p, len), cksum_add((const uint16_t*)p, len));
+        }
+    }
+}
+
+TEST(checksum, around_simd_minimum)
+{
+#ifdef CKSUM_SIMD
+    const std::size_t min = detail::CKSUM_SIMD_MIN;
+#else
+    const std::size_t min = 128;
+#endif
+    std::vector<uint8_t> buf = make_buf(min + 64, 2);
+
+    for ( unsigned start = 0; start < 2; ++start )
+    {
+        for ( std::size_t len = min - 33; len <= min + 33; ++len )
+        {
+            const uint8_t* p = buf.data() + start;
+            CHECK_EQUAL(ref_cksum(p, len), cksum_add((const uint16_t*)p, len));
+        }
+    }
+}
+
+TEST(checksum, large_buffers)
+{
+    // all ones words make the vector lanes grow as fast as they can, and
+    // 1 MB is more than one lane folding pass for either vector width
+    std::vector<uint8_t> ones(1 << 20, 0xff);
+    std::vector<uint8_t> rnd = make_buf(1 << 20, 3);
+
+    for ( std::size_t len : { (std::size_t)65535, (std::size_t)65536 + 1, ones.size() - 1, ones.size() - 2 } )
+    {
+        for ( unsigned start = 0; start < 2; ++start )
+        {
+            CHECK_EQUAL(ref_cksum(ones.data() + start, len),
+                cksum_add((const uint16_t*)(ones.data() + start), len));
+            CHECK_EQUAL(ref_cksum(rnd.data() + start, len),
+                cksum_add((const uint16_t*)(rnd.data() + start), len));
+        }
+    }
+}
+
+#ifdef CKSUM_SIMD
+// each vector path must sum exactly the bytes it consumes
+static void check_vector_sum(
+    uint64_t (*sum_words)(const uint8_t*&, std::size_t&), std::size_t width,
+    const uint8_t* buf, std::size_t len)
+{
+    const uint8_t* p = buf;
+    std::size_t left = len;
+    uint64_t sum = sum_words(p, left);
+
+    CHECK_EQUAL(len % width, left);
+    CHECK(p == buf + len - left);
+
+    while ( sum >> 16 )
+        sum = (sum & 0xffff) + (sum >> 16);
+
+    CHECK_EQUAL(ref_cksum(buf, p - buf), (uint16_t)~sum);
+}
+
+TEST(checksum, sse2_matches_scalar)
+{
+    std::vector<uint8_t> buf = make_buf((1 << 20) + 64, 4);
+    std::vector<uint8_t> ones((1 << 20) + 64, 0xff);
+
+    for ( unsigned start = 0; start < 4; ++start )
+    {
+        for ( std::size_t len : { 16, 17, 31, 127, 128, 129, 1500, 9001, 1 << 20 } )
+        {
+            check_vector_sum(detail::sum_words_sse2, 16, buf.data() + start, len);
+            check_vector_sum(detail::sum_words_sse2, 16, ones.data() + start, len);
+        }
+    }
+}
+
+TEST(checksum, avx2_matches_scalar)
+{
+    if ( !detail::cksum_use_avx2() )
+        return;
+
+    std::vector<uint8_t> buf = make_buf((1 << 20) + 64, 5);
+    std::vector<uint8_t> ones((1 << 20) + 64, 0xff);
+
+    for ( unsigned start = 0; start < 4; ++start )
+    {
+        for ( std::size_t len : { 32, 33, 63, 127, 128, 129, 1500, 9001, 1 << 20 } )
+        {
+            check_vector_sum(detail::sum_words_avx2, 32, buf.data() + start, len);
+            check_vector_sum(detail::sum_words_avx2, 32, ones.data() + start, len);
+        }
+    }
+}
+#endif
+
+TEST(checksum, update_word_matches_recompute)
+{
+    std::vector<uint8_t> buf = make_buf(60, 6);
+    buf[10] = buf[11] = 0;
+
+    uint16_t ck = cksum_add((const uint16_t*)buf.data(), buf.size());
+    memcpy(&buf[10], &ck, sizeof(ck));
+    CHECK_EQUAL(0, cksum_add((const uint16_t*)buf.data(), buf.size()));
+
+    // e.g. a ttl / protocol word being normalized
+    for ( uint16_t w : { 0x0000, 0x0001, 0x4006, 0xffff } )
+    {
+        uint16_t old_word;
+        memcpy(&old_word, &buf[8], sizeof(old_word));
+        memcpy(&buf[8], &w, sizeof(w));
+
+        update_cksum(ck, old_word, w);
+        memcpy(&buf[10], &ck, sizeof(ck));
+
+        CHECK_EQUAL(0, cksum_add((const uint16_t*)buf.data(), buf.size()));
+    }
+}
+
+TEST(checksum, update_field_matches_recompute)
+{
+    for ( std::size_t len : { 20, 21, 40, 41, 60 } )
+    {
+        std::vector<uint8_t> buf = make_buf(len, len);
+        std::vector<uint8_t> cur = buf;
+
+        // a field at an even offset, such as options being cleared, and an
+        // odd length tail padded with zero
+        memset(&cur[4], 0, 8);
+        cur[len - 1] ^= 0x5a;
+
+        uint16_t ck = cksum_add((const uint16_t*)buf.data(), len);
+        update_cksum(ck, &buf[4], &cur[4], 8);
+
+        std::size_t tail = len & 1 ? len - 1 : len - 2;
+        update_cksum(ck, &buf[tail], &cur[tail], len - tail);
+
+        CHECK_EQUAL(cksum_add((const uint16_t*)cur.data(), len), ck);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -28,6 +28,8 @@
 #include "packet_io/active.h"
 #include "protocols/geneve.h"
 
+#include "tunnel_cache.h"
+
 using namespace snort;
 
 #define CD_GENEVE_NAME "geneve"
@@ -53,6 +55,22 @@ static const RuleMap geneve_rules[] =
     { 0, nullptr }
 };
 
+const PegInfo geneve_pegs[]
+{
+    { CountType::SUM, "cache_hits", "headers with options found in the validated header cache" },
+    { CountType::SUM, "cache_misses", "headers with options validated and added to the cache" },
+    { CountType::END, nullptr, nullptr }
+};
+
+struct GeneveStats
+{
+    PegCount cache_hits;
+    PegCount cache_misses;
+};
+
+static THREAD_LOCAL GeneveStats geneve_stats;
+static THREAD_LOCAL TunnelCache* tunnel_cache = nullptr;
+
 class GeneveModule : public BaseCodecModule
 {
 public:
@@ -60,6 +78,12 @@ public:
 
     const RuleMap* get_rules() const override
     { return geneve_rules; }
+
+    const PegInfo* get_pegs() const override
+    { return geneve_pegs; }
+
+    PegCount* get_counts() const override
+    { return (PegCount*)&geneve_stats; }
 };
 
 class GeneveCodec : public Codec
@@ -127,7 +151,7 @@ bool GeneveCodec::validate_options(const uint8_t* rptr, uint16_t hdrlen, CodecDa
     return true;
 }
 
-bool GeneveCodec::decode(const RawData& raw, CodecData& codec, DecodeData&)
+bool GeneveCodec::decode(const RawData& raw, CodecData& codec, DecodeData& dd)
 {
     if ( raw.len < sizeof(geneve::GeneveHdr) )
     {
@@ -151,16 +175,34 @@ bool GeneveCodec::decode(const RawData& raw, CodecData& codec, DecodeData&)
         return false;
     }
 
-    /* If critical header present bit is set, opts_len cannot be 0 */
-    if (hdr->is_set(GENEVE_FLAG_C) && (opts_len == 0))
-    {
-        codec_event(codec, DECODE_GENEVE_INVALID_FLAGS);
-        return false;
-    }
+    // an identical header of the same tunnel was already validated; without
+    // options there is nothing to walk and a lookup would only cost more
+    TunnelKey key;
+    const bool keyed = opts_len and tunnel_cache and
+        TunnelCache::get_key(dd, hdr->vni(), key);
+
+    if ( keyed and tunnel_cache->find(key, raw.data, hdrlen) )
+        geneve_stats.cache_hits++;
 
-    if (!validate_options(raw.data, hdrlen, codec))
+    else
     {
-        return false;
+        /* If critical header present bit is set, opts_len cannot be 0 */
+        if (hdr->is_set(GENEVE_FLAG_C) && (opts_len == 0))
+        {
+            codec_event(codec, DECODE_GENEVE_INVALID_FLAGS);
+            return false;
+        }
+
+        if (!validate_options(raw.data, hdrlen, codec))
+        {
+            return false;
+        }
+
+        if ( keyed )
+        {
+            tunnel_cache->add(key, raw.data, hdrlen, hdrlen);
+            geneve_stats.cache_misses++;
+        }
     }
 
     if ( codec.conf->tunnel_bypass_enabled(TUNNEL_GENEVE) )
@@ -243,6 +285,15 @@ static Module* mod_ctor()
 static void mod_dtor(Module* m)
 { delete m; }
 
+static void geneve_codec_tinit()
+{ tunnel_cache = new TunnelCache; }
+
+static void geneve_codec_tterm()
+{
+    delete tunnel_cache;
+    tunnel_cache = nullptr;
+}
+
 static Codec* ctor(Module*)
 { return new GeneveCodec(); }
 
@@ -265,8 +316,8 @@ static const CodecApi geneve_api =
     },
     nullptr, // pinit
     nullptr, // pterm
-    nullptr, // tinit
-    nullptr, // tterm
+    geneve_codec_tinit, // tinit
+    geneve_codec_tterm, // tterm
     ctor, // ctor
     dtor, // dtor
 };
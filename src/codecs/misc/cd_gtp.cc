@@ -26,6 +26,8 @@
 #include "framework/codec.h"
 #include "main/snort_config.h"
 
+#include "tunnel_cache.h"
+
 using namespace snort;
 
 #define CD_GTP_NAME "gtp"
@@ -40,6 +42,22 @@ static const RuleMap gtp_rules[] =
     { 0, nullptr }
 };
 
+const PegInfo gtp_pegs[]
+{
+    { CountType::SUM, "cache_hits", "extension headers found in the validated header cache" },
+    { CountType::SUM, "cache_misses", "extension headers validated and added to the cache" },
+    { CountType::END, nullptr, nullptr }
+};
+
+struct GtpStats
+{
+    PegCount cache_hits;
+    PegCount cache_misses;
+};
+
+static THREAD_LOCAL GtpStats gtp_stats;
+static THREAD_LOCAL TunnelCache* tunnel_cache = nullptr;
+
 class GtpModule : public BaseCodecModule
 {
 public:
@@ -47,6 +65,12 @@ public:
 
     const RuleMap* get_rules() const override
     { return gtp_rules; }
+
+    const PegInfo* get_pegs() const override
+    { return gtp_pegs; }
+
+    PegCount* get_counts() const override
+    { return (PegCount*)&gtp_stats; }
 };
 
 //-------------------------------------------------------------------------
@@ -130,34 +154,60 @@ bool GtpCodec::decode(const RawData& raw, CodecData& codec, DecodeData& dd)
                 codec_event(codec, DECODE_GTP_BAD_LEN);
                 return false;
             }
-            uint8_t next_hdr_type = *(raw.data + len - 1);
 
-            /*Check extension headers*/
-            while (next_hdr_type)
-            {
-                uint16_t ext_hdr_len;
-                if (raw.len < (uint32_t)(len + 4))
-                {
-                    codec_event(codec, DECODE_GTP_BAD_LEN);
-                    return false;
-                }
+            // the extension headers start with the next type of the fixed
+            // header; an identical chain of the same tunnel was validated
+            const uint8_t* ext = raw.data + GTP_V1_HEADER_LEN - 1;
+            uint32_t teid;
+            memcpy(&teid, raw.data + 4, sizeof(teid));
+
+            TunnelKey key;
+            const bool keyed = tunnel_cache and TunnelCache::get_key(dd, teid, key);
+            const TunnelEntry* cached = keyed ?
+                tunnel_cache->find(key, ext, raw.len - GTP_V1_HEADER_LEN + 1) : nullptr;
 
-                ext_hdr_len = *(raw.data + len);
+            if ( cached )
+            {
+                len = cached->lyr_len;
+                gtp_stats.cache_hits++;
+            }
+            else
+            {
+                uint8_t next_hdr_type = *(raw.data + len - 1);
 
-                if (!ext_hdr_len)
+                /*Check extension headers*/
+                while (next_hdr_type)
                 {
-                    codec_event(codec, DECODE_GTP_BAD_LEN);
-                    return false;
+                    uint16_t ext_hdr_len;
+                    if (raw.len < (uint32_t)(len + 4))
+                    {
+                        codec_event(codec, DECODE_GTP_BAD_LEN);
+                        return false;
+                    }
+
+                    ext_hdr_len = *(raw.data + len);
+
+                    if (!ext_hdr_len)
+                    {
+                        codec_event(codec, DECODE_GTP_BAD_LEN);
+                        return false;
+                    }
+                    /*Extension header length is a unit of 4 octets*/
+                    len += ext_hdr_len * 4;
+
+                    if (raw.len < len)
+                    {
+                        codec_event(codec, DECODE_GTP_BAD_LEN);
+                        return false;
+                    }
+                    next_hdr_type = *(raw.data + len - 1);
                 }
-                /*Extension header length is a unit of 4 octets*/
-                len += ext_hdr_len * 4;
 
-                if (raw.len < len)
+                if ( keyed )
                 {
-                    codec_event(codec, DECODE_GTP_BAD_LEN);
-                    return false;
+                    tunnel_cache->add(key, ext, len - GTP_V1_HEADER_LEN + 1, len);
+                    gtp_stats.cache_misses++;
                 }
-                next_hdr_type = *(raw.data + len - 1);
             }
         }
         else
@@ -251,6 +301,15 @@ static Module* mod_ctor()
 static void mod_dtor(Module* m)
 { delete m; }
 
+static void gtp_codec_tinit()
+{ tunnel_cache = new TunnelCache; }
+
+static void gtp_codec_tterm()
+{
+    delete tunnel_cache;
+    tunnel_cache = nullptr;
+}
+
 static Codec* ctor(Module*)
 { return new GtpCodec(); }
 
@@ -273,8 +332,8 @@ static const CodecApi gtp_api =
     },
     nullptr, // pinit
     nullptr, // pterm
-    nullptr, // tinit
-    nullptr, // tterm
+    gtp_codec_tinit, // tinit
+    gtp_codec_tterm, // tterm
     ctor, // ctor
     dtor, // dtor
 };
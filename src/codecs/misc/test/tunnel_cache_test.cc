@@ -0,0 +1,146 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2023-2023 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// tunnel_cache_test.cc author Cisco
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "../tunnel_cache.h"
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness.h>
+
+using namespace snort;
+
+// GTPv1 extension headers: the first byte is a length in 4-byte units
+static const uint8_t ext_hdr[] = {
+    0x01, 0x00, 0x01, 0x00,     // PDU number
+    0x01, 0x09, 0x00, 0x00      // UDP port
+};
+
+static TunnelKey make_key(uint32_t id)
+{
+    TunnelKey key;
+    memset(&key, 0, sizeof(key));
+
+    key.src[3] = 0x0100000a;
+    key.dst[3] = 0x0200000a;
+    key.sp = 2152;
+    key.dp = 2152;
+    key.id = id;
+    return key;
+}
+
+TEST_GROUP(tunnel_cache)
+{
+    TunnelCache* cache = nullptr;
+
+    void setup() override
+    { cache = new TunnelCache; }
+
+    void teardown() override
+    { delete cache; }
+};
+
+TEST(tunnel_cache, miss_when_empty)
+{
+    TunnelKey key = make_key(1);
+    CHECK(!cache->find(key, ext_hdr, sizeof(ext_hdr)));
+}
+
+TEST(tunnel_cache, hit)
+{
+    TunnelKey key = make_key(1);
+    cache->add(key, ext_hdr, sizeof(ext_hdr), 20);
+
+    const TunnelEntry* e = cache->find(key, ext_hdr, sizeof(ext_hdr));
+    CHECK(e);
+    CHECK(e->lyr_len == 20);
+}
+
+TEST(tunnel_cache, miss_on_other_tunnel)
+{
+    TunnelKey key = make_key(1);
+    cache->add(key, ext_hdr, sizeof(ext_hdr), 20);
+
+    TunnelKey other = make_key(2);
+    CHECK(!cache->find(other, ext_hdr, sizeof(ext_hdr)));
+
+    other = make_key(1);
+    other.sp = 2153;
+    CHECK(!cache->find(other, ext_hdr, sizeof(ext_hdr)));
+}
+
+TEST(tunnel_cache, miss_on_changed_length)
+{
+    TunnelKey key = make_key(1);
+    cache->add(key, ext_hdr, sizeof(ext_hdr), 20);
+
+    uint8_t hdr[sizeof(ext_hdr)];
+    memcpy(hdr, ext_hdr, sizeof(hdr));
+    hdr[4] = 0x02;
+
+    CHECK(!cache->find(key, hdr, sizeof(hdr)));
+}
+
+TEST(tunnel_cache, miss_on_short_packet)
+{
+    TunnelKey key = make_key(1);
+    cache->add(key, ext_hdr, sizeof(ext_hdr), 20);
+
+    CHECK(!cache->find(key, ext_hdr, sizeof(ext_hdr) - 1));
+}
+
+TEST(tunnel_cache, long_header_not_cached)
+{
+    uint8_t hdr[TunnelEntry::max_hdr + 4] = { };
+    TunnelKey key = make_key(1);
+
+    cache->add(key, hdr, sizeof(hdr), sizeof(hdr));
+    CHECK(!cache->find(key, hdr, sizeof(hdr)));
+}
+
+TEST(tunnel_cache, eviction)
+{
+    TunnelKey first = make_key(0);
+    cache->add(first, ext_hdr, sizeof(ext_hdr), 20);
+
+    // the cache is direct mapped, so some other tunnel takes the same row
+    uint32_t id = 1;
+
+    for ( ; id <= 16 * TunnelCache::num_rows; ++id )
+    {
+        TunnelKey key = make_key(id);
+        cache->add(key, ext_hdr, sizeof(ext_hdr), 24);
+
+        if ( !cache->find(first, ext_hdr, sizeof(ext_hdr)) )
+            break;
+    }
+    CHECK(id <= 16 * TunnelCache::num_rows);
+
+    TunnelKey last = make_key(id);
+    const TunnelEntry* e = cache->find(last, ext_hdr, sizeof(ext_hdr));
+    CHECK(e);
+    CHECK(e->lyr_len == 24);
+}
+
+int main(int argc, char** argv)
+{
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -0,0 +1,122 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2023-2023 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// tunnel_cache.h
+
+#ifndef TUNNEL_CACHE_H
+#define TUNNEL_CACHE_H
+
+// TunnelCache remembers the tunnel headers a codec has already validated.
+// It is keyed by the outer addresses and ports plus the tunnel id (VNI,
+// TEID, etc.) and holds a copy of the header bytes the validation looked
+// at.  A later packet of the same tunnel with identical bytes takes the
+// cached result instead of walking the header again.  Only headers that
+// passed validation without events are cached, so a hit can't hide one.
+// The cache is direct mapped and per thread; this header is used by the
+// tunnel codecs, which may be built as dynamic plugins.
+
+#include <cstdint>
+#include <cstring>
+
+#include "framework/decode_data.h"
+
+namespace snort
+{
+struct TunnelKey
+{
+    uint32_t src[4];
+    uint32_t dst[4];
+    uint16_t sp;
+    uint16_t dp;
+    uint32_t id;
+};
+
+struct TunnelEntry
+{
+    static const unsigned max_hdr = 128;
+
+    TunnelKey key;
+    uint16_t hdr_len;       // length of the cached header bytes
+    uint16_t lyr_len;
+    bool valid;
+    uint8_t hdr[max_hdr];
+};
+
+class TunnelCache
+{
+public:
+    static const unsigned num_rows = 256;
+
+    // the outer IP and UDP layers must already be decoded into dd
+    static bool get_key(const DecodeData& dd, uint32_t id, TunnelKey& key)
+    {
+        if ( !dd.ip_api.is_ip() or !dd.udph )
+            return false;
+
+        memcpy(key.src, dd.ip_api.get_src()->get_ip6_ptr(), sizeof(key.src));
+        memcpy(key.dst, dd.ip_api.get_dst()->get_ip6_ptr(), sizeof(key.dst));
+        key.sp = dd.sp;
+        key.dp = dd.dp;
+        key.id = id;
+        return true;
+    }
+
+    // avail is the number of header bytes available for comparison
+    const TunnelEntry* find(const TunnelKey& key, const uint8_t* hdr, uint32_t avail) const
+    {
+        const TunnelEntry& e = rows[row(key)];
+
+        if ( !e.valid or e.hdr_len > avail or memcmp(&e.key, &key, sizeof(key)) or
+            memcmp(e.hdr, hdr, e.hdr_len) )
+            return nullptr;
+
+        return &e;
+    }
+
+    // headers longer than max_hdr are not cached
+    void add(const TunnelKey& key, const uint8_t* hdr, uint16_t len, uint16_t lyr_len)
+    {
+        if ( len > TunnelEntry::max_hdr )
+            return;
+
+        TunnelEntry& e = rows[row(key)];
+        e.key = key;
+        e.hdr_len = len;
+        e.lyr_len = lyr_len;
+        e.valid = true;
+        memcpy(e.hdr, hdr, len);
+    }
+
+private:
+    static unsigned row(const TunnelKey& key)
+    {
+        uint32_t h = key.id;
+
+        for ( unsigned i = 0; i < 4; ++i )
+            h = (h ^ key.src[i] ^ key.dst[i]) * 0x9e3779b1;
+
+        h ^= ((uint32_t)key.sp << 16) | key.dp;
+        h ^= h >> 16;
+        return h % num_rows;
+    }
+
+    TunnelEntry rows[num_rows] = { };
+};
+}
+
+#endif
+
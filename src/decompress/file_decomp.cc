@@ -25,6 +25,7 @@
 #include "file_decomp.h"
 
 #include <cassert>
+#include <chrono>
 
 #include "detection/detection_util.h"
 #include "utils/util.h"
@@ -32,6 +33,7 @@
 #include "file_decomp_pdf.h"
 #include "file_decomp_swf.h"
 #include "file_decomp_zip.h"
+#include "file_olestream.h"
 
 #ifdef UNIT_TEST
 #include "catch/snort_catch.h"
@@ -39,6 +41,11 @@
 
 using namespace snort;
 
+THREAD_LOCAL FileDecompStats file_decomp_stats;
+
+static THREAD_LOCAL uint8_t* decomp_buffer = nullptr;
+static THREAD_LOCAL uint32_t decomp_buffer_size = 0;
+
 static const char PDF_Sig[5] = { '%', 'P', 'D', 'F', '-' };
 static const char SWF_ZLIB_Sig[3] = { 'C', 'W', 'S' };
 #ifdef HAVE_LZMA
@@ -54,22 +61,24 @@ static struct sig_map_s
 {
     const char* Sig;
     size_t Sig_Length;
-    bool Enabled;
+    uint32_t Modes;     // session modes that look for this sig
     file_type_t File_Type;
     file_compression_type_t File_Compression_Type;
 } Signature_Map[] =
 {
     // none: compression type is embedded in PDF dictionaries
-    { PDF_Sig, sizeof(PDF_Sig), false, FILE_TYPE_PDF, FILE_COMPRESSION_TYPE_NONE },
+    { PDF_Sig, sizeof(PDF_Sig), FILE_PDF_ANY, FILE_TYPE_PDF, FILE_COMPRESSION_TYPE_NONE },
 
-    { SWF_ZLIB_Sig, sizeof(SWF_ZLIB_Sig), false, FILE_TYPE_SWF, FILE_COMPRESSION_TYPE_ZLIB },
+    { SWF_ZLIB_Sig, sizeof(SWF_ZLIB_Sig), FILE_SWF_ZLIB_BIT, FILE_TYPE_SWF,
+      FILE_COMPRESSION_TYPE_ZLIB },
 #ifdef HAVE_LZMA
-    { SWF_LZMA_Sig, sizeof(SWF_LZMA_Sig), false, FILE_TYPE_SWF, FILE_COMPRESSION_TYPE_LZMA },
+    { SWF_LZMA_Sig, sizeof(SWF_LZMA_Sig), FILE_SWF_LZMA_BIT, FILE_TYPE_SWF,
+      FILE_COMPRESSION_TYPE_LZMA },
 #endif
 
-    { ZIP_Sig, sizeof(ZIP_Sig), false, FILE_TYPE_ZIP, FILE_COMPRESSION_TYPE_NONE },
+    { ZIP_Sig, sizeof(ZIP_Sig), FILE_ZIP_DEFL_BIT, FILE_TYPE_ZIP, FILE_COMPRESSION_TYPE_NONE },
 
-    { nullptr, 0, false, FILE_TYPE_NONE, FILE_COMPRESSION_TYPE_NONE }
+    { nullptr, 0, 0, FILE_TYPE_NONE, FILE_COMPRESSION_TYPE_NONE }
 };
 
 /* Define the elements of the Sig_State value (packed for storage efficiency */
@@ -129,7 +138,7 @@ static fd_status_t Locate_Sig_Here(fd_session_t* SessionPtr)
             return( File_Decomp_NoSig );
 
         /* Get next char and see if it matches next char in sig */
-        if ( (Signature_Map[Sig_Index].Enabled) &&
+        if ( (Signature_Map[Sig_Index].Modes & SessionPtr->Modes) &&
             (*(SessionPtr->Next_In+Char_Index) == *(Signature_Map[Sig_Index].Sig+Char_Index)) )
         {
             /* Check to see if we are at the end of the sig string. */
@@ -247,43 +256,34 @@ static fd_status_t Process_Decompression(fd_session_t* SessionPtr)
     return( Ret_Code );
 }
 
+bool fd_session_t::get_vba_data(uint8_t*& vba_buf, uint32_t& vba_len)
+{
+    vba_buf = nullptr;
+    vba_len = 0;
+
+    if ( !ole_stream or !ole_stream->is_finished() )
+        return false;
+
+    ole_stream->get_vba(vba_buf, vba_len);
+
+    delete ole_stream;
+    ole_stream = nullptr;
+
+    return true;
+}
+
 namespace snort
 {
 /* The caller provides Compr_Depth, Decompr_Depth and Modes in the session object.
-   Based on the requested Modes, gear=up to initialize the potential decompressors. */
+   Only the signatures of the session's own Modes are looked for. */
 fd_status_t File_Decomp_Init(fd_session_t* SessionPtr)
 {
-    int Sig;
-
     if ( SessionPtr == nullptr )
         return( File_Decomp_Error );
 
     SessionPtr->State = STATE_READY;
     SessionPtr->Decomp_Type = FILE_COMPRESSION_TYPE_NONE;
 
-    for ( Sig=0; Signature_Map[Sig].Sig != nullptr; Sig++ )
-    {
-        if ( (Signature_Map[Sig].File_Type == FILE_TYPE_PDF ) &&
-            ((SessionPtr->Modes & FILE_PDF_ANY) != 0) )
-            Signature_Map[Sig].Enabled = true;
-
-        if ( (Signature_Map[Sig].File_Type == FILE_TYPE_SWF ) &&
-            (Signature_Map[Sig].File_Compression_Type == FILE_COMPRESSION_TYPE_ZLIB) &&
-            ((SessionPtr->Modes & FILE_SWF_ZLIB_BIT) != 0) )
-            Signature_Map[Sig].Enabled = true;
-
-#ifdef HAVE_LZMA
-        if ( (Signature_Map[Sig].File_Type == FILE_TYPE_SWF ) &&
-            (Signature_Map[Sig].File_Compression_Type == FILE_COMPRESSION_TYPE_LZMA) &&
-            ((SessionPtr->Modes & FILE_SWF_LZMA_BIT) != 0) )
-            Signature_Map[Sig].Enabled = true;
-#endif
-
-        if ( (Signature_Map[Sig].File_Type == FILE_TYPE_ZIP ) &&
-            ((SessionPtr->Modes & FILE_ZIP_DEFL_BIT) != 0) )
-            Signature_Map[Sig].Enabled = true;
-    }
-
     return( File_Decomp_OK );
 }
 
@@ -293,15 +293,8 @@ fd_session_t* File_Decomp_New()
     return new fd_session_t{};
 }
 
-/* Process Decompression.  The session Next_In, Avail_In, Next_Out, Avail_Out MUST have been
-   set by caller.
-*/
-fd_status_t File_Decomp(fd_session_t* SessionPtr)
+static fd_status_t Decomp(fd_session_t* SessionPtr)
 {
-    if ( (SessionPtr == nullptr) || (SessionPtr->State == STATE_NEW) ||
-        (SessionPtr->Next_In == nullptr) || (SessionPtr->Next_Out == nullptr) )
-        return( File_Decomp_Error );
-
     /* STATE_NEW: Look for one of the configured file signatures. */
     if ( SessionPtr->State == STATE_READY )
     {
@@ -330,6 +323,50 @@ fd_status_t File_Decomp(fd_session_t* SessionPtr)
         return( File_Decomp_Error );
 }
 
+static void Update_Stats(const fd_session_t* SessionPtr, uint64_t In, uint64_t Out,
+    uint64_t Usecs)
+{
+    file_decomp_stats.bytes_in += In;
+    file_decomp_stats.usecs += Usecs;
+
+    switch ( SessionPtr->File_Type )
+    {
+    case FILE_TYPE_PDF:
+        file_decomp_stats.pdf_bytes_out += Out;
+        break;
+    case FILE_TYPE_SWF:
+        file_decomp_stats.swf_bytes_out += Out;
+        break;
+    case FILE_TYPE_ZIP:
+        file_decomp_stats.zip_bytes_out += Out;
+        break;
+    }
+}
+
+/* Process Decompression.  The session Next_In, Avail_In, Next_Out, Avail_Out MUST have been
+   set by caller.
+*/
+fd_status_t File_Decomp(fd_session_t* SessionPtr)
+{
+    if ( (SessionPtr == nullptr) || (SessionPtr->State == STATE_NEW) ||
+        (SessionPtr->Next_In == nullptr) || (SessionPtr->Next_Out == nullptr) )
+        return( File_Decomp_Error );
+
+    const uint8_t* Start_In = SessionPtr->Next_In;
+    const uint8_t* Start_Out = SessionPtr->Next_Out;
+    auto Start = std::chrono::steady_clock::now();
+
+    fd_status_t Return_Code = Decomp(SessionPtr);
+
+    auto Usecs = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - Start).count();
+
+    Update_Stats(SessionPtr, SessionPtr->Next_In - Start_In, SessionPtr->Next_Out - Start_Out,
+        Usecs);
+
+    return( Return_Code );
+}
+
 fd_status_t File_Decomp_End(fd_session_t* SessionPtr)
 {
     if ( SessionPtr == nullptr )
@@ -398,6 +435,7 @@ void File_Decomp_Free(fd_session_t* SessionPtr)
         break;
     }
 
+    delete SessionPtr->ole_stream;
     delete SessionPtr;
 }
 
@@ -408,6 +446,24 @@ void File_Decomp_Alert(fd_session_t* SessionPtr, int Event)
         (SessionPtr->Alert_Callback)(SessionPtr->Alert_Context, Event);
 }
 
+uint8_t* File_Decomp_Buffer(uint32_t size)
+{
+    if ( size > decomp_buffer_size )
+    {
+        delete[] decomp_buffer;
+        decomp_buffer = new uint8_t[size];
+        decomp_buffer_size = size;
+    }
+    return decomp_buffer;
+}
+
+void File_Decomp_Thread_Term()
+{
+    delete[] decomp_buffer;
+    decomp_buffer = nullptr;
+    decomp_buffer_size = 0;
+}
+
 } // namespace snort
 
 //--------------------------------------------------------------------------
@@ -25,7 +25,11 @@
 
 #include <cstring>
 
+#include "framework/counts.h"
 #include "main/snort_types.h"
+#include "main/thread.h"
+
+class OleStream;
 
 #define NEW_OFFICE_FRMT 120
 #define OLD_OFFICE_FRMT  27
@@ -140,23 +144,31 @@ struct fd_session_t
     uint8_t Decomp_Type; // Active decompression type
     uint8_t Sig_State;   // Sig search state machine
     uint8_t State;       // main state machine
-    uint8_t* ole_data_ptr; // compressed ole file.
-    uint32_t ole_data_len;
+
+    // VBA extraction from the OLE file in a ZIP archive, fed as it is inflated
+    OleStream* ole_stream;
+    uint32_t ole_window; // bytes of OLE sectors kept, 0 for the default
     bool vba_analysis;
 
-    void get_ole_data(uint8_t*& ole_data_ptr, uint32_t& ole_data_len)
-    {
-        ole_data_ptr = this->ole_data_ptr;
-        ole_data_len = this->ole_data_len;
-    }
+    // true once the OLE file has ended, with its decompressed VBA if any;
+    // the caller owns the buffer
+    bool get_vba_data(uint8_t*& vba_buf, uint32_t& vba_len);
+};
 
-    void ole_data_reset()
-    {
-        ole_data_ptr = nullptr;
-        ole_data_len = 0;
-    }
+/* Per packet thread decompression statistics, pegged by file_id */
+struct FileDecompStats
+{
+    PegCount bytes_in;
+    PegCount pdf_bytes_out;
+    PegCount swf_bytes_out;
+    PegCount zip_bytes_out;
+    PegCount usecs;
+    PegCount zip_deflate64_streams;
+    PegCount ole_sectors_dropped;
 };
 
+extern THREAD_LOCAL FileDecompStats file_decomp_stats;
+
 /* Macros */
 
 /* Macros used to sync my decompression context with that
@@ -321,6 +333,13 @@ SO_PUBLIC void File_Decomp_Free(fd_session_t*);
 
 /* Call the error alerting call-back function */
 SO_PUBLIC void File_Decomp_Alert(fd_session_t*, int Event);
+
+/* Per thread output buffer of at least size bytes, valid until the next call.
+   Callers decompress into it and copy out only what was produced. */
+SO_PUBLIC uint8_t* File_Decomp_Buffer(uint32_t size);
+
+/* Release the per thread output buffer */
+SO_PUBLIC void File_Decomp_Thread_Term();
 }
 #endif
 
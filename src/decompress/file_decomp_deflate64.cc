@@ -0,0 +1,704 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2023-2023 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// file_decomp_deflate64.cc
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "file_decomp_deflate64.h"
+
+#ifdef UNIT_TEST
+#include <zlib.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "catch/snort_catch.h"
+#endif
+
+#define WINDOW_MASK 0xFFFF
+
+// deflate64 differs from deflate in the last length code and distance codes
+static const uint16_t len_base[29] =
+{
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 3
+};
+
+static const uint8_t len_extra[29] =
+{
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 16
+};
+
+static const uint32_t dist_base[32] =
+{
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577,
+    32769, 49153
+};
+
+static const uint8_t dist_extra[32] =
+{
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13, 14, 14
+};
+
+// order of code length code lengths
+static const uint8_t clen_order[19] =
+{ 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+// build a canonical Huffman decoding table from code lengths; returns 0 for
+// a complete code, > 0 for an incomplete code, and < 0 if over-subscribed
+static int construct(Deflate64Huffman& h, const uint8_t* length, unsigned n)
+{
+    uint16_t offs[16];
+
+    memset(h.count, 0, sizeof(h.count));
+
+    for ( unsigned symbol = 0; symbol < n; symbol++ )
+        h.count[length[symbol]]++;
+
+    if ( h.count[0] == n )
+        return 0;
+
+    int left = 1;
+
+    for ( unsigned len = 1; len < 16; len++ )
+    {
+        left <<= 1;
+        left -= h.count[len];
+
+        if ( left < 0 )
+            return left;
+    }
+
+    offs[1] = 0;
+
+    for ( unsigned len = 1; len < 15; len++ )
+        offs[len + 1] = offs[len] + h.count[len];
+
+    for ( unsigned symbol = 0; symbol < n; symbol++ )
+    {
+        if ( length[symbol] )
+            h.symbol[offs[length[symbol]]++] = symbol;
+    }
+
+    return left;
+}
+
+Deflate64::Deflate64()
+{
+    memset(lengths, 0, sizeof(lengths));
+    memset(&lencode, 0, sizeof(lencode));
+    memset(&distcode, 0, sizeof(distcode));
+}
+
+// pull input bytes until n bits are buffered
+bool Deflate64::need(fd_session_t* SessionPtr, unsigned n)
+{
+    while ( bit_cnt < n )
+    {
+        uint8_t c;
+
+        if ( !Get_1(SessionPtr, &c) )
+            return false;
+
+        bit_buf |= (uint64_t)c << bit_cnt;
+        bit_cnt += 8;
+    }
+
+    return true;
+}
+
+// returns the next symbol without consuming it, -1 if more input is needed,
+// or -2 for an invalid code
+int Deflate64::decode(fd_session_t* SessionPtr, const Deflate64Huffman& h, unsigned& used)
+{
+    int code = 0;
+    int first = 0;
+    int idx = 0;
+
+    for ( unsigned len = 1; len < 16; len++ )
+    {
+        if ( !need(SessionPtr, len) )
+            return -1;
+
+        // Huffman codes are packed starting with the most significant bit
+        code |= peek(len - 1, 1);
+        int count = h.count[len];
+
+        if ( code - count < first )
+        {
+            used = len;
+            return h.symbol[idx + (code - first)];
+        }
+
+        idx += count;
+        first += count;
+        first <<= 1;
+        code <<= 1;
+    }
+
+    return -2;
+}
+
+bool Deflate64::put(fd_session_t* SessionPtr, uint8_t c)
+{
+    if ( !Put_1(SessionPtr, c) )
+        return false;
+
+    window[window_pos++ & WINDOW_MASK] = c;
+
+    if ( window_fill <= WINDOW_MASK )
+        window_fill++;
+
+    return true;
+}
+
+fd_status_t Deflate64::stored(fd_session_t* SessionPtr)
+{
+    while ( remaining )
+    {
+        uint8_t c;
+
+        if ( !SessionPtr->Avail_Out )
+            return File_Decomp_BlockOut;
+
+        if ( !Get_1(SessionPtr, &c) )
+            return File_Decomp_BlockIn;
+
+        put(SessionPtr, c);
+        remaining--;
+    }
+
+    state = last ? D64_DONE : D64_HEADER;
+    return File_Decomp_OK;
+}
+
+fd_status_t Deflate64::table_lens(fd_session_t* SessionPtr)
+{
+    while ( index < nlen + ndist )
+    {
+        unsigned used;
+        int sym = decode(SessionPtr, lencode, used);
+
+        if ( sym == -1 )
+            return File_Decomp_BlockIn;
+
+        if ( sym < 0 )
+            return File_Decomp_Error;
+
+        if ( sym < 16 )
+        {
+            drop(used);
+            lengths[index++] = sym;
+            continue;
+        }
+
+        // repeat the previous length 3-6 times, or a zero length 3-10 or
+        // 11-138 times
+        unsigned extra = (sym == 16) ? 2 : (sym == 17) ? 3 : 7;
+        unsigned base = (sym == 18) ? 11 : 3;
+
+        if ( !need(SessionPtr, used + extra) )
+            return File_Decomp_BlockIn;
+
+        unsigned repeat = base + peek(used, extra);
+        uint8_t len = 0;
+
+        if ( sym == 16 )
+        {
+            if ( !index )
+                return File_Decomp_Error;
+
+            len = lengths[index - 1];
+        }
+
+        drop(used + extra);
+
+        if ( index + repeat > (unsigned)(nlen + ndist) )
+            return File_Decomp_Error;
+
+        while ( repeat-- )
+            lengths[index++] = len;
+    }
+
+    // there must be an end of block code
+    if ( !lengths[256] )
+        return File_Decomp_Error;
+
+    // an incomplete code is only allowed for a single code of length 1
+    int err = construct(lencode, lengths, nlen);
+
+    if ( err and (err < 0 or nlen != lencode.count[0] + lencode.count[1]) )
+        return File_Decomp_Error;
+
+    err = construct(distcode, lengths + nlen, ndist);
+
+    if ( err and (err < 0 or ndist != distcode.count[0] + distcode.count[1]) )
+        return File_Decomp_Error;
+
+    state = D64_CODES;
+    return File_Decomp_OK;
+}
+
+fd_status_t Deflate64::codes(fd_session_t* SessionPtr)
+{
+    while ( true )
+    {
+        unsigned used;
+        int sym = decode(SessionPtr, lencode, used);
+
+        if ( sym == -1 )
+            return File_Decomp_BlockIn;
+
+        if ( sym < 0 )
+            return File_Decomp_Error;
+
+        if ( sym < 256 )
+        {
+            if ( !SessionPtr->Avail_Out )
+                return File_Decomp_BlockOut;
+
+            drop(used);
+            put(SessionPtr, sym);
+            continue;
+        }
+
+        if ( sym == 256 )
+        {
+            drop(used);
+            state = last ? D64_DONE : D64_HEADER;
+            return File_Decomp_OK;
+        }
+
+        sym -= 257;
+
+        if ( sym >= 29 )
+            return File_Decomp_Error;
+
+        if ( !need(SessionPtr, used + len_extra[sym]) )
+            return File_Decomp_BlockIn;
+
+        remaining = len_base[sym] + peek(used, len_extra[sym]);
+        drop(used + len_extra[sym]);
+
+        state = D64_DIST;
+        return File_Decomp_OK;
+    }
+}
+
+fd_status_t Deflate64::copy(fd_session_t* SessionPtr)
+{
+    while ( remaining )
+    {
+        if ( !SessionPtr->Avail_Out )
+            return File_Decomp_BlockOut;
+
+        put(SessionPtr, window[(window_pos - distance) & WINDOW_MASK]);
+        remaining--;
+    }
+
+    state = D64_CODES;
+    return File_Decomp_OK;
+}
+
+fd_status_t Deflate64::inflate(fd_session_t* SessionPtr)
+{
+    fd_status_t status = File_Decomp_OK;
+
+    while ( status == File_Decomp_OK )
+    {
+        switch ( state )
+        {
+        case D64_HEADER:
+        {
+            if ( !need(SessionPtr, 3) )
+                return File_Decomp_OK;
+
+            last = peek(0, 1);
+            unsigned type = peek(1, 2);
+            drop(3);
+
+            if ( type == 0 )
+            {
+                // stored blocks start on a byte boundary
+                drop(bit_cnt & 7);
+                state = D64_STORED_HEADER;
+            }
+            else if ( type == 1 )
+            {
+                unsigned sym = 0;
+
+                for ( ; sym < 144; sym++ )
+                    lengths[sym] = 8;
+                for ( ; sym < 256; sym++ )
+                    lengths[sym] = 9;
+                for ( ; sym < 280; sym++ )
+                    lengths[sym] = 7;
+                for ( ; sym < 288; sym++ )
+                    lengths[sym] = 8;
+
+                construct(lencode, lengths, 288);
+
+                for ( sym = 0; sym < 32; sym++ )
+                    lengths[sym] = 5;
+
+                construct(distcode, lengths, 32);
+                state = D64_CODES;
+            }
+            else if ( type == 2 )
+                state = D64_TABLE_COUNTS;
+            else
+                status = File_Decomp_Error;
+            break;
+        }
+        case D64_STORED_HEADER:
+        {
+            if ( !need(SessionPtr, 32) )
+                return File_Decomp_OK;
+
+            uint32_t len = peek(0, 16);
+            uint32_t nlen_check = peek(16, 16);
+            drop(32);
+
+            if ( len != (~nlen_check & 0xFFFF) )
+                return File_Decomp_Error;
+
+            remaining = len;
+            state = D64_STORED;
+            break;
+        }
+        case D64_STORED:
+            status = stored(SessionPtr);
+            break;
+
+        case D64_TABLE_COUNTS:
+            if ( !need(SessionPtr, 14) )
+                return File_Decomp_OK;
+
+            nlen = peek(0, 5) + 257;
+            ndist = peek(5, 5) + 1;
+            ncode = peek(10, 4) + 4;
+            drop(14);
+
+            if ( nlen > 286 )
+                return File_Decomp_Error;
+
+            index = 0;
+            state = D64_TABLE_CLENS;
+            break;
+
+        case D64_TABLE_CLENS:
+            for ( ; index < ncode; index++ )
+            {
+                if ( !need(SessionPtr, 3) )
+                    return File_Decomp_OK;
+
+                lengths[clen_order[index]] = peek(0, 3);
+                drop(3);
+            }
+
+            for ( ; index < 19; index++ )
+                lengths[clen_order[index]] = 0;
+
+            // the code length code must be complete
+            if ( construct(lencode, lengths, 19) )
+                return File_Decomp_Error;
+
+            index = 0;
+            state = D64_TABLE_LENS;
+            break;
+
+        case D64_TABLE_LENS:
+            status = table_lens(SessionPtr);
+            break;
+
+        case D64_CODES:
+            status = codes(SessionPtr);
+            break;
+
+        case D64_DIST:
+        {
+            unsigned used;
+            int sym = decode(SessionPtr, distcode, used);
+
+            if ( sym == -1 )
+                return File_Decomp_OK;
+
+            if ( sym < 0 )
+                return File_Decomp_Error;
+
+            if ( !need(SessionPtr, used + dist_extra[sym]) )
+                return File_Decomp_OK;
+
+            distance = dist_base[sym] + peek(used, dist_extra[sym]);
+            drop(used + dist_extra[sym]);
+
+            if ( distance > window_fill )
+                return File_Decomp_Error;
+
+            state = D64_COPY;
+            break;
+        }
+        case D64_COPY:
+            status = copy(SessionPtr);
+            break;
+
+        case D64_DONE:
+            return File_Decomp_Complete;
+        }
+    }
+
+    return (status == File_Decomp_BlockIn) ? File_Decomp_OK : status;
+}
+
+//--------------------------------------------------------------------------
+// unit tests
+//--------------------------------------------------------------------------
+
+#ifdef UNIT_TEST
+// writes a deflate bit stream
+class BitWriter
+{
+public:
+    void bits(uint32_t value, unsigned n)
+    {
+        for ( unsigned i = 0; i < n; i++ )
+            bit((value >> i) & 1);
+    }
+
+    // Huffman codes are written starting with the most significant bit
+    void code(uint32_t value, unsigned n)
+    {
+        while ( n-- )
+            bit((value >> n) & 1);
+    }
+
+    void align()
+    {
+        while ( cnt )
+            bit(0);
+    }
+
+    void bytes(const std::string& s)
+    {
+        out.insert(out.end(), s.begin(), s.end());
+    }
+
+    // fixed Huffman code for a literal/length symbol
+    void fixed(unsigned sym)
+    {
+        if ( sym < 144 )
+            code(0x30 + sym, 8);
+        else if ( sym < 256 )
+            code(0x190 + sym - 144, 9);
+        else if ( sym < 280 )
+            code(sym - 256, 7);
+        else
+            code(0xC0 + sym - 280, 8);
+    }
+
+    std::vector<uint8_t> out;
+
+private:
+    void bit(unsigned b)
+    {
+        if ( !cnt )
+            out.push_back(0);
+
+        out.back() |= b << cnt;
+        cnt = (cnt + 1) & 7;
+    }
+
+    unsigned cnt = 0;
+};
+
+static std::string inflate64(const std::vector<uint8_t>& in, unsigned in_chunk,
+    unsigned out_chunk, fd_status_t& status)
+{
+    Deflate64* d64 = new Deflate64;
+    fd_session_t session { };
+    std::string out;
+    uint8_t buf[65536];
+    size_t off = 0;
+
+    do
+    {
+        unsigned len = std::min((size_t)in_chunk, in.size() - off);
+
+        session.Next_In = in.data() + off;
+        session.Avail_In = len;
+
+        do
+        {
+            session.Next_Out = buf;
+            session.Avail_Out = out_chunk;
+            status = d64->inflate(&session);
+            out.append((char*)buf, session.Next_Out - buf);
+        }
+        while ( status == File_Decomp_BlockOut );
+
+        off += len - session.Avail_In;
+    }
+    while ( status == File_Decomp_OK and off < in.size() );
+
+    delete d64;
+    return out;
+}
+
+static std::vector<uint8_t> deflate(const std::string& data, int level)
+{
+    z_stream z { };
+    std::vector<uint8_t> out(compressBound(data.size()) + 64);
+
+    deflateInit2(&z, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+    z.next_in = (Bytef*)data.data();
+    z.avail_in = data.size();
+    z.next_out = out.data();
+    z.avail_out = out.size();
+    deflate(&z, Z_FINISH);
+    out.resize(z.total_out);
+    deflateEnd(&z);
+
+    return out;
+}
+
+// text without repeats of 258 bytes so zlib never emits length code 285,
+// which is the one length code deflate64 decodes differently
+static std::string make_text(unsigned size)
+{
+    static const char* words[] = { "alpha ", "bravo ", "charlie ", "delta ", "echo ",
+        "foxtrot ", "golf ", "hotel ", "india ", "juliet ", "kilo ", "lima " };
+    std::string s;
+    uint32_t r = 1;
+
+    while ( s.size() < size )
+    {
+        r = r * 1103515245 + 12345;
+        s += words[(r >> 16) % 12];
+    }
+
+    s.resize(size);
+    return s;
+}
+
+TEST_CASE("deflate64 decodes deflate streams", "[file_decomp_deflate64]")
+{
+    std::string text = make_text(200000);
+    fd_status_t status;
+
+    SECTION("dynamic")
+    {
+        std::vector<uint8_t> in = deflate(text, 9);
+        CHECK(inflate64(in, in.size(), 65536, status) == text);
+        CHECK(status == File_Decomp_Complete);
+    }
+    SECTION("stored")
+    {
+        std::vector<uint8_t> in = deflate(text, 0);
+        CHECK(inflate64(in, in.size(), 65536, status) == text);
+        CHECK(status == File_Decomp_Complete);
+    }
+    SECTION("byte at a time")
+    {
+        std::vector<uint8_t> in = deflate(text, 6);
+        CHECK(inflate64(in, 1, 7, status) == text);
+        CHECK(status == File_Decomp_Complete);
+    }
+}
+
+TEST_CASE("deflate64 long lengths and distances", "[file_decomp_deflate64]")
+{
+    std::string history = make_text(50000);
+
+    BitWriter bw;
+
+    // stored block with the history
+    bw.bits(0, 1);
+    bw.bits(0, 2);
+    bw.align();
+    bw.bits(history.size(), 16);
+    bw.bits(~history.size() & 0xFFFF, 16);
+    bw.bytes(history);
+
+    // fixed block: a match of 1000 bytes at distance 40000, then 'x'
+    bw.bits(1, 1);
+    bw.bits(1, 2);
+    bw.fixed(285);
+    bw.bits(1000 - 3, 16);
+    bw.code(30, 5);
+    bw.bits(40000 - 32769, 14);
+    bw.fixed('x');
+    bw.fixed(256);
+    bw.out.push_back(0xAA);   // trailing data is not consumed
+
+    std::string expected = history;
+    expected += history.substr(history.size() - 40000, 1000);
+    expected += 'x';
+
+    Deflate64* d64 = new Deflate64;
+    fd_session_t session { };
+    std::vector<uint8_t> out(expected.size());
+
+    session.Next_In = bw.out.data();
+    session.Avail_In = bw.out.size();
+    session.Next_Out = out.data();
+    session.Avail_Out = out.size();
+
+    CHECK(d64->inflate(&session) == File_Decomp_Complete);
+    CHECK(session.Avail_In == 1);
+    CHECK(session.Avail_Out == 0);
+    CHECK(std::string((char*)out.data(), out.size()) == expected);
+
+    delete d64;
+}
+
+TEST_CASE("deflate64 rejects invalid data", "[file_decomp_deflate64]")
+{
+    fd_status_t status;
+
+    SECTION("reserved block type")
+    {
+        std::vector<uint8_t> in = { 0x07 };
+        inflate64(in, in.size(), 100, status);
+        CHECK(status == File_Decomp_Error);
+    }
+    SECTION("distance beyond output")
+    {
+        BitWriter bw;
+        bw.bits(1, 1);
+        bw.bits(1, 2);
+        bw.fixed('a');
+        bw.fixed(257);
+        bw.code(3, 5);
+        inflate64(bw.out, bw.out.size(), 100, status);
+        CHECK(status == File_Decomp_Error);
+    }
+    SECTION("stored length mismatch")
+    {
+        std::vector<uint8_t> in = { 0x01, 0x05, 0x00, 0x00, 0x00 };
+        inflate64(in, in.size(), 100, status);
+        CHECK(status == File_Decomp_Error);
+    }
+}
+#endif
+
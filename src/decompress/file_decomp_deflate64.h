@@ -0,0 +1,107 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2023-2023 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// file_decomp_deflate64.h
+
+#ifndef FILE_DECOMP_DEFLATE64_H
+#define FILE_DECOMP_DEFLATE64_H
+
+// Incremental decoder for Deflate64 (ZIP compression method 9), which zlib
+// does not support.  Deflate64 is deflate with a 64 KiB window, a 16 bit
+// extra length for length code 285, and distance codes 30 and 31.
+//
+// Input and output are taken from the session like the zlib wrappers.  Bits
+// are pulled from the input one byte at a time as a symbol needs them and a
+// symbol is only consumed once it can be completely decoded, so decoding
+// resumes at any input boundary and no input past the end of the stream is
+// consumed.
+
+#include "file_decomp.h"
+
+struct Deflate64Huffman
+{
+    uint16_t count[16];    // number of codes of each length
+    uint16_t symbol[288];  // symbols ordered by code
+};
+
+class Deflate64
+{
+public:
+    Deflate64();
+
+    // File_Decomp_OK when more input is needed, File_Decomp_BlockOut when
+    // the output is full, File_Decomp_Complete at the end of the stream, or
+    // File_Decomp_Error for invalid data
+    fd_status_t inflate(fd_session_t*);
+
+private:
+    enum State
+    {
+        D64_HEADER,
+        D64_STORED_HEADER,
+        D64_STORED,
+        D64_TABLE_COUNTS,
+        D64_TABLE_CLENS,
+        D64_TABLE_LENS,
+        D64_CODES,
+        D64_DIST,
+        D64_COPY,
+        D64_DONE
+    };
+
+    bool need(fd_session_t*, unsigned n);
+    uint32_t peek(unsigned skip, unsigned n) const
+    { return (uint32_t)(bit_buf >> skip) & ((1u << n) - 1); }
+    void drop(unsigned n)
+    { bit_buf >>= n; bit_cnt -= n; }
+
+    int decode(fd_session_t*, const Deflate64Huffman&, unsigned& used);
+    bool put(fd_session_t*, uint8_t);
+
+    fd_status_t stored(fd_session_t*);
+    fd_status_t table_lens(fd_session_t*);
+    fd_status_t codes(fd_session_t*);
+    fd_status_t copy(fd_session_t*);
+
+    uint64_t bit_buf = 0;
+    unsigned bit_cnt = 0;
+
+    State state = D64_HEADER;
+    bool last = false;
+
+    // stored block bytes or match bytes left to copy
+    uint32_t remaining = 0;
+    uint32_t distance = 0;
+
+    // dynamic table construction
+    uint16_t nlen = 0;
+    uint16_t ndist = 0;
+    uint16_t ncode = 0;
+    uint16_t index = 0;
+    uint8_t lengths[320];
+
+    Deflate64Huffman lencode;
+    Deflate64Huffman distcode;
+
+    // sliding window of the last 64 KiB of output
+    uint32_t window_pos = 0;
+    uint32_t window_fill = 0;
+    uint8_t window[1 << 16];
+};
+
+#endif
+
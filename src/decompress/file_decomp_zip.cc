@@ -26,11 +26,28 @@
 #include "helpers/boyer_moore_search.h"
 #include "utils/util.h"
 
+#include "file_decomp_deflate64.h"
+#include "file_olestream.h"
+
+#ifdef UNIT_TEST
+#include <algorithm>
+#include <string>
+
+#include "catch/snort_catch.h"
+#endif
+
 using namespace snort;
 
-// initialize zlib decompression
+// initialize zlib or deflate64 decompression
 static fd_status_t Inflate_Init(fd_session_t* SessionPtr)
 {
+    if ( SessionPtr->ZIP->method == ZIP_METHOD_DEFLATE64 )
+    {
+        SessionPtr->ZIP->deflate64 = new Deflate64;
+        file_decomp_stats.zip_deflate64_streams++;
+        return File_Decomp_OK;
+    }
+
     z_stream* z_s = &(SessionPtr->ZIP->Stream);
 
     memset((char*)z_s, 0, sizeof(z_stream));
@@ -48,9 +65,16 @@ static fd_status_t Inflate_Init(fd_session_t* SessionPtr)
     return File_Decomp_OK;
 }
 
-// end zlib decompression
+// end zlib or deflate64 decompression
 static fd_status_t Inflate_End(fd_session_t* SessionPtr)
 {
+    if ( SessionPtr->ZIP->deflate64 )
+    {
+        delete SessionPtr->ZIP->deflate64;
+        SessionPtr->ZIP->deflate64 = nullptr;
+        return File_Decomp_OK;
+    }
+
     z_stream* z_s = &(SessionPtr->ZIP->Stream);
 
     inflateEnd(z_s);
@@ -58,11 +82,31 @@ static fd_status_t Inflate_End(fd_session_t* SessionPtr)
     return File_Decomp_OK;
 }
 
+// perform deflate64 decompression
+static fd_status_t Inflate64(fd_session_t* SessionPtr)
+{
+    const uint8_t* start = SessionPtr->Next_In;
+
+    fd_status_t status = SessionPtr->ZIP->deflate64->inflate(SessionPtr);
+
+    // keep track of decompression progress
+    SessionPtr->ZIP->progress += SessionPtr->Next_In - start;
+
+    // like zlib, a full output buffer only blocks if there is input left
+    if ( status == File_Decomp_BlockOut and SessionPtr->Avail_In == 0 )
+        return File_Decomp_OK;
+
+    return status;
+}
+
 // perform zlib decompression
 static fd_status_t Inflate(fd_session_t* SessionPtr)
 {
     const uint8_t *zlib_start, *zlib_end;
 
+    if ( SessionPtr->ZIP->deflate64 )
+        return Inflate64(SessionPtr);
+
     z_stream* z_s = &(SessionPtr->ZIP->Stream);
 
     zlib_start = SessionPtr->Next_In;
@@ -110,6 +154,21 @@ fd_status_t File_Decomp_Init_ZIP(fd_session_t* SessionPtr)
     return File_Decomp_OK;
 }
 
+// pass newly inflated bytes of vbaProject.bin to the OLE parser
+static void Ole_Process(fd_session_t* SessionPtr, const uint8_t* out)
+{
+    if ( SessionPtr->Next_Out > out )
+        SessionPtr->ole_stream->process(out, SessionPtr->Next_Out - out);
+}
+
+// vbaProject.bin has ended, extract what is left
+static void Ole_End(fd_session_t* SessionPtr)
+{
+    SessionPtr->ole_stream->finish();
+    file_decomp_stats.ole_sectors_dropped += SessionPtr->ole_stream->get_dropped();
+    SessionPtr->ZIP->ole_entry = false;
+}
+
 // end ZIP processing
 fd_status_t File_Decomp_End_ZIP(fd_session_t* SessionPtr)
 {
@@ -120,6 +179,9 @@ fd_status_t File_Decomp_End_ZIP(fd_session_t* SessionPtr)
     if ( SessionPtr->ZIP->State == ZIP_STATE_INFLATE )
         Inflate_End(SessionPtr);
 
+    if ( SessionPtr->ZIP->ole_entry )
+        Ole_End(SessionPtr);
+
     if (SessionPtr->ZIP->file_name)
     {
         delete[] SessionPtr->ZIP->file_name;
@@ -162,7 +224,24 @@ fd_status_t File_Decomp_ZIP(fd_session_t* SessionPtr)
             {
                 // check if we read a local_header
                 if ( parser->local_header != ZIP_LOCAL_HEADER )
+                {
+                    // zip64 data descriptors are larger; unless the archive
+                    // ended, search for the next local header
+                    if ( parser->after_data_desc and parser->local_header != ZIP_CENTRAL_HEADER )
+                    {
+                        parser->Index = 0;
+                        parser->local_header = 0;
+                        parser->after_data_desc = false;
+
+                        parser->State = ZIP_STATE_SEARCH;
+                        parser->Length = 0;
+                        continue;
+                    }
+
                     return output_blocked ? File_Decomp_BlockOut : File_Decomp_Complete;
+                }
+
+                parser->after_data_desc = false;
 
                 // read a local_header, reset the index
                 parser->Index = 0;
@@ -316,10 +395,11 @@ fd_status_t File_Decomp_ZIP(fd_session_t* SessionPtr)
                 parser->State = ZIP_STATE_SKIP;
                 parser->Length = parser->extra_length;
 
-                if ( (SessionPtr->Avail_Out > 0) && (parser->method == 8) )
+                if ( (SessionPtr->Avail_Out > 0) && ((parser->method == ZIP_METHOD_DEFLATE) ||
+                    (parser->method == ZIP_METHOD_DEFLATE64)) )
                 {
                     // we have available output space and
-                    // the compression type is deflate (8),
+                    // the compression type is deflate (8) or deflate64 (9),
                     // land on the compressed stream, init zlib
                     //If the filename ends with vbaProject.bin, then
                     //the file has vbaMacros.
@@ -361,8 +441,14 @@ fd_status_t File_Decomp_ZIP(fd_session_t* SessionPtr)
             break;
 
         case ZIP_STATE_OLE_FILE:
-            if (SessionPtr->vba_analysis)
-                SessionPtr->ole_data_ptr = SessionPtr->Next_Out;
+            // the OLE file is parsed as it is inflated, only the first one
+            if ( SessionPtr->vba_analysis and !SessionPtr->ole_stream )
+            {
+                uint32_t window = SessionPtr->ole_window ? SessionPtr->ole_window :
+                    OLE_DEFAULT_WINDOW;
+                SessionPtr->ole_stream = new OleStream(window);
+                parser->ole_entry = true;
+            }
         //fallthrough
         // initialize zlib inflate
         case ZIP_STATE_INFLATE_INIT:
@@ -376,8 +462,17 @@ fd_status_t File_Decomp_ZIP(fd_session_t* SessionPtr)
         case ZIP_STATE_INFLATE:
         {
             // run inflate
+            const uint8_t* out = SessionPtr->Next_Out;
             fd_status_t status = Inflate(SessionPtr);
 
+            if ( parser->ole_entry )
+            {
+                Ole_Process(SessionPtr, out);
+
+                if ( status != File_Decomp_OK )
+                    Ole_End(SessionPtr);
+            }
+
             if ( status == File_Decomp_Error )
             {
                 // error inflating the stream
@@ -386,9 +481,6 @@ fd_status_t File_Decomp_ZIP(fd_session_t* SessionPtr)
                 return File_Decomp_Error;
             }
 
-            if (SessionPtr->ole_data_ptr)
-                SessionPtr->ole_data_len = SessionPtr->Next_Out - SessionPtr->ole_data_ptr;
-
             if ( status == File_Decomp_BlockOut )
             {
                 // ran out of output space
@@ -430,9 +522,10 @@ fd_status_t File_Decomp_ZIP(fd_session_t* SessionPtr)
 
                 if ( parser->data_descriptor )
                 {
-                    // search for the next file
-                    parser->State = ZIP_STATE_SEARCH;
-                    parser->Length = 0;
+                    // the stream ended on its own,
+                    // the next file follows the data descriptor
+                    parser->State = ZIP_STATE_DATA_DESC;
+                    parser->Length = 4;
                     continue;
                 }
 
@@ -446,6 +539,29 @@ fd_status_t File_Decomp_ZIP(fd_session_t* SessionPtr)
             // circle back for more input
             return File_Decomp_OK;
         }
+        // data descriptor
+        case ZIP_STATE_DATA_DESC:
+            // check if we are done with the signature or crc
+            if ( parser->Index == parser->Length )
+            {
+                parser->Index = 0;
+
+                // the signature is optional, without it we just read the crc
+                // skip: [crc(4)], compressed size(4), uncompressed size(4)
+                parser->State = ZIP_STATE_SKIP;
+                parser->Length = (parser->data_desc == ZIP_DATA_DESC) ? 12 : 8;
+                parser->data_desc = 0;
+                parser->after_data_desc = true;
+
+                // land on another local header
+                parser->Next = ZIP_STATE_LH;
+                parser->Next_Length = 4;
+                continue;
+            }
+            // read the signature or crc
+            byte = *SessionPtr->Next_In;
+            parser->data_desc |= (uint32_t)byte << (parser->Index * 8);
+            break;
         // search state
         case ZIP_STATE_SEARCH:
         {
@@ -556,3 +672,178 @@ fd_status_t File_Decomp_ZIP(fd_session_t* SessionPtr)
     return output_blocked ? File_Decomp_BlockOut : File_Decomp_BlockIn;
 }
 
+
+//--------------------------------------------------------------------------
+// unit tests
+//--------------------------------------------------------------------------
+
+#ifdef UNIT_TEST
+
+static void put16(std::string& s, uint16_t v)
+{
+    s += (char)(v & 0xff);
+    s += (char)(v >> 8);
+}
+
+static void put32(std::string& s, uint32_t v)
+{
+    put16(s, v & 0xffff);
+    put16(s, v >> 16);
+}
+
+// raw deflate without matches is also a valid deflate64 stream
+static std::string deflate_raw(const std::string& data, int strategy)
+{
+    z_stream z = { };
+    deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, strategy);
+
+    std::string out(deflateBound(&z, data.size()), '\0');
+    z.next_in = (Bytef*)data.data();
+    z.avail_in = data.size();
+    z.next_out = (Bytef*)&out[0];
+    z.avail_out = out.size();
+
+    deflate(&z, Z_FINISH);
+    out.resize(z.total_out);
+    deflateEnd(&z);
+    return out;
+}
+
+static std::string local_file(const std::string& name, const std::string& data,
+    uint16_t method, unsigned desc_len)
+{
+    const std::string comp = deflate_raw(data,
+        method == ZIP_METHOD_DEFLATE64 ? Z_HUFFMAN_ONLY : Z_DEFAULT_STRATEGY);
+
+    std::string s;
+    put32(s, ZIP_LOCAL_HEADER);
+    put16(s, 20);                         // version
+    put16(s, desc_len ? DATA_DESC_BIT : 0);
+    put16(s, method);
+    put32(s, 0);                          // time and date
+    put32(s, 0);                          // crc
+    put32(s, desc_len ? 0 : comp.size());
+    put32(s, desc_len ? 0 : data.size());
+    put16(s, name.size());
+    put16(s, 0);                          // extra length
+    s += name;
+    s += comp;
+
+    if ( desc_len == 12 or desc_len == 16 or desc_len == 24 )
+    {
+        if ( desc_len != 12 )
+            put32(s, ZIP_DATA_DESC);
+        put32(s, 0);                      // crc
+        put32(s, comp.size());
+        if ( desc_len == 24 )
+            put32(s, 0);
+        put32(s, data.size());
+        if ( desc_len == 24 )
+            put32(s, 0);
+    }
+    return s;
+}
+
+// the archive ends when the header after the last file is read
+static void central_directory(std::string& s)
+{
+    put32(s, ZIP_CENTRAL_HEADER);
+    s += std::string(42, '\0');
+}
+
+static fd_status_t decompress_zip(const std::string& zip, std::string& out, unsigned chunk)
+{
+    fd_session_t s = { };
+    REQUIRE(File_Decomp_Init_ZIP(&s) == File_Decomp_OK);
+
+    // file_decomp.cc consumes the local header signature
+    std::string buf(1 << 16, '\0');
+    size_t off = 4;
+    fd_status_t status = File_Decomp_OK;
+
+    s.Next_Out = (uint8_t*)&buf[0];
+    s.Avail_Out = buf.size();
+
+    while ( off < zip.size() and status != File_Decomp_Complete and status != File_Decomp_Error )
+    {
+        unsigned n = std::min<size_t>(chunk, zip.size() - off);
+        s.Next_In = (const uint8_t*)zip.data() + off;
+        s.Avail_In = n;
+        status = File_Decomp_ZIP(&s);
+        off += n - s.Avail_In;
+
+        if ( status != File_Decomp_Complete and s.Avail_In )
+            break;
+    }
+    out.assign(buf.data(), s.Next_Out - (uint8_t*)&buf[0]);
+
+    File_Decomp_End_ZIP(&s);
+    snort_free(s.ZIP);
+    return status;
+}
+
+static std::string make_data(const char* tag, unsigned size)
+{
+    std::string s;
+    unsigned i = 0;
+    while ( s.size() < size )
+        s += std::string(tag) + " line " + std::to_string(i++ * 7919 % 1000) + "\n";
+    return s;
+}
+
+TEST_CASE("zip deflate64 entry", "[file_decomp_zip]")
+{
+    const std::string a = make_data("first", 3000);
+    const std::string b = make_data("second", 2000);
+
+    std::string zip = local_file("a.txt", a, ZIP_METHOD_DEFLATE64, 0) +
+        local_file("b.txt", b, ZIP_METHOD_DEFLATE, 0);
+    central_directory(zip);
+
+    const uint64_t streams = file_decomp_stats.zip_deflate64_streams;
+
+    for ( unsigned chunk : { 1u, 100u, 100000u } )
+    {
+        std::string out;
+        CHECK(decompress_zip(zip, out, chunk) == File_Decomp_Complete);
+        CHECK(out.find(a) != std::string::npos);
+        CHECK(out.find(b) != std::string::npos);
+    }
+    CHECK(file_decomp_stats.zip_deflate64_streams == streams + 3);
+}
+
+TEST_CASE("zip data descriptors", "[file_decomp_zip]")
+{
+    const std::string a = make_data("first", 3000);
+    const std::string b = make_data("second", 2000);
+    const std::string c = make_data("third", 1000);
+
+    SECTION("with and without signature")
+    {
+        std::string zip = local_file("a.txt", a, ZIP_METHOD_DEFLATE, 16) +
+            local_file("b.txt", b, ZIP_METHOD_DEFLATE64, 12) +
+            local_file("c.txt", c, ZIP_METHOD_DEFLATE, 0);
+        central_directory(zip);
+
+        for ( unsigned chunk : { 1u, 100u, 100000u } )
+        {
+            std::string out;
+            CHECK(decompress_zip(zip, out, chunk) == File_Decomp_Complete);
+            CHECK(out.find(a) != std::string::npos);
+            CHECK(out.find(b) != std::string::npos);
+            CHECK(out.find(c) != std::string::npos);
+        }
+    }
+    SECTION("zip64 descriptor")
+    {
+        std::string zip = local_file("a.txt", a, ZIP_METHOD_DEFLATE, 24) +
+            local_file("b.txt", b, ZIP_METHOD_DEFLATE, 0);
+        central_directory(zip);
+
+        std::string out;
+        decompress_zip(zip, out, 100000);
+        CHECK(out.find(a) != std::string::npos);
+        CHECK(out.find(b) != std::string::npos);
+    }
+}
+#endif
@@ -29,11 +29,17 @@ namespace snort
 class BoyerMooreSearchCase;
 }
 
+class Deflate64;
+
 #define MACRO_BINNAME_LEN 14
 
 static const char* const macro_binname = "vbaProject.bin";
 
 static const uint32_t ZIP_LOCAL_HEADER = 0x04034B50;
+static const uint32_t ZIP_DATA_DESC = 0x08074B50;
+static const uint32_t ZIP_CENTRAL_HEADER = 0x02014B50;
+static const uint16_t ZIP_METHOD_DEFLATE = 8;
+static const uint16_t ZIP_METHOD_DEFLATE64 = 9;
 static const uint8_t header_pattern[4] = { 0x50, 0x4B, 0x03, 0x04 };
 static const uint8_t DATA_DESC_BIT = 0x08;
 
@@ -69,6 +75,7 @@ enum fd_ZIP_states
     ZIP_STATE_OLE_FILE,
     ZIP_STATE_INFLATE_INIT,   // initialize zlib inflate
     ZIP_STATE_INFLATE,        // perform zlib inflate
+    ZIP_STATE_DATA_DESC,      // data descriptor following a stream
     ZIP_STATE_SEARCH,         // search for local header
     ZIP_STATE_SKIP            // skip state
 };
@@ -78,6 +85,9 @@ struct fd_ZIP_t
     // zlib stream
     z_stream Stream;
 
+    // deflate64 stream, zlib doesn't support it
+    Deflate64* deflate64;
+
     // decompression progress
     uint32_t progress;
 
@@ -85,11 +95,15 @@ struct fd_ZIP_t
     uint32_t local_header;
     uint16_t bitflag;
     bool data_descriptor;
+    uint32_t data_desc;
+    bool after_data_desc;
     uint16_t method;
     uint32_t compressed_size;
     uint16_t filename_length;
     uint16_t extra_length;
     char* file_name;
+    // inflating vbaProject.bin into the session OLE stream
+    bool ole_entry;
     // field index
     uint32_t Index;
 
@@ -55,10 +55,6 @@ void OleFile :: walk_directory_list()
 {
     int32_t current_sector;
     uint16_t sector_size;
-    uint8_t* name_buf;
-    int bytes_copied;
-    FileProperty* node;
-    char* file_name;
 
     VBA_DEBUG(vba_data_trace, DEFAULT_TRACE_OPTION_ID, TRACE_INFO_LEVEL, CURRENT_PACKET,
         "Parsing the Directory list.\n");
@@ -78,59 +74,8 @@ void OleFile :: walk_directory_list()
 
         buf += start_offset;
 
-        int32_t count = 0;
+        dir_list->add_entries(buf, sector_size, header->get_byte_order());
 
-        while (count < (sector_size/DIR_ENTRY_SIZE))
-        {
-            node = new FileProperty;
-            name_buf = new uint8_t[32];
-
-            // The filename is UTF16 encoded and will be of the size 64 bytes.
-            snort::UtfDecodeSession utf_state;
-            if (!header->get_byte_order())
-                utf_state.set_decode_utf_state_charset(CHARSET_UTF16LE);
-            else
-                utf_state.set_decode_utf_state_charset(CHARSET_UTF16BE);
-            utf_state.decode_utf(buf, OLE_MAX_FILENAME_LEN_UTF16, name_buf,
-                OLE_MAX_FILENAME_ASCII, &bytes_copied);
-
-            node->set_name(name_buf);
-
-            node->set_file_type(buf + DIR_FILE_TYPE_OFFSET);
-
-            node->set_color(buf + DIR_COLOR_OFFSET);
-
-            node->set_lef_sib_id(buf + DIR_LEFT_SIB_OFFSET, header->get_byte_order());
-
-            node->set_rig_sib_id(buf + DIR_RIGHT_SIB_OFFSET, header->get_byte_order());
-
-            node->set_root_node_id(buf + DIR_ROOT_NODE_OFFSET, header->get_byte_order());
-
-            node->set_cls_id(buf + DIR_CLS_ID_OFFSET);
-
-            node->set_starting_sector(buf + DIR_STARTING_SEC_OFFSET, header->get_byte_order());
-
-            node->set_stream_size(buf + DIR_STREAM_SIZE_OFFSET, header->get_byte_order());
-
-            buf += DIR_NEXT_ENTR_OFFSET;
-
-            //Insert the oleentry
-            file_name = (char*)name_buf;
-
-            if (strcmp(file_name, ROOT_ENTRY) == 0)
-                dir_list->set_mini_stream_sector(node->get_starting_sector());
-
-            object_type type = node->get_file_type();
-            // check for all the empty/non valid entries in the directory list.
-            if (!(type == ROOT_STORAGE or type == STORAGE or type == STREAM))
-            {
-                delete node;
-                delete[] name_buf;
-            }
-            else
-                dir_list->oleentry.emplace_back(node);
-            count++;
-        }
         // Reading the next sector of current_sector by referring the FAT list array.
         // A negative number suggests the end of directory entry array and there are
         // no more stream/storage to read.
@@ -158,6 +103,67 @@ FileProperty* DirectoryList :: get_file_node(char* name)
     return *it;
 }
 
+// Each directory sector holds sector_size / DIR_ENTRY_SIZE entries. Empty and
+// invalid entries are skipped.
+void DirectoryList :: add_entries(const uint8_t* buf, uint16_t sector_size,
+    byte_order_endianess byte_order)
+{
+    int32_t count = 0;
+
+    while (count < (sector_size/DIR_ENTRY_SIZE))
+    {
+        FileProperty* node = new FileProperty;
+        uint8_t* name_buf = new uint8_t[32];
+        int bytes_copied;
+
+        // The filename is UTF16 encoded and will be of the size 64 bytes.
+        snort::UtfDecodeSession utf_state;
+        if (!byte_order)
+            utf_state.set_decode_utf_state_charset(CHARSET_UTF16LE);
+        else
+            utf_state.set_decode_utf_state_charset(CHARSET_UTF16BE);
+        utf_state.decode_utf(buf, OLE_MAX_FILENAME_LEN_UTF16, name_buf,
+            OLE_MAX_FILENAME_ASCII, &bytes_copied);
+
+        node->set_name(name_buf);
+
+        node->set_file_type(buf + DIR_FILE_TYPE_OFFSET);
+
+        node->set_color(buf + DIR_COLOR_OFFSET);
+
+        node->set_lef_sib_id(buf + DIR_LEFT_SIB_OFFSET, byte_order);
+
+        node->set_rig_sib_id(buf + DIR_RIGHT_SIB_OFFSET, byte_order);
+
+        node->set_root_node_id(buf + DIR_ROOT_NODE_OFFSET, byte_order);
+
+        node->set_cls_id(buf + DIR_CLS_ID_OFFSET);
+
+        node->set_starting_sector(buf + DIR_STARTING_SEC_OFFSET, byte_order);
+
+        node->set_stream_size(buf + DIR_STREAM_SIZE_OFFSET, byte_order);
+
+        buf += DIR_NEXT_ENTR_OFFSET;
+
+        //Insert the oleentry
+        char* file_name = (char*)name_buf;
+
+        if (strcmp(file_name, ROOT_ENTRY) == 0)
+            set_mini_stream_sector(node->get_starting_sector());
+
+        object_type type = node->get_file_type();
+        // check for all the empty/non valid entries in the directory list.
+        if (!(type == ROOT_STORAGE or type == STORAGE or type == STREAM))
+        {
+            delete node;
+            delete[] name_buf;
+        }
+        else
+            oleentry.emplace_back(node);
+        count++;
+    }
+}
+
 // Every index of fat_list array is the fat sector ID and the value present
 // at that index will be its corresponding next fat sector ID.
 int32_t OleFile :: get_next_fat_sector(int32_t sec_id)
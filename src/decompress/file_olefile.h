@@ -204,6 +204,7 @@ public:
     FileProperty* get_file_node(char* name);
     int32_t get_file_sector(char* name);
     bool is_mini_sector(char* name);
+    void add_entries(const uint8_t* buf, uint16_t sector_size, byte_order_endianess);
     void set_mini_stream_sector(int32_t mini_stream_sector)
     {
         this->mini_stream_sector = mini_stream_sector;
@@ -234,9 +235,9 @@ public:
     int32_t get_next_mini_fat_sector(int32_t sec_id);
     int32_t get_fat_offset(int32_t sec_id);
     int32_t get_mini_fat_offset(int32_t sec_id);
-    int32_t get_file_offset(const uint8_t*, uint32_t data_len);
+    static int32_t get_file_offset(const uint8_t*, uint32_t data_len);
 
-    void decompression(const uint8_t* data, uint32_t& data_len, uint8_t*& buffer,
+    static void decompression(const uint8_t* data, uint32_t& data_len, uint8_t*& buffer,
         uint32_t& buffer_ofset);
     uint32_t find_bytes_to_copy(uint32_t byte_offset, uint32_t data_len,
                                    uint32_t stream_size, uint16_t sector_size);
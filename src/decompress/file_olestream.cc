@@ -0,0 +1,624 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2023-2023 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// file_olestream.cc
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "file_olestream.h"
+
+#include <algorithm>
+#include <climits>
+
+// a FAT entry whose FAT sector has not arrived yet
+#define FAT_UNKNOWN INT32_MIN
+
+// bytes before the VBA keyword that belong to the compressed container and
+// the most kept while looking for it
+#define VBA_KEY_PREFIX 4
+#define VBA_KEY_TAIL (VBA_KEY_PREFIX + 7)
+
+static inline int32_t get_int32(const uint8_t* buf, byte_order_endianess endian)
+{
+    return (!endian) ? LETOHL_UNALIGNED(buf) : BETOHL_UNALIGNED(buf);
+}
+
+OleStream::OleStream(uint32_t window) : window(window)
+{ }
+
+OleStream::~OleStream()
+{
+    release_all();
+}
+
+void OleStream::process(const uint8_t* data, uint32_t len)
+{
+    if ( failed or complete or input_done )
+        return;
+
+    if ( !header_done )
+    {
+        uint32_t n = std::min(OLE_HEADER_LEN - header_len, len);
+        memcpy(header_buf + header_len, data, n);
+        header_len += n;
+        data += n;
+        len -= n;
+
+        if ( header_len < OLE_HEADER_LEN )
+            return;
+
+        parse_header();
+
+        if ( failed )
+            return;
+    }
+
+    while ( len and !complete )
+    {
+        // whole sectors are taken straight from the input
+        if ( !partial_len and len >= sector_size )
+        {
+            add_sector(data);
+            data += sector_size;
+            len -= sector_size;
+            continue;
+        }
+
+        uint32_t n = std::min(sector_size - partial_len, len);
+        memcpy(partial + partial_len, data, n);
+        partial_len += n;
+        data += n;
+        len -= n;
+
+        if ( partial_len == sector_size )
+        {
+            partial_len = 0;
+            add_sector(partial);
+        }
+    }
+}
+
+void OleStream::finish()
+{
+    if ( input_done )
+        return;
+
+    // OleFile reads a short last sector as far as it goes
+    if ( header_done and !failed and !complete and partial_len )
+    {
+        memset(partial + partial_len, 0, sector_size - partial_len);
+        partial_len = 0;
+        add_sector(partial);
+    }
+
+    input_done = true;
+    advance();
+}
+
+void OleStream::get_vba(uint8_t*& buf, uint32_t& len)
+{
+    buf = nullptr;
+    len = 0;
+
+    for ( const auto& e : entries )
+        len += e.vba.size();
+
+    if ( !len )
+        return;
+
+    len = std::min(len, (uint32_t)MAX_VBA_BUFFER_LEN);
+    buf = new uint8_t[MAX_VBA_BUFFER_LEN + 1]();
+
+    uint32_t offset = 0;
+
+    for ( const auto& e : entries )
+    {
+        uint32_t n = std::min((uint32_t)e.vba.size(), len - offset);
+        memcpy(buf + offset, e.vba.data(), n);
+        offset += n;
+    }
+}
+
+void OleStream::parse_header()
+{
+    if ( !header.set_byte_order(header_buf + HEADER_BYTE_ORDER_OFFSET) or
+        !header.match_ole_sig(header_buf) )
+    {
+        VBA_DEBUG(vba_data_trace, DEFAULT_TRACE_OPTION_ID, TRACE_ERROR_LEVEL, CURRENT_PACKET,
+            "Invalid OLE header. Skipping the stream.\n");
+        failed = true;
+        return;
+    }
+
+    header.set_minor_version(header_buf + HEADER_MINOR_VER_OFFSET);
+    header.set_major_version(header_buf + HEADER_MAJOR_VER_OFFSET);
+    header.set_sector_size(header_buf + HEADER_SECTR_SIZE_OFFSET);
+    header.set_mini_sector_size(header_buf + HEADER_MIN_SECTR_SIZE_OFFSET);
+    header.set_fat_sector_count(header_buf + HEADER_FAT_SECTR_CNT_OFFSET);
+    header.set_first_dir(header_buf + HEADER_FIRST_DIR_SECTR_OFFSET);
+    header.set_minifat_cutoff(header_buf + HEADER_MINFAT_CUTOFF_OFFSET);
+    header.set_first_minifat(header_buf + HEADER_FIRST_MINFAT_OFFSET);
+    header.set_minifat_count(header_buf + HEADER_MINFAT_COUNT_OFFSET);
+    header.set_first_difat(header_buf + HEADER_FIRST_DIFAT_OFFSET);
+    header.set_difat_count(header_buf + HEADER_DIFAT_CNT_OFFSET);
+    header.set_dir_sector_count(header_buf + HEADER_DIR_SECTR_CNT_OFFSET);
+    header.set_difat_array(header_buf + HEADER_DIFAT_ARRY_OFFSET);
+
+    sector_size = header.get_sector_size();
+    mini_sector_size = header.get_mini_sector_size();
+
+    if ( (sector_size != 512 and sector_size != 4096) or !mini_sector_size or
+        mini_sector_size >= sector_size or sector_size % mini_sector_size )
+    {
+        VBA_DEBUG(vba_data_trace, DEFAULT_TRACE_OPTION_ID, TRACE_ERROR_LEVEL, CURRENT_PACKET,
+            "Invalid OLE sector size %u, mini sector size %u.\n", sector_size,
+            mini_sector_size);
+        failed = true;
+        return;
+    }
+
+    // like OleFile, only the FAT sectors listed in the header are used
+    int32_t fat_count = std::min(header.get_fat_sector_count(), MAX_DIFAT_SECTORS);
+
+    for ( int32_t i = 0; i < fat_count; ++i )
+    {
+        int32_t id = header.get_difat_array(i);
+
+        if ( id <= INVALID_SECTOR )
+            break;
+
+        fat_ids.emplace_back(id);
+        fat_index.emplace(id, i);
+    }
+
+    // no chain can be longer than the FAT
+    max_chain = fat_ids.size() * (sector_size / 4);
+
+    mini_fat_next = header.get_first_minifat();
+    mini_fat_left = header.get_minifat_count();
+    dir_next = header.get_first_dir();
+
+    partial = new uint8_t[sector_size];
+    header_done = true;
+}
+
+// Sectors are numbered from the end of the 512 byte header, as in OleFile.
+void OleStream::add_sector(const uint8_t* buf)
+{
+    int32_t id = sector_count++;
+
+    auto it = fat_index.find(id);
+
+    if ( it != fat_index.end() )
+        parse_fat(it->second, buf);
+    else
+        retain(id, buf);
+
+    if ( sector_count > next_wait )
+        advance();
+}
+
+void OleStream::retain(int32_t id, const uint8_t* buf)
+{
+    while ( retained + sector_size > window and !retain_order.empty() )
+    {
+        int32_t oldest = retain_order.front();
+        retain_order.pop_front();
+
+        auto it = sectors.find(oldest);
+
+        if ( it == sectors.end() )
+            continue;
+
+        delete[] it->second;
+        sectors.erase(it);
+        retained -= sector_size;
+        ++dropped;
+    }
+
+    uint8_t* copy = new uint8_t[sector_size];
+    memcpy(copy, buf, sector_size);
+
+    sectors.emplace(id, copy);
+    retain_order.emplace_back(id);
+    retained += sector_size;
+}
+
+void OleStream::release(int32_t id)
+{
+    auto it = sectors.find(id);
+
+    if ( it == sectors.end() )
+        return;
+
+    delete[] it->second;
+    sectors.erase(it);
+    retained -= sector_size;
+
+    if ( retain_order.front() == id )
+        retain_order.pop_front();
+}
+
+void OleStream::release_all()
+{
+    for ( auto& s : sectors )
+        delete[] s.second;
+
+    sectors.clear();
+    retain_order.clear();
+    retained = 0;
+
+    delete[] partial;
+    partial = nullptr;
+
+    fat.clear();
+    fat.shrink_to_fit();
+    mini_fat.clear();
+    mini_fat.shrink_to_fit();
+    mini_stream.clear();
+    mini_stream.shrink_to_fit();
+
+    for ( auto& e : entries )
+    {
+        e.data.clear();
+        e.data.shrink_to_fit();
+    }
+}
+
+void OleStream::parse_fat(uint32_t index, const uint8_t* buf)
+{
+    uint32_t per_sector = sector_size / 4;
+    uint32_t base = index * per_sector;
+
+    if ( fat.size() < base + per_sector )
+        fat.resize(base + per_sector, FAT_UNKNOWN);
+
+    for ( uint32_t i = 0; i < per_sector; ++i )
+        fat[base + i] = get_int32(buf + i * 4, header.get_byte_order());
+}
+
+void OleStream::parse_mini_fat(const uint8_t* buf)
+{
+    uint32_t per_sector = sector_size / 4;
+
+    for ( uint32_t i = 0; i < per_sector; ++i )
+        mini_fat.emplace_back(get_int32(buf + i * 4, header.get_byte_order()));
+}
+
+void OleStream::parse_dir(const uint8_t* buf)
+{
+    dir_list.add_entries(buf, sector_size, header.get_byte_order());
+}
+
+const uint8_t* OleStream::get_sector(int32_t id, int32_t& wait_for)
+{
+    wait_for = INVALID_SECTOR;
+
+    if ( id <= INVALID_SECTOR )
+        return nullptr;
+
+    auto it = sectors.find(id);
+
+    if ( it != sectors.end() )
+        return it->second;
+
+    // otherwise it was used, dropped or is past the end of the file
+    if ( id >= sector_count and !input_done )
+        wait_for = id;
+
+    return nullptr;
+}
+
+int32_t OleStream::get_next_sector(int32_t id, int32_t& wait_for)
+{
+    wait_for = INVALID_SECTOR;
+
+    if ( id <= INVALID_SECTOR )
+        return INVALID_SECTOR;
+
+    uint32_t index = id;
+
+    if ( index < fat.size() and fat[index] != FAT_UNKNOWN )
+        return fat[index];
+
+    uint32_t fat_sector = index / (sector_size / 4);
+
+    if ( fat_sector < fat_ids.size() and fat_ids[fat_sector] >= sector_count and !input_done )
+    {
+        wait_for = fat_ids[fat_sector];
+        return FAT_UNKNOWN;
+    }
+
+    return INVALID_SECTOR;
+}
+
+int32_t OleStream::get_next_mini_sector(int32_t id)
+{
+    if ( id > INVALID_SECTOR and (uint32_t)id < mini_fat.size() )
+        return mini_fat[id];
+
+    return INVALID_SECTOR;
+}
+
+// The mini stream is the chain of sectors starting at the Root Entry sector.
+// It is followed only as far as the mini sectors asked for.
+const uint8_t* OleStream::get_mini_sector(int32_t id, int32_t& wait_for)
+{
+    wait_for = INVALID_SECTOR;
+
+    if ( id <= INVALID_SECTOR )
+        return nullptr;
+
+    uint32_t per_sector = sector_size / mini_sector_size;
+    uint32_t index = id / per_sector;
+
+    if ( index >= max_chain )
+        return nullptr;
+
+    while ( mini_stream.size() <= index )
+    {
+        int32_t next;
+
+        if ( mini_stream.empty() )
+            next = dir_list.get_mini_stream_sector();
+        else
+            next = get_next_sector(mini_stream.back(), wait_for);
+
+        if ( next <= INVALID_SECTOR )
+            return nullptr;
+
+        mini_stream.emplace_back(next);
+    }
+
+    const uint8_t* buf = get_sector(mini_stream[index], wait_for);
+
+    if ( !buf )
+        return nullptr;
+
+    return buf + (id % per_sector) * mini_sector_size;
+}
+
+// Chains are followed as far as the sectors have arrived. Each sector is
+// released once used so a chain looping back on itself ends there.
+bool OleStream::follow_mini_fat()
+{
+    while ( mini_fat_next > INVALID_SECTOR and mini_fat_left > 0 )
+    {
+        int32_t wait_for;
+        const uint8_t* buf = get_sector(mini_fat_next, wait_for);
+
+        if ( !buf )
+        {
+            if ( wait_for > INVALID_SECTOR )
+            {
+                next_wait = std::min(next_wait, wait_for);
+                return false;
+            }
+            break;
+        }
+
+        int32_t next = get_next_sector(mini_fat_next, wait_for);
+
+        if ( next == FAT_UNKNOWN )
+        {
+            next_wait = std::min(next_wait, wait_for);
+            return false;
+        }
+
+        parse_mini_fat(buf);
+        release(mini_fat_next);
+        mini_fat_next = next;
+        --mini_fat_left;
+    }
+
+    mini_fat_parsed = true;
+    return true;
+}
+
+bool OleStream::follow_dir()
+{
+    while ( dir_next > INVALID_SECTOR )
+    {
+        int32_t wait_for;
+        const uint8_t* buf = get_sector(dir_next, wait_for);
+
+        if ( !buf )
+        {
+            if ( wait_for > INVALID_SECTOR )
+            {
+                next_wait = std::min(next_wait, wait_for);
+                return false;
+            }
+            break;
+        }
+
+        int32_t next = get_next_sector(dir_next, wait_for);
+
+        if ( next == FAT_UNKNOWN )
+        {
+            next_wait = std::min(next_wait, wait_for);
+            return false;
+        }
+
+        parse_dir(buf);
+        release(dir_next);
+        dir_next = next;
+    }
+
+    uint32_t cutoff = header.get_minifat_cutoff();
+
+    for ( auto node : dir_list.oleentry )
+    {
+        if ( node->get_file_type() != STREAM )
+            continue;
+
+        // sizes are taken as 32 bits like OleFile does
+        int64_t stream_size = node->get_stream_size();
+
+        OleEntry e;
+        e.node = node;
+        e.size = (uint32_t)stream_size;
+        e.read = 0;
+        e.next = node->get_starting_sector();
+        e.mini = e.size <= cutoff;
+        e.found = false;
+        e.done = false;
+
+        entries.emplace_back(e);
+    }
+
+    entries_left = entries.size();
+    dir_parsed = true;
+
+    VBA_DEBUG(vba_data_trace, DEFAULT_TRACE_OPTION_ID, TRACE_INFO_LEVEL, CURRENT_PACKET,
+        "OLE directory parsed, %u streams.\n", entries_left);
+
+    return true;
+}
+
+// Reads the sectors of the stream that are available. Returns false while
+// waiting for more sectors. A missing sector that will not arrive ends the
+// stream where it is.
+//
+// Until the VBA keyword is found only enough of the stream is kept to find
+// it across a sector boundary. From there on up to a window of the stream
+// is kept for decompression.
+bool OleStream::read_entry(OleEntry& e)
+{
+    uint16_t unit = e.mini ? mini_sector_size : sector_size;
+
+    while ( e.next > INVALID_SECTOR and e.read < e.size and
+        (!e.found or e.data.size() < window) )
+    {
+        int32_t wait_for;
+        const uint8_t* buf = e.mini ? get_mini_sector(e.next, wait_for) :
+            get_sector(e.next, wait_for);
+
+        if ( !buf )
+        {
+            if ( wait_for > INVALID_SECTOR )
+            {
+                next_wait = std::min(next_wait, wait_for);
+                return false;
+            }
+            break;
+        }
+
+        int32_t next = e.mini ? get_next_mini_sector(e.next) : get_next_sector(e.next, wait_for);
+
+        if ( next == FAT_UNKNOWN )
+        {
+            next_wait = std::min(next_wait, wait_for);
+            return false;
+        }
+
+        uint32_t n = std::min((uint32_t)unit, e.size - e.read);
+        e.data.append((const char*)buf, n);
+        e.read += n;
+
+        // mini stream sectors are shared so they stay until the end
+        if ( !e.mini )
+            release(e.next);
+
+        e.next = next;
+
+        if ( !e.found )
+            find_vba(e);
+    }
+
+    return true;
+}
+
+void OleStream::find_vba(OleEntry& e)
+{
+    int32_t offset = OleFile::get_file_offset((const uint8_t*)e.data.data(), e.data.size());
+
+    // the compressed container starts 4 bytes before the keyword
+    if ( offset >= VBA_KEY_PREFIX )
+    {
+        e.data.erase(0, offset - VBA_KEY_PREFIX);
+        e.found = true;
+    }
+    else if ( offset >= 0 )
+    {
+        // OleFile does not take a keyword at the start of the stream either
+        e.data.clear();
+        e.next = INVALID_SECTOR;
+    }
+    else if ( e.data.size() > VBA_KEY_TAIL )
+        e.data.erase(0, e.data.size() - VBA_KEY_TAIL);
+}
+
+void OleStream::extract_vba(OleEntry& e)
+{
+    if ( !e.found )
+    {
+        VBA_DEBUG(vba_data_trace, DEFAULT_TRACE_OPTION_ID, TRACE_INFO_LEVEL, CURRENT_PACKET,
+            "Stream %s of size %ld does not have VBA code within first detected"
+            " %u bytes\n", e.node->get_name(), e.node->get_stream_size(), e.read);
+    }
+    else
+    {
+        uint32_t data_len = e.data.size();
+        uint8_t* buf = new uint8_t[MAX_VBA_BUFFER_LEN + 1]();
+        uint32_t buf_len = 0;
+
+        OleFile::decompression((const uint8_t*)e.data.data(), data_len, buf, buf_len);
+        e.vba.assign((const char*)buf, buf_len);
+
+        delete[] buf;
+    }
+
+    e.data.clear();
+    e.data.shrink_to_fit();
+}
+
+void OleStream::advance()
+{
+    if ( failed or complete or !header_done )
+        return;
+
+    next_wait = INT32_MAX;
+
+    bool mini_ready = mini_fat_parsed or follow_mini_fat();
+
+    if ( !dir_parsed and !follow_dir() )
+        return;
+
+    // streams in sectors only need the directory, those in the mini stream
+    // wait for the mini FAT too
+    for ( auto& e : entries )
+    {
+        if ( e.done or (e.mini and !mini_ready) )
+            continue;
+
+        if ( !read_entry(e) )
+            continue;
+
+        extract_vba(e);
+        e.done = true;
+        --entries_left;
+    }
+
+    if ( !entries_left )
+    {
+        complete = true;
+        release_all();
+    }
+}
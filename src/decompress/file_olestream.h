@@ -0,0 +1,156 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2023-2023 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// file_olestream.h
+
+#ifndef FILE_OLE_STREAM_H
+#define FILE_OLE_STREAM_H
+
+// OleStream extracts VBA macros from an OLE file as its bytes arrive instead
+// of parsing a buffered copy of the whole file like OleFile.
+//
+// FAT sectors are listed in the header so they are parsed into the sector
+// map as they arrive and never kept.  Other sectors are kept until the
+// directory and mini FAT chains can be followed through them.  Once the
+// directory is known each stream is extracted and RLE decompressed as soon
+// as its sectors arrive, keeping only the part from the VBA keyword on, and
+// the sectors are released.  Kept sectors and the part of each stream kept
+// for decompression are bounded by a window; when it is full the oldest
+// sectors are dropped and streams needing them are cut short, like OleFile
+// does for streams running past the end of its buffer.
+
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "file_olefile.h"
+
+#define OLE_DEFAULT_WINDOW 65536
+
+class OleStream
+{
+public:
+    OleStream(uint32_t window);
+    ~OleStream();
+
+    // the next bytes of the file, in order
+    void process(const uint8_t* data, uint32_t len);
+
+    // no more data, extract what is left
+    void finish();
+
+    // true once finish() was called or every stream was extracted
+    bool is_finished() const
+    { return input_done or complete; }
+
+    // the decompressed VBA of all streams in directory order, the caller
+    // owns the buffer; buf is null if no VBA was found
+    void get_vba(uint8_t*& buf, uint32_t& len);
+
+    uint32_t get_retained() const
+    { return retained; }
+
+    uint32_t get_dropped() const
+    { return dropped; }
+
+private:
+    struct OleEntry
+    {
+        FileProperty* node;
+        std::string data;
+        std::string vba;
+        uint32_t size;
+        uint32_t read;
+        int32_t next;
+        bool mini;
+        bool found;
+        bool done;
+    };
+
+    void parse_header();
+    void add_sector(const uint8_t*);
+    void retain(int32_t sector, const uint8_t*);
+    void release(int32_t sector);
+    void release_all();
+
+    void parse_fat(uint32_t index, const uint8_t*);
+    void parse_mini_fat(const uint8_t*);
+    void parse_dir(const uint8_t*);
+
+    // these return null or FAT_UNKNOWN with wait_for set to the sector
+    // that has to arrive first, or to INVALID_SECTOR if it never will
+    const uint8_t* get_sector(int32_t sector, int32_t& wait_for);
+    const uint8_t* get_mini_sector(int32_t mini_sector, int32_t& wait_for);
+    int32_t get_next_sector(int32_t sector, int32_t& wait_for);
+    int32_t get_next_mini_sector(int32_t mini_sector);
+
+    void advance();
+    bool follow_mini_fat();
+    bool follow_dir();
+    bool read_entry(OleEntry&);
+    void find_vba(OleEntry&);
+    void extract_vba(OleEntry&);
+
+    OleHeader header;
+    uint8_t header_buf[OLE_HEADER_LEN];
+    uint32_t header_len = 0;
+    bool header_done = false;
+    bool failed = false;
+    bool input_done = false;
+    bool complete = false;
+
+    uint16_t sector_size = 0;
+    uint16_t mini_sector_size = 0;
+    uint8_t* partial = nullptr;
+    uint32_t partial_len = 0;
+    int32_t sector_count = 0;
+
+    // nothing can progress before this sector arrives
+    int32_t next_wait = INVALID_SECTOR;
+
+    // FAT sectors from the header DIFAT array and the entries of those
+    // parsed so far
+    std::vector<int32_t> fat_ids;
+    std::unordered_map<int32_t, uint32_t> fat_index;
+    std::vector<int32_t> fat;
+    uint32_t max_chain = 0;
+
+    std::vector<int32_t> mini_fat;
+    int32_t mini_fat_next = INVALID_SECTOR;
+    int32_t mini_fat_left = 0;
+    bool mini_fat_parsed = false;
+
+    int32_t dir_next = INVALID_SECTOR;
+    bool dir_parsed = false;
+
+    // sectors of the mini stream in order
+    std::vector<int32_t> mini_stream;
+
+    DirectoryList dir_list;
+    std::vector<OleEntry> entries;
+    unsigned entries_left = 0;
+
+    std::unordered_map<int32_t, uint8_t*> sectors;
+    std::deque<int32_t> retain_order;
+    uint32_t window;
+    uint32_t retained = 0;
+    uint32_t dropped = 0;
+};
+
+#endif
+
@@ -0,0 +1,298 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2023-2023 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// file_olestream_test.cc
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "../file_olestream.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "detection/detection_engine.h"
+#include "helpers/literal_search.h"
+
+#include <CppUTest/CommandLineTestRunner.h>
+#include <CppUTest/TestHarness.h>
+
+THREAD_LOCAL const snort::Trace* vba_data_trace = nullptr;
+
+snort::LiteralSearch::Handle* search_handle = nullptr;
+const snort::LiteralSearch* searcher = nullptr;
+
+namespace
+{
+class KeywordSearch : public snort::LiteralSearch
+{
+public:
+    int search(Handle*, const uint8_t* buf, unsigned len) const override
+    {
+        static const char* key = "ATTRIBUT";
+        const uint8_t* end = buf + len;
+        const uint8_t* pos = std::search(buf, end, key, key + 8);
+        return pos == end ? -1 : pos - buf;
+    }
+};
+}
+
+namespace snort
+{
+LiteralSearch::Handle* LiteralSearch::setup() { return nullptr; }
+void LiteralSearch::cleanup(LiteralSearch::Handle*) { }
+LiteralSearch* LiteralSearch::instantiate(LiteralSearch::Handle*, const uint8_t*, unsigned, bool,
+    bool) { return new KeywordSearch; }
+Packet* DetectionEngine::get_current_packet() { return nullptr; }
+void trace_vprintf(char const*, unsigned char, char const*, snort::Packet const*, char const*, va_list) { }
+uint8_t TraceApi::get_constraints_generation() { return 0; }
+void TraceApi::filter(snort::Packet const&) { }
+}
+
+//--------------------------------------------------------------------------
+// a small OLE file with a 5000 byte stream in sectors and a 100 byte stream
+// in the mini stream, both holding VBA source stored as literal runs
+//--------------------------------------------------------------------------
+
+#define SECTOR 512
+
+static const char* module_vba = "ATTRIBUTE VB_Name = \"Module1\"\r\nSub AutoOpen()\r\nEnd Sub\r\n";
+static const char* small_vba = "ATTRIBUTE VB_Name = \"Small\"";
+
+struct Layout
+{
+    int32_t dir;
+    int32_t mini_stream;
+    int32_t module;
+    int32_t mini_fat;
+};
+
+static const Layout dir_first = { 1, 2, 3, 13 };
+static const Layout dir_last = { 13, 1, 2, 12 };
+
+static void put32(uint8_t* p, int32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static void put_vba(uint8_t* p, const char* text)
+{
+    unsigned len = strlen(text);
+
+    *p++ = SIG_COMP_CONTAINER;
+    *p++ = 0x00;
+    *p++ = 0xB0;
+
+    for ( unsigned i = 0; i < len; i += 8 )
+    {
+        *p++ = 0x00;
+        unsigned n = std::min(8u, len - i);
+        memcpy(p, text + i, n);
+        p += n;
+    }
+}
+
+static void put_entry(uint8_t* p, const char* name, uint8_t type, int32_t start, int32_t size)
+{
+    for ( unsigned i = 0; name[i]; ++i )
+        p[i * 2] = name[i];
+
+    p[DIR_FILE_TYPE_OFFSET] = type;
+    put32(p + DIR_LEFT_SIB_OFFSET, -1);
+    put32(p + DIR_RIGHT_SIB_OFFSET, -1);
+    put32(p + DIR_ROOT_NODE_OFFSET, -1);
+    put32(p + DIR_STARTING_SEC_OFFSET, start);
+    put32(p + DIR_STREAM_SIZE_OFFSET, size);
+}
+
+static std::vector<uint8_t> make_ole(const Layout& l)
+{
+    std::vector<uint8_t> f(OLE_HEADER_LEN + 14 * SECTOR);
+    uint8_t* h = f.data();
+    static const uint8_t sig[8] = { 0xD0, 0xCF, 0x11, 0xE0, 0xA1, 0xB1, 0x1A, 0xE1 };
+
+    memcpy(h, sig, sizeof(sig));
+    h[24] = 0x3E;
+    h[26] = 0x03;
+    h[28] = 0xFE;
+    h[29] = 0xFF;
+    h[30] = 9;
+    h[32] = 6;
+    put32(h + HEADER_FAT_SECTR_CNT_OFFSET, 1);
+    put32(h + HEADER_FIRST_DIR_SECTR_OFFSET, l.dir);
+    put32(h + HEADER_MINFAT_CUTOFF_OFFSET, 4096);
+    put32(h + HEADER_FIRST_MINFAT_OFFSET, l.mini_fat);
+    put32(h + HEADER_MINFAT_COUNT_OFFSET, 1);
+    put32(h + HEADER_FIRST_DIFAT_OFFSET, -2);
+    memset(h + HEADER_DIFAT_ARRY_OFFSET, 0xFF, 4 * MAX_DIFAT_SECTORS);
+    put32(h + HEADER_DIFAT_ARRY_OFFSET, 0);
+
+    auto sector = [&f](int32_t id) { return f.data() + OLE_HEADER_LEN + id * SECTOR; };
+
+    uint8_t* fat = sector(0);
+    memset(fat, 0xFF, SECTOR);
+    put32(fat, -3);
+    put32(fat + 4 * l.dir, -2);
+    put32(fat + 4 * l.mini_stream, -2);
+    put32(fat + 4 * l.mini_fat, -2);
+    for ( int32_t i = 0; i < 9; ++i )
+        put32(fat + 4 * (l.module + i), l.module + i + 1);
+    put32(fat + 4 * (l.module + 9), -2);
+
+    uint8_t* mini_fat = sector(l.mini_fat);
+    memset(mini_fat, 0xFF, SECTOR);
+    put32(mini_fat, 1);
+    put32(mini_fat + 4, -2);
+
+    uint8_t* dir = sector(l.dir);
+    put_entry(dir, ROOT_ENTRY, ROOT_STORAGE, l.mini_stream, SECTOR);
+    put_entry(dir + DIR_ENTRY_SIZE, "Module1", STREAM, l.module, 5000);
+    put_entry(dir + 2 * DIR_ENTRY_SIZE, "Small", STREAM, 0, 100);
+
+    // both keywords cross from one sector of their stream to the next
+    put_vba(sector(l.module) + 4598, module_vba);
+    put_vba(sector(l.mini_stream) + 58, small_vba);
+
+    return f;
+}
+
+static std::string get_vba(OleStream& ole)
+{
+    uint8_t* buf;
+    uint32_t len;
+    ole.get_vba(buf, len);
+
+    if ( !buf )
+        return "";
+
+    std::string vba((const char*)buf, len);
+    delete[] buf;
+    return vba;
+}
+
+static std::string expected_vba()
+{
+    return std::string(module_vba) + small_vba;
+}
+
+TEST_GROUP(ole_stream)
+{
+    void setup() override
+    {
+        searcher = snort::LiteralSearch::instantiate(search_handle, (const uint8_t*)"ATTRIBUT",
+            8, true);
+    }
+
+    void teardown() override
+    {
+        delete searcher;
+        searcher = nullptr;
+    }
+};
+
+TEST(ole_stream, same_as_oleprocess)
+{
+    std::vector<uint8_t> f = make_ole(dir_first);
+
+    uint8_t* buf = nullptr;
+    uint32_t len = 0;
+    oleprocess(f.data(), f.size(), buf, len);
+    std::string whole((const char*)buf, len);
+    delete[] buf;
+
+    CHECK(whole == expected_vba());
+
+    OleStream ole(OLE_DEFAULT_WINDOW);
+    ole.process(f.data(), f.size());
+    CHECK_TRUE(ole.is_finished());
+    CHECK(get_vba(ole) == whole);
+    CHECK(ole.get_dropped() == 0);
+}
+
+TEST(ole_stream, byte_at_a_time_in_window)
+{
+    std::vector<uint8_t> f = make_ole(dir_first);
+    OleStream ole(4096);
+    uint32_t max_retained = 0;
+
+    for ( auto b : f )
+    {
+        ole.process(&b, 1);
+        max_retained = std::max(max_retained, ole.get_retained());
+    }
+    ole.finish();
+
+    CHECK(get_vba(ole) == expected_vba());
+    CHECK(ole.get_dropped() == 0);
+    CHECK(max_retained <= 4096);
+}
+
+TEST(ole_stream, directory_at_end)
+{
+    std::vector<uint8_t> f = make_ole(dir_last);
+
+    OleStream big(OLE_DEFAULT_WINDOW);
+    big.process(f.data(), f.size());
+    CHECK_TRUE(big.is_finished());
+    CHECK(get_vba(big) == expected_vba());
+
+    // the mini stream and the start of the module are dropped before the
+    // directory arrives
+    OleStream small(4096);
+    small.process(f.data(), f.size());
+    small.finish();
+    CHECK(small.get_dropped() == 4);
+    CHECK(get_vba(small).empty());
+}
+
+TEST(ole_stream, truncated_file)
+{
+    std::vector<uint8_t> f = make_ole(dir_first);
+    OleStream ole(OLE_DEFAULT_WINDOW);
+
+    ole.process(f.data(), OLE_HEADER_LEN + 10 * SECTOR + 100);
+    CHECK_FALSE(ole.is_finished());
+
+    ole.finish();
+    CHECK_TRUE(ole.is_finished());
+
+    // the module keyword is in a sector that never arrived and the small
+    // stream cannot be followed past its first mini sector without the
+    // mini FAT
+    CHECK(get_vba(ole).empty());
+}
+
+TEST(ole_stream, not_ole)
+{
+    uint8_t data[2048] = { };
+    OleStream ole(OLE_DEFAULT_WINDOW);
+
+    ole.process(data, sizeof(data));
+    ole.finish();
+    CHECK_TRUE(ole.is_finished());
+    CHECK(get_vba(ole).empty());
+}
+
+int main(int argc, char** argv)
+{
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
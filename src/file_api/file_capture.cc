@@ -30,9 +30,16 @@
 
 #include "file_capture.h"
 
-#include <sys/stat.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
 
 #include "log/messages.h"
 #include "utils/stats.h"
@@ -52,9 +59,24 @@ int64_t FileCapture::capture_block_size = 0;
 
 std::mutex FileCapture::capture_mutex;
 std::condition_variable FileCapture::capture_cv;
-std::thread* FileCapture::file_storer = nullptr;
+std::vector<std::thread*> FileCapture::file_storers;
 std::queue<FileCapture*> FileCapture::files_waiting;
 bool FileCapture::running = true;
+bool FileCapture::direct_io = false;
+
+// capture blocks written per system call
+#define MAX_WRITE_IOVS 64
+
+// direct I/O transfers must be aligned in memory, length, and file offset
+#define DIRECT_IO_ALIGN 4096
+#define DIRECT_IO_BUF_SIZE (1024 * 1024)
+
+// these are global / shared by all writer threads
+static std::atomic<uint64_t> files_stored{0};
+static std::atomic<uint64_t> bytes_stored{0};
+static std::atomic<uint64_t> store_errors{0};
+static std::atomic<uint64_t> store_usecs_total{0};
+static std::atomic<uint64_t> store_usecs_max{0};
 
 FileCaptureState FileCapture::error_capture(FileCaptureState state)
 {
@@ -62,7 +84,7 @@ FileCaptureState FileCapture::error_capture(FileCaptureState state)
     return state;
 }
 
-// Only one writer thread supported
+// Any number of writer threads may serve the queue
 void FileCapture::writer_thread()
 {
     while (true)
@@ -81,9 +103,19 @@ void FileCapture::writer_thread()
         files_waiting.pop();
         lk.unlock();
 
+        auto start = std::chrono::steady_clock::now();
         file->store_file();
         delete file;
+
+        uint64_t usecs = std::chrono::duration_cast<std::chrono::microseconds>
+            (std::chrono::steady_clock::now() - start).count();
+        uint64_t max = store_usecs_max;
+
+        store_usecs_total += usecs;
+        while (usecs > max and !store_usecs_max.compare_exchange_weak(max, usecs));
     }
+
+    thread_term();
 }
 
 FileCapture::FileCapture(int64_t min_size, int64_t max_size)
@@ -131,11 +163,15 @@ FileCapture::~FileCapture()
         delete file_info;
 }
 
-void FileCapture::init(int64_t memcap, int64_t block_size)
+void FileCapture::init(int64_t memcap, int64_t block_size, unsigned writers, bool direct)
 {
     capture_block_size = block_size;
+    direct_io = direct;
+    running = true;
     init_mempool(memcap, capture_block_size);
-    file_storer = new std::thread(writer_thread);
+
+    for (unsigned i = 0; i < writers; i++)
+        file_storers.emplace_back(new std::thread(writer_thread));
 }
 
 /*
@@ -148,14 +184,20 @@ void FileCapture::exit()
         std::lock_guard<std::mutex> lk(capture_mutex);
         running = false;
     }
-    capture_cv.notify_one();
+    capture_cv.notify_all();
 
-    if (file_storer)
+    for (auto* t : file_storers)
     {
-        file_storer->join();
-        delete file_storer;
-        file_storer = nullptr;
+        t->join();
+        delete t;
     }
+    file_storers.clear();
+}
+
+void FileCapture::thread_term()
+{
+    if (file_mempool)
+        file_mempool->flush_cache();
 }
 
 /*
@@ -431,42 +473,143 @@ FileCaptureBlock* FileCapture::get_file_data(uint8_t** buff, int* size)
 }
 
 /*
- * writing file data to the disk.
+ * Write out the whole vector, resuming after short writes.
  *
  * In the case of interrupt errors, the write is retried, but only for a
  * finite number of times.
  */
-void FileCapture::write_file_data(uint8_t* buf, size_t buf_len, FILE* fh)
+static bool write_vector(int fd, struct iovec* iov, int count)
 {
     int max_retries = 3;
-    size_t bytes_written = 0;
-    int err;
-
-    /* Nothing to write or nothing to write to */
-    if ((buf == nullptr) || (fh == nullptr))
-        return;
 
-    /* writing several times */
-    do
+    while (count > 0)
     {
-        size_t bytes_left = buf_len - bytes_written;
+        ssize_t n = writev(fd, iov, count);
+
+        if (n <= 0)
+        {
+            if ((n == 0 || errno == EINTR || errno == EAGAIN) && --max_retries > 0)
+                continue;
 
-        bytes_written += fwrite(buf + bytes_written, 1, bytes_left, fh);
+            ErrorMessage("File inspect: disk writing error - %s!\n", get_error(errno));
+            return false;
+        }
 
-        err = ferror(fh);
-        if (err && (err != EINTR) && (err != EAGAIN))
+        while (count > 0 && (size_t)n >= iov->iov_len)
         {
-            break;
+            n -= iov->iov_len;
+            iov++;
+            count--;
+        }
+
+        if (count > 0)
+        {
+            iov->iov_base = (uint8_t*)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+
+    return true;
+}
+
+static bool set_direct_io(int fd, bool on)
+{
+#ifdef O_DIRECT
+    int flags = fcntl(fd, F_GETFL);
+
+    if (flags < 0)
+        return false;
+
+    flags = on ? (flags | O_DIRECT) : (flags & ~O_DIRECT);
+
+    // file systems without direct I/O support reject the flag
+    return fcntl(fd, F_SETFL, flags) == 0;
+#else
+    UNUSED(fd);
+    return !on;
+#endif
+}
+
+/*
+ * writing file data to the disk, many capture blocks per system call
+ */
+bool FileCapture::write_file_data(int fd)
+{
+    struct iovec iov[MAX_WRITE_IOVS];
+    int count = 0;
+
+    for (FileCaptureBlock* block = head; block; block = block->next)
+    {
+        if (block->length)
+        {
+            iov[count].iov_base = (uint8_t*)block + sizeof(*block);
+            iov[count].iov_len = block->length;
+            count++;
+        }
+
+        if (count == MAX_WRITE_IOVS || (count && !block->next))
+        {
+            if (!write_vector(fd, iov, count))
+                return false;
+
+            count = 0;
         }
+    }
+
+    return true;
+}
 
-        max_retries--;
+/*
+ * writing file data to the disk with direct I/O. Capture blocks are not
+ * aligned so data goes through an aligned bounce buffer; the last write is
+ * padded to the alignment and the file is trimmed to its real size.
+ */
+bool FileCapture::write_file_direct(int fd)
+{
+    void* buf;
+
+    if (posix_memalign(&buf, DIRECT_IO_ALIGN, DIRECT_IO_BUF_SIZE))
+        return set_direct_io(fd, false) && write_file_data(fd);
+
+    uint8_t* direct_buf = (uint8_t*)buf;
+    uint64_t file_size = 0;
+    size_t used = 0;
+    bool ok = true;
+
+    for (FileCaptureBlock* block = head; block && ok; block = block->next)
+    {
+        const uint8_t* data = (uint8_t*)block + sizeof(*block);
+        size_t left = block->length;
+
+        while (left && ok)
+        {
+            size_t n = std::min(left, (size_t)DIRECT_IO_BUF_SIZE - used);
+            memcpy(direct_buf + used, data, n);
+            used += n;
+            data += n;
+            left -= n;
+            file_size += n;
+
+            if (used == DIRECT_IO_BUF_SIZE)
+            {
+                struct iovec iov = { direct_buf, used };
+                ok = write_vector(fd, &iov, 1);
+                used = 0;
+            }
+        }
     }
-    while ((max_retries > 0) && (bytes_written < buf_len));
 
-    if (bytes_written < buf_len)
+    if (ok && used)
     {
-        ErrorMessage("File inspect: disk writing error - %s!\n", get_error(err));
+        size_t padded = (used + DIRECT_IO_ALIGN - 1) & ~(size_t)(DIRECT_IO_ALIGN - 1);
+        memset(direct_buf + used, 0, padded - used);
+
+        struct iovec iov = { direct_buf, padded };
+        ok = write_vector(fd, &iov, 1) && ftruncate(fd, file_size) == 0;
     }
+
+    free(buf);
+    return ok;
 }
 
 // Store files on local disk
@@ -477,39 +620,32 @@ void FileCapture::store_file()
 
     const std::string& file_full_name = file_info->get_file_name();
 
-    /*Check whether the file exists*/
-    struct stat buffer;
-    if (stat (file_full_name.c_str(), &buffer) == 0)
+    // Skip files that exist; O_EXCL also keeps concurrent writers from
+    // storing the same file twice
+    int fd = open(file_full_name.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0666);
+    if (fd < 0)
     {
+        if (errno != EEXIST)
+            store_errors++;
         return;
     }
 
-    FILE* fh = fopen(file_full_name.c_str(), "w");
-    if (!fh )
-    {
-        return;
-    }
+    bool stored;
 
-    // Check the file buffer
-    uint8_t* buff = nullptr;
-    int size = 0;
-    void* file_mem;
+    if (direct_io && set_direct_io(fd, true))
+        stored = write_file_direct(fd);
+    else
+        stored = write_file_data(fd);
 
-    do
-    {
-        file_mem = get_file_data(&buff, &size);
-        // Get file from file buffer
-        if (!buff || !size )
-        {
-            fclose(fh);
-            return;
-        }
+    close(fd);
 
-        write_file_data(buff, size, fh);
+    if (stored)
+    {
+        files_stored++;
+        bytes_stored += capture_size;
     }
-    while (file_mem);
-
-    fclose(fh);
+    else
+        store_errors++;
 }
 
 // Queue files to be stored to disk
@@ -532,9 +668,13 @@ void FileCapture::store_file_async()
     std::lock_guard<std::mutex> lk(capture_mutex);
     files_waiting.push(this);
     capture_cv.notify_one();
+
+    file_counts.capture_files_queued++;
+    if (file_counts.capture_queue_max < files_waiting.size())
+        file_counts.capture_queue_max = files_waiting.size();
 }
 
-/*Log file capture mempool usage*/
+/*Log file capture mempool and writer usage*/
 void FileCapture::print_mem_usage()
 {
     if (file_mempool)
@@ -546,7 +686,13 @@ void FileCapture::print_mem_usage()
         LogCount("Buffers in use", file_mempool->allocated());
         LogCount("Buffers in free list", file_mempool->freed());
         LogCount("Buffers in release list", file_mempool->released());
+        LogCount("Buffers in thread caches", file_mempool->cached());
         LogCount("Memory usage in bytes", file_mempool->allocated() * block_size);
+        LogCount("Files stored", files_stored);
+        LogCount("Bytes stored", bytes_stored);
+        LogCount("Store errors", store_errors);
+        LogCount("Store time total usecs", store_usecs_total);
+        LogCount("Store time max usecs", store_usecs_max);
     }
 }
 
@@ -561,4 +707,43 @@ TEST_CASE ("Should not segfault when file mempool is not configured", "[file_cap
 
     CHECK(fc.process_buffer((const uint8_t*)"dummy", 5, SNORT_FILE_START) == FILE_CAPTURE_MEMCAP);
 }
+
+TEST_CASE ("Captured file is stored to a local directory", "[file_capture]")
+{
+    char dir[] = "/tmp/file_capture_XXXXXX";
+    REQUIRE(mkdtemp(dir));
+    std::string name = std::string(dir) + "/file";
+
+    uint8_t data[5000];
+    for (unsigned i = 0; i < sizeof(data); i++)
+        data[i] = (uint8_t)(i * 7);
+
+    // direct I/O falls back to buffered writes where it is not supported
+    FileCapture::init(1, 1000, 2, true);
+
+    FileCapture* fc = new FileCapture(0, sizeof(data));
+    CHECK(fc->process_buffer(data, 3000, SNORT_FILE_START) == FILE_CAPTURE_SUCCESS);
+    CHECK(fc->process_buffer(data + 3000, 2000, SNORT_FILE_END) == FILE_CAPTURE_SUCCESS);
+
+    FileInfo file;
+    file.set_file_size(sizeof(data));
+    REQUIRE(fc->reserve_file(&file) == FILE_CAPTURE_SUCCESS);
+
+    fc->get_file_info()->set_file_name(name.c_str(), name.size());
+    fc->store_file();
+    delete fc;
+
+    FileCapture::thread_term();
+    FileCapture::exit();
+
+    uint8_t stored[sizeof(data) + 1];
+    FILE* fh = fopen(name.c_str(), "r");
+    REQUIRE(fh);
+    CHECK(fread(stored, 1, sizeof(stored), fh) == sizeof(data));
+    fclose(fh);
+    CHECK(!memcmp(data, stored, sizeof(data)));
+
+    unlink(name.c_str());
+    rmdir(dir);
+}
 #endif
@@ -30,11 +30,17 @@
 //     data will stay in the mempool.
 // 3) Then file data can be read through file_capture_read()
 // 4) Finally, file data must be released from mempool file_capture_release()
+//
+// Files queued with store_file_async() are written by a pool of writer
+// threads. Each file is written with vectored writes covering many capture
+// blocks per system call, or through an aligned bounce buffer when direct
+// I/O is enabled.
 
 #include <condition_variable>
 #include <mutex>
 #include <queue>
 #include <thread>
+#include <vector>
 
 #include "file_api.h"
 
@@ -57,7 +63,8 @@ public:
     ~FileCapture();
 
     // this must be called during snort init
-    static void init(int64_t memcap, int64_t block_size);
+    static void init(int64_t memcap, int64_t block_size, unsigned writers = 1,
+        bool direct_io = false);
 
     // Capture file data to local buffer
     // This is the main function call to enable file capture
@@ -80,7 +87,11 @@ public:
     // Store file to disk asynchronously
     void store_file_async();
 
-    // Log file capture mempool usage
+    // Return the capture buffers cached by the calling thread
+    // this must be called before a thread using file capture exits
+    static void thread_term();
+
+    // Log file capture mempool and writer usage
     static void print_mem_usage();
 
     // Exit file capture, release all file capture memory etc,
@@ -104,15 +115,17 @@ private:
     inline FileCaptureBlock* create_file_buffer();
     inline FileCaptureState save_to_file_buffer(const uint8_t* file_data, int data_size,
         int64_t max_size);
-    void write_file_data(uint8_t* buf, size_t buf_len, FILE* fh);
+    bool write_file_data(int fd);
+    bool write_file_direct(int fd);
 
     static FileMemPool* file_mempool;
     static int64_t capture_block_size;
     static std::mutex capture_mutex;
     static std::condition_variable capture_cv;
-    static std::thread* file_storer;
+    static std::vector<std::thread*> file_storers;
     static std::queue<FileCapture*> files_waiting;
     static bool running;
+    static bool direct_io;
 
     uint64_t capture_size;
     FileCaptureBlock* last;  /* last block of file data */
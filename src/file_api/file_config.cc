@@ -29,6 +29,10 @@
 
 #include "file_config.h"
 
+#include "detection/pattern_match_data.h"
+#include "detection/treenodes.h"
+#include "hash/ghash.h"
+#include "log/messages.h"
 #include "main/snort_config.h"
 #include "managers/inspector_manager.h"
 #include "parser/parse_utils.h"
@@ -38,11 +42,76 @@
 using namespace snort;
 
 uint32_t FileConfig::find_file_type_id(const uint8_t* buf, int len,
-    uint64_t file_offset, void** context)
+    uint64_t file_offset, void** context) const
 {
     return fileIdentifier.find_file_type_id(buf, len, file_offset, context);
 }
 
+// only file_data and literal contents anchored with offset and depth can be
+// compiled; anything else needs the detection engine
+static bool get_file_magic_rule(const OptTreeNode* otn, FileMagicRule& rule)
+{
+    rule.id = otn->sigInfo.file_id;
+
+    for ( const OptFpList* ofl = otn->opt_func; ofl; ofl = ofl->next )
+    {
+        IpsOption* opt = ofl->ips_opt;
+
+        if ( !opt )
+            continue;
+
+        if ( !strcmp(opt->get_name(), "file_data") )
+            continue;
+
+        if ( strcmp(opt->get_name(), "content") )
+            return false;
+
+        const PatternMatchData* pmd = opt->get_pattern(UNKNOWN_PROTOCOL_ID);
+
+        if ( !pmd or pmd->is_negated() or pmd->is_no_case() or pmd->is_relative() or
+            pmd->offset < 0 or pmd->depth != pmd->pattern_size )
+            return false;
+
+        rule.magics.push_back({ (uint32_t)pmd->offset,
+            std::string(pmd->pattern_buf, pmd->pattern_size) });
+    }
+
+    return !rule.magics.empty();
+}
+
+void FileConfig::load_magic_rules(SnortConfig* sc)
+{
+    if ( !sc->otn_map )
+        return;
+
+    std::vector<FileMagicRule> rules;
+
+    for ( GHashNode* node = sc->otn_map->find_first(); node; node = sc->otn_map->find_next() )
+    {
+        const OptTreeNode* otn = (OptTreeNode*)node->data;
+
+        if ( !otn->sigInfo.file_id or !otn->enabled_somewhere() )
+            continue;
+
+        FileMagicRule rule;
+
+        if ( !get_file_magic_rule(otn, rule) )
+        {
+            ParseWarning(WARN_RULES, "file_id.magic_table: rule %u:%u can't be compiled, "
+                "using rule evaluation for file type identification\n",
+                otn->sigInfo.gid, otn->sigInfo.sid);
+            return;
+        }
+
+        rules.emplace_back(rule);
+    }
+
+    for ( const auto& rule : rules )
+        fileIdentifier.add_magic_rule(rule);
+
+    fileIdentifier.compile_magic_rules();
+}
+
 /*The main function for parsing rule option*/
 void FileConfig::process_file_rule(FileMeta& rule)
 {
@@ -38,6 +38,12 @@
 #define DEFAULT_FILE_CAPTURE_BLOCK_SIZE     32768       // 32 KiB
 #define DEFAULT_MAX_FILES_CACHED            65536
 #define DEFAULT_MAX_FILES_PER_FLOW          128
+#define DEFAULT_MAX_VERDICTS_CACHED         65536
+#define DEFAULT_VERDICT_CACHE_TIMEOUT       3600        // 1 hour
+#define DEFAULT_VERDICT_CACHE_NEG_TIMEOUT   60          // 1 minute
+#define DEFAULT_FILE_SIGNATURE_QUEUE_MEM    32          // 32 MiB
+#define DEFAULT_PDF_OFFLOAD_DEPTH           10485760    // 10 MiB
+#define DEFAULT_PDF_OFFLOAD_TIME            1000        // 1 second
 
 #define FILE_ID_NAME "file_id"
 #define FILE_ID_HELP "configure file identification"
@@ -49,21 +55,36 @@ public:
     void get_magic_rule_ids_from_type(const std::string&, const std::string&,
         snort::FileTypeBitSet&) const;
     void process_file_rule(FileMeta&);
-    uint32_t find_file_type_id(const uint8_t* buf, int len, uint64_t file_offset, void** context);
+    void load_magic_rules(snort::SnortConfig*);
+    bool has_magic_rules() const { return fileIdentifier.has_magic_rules(); }
+    uint32_t find_file_type_id(const uint8_t* buf, int len, uint64_t file_offset,
+        void** context) const;
     std::string file_type_name(uint32_t id) const;
 
     int64_t file_type_depth = DEFAULT_FILE_TYPE_DEPTH;
     int64_t file_signature_depth = DEFAULT_FILE_SIGNATURE_DEPTH;
+    uint32_t signature_threads = 0;
+    int64_t signature_queue_memcap = DEFAULT_FILE_SIGNATURE_QUEUE_MEM;
+    uint32_t pdf_threads = 0;
+    int64_t pdf_depth = DEFAULT_PDF_OFFLOAD_DEPTH;
+    uint32_t pdf_time = DEFAULT_PDF_OFFLOAD_TIME;
     int64_t file_block_timeout = DEFAULT_FILE_BLOCK_TIMEOUT;
     int64_t file_lookup_timeout = DEFAULT_FILE_LOOKUP_TIMEOUT;
     bool block_timeout_lookup = false;
+    bool magic_table = false;
     int64_t capture_memcap = DEFAULT_FILE_CAPTURE_MEM;
     int64_t capture_max_size = DEFAULT_FILE_CAPTURE_MAX_SIZE;
     int64_t capture_min_size = DEFAULT_FILE_CAPTURE_MIN_SIZE;
     int64_t capture_block_size = DEFAULT_FILE_CAPTURE_BLOCK_SIZE;
+    uint32_t capture_writers = 1;
+    bool capture_direct_io = false;
     int64_t file_depth =  0;
     int64_t max_files_cached = DEFAULT_MAX_FILES_CACHED;
     uint64_t max_files_per_flow = DEFAULT_MAX_FILES_PER_FLOW;
+    uint32_t max_verdicts_cached = DEFAULT_MAX_VERDICTS_CACHED;
+    int64_t verdict_cache_timeout = DEFAULT_VERDICT_CACHE_TIMEOUT;
+    int64_t verdict_cache_negative_timeout = DEFAULT_VERDICT_CACHE_NEG_TIMEOUT;
+    uint32_t verdict_prefix_depth = 0;
 
     int64_t show_data_depth = DEFAULT_FILE_SHOW_DATA_DEPTH;
     bool trace_type = false;
@@ -43,6 +43,7 @@
 #include "file_module.h"
 #include "file_service.h"
 #include "file_stats.h"
+#include "file_verdict_cache.h"
 #include <thread>
 
 using namespace snort;
@@ -123,7 +124,7 @@ void FileFlows::handle_retransmit(Packet* p)
         }
     }
     file->user_file_data_mutex.lock();
-    FileVerdict verdict = file_policy->signature_lookup(p, file);
+    FileVerdict verdict = file->verdict_cache_lookup(p, file_policy);
     file->user_file_data_mutex.unlock();
 
     if (file_cache)
@@ -543,11 +544,14 @@ FileInspect:: ~FileInspect()
         delete config;
 }
 
-bool FileInspect::configure(SnortConfig*)
+bool FileInspect::configure(SnortConfig* sc)
 {
     if (!config)
         return true;
 
+    if (config->magic_table)
+        config->load_magic_rules(sc);
+
     FileCache* file_cache = FileService::get_file_cache();
     if (file_cache)
     {
@@ -556,13 +560,21 @@ bool FileInspect::configure(SnortConfig*)
         file_cache->set_max_files(config->max_files_cached);
     }
 
+    FileVerdictCache* verdict_cache = FileService::get_verdict_cache();
+    if (verdict_cache)
+        verdict_cache->set_timeouts(config->verdict_cache_timeout,
+            config->verdict_cache_negative_timeout);
+
     return true;
 }
 
 static void file_config_show(const FileConfig* fc)
 {
     if ( ConfigLogger::log_flag("enable_type", FileService::is_file_type_id_enabled()) )
+    {
         ConfigLogger::log_value("type_depth", fc->file_type_depth);
+        ConfigLogger::log_flag("magic_table", fc->has_magic_rules());
+    }
 
     if ( ConfigLogger::log_flag("enable_signature", FileService::is_file_signature_enabled()) )
         ConfigLogger::log_value("signature_depth", fc->file_signature_depth);
@@ -576,6 +588,8 @@ static void file_config_show(const FileConfig* fc)
         ConfigLogger::log_value("capture_max_size", fc->capture_max_size);
         ConfigLogger::log_value("capture_min_size", fc->capture_min_size);
         ConfigLogger::log_value("capture_block_size", fc->capture_block_size);
+        ConfigLogger::log_value("capture_writers", fc->capture_writers);
+        ConfigLogger::log_flag("capture_direct_io", fc->capture_direct_io);
     }
 
     ConfigLogger::log_value("lookup_timeout", fc->file_lookup_timeout);
@@ -0,0 +1,327 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2023-2023 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+// file_hasher.cc
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "file_hasher.h"
+
+#include <openssl/sha.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+
+#include "file_stats.h"
+
+#ifdef UNIT_TEST
+#include "catch/snort_catch.h"
+#endif
+
+struct HashSegment
+{
+    uint8_t* data;
+    unsigned len;
+};
+
+class FileHashState
+{
+public:
+    SHA256_CTX ctx;
+    std::deque<HashSegment> pending;
+    bool queued = false;    // on the ready list or held by a worker
+    bool released = false;  // owner is gone, worker must delete
+};
+
+std::vector<std::thread*> FileHasher::workers;
+
+static std::mutex hash_mutex;
+static std::condition_variable work_cv;
+static std::condition_variable done_cv;
+static std::deque<FileHashState*> ready;
+static std::atomic<uint64_t> queued_bytes { 0 };
+static uint64_t queue_memcap = 0;
+static bool running = false;
+
+void FileHasher::worker()
+{
+    std::unique_lock<std::mutex> lk(hash_mutex);
+
+    while ( true )
+    {
+        work_cv.wait(lk, [] { return !running or !ready.empty(); });
+
+        // when !running we finish any remaining work before exiting
+        if ( ready.empty() )
+            break;
+
+        FileHashState* state = ready.front();
+        ready.pop_front();
+
+        std::deque<HashSegment> segs;
+        segs.swap(state->pending);
+        lk.unlock();
+
+        uint64_t bytes = 0;
+
+        for ( auto& seg : segs )
+        {
+            SHA256_Update(&state->ctx, seg.data, seg.len);
+            bytes += seg.len;
+            delete[] seg.data;
+        }
+
+        lk.lock();
+        queued_bytes -= bytes;
+
+        if ( state->released )
+            delete state;
+
+        else if ( !state->pending.empty() )
+            ready.emplace_back(state);
+
+        else
+        {
+            state->queued = false;
+            done_cv.notify_all();
+        }
+    }
+}
+
+void FileHasher::init(unsigned num_threads, int64_t memcap)
+{
+    queue_memcap = memcap * 1024 * 1024;
+    running = true;
+
+    for ( unsigned i = 0; i < num_threads; ++i )
+        workers.emplace_back(new std::thread(worker));
+}
+
+void FileHasher::exit()
+{
+    {
+        std::lock_guard<std::mutex> lk(hash_mutex);
+        running = false;
+    }
+    work_cv.notify_all();
+
+    for ( auto* t : workers )
+    {
+        t->join();
+        delete t;
+    }
+    workers.clear();
+}
+
+FileHashState* FileHasher::create()
+{
+    FileHashState* state = new FileHashState;
+    SHA256_Init(&state->ctx);
+    return state;
+}
+
+static void drain(std::unique_lock<std::mutex>& lk, FileHashState* state)
+{
+    if ( !state->queued )
+        return;
+
+    file_counts.signature_waits++;
+    done_cv.wait(lk, [state] { return !state->queued; });
+}
+
+// count the segment against the memcap before it is copied
+static bool reserve(unsigned len)
+{
+    if ( queued_bytes.fetch_add(len) + len <= queue_memcap )
+        return true;
+
+    queued_bytes -= len;
+    return false;
+}
+
+void FileHasher::update(FileHashState* state, const uint8_t* data, unsigned len)
+{
+    // the segment is copied before taking the lock, which is only held to
+    // link the copy to the file
+    uint8_t* copy = nullptr;
+
+    if ( reserve(len) )
+    {
+        copy = new uint8_t[len];
+        memcpy(copy, data, len);
+    }
+
+    std::unique_lock<std::mutex> lk(hash_mutex);
+
+    if ( !running or !copy )
+    {
+        drain(lk, state);
+        lk.unlock();
+
+        if ( copy )
+        {
+            queued_bytes -= len;
+            delete[] copy;
+        }
+        file_counts.signature_segments_inline++;
+        SHA256_Update(&state->ctx, data, len);
+        return;
+    }
+
+    state->pending.push_back({ copy, len });
+    file_counts.signature_segments_offloaded++;
+
+    if ( !state->queued )
+    {
+        state->queued = true;
+        ready.emplace_back(state);
+        work_cv.notify_one();
+    }
+}
+
+void FileHasher::digest(FileHashState* state, uint8_t* sha256)
+{
+    std::unique_lock<std::mutex> lk(hash_mutex);
+    drain(lk, state);
+    lk.unlock();
+
+    SHA256_CTX ctx = state->ctx;
+    SHA256_Final(sha256, &ctx);
+}
+
+void FileHasher::finish(FileHashState* state, const uint8_t* data, unsigned len,
+    uint8_t* sha256)
+{
+    std::unique_lock<std::mutex> lk(hash_mutex);
+    drain(lk, state);
+    lk.unlock();
+
+    SHA256_Update(&state->ctx, data, len);
+    SHA256_Final(sha256, &state->ctx);
+}
+
+void FileHasher::release(FileHashState* state)
+{
+    std::lock_guard<std::mutex> lk(hash_mutex);
+
+    for ( auto& seg : state->pending )
+    {
+        queued_bytes -= seg.len;
+        delete[] seg.data;
+    }
+    state->pending.clear();
+
+    if ( state->queued )
+        state->released = true;
+    else
+        delete state;
+}
+
+//--------------------------------------------------------------------------
+// unit tests
+//--------------------------------------------------------------------------
+
+#ifdef UNIT_TEST
+static void hash_segments(const uint8_t* data, unsigned len, unsigned seg_len, uint8_t* sha256)
+{
+    FileHashState* state = FileHasher::create();
+    unsigned off = 0;
+
+    while ( len - off > seg_len )
+    {
+        FileHasher::update(state, data + off, seg_len);
+        off += seg_len;
+    }
+    FileHasher::finish(state, data + off, len - off, sha256);
+    FileHasher::release(state);
+}
+
+TEST_CASE("offloaded digest matches inline digest", "[file_hasher]")
+{
+    uint8_t data[100000];
+    for ( unsigned i = 0; i < sizeof(data); ++i )
+        data[i] = (uint8_t)(i * 7);
+
+    uint8_t expected[SHA256_DIGEST_LENGTH];
+    SHA256(data, sizeof(data), expected);
+
+    uint8_t actual[SHA256_DIGEST_LENGTH];
+
+    SECTION("queued")
+    {
+        FileHasher::init(2, 1);
+        hash_segments(data, sizeof(data), 1460, actual);
+        FileHasher::exit();
+        CHECK(!memcmp(expected, actual, sizeof(expected)));
+    }
+    SECTION("over memcap")
+    {
+        FileHasher::init(1, 0);
+        hash_segments(data, sizeof(data), 1460, actual);
+        FileHasher::exit();
+        CHECK(!memcmp(expected, actual, sizeof(expected)));
+    }
+    SECTION("not running")
+    {
+        hash_segments(data, sizeof(data), 1460, actual);
+        CHECK(!memcmp(expected, actual, sizeof(expected)));
+    }
+}
+
+TEST_CASE("intermediate digest does not disturb the final digest", "[file_hasher]")
+{
+    const uint8_t data[] = "0123456789abcdef";
+    uint8_t expected[SHA256_DIGEST_LENGTH];
+    uint8_t actual[SHA256_DIGEST_LENGTH];
+
+    FileHasher::init(1, 1);
+    FileHashState* state = FileHasher::create();
+
+    FileHasher::update(state, data, 8);
+    FileHasher::digest(state, actual);
+    SHA256(data, 8, expected);
+    CHECK(!memcmp(expected, actual, sizeof(expected)));
+
+    FileHasher::finish(state, data + 8, 8, actual);
+    SHA256(data, 16, expected);
+    CHECK(!memcmp(expected, actual, sizeof(expected)));
+
+    FileHasher::release(state);
+    FileHasher::exit();
+}
+
+TEST_CASE("release with queued segments", "[file_hasher]")
+{
+    uint8_t data[4096] = { };
+    FileHasher::init(1, 1);
+
+    FileHashState* state = FileHasher::create();
+    for ( int i = 0; i < 64; ++i )
+        FileHasher::update(state, data, sizeof(data));
+    FileHasher::release(state);
+
+    FileHasher::exit();
+    CHECK(!FileHasher::is_enabled());
+}
+#endif
+
@@ -0,0 +1,70 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2023-2023 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+// file_hasher.h
+
+#ifndef FILE_HASHER_H
+#define FILE_HASHER_H
+
+// FileHasher computes file SHA-256 signatures on worker threads so the
+// packet thread only pays for copying the segment.  Each file owns a
+// FileHashState; a state is held by at most one worker at a time so the
+// segments of a file are always hashed in arrival order while different
+// files are hashed in parallel.  Digests are produced synchronously: the
+// caller blocks until the file's queued segments have been hashed.
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+class FileHashState;
+
+class FileHasher
+{
+public:
+    // these must be called during snort init and exit
+    static void init(unsigned num_threads, int64_t memcap);
+    static void exit();
+
+    static bool is_enabled() { return !workers.empty(); }
+
+    static FileHashState* create();
+
+    // queue a copy of the segment for hashing; when the queue is over
+    // memcap the file is drained and the segment is hashed inline
+    static void update(FileHashState*, const uint8_t* data, unsigned len);
+
+    // wait for queued segments and store the digest of the data so far;
+    // hashing may continue afterwards
+    static void digest(FileHashState*, uint8_t* sha256);
+
+    // wait for queued segments, hash the last segment inline, and store
+    // the final digest
+    static void finish(FileHashState*, const uint8_t* data, unsigned len, uint8_t* sha256);
+
+    // discard any queued segments and free the state
+    static void release(FileHashState*);
+
+private:
+    static void worker();
+
+    static std::vector<std::thread*> workers;
+};
+
+#endif
+
@@ -31,8 +31,8 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstring>
 
-#include "hash/ghash.h"
 #include "log/messages.h"
 #include "utils/util.h"
 
@@ -42,11 +42,8 @@
 
 using namespace snort;
 
-struct MergeNode
-{
-    IdentifierNode* shared_node;  /*the node that is shared*/
-    IdentifierNode* append_node;  /*the node that is added*/
-};
+// rules with magics longer than this are verified after the key matches
+#define MAX_MAGIC_KEY_LEN 8
 
 void FileMeta::clear()
 {
@@ -58,140 +55,245 @@ void FileMeta::clear()
     groups.clear();
 }
 
-void FileIdentifier::init_merge_hash()
+static inline uint64_t get_key(const uint8_t* data, unsigned len)
 {
-    identifier_merge_hash = new GHash(1000, sizeof(MergeNode), false, nullptr);
+    uint64_t key = 0;
+
+    for ( unsigned i = 0; i < len; i++ )
+        key = (key << 8) | data[i];
+
+    return key;
 }
 
-FileIdentifier::~FileIdentifier()
+static inline unsigned get_key_len(const FileMagicRule& rule)
 {
-    /*Release memory used for identifiers*/
-    for (auto mem_block:id_memory_blocks)
-        snort_free(mem_block);
+    return std::min((unsigned)rule.magics[0].content.size(), (unsigned)MAX_MAGIC_KEY_LEN);
+}
+
+static uint64_t get_magic_end(const FileMagicRule& rule)
+{
+    uint64_t end = 0;
+
+    for ( const auto& m : rule.magics )
+        end = std::max(end, (uint64_t)m.offset + m.content.size());
 
-    if (identifier_merge_hash != nullptr)
-        delete identifier_merge_hash;
+    return end;
 }
 
-void* FileIdentifier::calloc_mem(size_t size)
+static size_t get_magic_len(const FileMagicRule& rule)
 {
-    void* ret = snort_calloc(size);
-    memory_used += size;
-    /*For memory management*/
-    id_memory_blocks.emplace_back(ret);
-    return ret;
+    size_t len = 0;
+
+    for ( const auto& m : rule.magics )
+        len += m.content.size();
+
+    return len;
 }
 
-void FileIdentifier::set_node_state_shared(IdentifierNode* start)
+size_t FileIdentifier::memory_usage() const
 {
-    unsigned int i;
+    size_t size = keys.capacity() * sizeof(uint64_t) + groups.capacity() * sizeof(MagicGroup);
+
+    for ( const auto& rule : magic_rules )
+    {
+        size += sizeof(rule);
+
+        for ( const auto& m : rule.magics )
+            size += sizeof(m) + m.content.capacity();
+    }
+
+    return size;
+}
 
-    if (!start)
+void FileIdentifier::add_file_id(FileMeta& rule)
+{
+    if (file_magic_rules[rule.id].id > 0)
+    {
+        ParseError("file type: rule id %u found duplicate", rule.id);
         return;
+    }
 
-    if (start->state == ID_NODE_SHARED)
+    file_magic_rules[rule.id] = rule;
+}
+
+void FileIdentifier::add_magic_rule(const FileMagicRule& rule)
+{
+    if ( !rule.id or rule.magics.empty() )
         return;
 
-    if (start->state == ID_NODE_USED)
-        start->state = ID_NODE_SHARED;
-    else
-        start->state = ID_NODE_USED;
+    magic_rules.emplace_back(rule);
 
-    for (i = 0; i < MAX_BRANCH; i++)
-        set_node_state_shared(start->next[i]);
+    // the magic at the lowest offset is the key
+    std::sort(magic_rules.back().magics.begin(), magic_rules.back().magics.end(),
+        [](const FileMagic& l, const FileMagic& r)
+        { return l.offset < r.offset; });
 }
 
-/*Clone a trie*/
-IdentifierNode* FileIdentifier::clone_node(IdentifierNode* start)
+void FileIdentifier::compile_magic_rules()
 {
-    unsigned int index;
-    IdentifierNode* node;
-    if (!start)
-        return nullptr;
+    keys.clear();
+    groups.clear();
 
-    node = (IdentifierNode*)calloc_mem(sizeof(*node));
+    auto it = std::remove_if(magic_rules.begin(), magic_rules.end(),
+        [](const FileMagicRule& r)
+        { return r.magics[0].content.empty(); });
+    magic_rules.erase(it, magic_rules.end());
 
-    node->offset = start->offset;
-    node->type_id = start->type_id;
+    std::sort(magic_rules.begin(), magic_rules.end(),
+        [](const FileMagicRule& l, const FileMagicRule& r)
+        {
+            if ( l.magics[0].offset != r.magics[0].offset )
+                return l.magics[0].offset < r.magics[0].offset;
+
+            unsigned llen = get_key_len(l);
+            unsigned rlen = get_key_len(r);
+
+            if ( llen != rlen )
+                return llen < rlen;
+
+            return get_key((const uint8_t*)l.magics[0].content.data(), llen) <
+                get_key((const uint8_t*)r.magics[0].content.data(), rlen);
+        });
 
-    for (index = 0; index < MAX_BRANCH; index++)
+    for ( uint32_t i = 0; i < magic_rules.size(); i++ )
     {
-        if (start->next[index])
+        const FileMagicRule& rule = magic_rules[i];
+        unsigned key_len = get_key_len(rule);
+
+        keys.emplace_back(get_key((const uint8_t*)rule.magics[0].content.data(), key_len));
+
+        if ( groups.empty() or groups.back().offset != rule.magics[0].offset or
+            groups.back().key_len != key_len )
         {
-            node->next[index] = start->next[index];
+            groups.push_back({ rule.magics[0].offset, key_len, i, i + 1 });
         }
+        else
+            groups.back().end = i + 1;
     }
-    return node;
+
+    keys.shrink_to_fit();
+    groups.shrink_to_fit();
+    magic_rules.shrink_to_fit();
 }
 
-void FileIdentifier::add_file_id(FileMeta& rule)
+// compares the part of each magic that lies in this data; the first skip
+// bytes of the leading magic are already known to match
+bool FileIdentifier::verify(const FileMagicRule& rule, unsigned skip, const uint8_t* buf,
+    int len, uint64_t offset) const
 {
-    if (!identifier_root)
-    {
-        identifier_root = (IdentifierNode*)calloc_mem(sizeof(*identifier_root));
-        init_merge_hash();
-    }
+    uint64_t end = offset + len;
 
-    if (file_magic_rules[rule.id].id > 0)
+    for ( unsigned i = 0; i < rule.magics.size(); i++ )
     {
-        ParseError("file type: rule id %u found duplicate", rule.id);
-        return;
+        const FileMagic& m = rule.magics[i];
+        uint64_t lo = std::max((uint64_t)m.offset + (i ? 0 : skip), offset);
+        uint64_t hi = std::min((uint64_t)m.offset + m.content.size(), end);
+
+        if ( lo < hi and memcmp(buf + (lo - offset), m.content.data() + (lo - m.offset), hi - lo) )
+            return false;
     }
 
-    file_magic_rules[rule.id] = rule;
+    return true;
 }
 
 /*
- * This is the main function to find file type
- * Find file type is to traverse the tries.
- * Context is saved to continue file type identification as data becomes available
+ * This is the main function to find file type.
+ * Each group of keys is binary searched with the data at its offset and the
+ * candidates are verified against the rest of their magics.  A key cut off
+ * by the end of the data is searched by its available prefix.  Rules that
+ * match as far as the data goes but have magics beyond it are partial
+ * matches; with a context they are carried to the next call, which
+ * compares only their bytes in the new data.  The context is a count
+ * followed by that many rule indexes.
  */
-uint32_t FileIdentifier::find_file_type_id(const uint8_t* buf, int len, uint64_t file_offset,
-    void** context)
+uint32_t FileIdentifier::find_file_type_id(const uint8_t* buf, int len,
+    uint64_t file_offset, void** context) const
 {
-    uint32_t file_type_id = SNORT_FILE_TYPE_CONTINUE;
-
-    assert(context);
-
     if ( !buf || len <= 0 )
         return SNORT_FILE_TYPE_CONTINUE;
 
-    if (!(*context))
-        *context = (void*)(identifier_root);
-
-    IdentifierNode* current = (IdentifierNode*)(*context);
-
     uint64_t end = file_offset + len;
+    uint32_t file_type_id = SNORT_FILE_TYPE_CONTINUE;
+    size_t best_len = 0;
+    bool pending = false;
+    std::vector<uint32_t> partial;
 
-    while (current &&  (current->offset >= file_offset))
+    auto check = [&](uint32_t idx, unsigned skip)
     {
-        /*Found file id, save and continue*/
-        if (current->type_id)
+        const FileMagicRule& rule = magic_rules[idx];
+
+        if ( !verify(rule, skip, buf, len, file_offset) )
+            return;
+
+        if ( get_magic_end(rule) > end )
         {
-            file_type_id = current->type_id;
+            partial.emplace_back(idx);
+            return;
         }
 
-        if ( current->offset >= end )
+        size_t magic_len = get_magic_len(rule);
+
+        if ( magic_len > best_len or (magic_len == best_len and rule.id < file_type_id) )
         {
-            /* Save current state */
-            *context = current;
-            if (file_type_id)
-                return file_type_id;
-            else
-                return SNORT_FILE_TYPE_CONTINUE;
+            file_type_id = rule.id;
+            best_len = magic_len;
         }
+    };
 
-        /*Move to the next level*/
-        current = current->next[buf[current->offset - file_offset ]];
+    uint32_t* carried = context ? (uint32_t*)*context : nullptr;
+
+    if ( carried )
+    {
+        for ( uint32_t i = 1; i <= carried[0]; i++ )
+            check(carried[i], 0);
     }
 
-    /*Either end of magics or passed the current offset*/
-    *context = nullptr;
+    for ( const auto& g : groups )
+    {
+        if ( g.offset >= end )
+        {
+            pending = true;
+            continue;
+        }
+
+        // earlier data had this group's keys; partial matches were carried
+        if ( g.offset < file_offset )
+            continue;
+
+        unsigned avail = std::min((uint64_t)g.key_len, end - g.offset);
+        unsigned shift = 8 * (g.key_len - avail);
+        uint64_t lo = get_key(buf + (g.offset - file_offset), avail) << shift;
+        uint64_t hi = lo | ((1ULL << shift) - 1);
+
+        auto first = keys.cbegin() + g.begin;
+        auto last = keys.cbegin() + g.end;
+
+        for ( auto k = std::lower_bound(first, last, lo); k != last and *k <= hi; ++k )
+            check(k - keys.cbegin(), avail);
+    }
 
-    if ( file_type_id == SNORT_FILE_TYPE_CONTINUE )
-        file_type_id = SNORT_FILE_TYPE_UNKNOWN;
+    if ( carried )
+    {
+        snort_free(carried);
+        *context = nullptr;
+    }
 
-    return file_type_id;
+    if ( file_type_id != SNORT_FILE_TYPE_CONTINUE )
+        return file_type_id;
+
+    if ( !partial.empty() )
+    {
+        if ( context )
+        {
+            carried = (uint32_t*)snort_alloc(partial.size() + 1, sizeof(uint32_t));
+            carried[0] = partial.size();
+            std::copy(partial.begin(), partial.end(), carried + 1);
+            *context = carried;
+        }
+        pending = true;
+    }
+
+    return pending ? SNORT_FILE_TYPE_CONTINUE : SNORT_FILE_TYPE_UNKNOWN;
 }
 
 const FileMeta* FileIdentifier::get_rule_from_id(uint32_t id) const
@@ -229,6 +331,18 @@ void FileIdentifier::get_magic_rule_ids_from_type(const std::string& type,
 //--------------------------------------------------------------------------
 
 #ifdef UNIT_TEST
+static void add_magic(FileIdentifier& fi, uint32_t id,
+    std::initializer_list<std::pair<uint32_t, const char*>> magics)
+{
+    FileMagicRule rule;
+    rule.id = id;
+
+    for ( const auto& m : magics )
+        rule.magics.push_back({ m.first, m.second });
+
+    fi.add_magic_rule(rule);
+}
+
 TEST_CASE ("FileIdMemory", "[FileMagic]")
 {
     FileIdentifier rc;
@@ -249,9 +363,7 @@ TEST_CASE ("FileIdRulePDF", "[FileMagic]")
 
     const char* data = "PDF";
 
-    void* context = nullptr;
-
-    CHECK(rc.find_file_type_id((const uint8_t*)data, strlen(data), 0, &context) ==
+    CHECK(rc.find_file_type_id((const uint8_t*)data, strlen(data), 0) ==
         SNORT_FILE_TYPE_UNKNOWN);
 }
 
@@ -268,9 +380,7 @@ TEST_CASE ("FileIdRuleUnknow", "[FileMagic]")
 
     const char* data = "DDF";
 
-    void* context = nullptr;
-
-    CHECK((rc.find_file_type_id((const uint8_t*)data, strlen(data), 0, &context) ==
+    CHECK((rc.find_file_type_id((const uint8_t*)data, strlen(data), 0) ==
         SNORT_FILE_TYPE_UNKNOWN));
 }
 
@@ -291,9 +401,8 @@ TEST_CASE ("FileIdRuleEXE", "[FileMagic]")
     rc.add_file_id(rule);
 
     const char* data = "PDFooo";
-    void* context = nullptr;
 
-    CHECK(rc.find_file_type_id((const uint8_t*)data, strlen(data), 0, &context) ==
+    CHECK(rc.find_file_type_id((const uint8_t*)data, strlen(data), 0) ==
         SNORT_FILE_TYPE_UNKNOWN);
 }
 
@@ -314,10 +423,9 @@ TEST_CASE ("FileIdRulePDFEXE", "[FileMagic]")
     rc.add_file_id(rule);
 
     const char* data = "PDFEXE";
-    void* context = nullptr;
 
     // Match the last one
-    CHECK((rc.find_file_type_id((const uint8_t*)data, strlen(data), 0, &context) ==
+    CHECK((rc.find_file_type_id((const uint8_t*)data, strlen(data), 0) ==
         SNORT_FILE_TYPE_UNKNOWN));
 }
 
@@ -338,10 +446,138 @@ TEST_CASE ("FileIdRuleFirst", "[FileMagic]")
     rc.add_file_id(rule);
 
     const char* data = "PDF";
-    void* context = nullptr;
 
-    CHECK(rc.find_file_type_id((const uint8_t*)data, strlen(data), 0, &context) ==
+    CHECK(rc.find_file_type_id((const uint8_t*)data, strlen(data), 0) ==
         SNORT_FILE_TYPE_UNKNOWN);
 }
-#endif
 
+TEST_CASE ("FileIdMagicTable", "[FileMagic]")
+{
+    FileIdentifier rc;
+
+    add_magic(rc, 22, { { 0, "%PDF" } });
+    add_magic(rc, 21, { { 0, "MZ" } });
+    add_magic(rc, 29, { { 0, "PK\x03\x04" } });
+    add_magic(rc, 60, { { 0, "PK\x03\x04" }, { 30, "[Content_Types].xml" } });
+    add_magic(rc, 2, { { 257, "ustar\x00  " } });
+    add_magic(rc, 36, { { 0, "(This file must be converted with BinHex " } });
+    add_magic(rc, 61, { { 0, "\x7f" "ELF" }, { 16, "\x02\x01" } });
+    rc.compile_magic_rules();
+
+    CHECK(rc.has_magic_rules());
+    CHECK(rc.memory_usage() > 0);
+
+    SECTION("single magic")
+    {
+        const char* data = "%PDF-1.7 ...";
+        CHECK(rc.find_file_type_id((const uint8_t*)data, strlen(data), 0) == 22);
+    }
+    SECTION("short magic")
+    {
+        const char* data = "MZ\x90";
+        CHECK(rc.find_file_type_id((const uint8_t*)data, strlen(data), 0) == 21);
+    }
+    SECTION("long magic")
+    {
+        const char* data = "(This file must be converted with BinHex 4.0)";
+        CHECK(rc.find_file_type_id((const uint8_t*)data, strlen(data), 0) == 36);
+
+        const char* bad = "(This file must be converted with BinHax 4.0)";
+        CHECK(rc.find_file_type_id((const uint8_t*)bad, strlen(bad), 0) ==
+            SNORT_FILE_TYPE_CONTINUE);
+    }
+    SECTION("most specific")
+    {
+        std::string data("PK\x03\x04", 4);
+        data.append(26, 'x');
+        data.append("[Content_Types].xml");
+        CHECK(rc.find_file_type_id((const uint8_t*)data.c_str(), data.size(), 0) == 60);
+
+        data[30] = '_';
+        CHECK(rc.find_file_type_id((const uint8_t*)data.c_str(), data.size(), 0) == 29);
+    }
+    SECTION("later offset")
+    {
+        std::string data(300, 'x');
+        data.replace(257, 8, "ustar\x00  ", 8);
+        CHECK(rc.find_file_type_id((const uint8_t*)data.c_str(), 100, 0) ==
+            SNORT_FILE_TYPE_CONTINUE);
+        CHECK(rc.find_file_type_id((const uint8_t*)data.c_str() + 100, 200, 100) == 2);
+    }
+    SECTION("past all magics")
+    {
+        std::string data(300, 'x');
+        CHECK(rc.find_file_type_id((const uint8_t*)data.c_str(), data.size(), 0) ==
+            SNORT_FILE_TYPE_UNKNOWN);
+    }
+    SECTION("magic split across calls")
+    {
+        const char* data = "%PDF-1.7 ...";
+        void* context = nullptr;
+
+        CHECK(rc.find_file_type_id((const uint8_t*)data, 2, 0, &context) ==
+            SNORT_FILE_TYPE_CONTINUE);
+        CHECK(context);
+        CHECK(rc.find_file_type_id((const uint8_t*)data + 2, strlen(data) - 2, 2, &context) ==
+            22);
+        CHECK(!context);
+    }
+    SECTION("long magic split across calls")
+    {
+        const char* data = "(This file must be converted with BinHex 4.0)";
+        void* context = nullptr;
+
+        CHECK(rc.find_file_type_id((const uint8_t*)data, 5, 0, &context) ==
+            SNORT_FILE_TYPE_CONTINUE);
+        CHECK(rc.find_file_type_id((const uint8_t*)data + 5, 20, 5, &context) ==
+            SNORT_FILE_TYPE_CONTINUE);
+        CHECK(rc.find_file_type_id((const uint8_t*)data + 25, strlen(data) - 25, 25,
+            &context) == 36);
+    }
+    SECTION("split magic that doesn't match")
+    {
+        std::string data(300, 'x');
+        data.replace(0, 4, "%PDX");
+        void* context = nullptr;
+
+        CHECK(rc.find_file_type_id((const uint8_t*)data.c_str(), 2, 0, &context) ==
+            SNORT_FILE_TYPE_CONTINUE);
+        CHECK(rc.find_file_type_id((const uint8_t*)data.c_str() + 2, data.size() - 2, 2,
+            &context) == SNORT_FILE_TYPE_UNKNOWN);
+        CHECK(!context);
+    }
+    SECTION("second magic in the next call")
+    {
+        std::string data("\x7f" "ELF", 4);
+        data.append(12, 'x');
+        data.append("\x02\x01");
+        data.append(10, 'x');
+        void* context = nullptr;
+
+        CHECK(rc.find_file_type_id((const uint8_t*)data.c_str(), 10, 0, &context) ==
+            SNORT_FILE_TYPE_CONTINUE);
+        CHECK(context);
+        CHECK(rc.find_file_type_id((const uint8_t*)data.c_str() + 10, data.size() - 10, 10,
+            &context) == 61);
+
+        data[17] = '\x02';
+        CHECK(rc.find_file_type_id((const uint8_t*)data.c_str(), 10, 0, &context) ==
+            SNORT_FILE_TYPE_CONTINUE);
+        CHECK(rc.find_file_type_id((const uint8_t*)data.c_str() + 10, 6, 10, &context) ==
+            SNORT_FILE_TYPE_CONTINUE);
+        // tar's magic is still ahead
+        CHECK(rc.find_file_type_id((const uint8_t*)data.c_str() + 16, data.size() - 16, 16,
+            &context) == SNORT_FILE_TYPE_CONTINUE);
+        CHECK(!context);
+    }
+    SECTION("without a context")
+    {
+        std::string data(300, 'x');
+        data.replace(0, 4, "%PDF");
+        CHECK(rc.find_file_type_id((const uint8_t*)data.c_str(), 2, 0) ==
+            SNORT_FILE_TYPE_CONTINUE);
+        CHECK(rc.find_file_type_id((const uint8_t*)data.c_str() + 2, data.size() - 2, 2) ==
+            SNORT_FILE_TYPE_UNKNOWN);
+    }
+}
+#endif
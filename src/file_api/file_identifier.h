@@ -22,29 +22,18 @@
 #ifndef FILE_IDENTIFIER_H
 #define FILE_IDENTIFIER_H
 
-// File type identification is based on file magic. To improve the detection
-// performance, a trie is created to scan file data once. Currently, only the
-// most specific file type is returned.
-
-#include <list>
+// File type identification is based on file magic. The file_id rules are
+// normally evaluated by the detection engine. When all of them are simple
+// anchored contents they can instead be compiled into a table sorted by
+// offset, magic length, and magic prefix so that a file start is identified
+// with a handful of binary searches over contiguous keys. Only the most
+// specific file type is returned.
+
+#include <string>
 #include <vector>
 
 #include "file_lib.h"
 
-namespace snort
-{
-class GHash;
-}
-
-#define MAX_BRANCH (UINT8_MAX + 1)
-
-enum IdNodeState
-{
-    ID_NODE_NEW,
-    ID_NODE_USED,
-    ID_NODE_SHARED
-};
-
 class FileMeta
 {
 public:
@@ -62,41 +51,56 @@ public:
     std::vector<std::string> groups;
 };
 
-struct IdentifierNode
+struct FileMagic
 {
-    uint32_t type_id;       /* magic content to match*/
-    IdNodeState state;
-    uint32_t offset;            /* offset from file start */
-    struct IdentifierNode* next[MAX_BRANCH]; /* pointer to an array of 256 identifiers pointers*/
+    uint32_t offset;        // from file start
+    std::string content;
 };
 
-typedef std::list<void* >  IDMemoryBlocks;
+struct FileMagicRule
+{
+    uint32_t id = 0;
+    std::vector<FileMagic> magics;
+};
 
 class FileIdentifier
 {
 public:
-    ~FileIdentifier();
-    uint32_t memory_usage() const { return memory_used; }
+    size_t memory_usage() const;
     void add_file_id(FileMeta& rule);
-    uint32_t find_file_type_id(const uint8_t* buf, int len, uint64_t offset, void** context);
+    void add_magic_rule(const FileMagicRule&);
+    void compile_magic_rules();
+    bool has_magic_rules() const { return !keys.empty(); }
+
+    // returns the matched type id, SNORT_FILE_TYPE_CONTINUE if magics may
+    // still match beyond this data, or SNORT_FILE_TYPE_UNKNOWN.  Rules that
+    // matched so far but continue past this data are kept in context for the
+    // next call; free it with snort_free() if identification stops early.
+    // Without a context each call stands alone.
+    uint32_t find_file_type_id(const uint8_t* buf, int len, uint64_t offset,
+        void** context = nullptr) const;
+
     const FileMeta* get_rule_from_id(uint32_t) const;
     void get_magic_rule_ids_from_type(const std::string&, const std::string&,
         snort::FileTypeBitSet&) const;
 
 private:
-    void init_merge_hash();
-    void* calloc_mem(size_t size);
-    void set_node_state_shared(IdentifierNode* start);
-    IdentifierNode* clone_node(IdentifierNode* start);
-    bool update_next(IdentifierNode* start, IdentifierNode** next_ptr, IdentifierNode* append);
-    void update_trie(IdentifierNode* start, IdentifierNode* append);
-
-    /*properties*/
-    IdentifierNode* identifier_root = nullptr; /*Root of magic tries*/
-    uint32_t memory_used = 0; /*Track memory usage*/
-    snort::GHash* identifier_merge_hash = nullptr;
+    // rules sharing the offset and length of their leading magic prefix
+    struct MagicGroup
+    {
+        uint32_t offset;
+        uint32_t key_len;
+        uint32_t begin;
+        uint32_t end;
+    };
+
+    bool verify(const FileMagicRule&, unsigned skip, const uint8_t* buf, int len,
+        uint64_t offset) const;
+
+    std::vector<FileMagicRule> magic_rules;   // parallel to keys once compiled
+    std::vector<uint64_t> keys;
+    std::vector<MagicGroup> groups;
     FileMeta file_magic_rules[FILE_ID_MAX + 1];
-    IDMemoryBlocks id_memory_blocks;
 };
 
 #endif
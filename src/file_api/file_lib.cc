@@ -31,6 +31,7 @@
 
 #include <openssl/sha.h>
 
+#include <algorithm>
 #include <iostream>
 #include <iomanip>
 
@@ -50,10 +51,12 @@
 #include "file_config.h"
 #include "file_cache.h"
 #include "file_flows.h"
+#include "file_hasher.h"
 #include "file_service.h"
 #include "file_segment.h"
 #include "file_stats.h"
 #include "file_module.h"
+#include "file_verdict_cache.h"
 #include "detection/fp_detect.h"
 
 using namespace snort;
@@ -328,8 +331,16 @@ FileContext::FileContext ()
 
 FileContext::~FileContext ()
 {
+    if (file_type_context)
+        snort_free(file_type_context);
     if (file_signature_context)
         snort_free(file_signature_context);
+    if (file_hash_state)
+        FileHasher::release(file_hash_state);
+    if (prefix_context)
+        snort_free(prefix_context);
+    if (prefix_sha256)
+        snort_free(prefix_sha256);
     if (file_capture)
         stop_file_capture();
     if (file_segments)
@@ -342,6 +353,8 @@ inline void FileContext::finalize_file_type()
 {
     if (SNORT_FILE_TYPE_CONTINUE ==  file_type_id)
         file_type_id = SNORT_FILE_TYPE_UNKNOWN;
+    if (file_type_context)
+        snort_free(file_type_context);
     file_type_context = nullptr;
 }
 
@@ -399,13 +412,82 @@ FileVerdict FileContext::file_signature_lookup(Packet* p)
     return FILE_VERDICT_UNKNOWN;
 }
 
+FileVerdict FileContext::verdict_cache_lookup(Packet* p, FilePolicyBase* policy)
+{
+    FileVerdictCache* verdict_cache = FileService::get_verdict_cache();
+
+    // digests of partial files are only good for this flow
+    if (!verdict_cache or !sha256 or file_state.sig_state != FILE_SIG_DONE)
+        return policy->signature_lookup(p, this);
+
+    FileVerdict v;
+    if (verdict_cache->find(sha256, policy_id, 0, v))
+    {
+        FILE_DEBUG(file_trace, DEFAULT_TRACE_OPTION_ID, TRACE_DEBUG_LEVEL,
+            p, "verdict cache hit verdict %d\n", v);
+        return v;
+    }
+
+    v = policy->signature_lookup(p, this);
+    verdict_cache->insert(sha256, policy_id, 0, v);
+
+    if (prefix_sha256)
+        verdict_cache->insert(prefix_sha256, policy_id, config->verdict_prefix_depth, v);
+
+    return v;
+}
+
+// Hash the first verdict_prefix_depth bytes of the file.  Once they are
+// hashed and more data follows, a blocking verdict cached for a file with
+// the same prefix is returned so the rest of the file need not be hashed.
+bool FileContext::prefix_lookup(const uint8_t* file_data, int data_size,
+    FilePosition position, FileVerdict& v)
+{
+    const uint32_t depth = config->verdict_prefix_depth;
+
+    if (prefix_sha256 or processed_bytes >= depth)
+        return false;
+
+    if (position == SNORT_FILE_START or position == SNORT_FILE_FULL)
+    {
+        if (!prefix_context)
+            prefix_context = snort_calloc(sizeof(SHA256_CTX));
+        SHA256_Init((SHA256_CTX*)prefix_context);
+    }
+    else if (!prefix_context)
+        return false;
+
+    const uint64_t len = std::min((uint64_t)data_size, depth - processed_bytes);
+    SHA256_Update((SHA256_CTX*)prefix_context, file_data, len);
+
+    if (processed_bytes + len < depth)
+        return false;
+
+    // files no longer than the prefix are only known by their full digest
+    const bool more = (uint64_t)data_size > len or
+        (position != SNORT_FILE_END and position != SNORT_FILE_FULL);
+
+    if (more)
+    {
+        prefix_sha256 = (uint8_t*)snort_alloc(SHA256_HASH_SIZE);
+        SHA256_Final(prefix_sha256, (SHA256_CTX*)prefix_context);
+    }
+    snort_free(prefix_context);
+    prefix_context = nullptr;
+
+    FileVerdictCache* verdict_cache = FileService::get_verdict_cache();
+
+    return more and verdict_cache and
+        verdict_cache->find(prefix_sha256, policy_id, depth, v);
+}
+
 void FileContext::finish_signature_lookup(Packet* p, bool final_lookup, FilePolicyBase* policy)
 {
     Flow* flow = p->flow;
 
     if (get_file_sig_sha256())
     {
-        verdict = policy->signature_lookup(p, this);
+        verdict = verdict_cache_lookup(p, policy);
         FILE_DEBUG(file_trace, DEFAULT_TRACE_OPTION_ID, TRACE_DEBUG_LEVEL,
             p, "finish signature lookup verdict %d\n", verdict);
         if ( verdict != FILE_VERDICT_UNKNOWN || final_lookup )
@@ -561,6 +643,25 @@ bool FileContext::process(Packet* p, const uint8_t* file_data, int data_size,
     {
         FILE_DEBUG(file_trace, DEFAULT_TRACE_OPTION_ID, TRACE_DEBUG_LEVEL, p,
             "file signature is enabled\n");
+
+        FileVerdict v;
+        if (config->verdict_prefix_depth and prefix_lookup(file_data, data_size, position, v))
+        {
+            FILE_DEBUG(file_trace, DEFAULT_TRACE_OPTION_ID, TRACE_INFO_LEVEL, p,
+                "File: prefix verdict %d\n", v);
+            if (PacketTracer::is_active())
+                PacketTracer::log("File: prefix verdict %s\n",
+                    v == FILE_VERDICT_BLOCK ? "block" : "reject");
+
+            update_file_size(data_size, position);
+            FileCache* file_cache = FileService::get_file_cache();
+            if (file_cache)
+                file_cache->apply_verdict(p, this, v, false, policy);
+            log_file_event(flow, policy);
+            config_file_signature(false);
+            return true;
+        }
+
         if (!sha256)
             process_file_signature_sha256(file_data, data_size, position);
 
@@ -669,11 +770,35 @@ void FileContext::find_file_type_from_ips(Packet* pkt, const uint8_t* file_data,
         finalize_file_type();
 }
 
+void FileContext::find_file_type_from_table(const uint8_t* file_data, int data_size,
+    FilePosition position)
+{
+    bool depth_exhausted = false;
+
+    if ((int64_t)processed_bytes + data_size >= config->file_type_depth)
+    {
+        data_size = config->file_type_depth - processed_bytes;
+        assert(data_size > 0);
+        depth_exhausted = true;
+    }
+
+    uint32_t id = config->find_file_type_id(file_data, data_size, processed_bytes,
+        &file_type_context);
+
+    if (id != SNORT_FILE_TYPE_CONTINUE)
+        file_type_id = id;
+
+    else if ((position == SNORT_FILE_END) || (position == SNORT_FILE_FULL) || depth_exhausted)
+        finalize_file_type();
+}
+
 void FileContext::process_file_type(Packet* pkt,const uint8_t* file_data, int data_size,
     FilePosition position)
 {
-    /* file type already found and no magics to continue */
-    find_file_type_from_ips(pkt, file_data, data_size, position);
+    if (config->has_magic_rules())
+        find_file_type_from_table(file_data, data_size, position);
+    else
+        find_file_type_from_ips(pkt, file_data, data_size, position);
 }
 
 void FileContext::process_file_signature_sha256(const uint8_t* file_data, int data_size,
@@ -689,6 +814,14 @@ void FileContext::process_file_signature_sha256(const uint8_t* file_data, int da
 
     FILE_DEBUG(file_trace, DEFAULT_TRACE_OPTION_ID, TRACE_DEBUG_LEVEL, GET_CURRENT_PACKET,
         "processing file signature position: %d sig state %d \n", position, file_state.sig_state);
+
+    // single segment files gain nothing from a round trip through the hasher
+    if (FileHasher::is_enabled() and position != SNORT_FILE_FULL)
+    {
+        offload_file_signature_sha256(file_data, data_size, position);
+        return;
+    }
+
     switch (position)
     {
     case SNORT_FILE_START:
@@ -756,6 +889,46 @@ void FileContext::process_file_signature_sha256(const uint8_t* file_data, int da
     }
 }
 
+void FileContext::offload_file_signature_sha256(const uint8_t* file_data, int data_size,
+    FilePosition position)
+{
+    switch (position)
+    {
+    case SNORT_FILE_START:
+        if (file_hash_state)
+            FileHasher::release(file_hash_state);
+        file_hash_state = FileHasher::create();
+        FileHasher::update(file_hash_state, file_data, data_size);
+        break;
+
+    case SNORT_FILE_MIDDLE:
+        if (!file_hash_state)
+            return;
+        FileHasher::update(file_hash_state, file_data, data_size);
+        break;
+
+    case SNORT_FILE_END:
+        if (!file_hash_state)
+            return;
+        sha256 = new uint8_t[SHA256_HASH_SIZE];
+        FileHasher::finish(file_hash_state, file_data, data_size, sha256);
+        FileHasher::release(file_hash_state);
+        file_hash_state = nullptr;
+        file_state.sig_state = FILE_SIG_DONE;
+        return;
+
+    default:
+        return;
+    }
+
+    if (file_state.sig_state == FILE_SIG_FLUSH)
+    {
+        if ( !sha256 )
+            sha256 = (uint8_t*)snort_alloc(SHA256_HASH_SIZE);
+        FileHasher::digest(file_hash_state, sha256);
+    }
+}
+
 FileCaptureState FileContext::process_file_capture(const uint8_t* file_data,
     int data_size, FilePosition position)
 {
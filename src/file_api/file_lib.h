@@ -38,6 +38,7 @@ const std::string VerdictName[] =
 {"Unknown", "Log", "Stop", "Block", "Reset", "Pending", "Stop Capture", "INVALID"};
 
 class FileConfig;
+class FileHashState;
 class FileSegments;
 
 namespace snort
@@ -139,6 +140,8 @@ public:
     FileCaptureState process_file_capture(const uint8_t* file_data, int data_size, FilePosition);
     void log_file_event(Flow*, FilePolicyBase*);
     FileVerdict file_signature_lookup(Packet*);
+    // signature lookup answered from and recorded in the shared verdict cache
+    FileVerdict verdict_cache_lookup(Packet*, FilePolicyBase*);
 
     void set_signature_state(bool gen_sig);
 
@@ -158,14 +161,20 @@ private:
     uint64_t processed_bytes = 0;
     void* file_type_context;
     void* file_signature_context;
+    FileHashState* file_hash_state = nullptr;
+    void* prefix_context = nullptr;
+    uint8_t* prefix_sha256 = nullptr;
     FileSegments* file_segments;
     FileInspect* inspector;
     FileConfig*  config;
     bool cacheable = true;
 
     void finalize_file_type();
+    void offload_file_signature_sha256(const uint8_t* file_data, int data_size, FilePosition);
     void finish_signature_lookup(Packet*, bool, FilePolicyBase*);
+    bool prefix_lookup(const uint8_t* file_data, int data_size, FilePosition, FileVerdict&);
     void find_file_type_from_ips(Packet*, const uint8_t *file_data, int data_size, FilePosition);
+    void find_file_type_from_table(const uint8_t* file_data, int data_size, FilePosition);
     void process_file_type(Packet*, const uint8_t* file_data, int data_size, FilePosition);
 };
 }
@@ -31,9 +31,22 @@
 
 #include "file_mempool.h"
 
+#include <algorithm>
+
 #include "log/messages.h"
+#include "main/thread.h"
 #include "utils/util.h"
 
+#include "file_stats.h"
+
+#ifdef UNIT_TEST
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "catch/snort_catch.h"
+#endif
+
 using namespace snort;
 
 /*This magic is used for double free detection*/
@@ -41,6 +54,21 @@ using namespace snort;
 #define FREE_MAGIC    0x2525252525252525
 typedef uint64_t MagicType;
 
+// A thread caches at most this many objects, and one object for every
+// FILE_MEM_CACHE_RATIO objects in the pool so that caches can't starve
+// other threads of a small pool
+#define FILE_MEM_CACHE_SIZE  32
+#define FILE_MEM_CACHE_RATIO 64
+
+struct FileMemCache
+{
+    const FileMemPool* pool;
+    unsigned count;
+    void* objs[FILE_MEM_CACHE_SIZE];
+};
+
+static THREAD_LOCAL FileMemCache* mem_cache = nullptr;
+
 
 void FileMemPool::free_pools()
 {
@@ -101,6 +129,11 @@ FileMemPool::FileMemPool(uint64_t num_objects, size_t o_size)
         *(MagicType*)data = FREE_MAGIC;
         total++;
     }
+
+    cache_size = std::min((uint64_t)FILE_MEM_CACHE_SIZE, total / FILE_MEM_CACHE_RATIO);
+
+    if (cache_size < 2)
+        cache_size = 0;
 }
 
 /*
@@ -121,23 +154,123 @@ FileMemPool::~FileMemPool()
  * Returns: a pointer to the FileMemPool object on success, nullptr on failure
  */
 
+int FileMemPool::read(void** obj)
+{
+    if (cbuffer_read(free_list, obj))
+    {
+        if (cbuffer_read(released_list, obj))
+        {
+            return FILE_MEM_FAIL;
+        }
+    }
+
+    return FILE_MEM_SUCCESS;
+}
+
+/*
+ * Get the cache of the calling thread, nullptr if the pool is not cached.
+ * An empty cache is rebound to whichever pool uses it next.
+ */
+FileMemCache* FileMemPool::get_cache()
+{
+    if (!cache_size)
+        return nullptr;
+
+    if (!mem_cache)
+    {
+        mem_cache = new FileMemCache;
+        mem_cache->count = 0;
+        mem_cache->pool = this;
+    }
+    else if (mem_cache->pool != this)
+    {
+        if (mem_cache->count)
+            return nullptr;
+
+        mem_cache->pool = this;
+    }
+
+    return mem_cache;
+}
+
 void* FileMemPool::m_alloc()
 {
+    FileMemCache* cache = get_cache();
+
+    if (cache)
+    {
+        if (cache->count)
+        {
+            file_counts.capture_cache_hits++;
+            cached_objects--;
+            return cache->objs[--cache->count];
+        }
+
+        file_counts.capture_cache_misses++;
+    }
+
     void* b = nullptr;
 
     std::lock_guard<std::mutex> lock(pool_mutex);
 
-    if (cbuffer_read(free_list, &b))
+    if (read(&b))
+        return nullptr;
+
+    // refill half of the cache while holding the lock
+    if (cache)
     {
-        if (cbuffer_read(released_list, &b))
+        while (cache->count < cache_size / 2 and !read(&cache->objs[cache->count]))
         {
-            return nullptr;
+            cache->count++;
+            cached_objects++;
         }
     }
 
     return b;
 }
 
+void FileMemPool::drain_cache(FileMemCache* cache, unsigned keep)
+{
+    std::lock_guard<std::mutex> lock(pool_mutex);
+
+    // the free list can hold every object so this can't fail
+    while (cache->count > keep)
+    {
+        cbuffer_write(free_list, cache->objs[--cache->count]);
+        cached_objects--;
+    }
+}
+
+int FileMemPool::cache_put(FileMemCache* cache, void* obj)
+{
+    if (obj == nullptr)
+        return FILE_MEM_FAIL;
+
+    if (*(MagicType*)obj == FREE_MAGIC)
+        return FILE_MEM_FAIL;
+
+    *(MagicType*)obj = FREE_MAGIC;
+
+    // return half of a full cache to the pool in one batch
+    if (cache->count == cache_size)
+        drain_cache(cache, cache_size / 2);
+
+    cache->objs[cache->count++] = obj;
+    cached_objects++;
+
+    return FILE_MEM_SUCCESS;
+}
+
+void FileMemPool::flush_cache()
+{
+    if (!mem_cache or mem_cache->pool != this)
+        return;
+
+    drain_cache(mem_cache, 0);
+    delete mem_cache;
+    mem_cache = nullptr;
+}
+
 /*
  * Free a new object from the buffer
  * We use circular buffer to synchronize one reader and one writer
@@ -147,12 +280,12 @@ int FileMemPool::remove(CircularBuffer* cb, void* obj)
     if (obj == nullptr)
         return FILE_MEM_FAIL;
 
-    if (cbuffer_write(cb, obj))
+    if (*(MagicType*)obj == FREE_MAGIC)
     {
         return FILE_MEM_FAIL;
     }
 
-    if (*(MagicType*)obj == FREE_MAGIC)
+    if (cbuffer_write(cb, obj))
     {
         return FILE_MEM_FAIL;
     }
@@ -164,6 +297,9 @@ int FileMemPool::remove(CircularBuffer* cb, void* obj)
 
 int FileMemPool::m_free(void* obj)
 {
+    if (FileMemCache* cache = get_cache())
+        return cache_put(cache, obj);
+
     std::lock_guard<std::mutex> lock(pool_mutex);
 
     int ret = remove(free_list, obj);
@@ -181,6 +317,9 @@ int FileMemPool::m_free(void* obj)
 
 int FileMemPool::m_release(void* obj)
 {
+    if (FileMemCache* cache = get_cache())
+        return cache_put(cache, obj);
+
     std::lock_guard<std::mutex> lock(pool_mutex);
 
     /*A writer that might from different thread*/
@@ -193,7 +332,7 @@ int FileMemPool::m_release(void* obj)
 /* Returns number of elements allocated in current buffer*/
 uint64_t FileMemPool::allocated()
 {
-    uint64_t total_freed = released() + freed();
+    uint64_t total_freed = released() + freed() + cached();
     return (total - total_freed);
 }
 
@@ -209,3 +348,94 @@ uint64_t FileMemPool::released()
     return (cbuffer_used(released_list));
 }
 
+//--------------------------------------------------------------------------
+// unit tests
+//--------------------------------------------------------------------------
+
+#ifdef UNIT_TEST
+// users overwrite the free magic with their data
+static void* alloc(FileMemPool& pool)
+{
+    void* obj = pool.m_alloc();
+
+    if (obj)
+        memset(obj, 0, sizeof(MagicType));
+
+    return obj;
+}
+
+TEST_CASE("thread cache serves allocations without the shared lists", "[file_mempool]")
+{
+    FileMemPool pool(256, 64);
+    file_counts.capture_cache_hits = file_counts.capture_cache_misses = 0;
+
+    void* a = alloc(pool);
+    REQUIRE(a);
+    CHECK(file_counts.capture_cache_misses == 1);
+    CHECK(pool.allocated() == 1);
+
+    // the miss refilled half of the cache
+    CHECK(pool.cached() == 2);
+
+    void* b = alloc(pool);
+    REQUIRE(b);
+    CHECK(file_counts.capture_cache_hits == 1);
+    CHECK(pool.allocated() == 2);
+
+    CHECK(pool.m_free(a) == FILE_MEM_SUCCESS);
+    CHECK(pool.m_free(a) == FILE_MEM_FAIL);
+    CHECK(pool.m_release(b) == FILE_MEM_SUCCESS);
+    CHECK(pool.allocated() == 0);
+
+    pool.flush_cache();
+    CHECK(pool.cached() == 0);
+    CHECK(pool.freed() == pool.total_objects());
+}
+
+TEST_CASE("small pools are not cached", "[file_mempool]")
+{
+    FileMemPool pool(8, 64);
+    void* objs[8];
+
+    for (auto& obj : objs)
+        REQUIRE((obj = alloc(pool)));
+
+    CHECK(!alloc(pool));
+    CHECK(pool.cached() == 0);
+
+    for (auto* obj : objs)
+        CHECK(pool.m_free(obj) == FILE_MEM_SUCCESS);
+
+    CHECK(pool.allocated() == 0);
+}
+
+TEST_CASE("objects move between thread caches", "[file_mempool]")
+{
+    FileMemPool pool(4096, 64);
+    std::vector<std::thread> threads;
+
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&pool]()
+        {
+            void* objs[100];
+
+            for (int i = 0; i < 1000; ++i)
+            {
+                for (auto& obj : objs)
+                    obj = alloc(pool);
+
+                for (auto* obj : objs)
+                    pool.m_release(obj);
+            }
+            pool.flush_cache();
+        });
+    }
+
+    for (auto& t : threads)
+        t.join();
+
+    CHECK(pool.cached() == 0);
+    CHECK(pool.allocated() == 0);
+}
+#endif
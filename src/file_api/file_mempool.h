@@ -27,7 +27,13 @@
 //  thread and one release thread.
 //  One more bonus: Double free detection is also added into this library
 //  This is a thread safe version of memory pool for one writer and one reader thread
+//
+//  Each thread keeps a small cache of objects. Allocations and frees are
+//  served from the cache without locking; the cache is refilled from and
+//  drained to the shared lists in batches. Pools too small to spare objects
+//  for caching are not cached.
 
+#include <atomic>
 #include <mutex>
 
 #include "circular_buffer.h"
@@ -35,6 +41,8 @@
 #define FILE_MEM_SUCCESS    0  // FIXIT-RC use bool
 #define FILE_MEM_FAIL      (-1)
 
+struct FileMemCache;
+
 class FileMemPool
 {
 public:
@@ -64,19 +72,32 @@ public:
     // Returns number of elements released in current buffer
     uint64_t released();
 
+    // Returns number of elements held in thread caches
+    uint64_t cached() { return cached_objects; }
+
     // Returns total number of elements in current buffer
     uint64_t total_objects() { return total; }
 
+    // Return objects cached by the calling thread to the pool
+    // This must be called before a thread using the pool exits
+    void flush_cache();
+
 private:
 
     void free_pools();
     int remove(CircularBuffer* cb, void* obj);
+    int read(void** obj);
+    FileMemCache* get_cache();
+    int cache_put(FileMemCache*, void* obj);
+    void drain_cache(FileMemCache*, unsigned keep);
 
     void** datapool = nullptr; /* memory buffer */
     uint64_t total = 0;
     CircularBuffer* free_list = nullptr;
     CircularBuffer* released_list = nullptr;
     size_t obj_size = 0;
+    unsigned cache_size = 0;
+    std::atomic<uint64_t> cached_objects{0};
     std::mutex pool_mutex;
 };
 
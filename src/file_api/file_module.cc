@@ -29,6 +29,7 @@
 
 #include "file_module.h"
 
+#include "decompress/file_decomp.h"
 #include "log/messages.h"
 #include "main/snort.h"
 #include "main/snort_config.h"
@@ -51,9 +52,27 @@ static const Parameter file_id_params[] =
     { "type_depth", Parameter::PT_INT, "0:max53", "1460",
       "stop type ID at this point" },
 
+    { "magic_table", Parameter::PT_BOOL, nullptr, "false",
+      "identify file types with a table compiled from file_id rules instead of rule evaluation" },
+
     { "signature_depth", Parameter::PT_INT, "0:max53", "10485760",
       "stop signature at this point" },
 
+    { "signature_threads", Parameter::PT_INT, "0:64", "0",
+      "number of threads computing file signatures off the packet threads, 0 computes inline" },
+
+    { "signature_queue_memcap", Parameter::PT_INT, "1:max32", "32",
+      "memcap for file data queued to signature threads in megabytes" },
+
+    { "pdf_threads", Parameter::PT_INT, "0:64", "0",
+      "number of threads inflating PDF files and extracting their JavaScript off the packet threads, 0 extracts inline" },
+
+    { "pdf_depth", Parameter::PT_INT, "0:max53", "10485760",
+      "stop extracting a PDF on PDF threads after this many bytes, 0 is unlimited" },
+
+    { "pdf_time", Parameter::PT_INT, "0:max32", "1000",
+      "stop extracting a PDF on PDF threads after this many milliseconds, 0 is unlimited" },
+
     { "block_timeout", Parameter::PT_INT, "0:max31", "86400",
       "stop blocking after this many seconds" },
 
@@ -75,9 +94,27 @@ static const Parameter file_id_params[] =
     { "capture_block_size", Parameter::PT_INT, "8:max53", "32768",
       "file capture block size in bytes" },
 
+    { "capture_writers", Parameter::PT_INT, "1:32", "1",
+      "number of threads storing captured files to disk" },
+
+    { "capture_direct_io", Parameter::PT_BOOL, nullptr, "false",
+      "store captured files with direct I/O, bypassing the page cache" },
+
     { "max_files_cached", Parameter::PT_INT, "8:max53", "65536",
       "maximal number of files cached in memory" },
 
+    { "max_verdicts_cached", Parameter::PT_INT, "0:max31", "65536",
+      "maximal number of file signature verdicts shared by all packet threads, 0 disables" },
+
+    { "verdict_cache_timeout", Parameter::PT_INT, "0:max31", "3600",
+      "reuse block verdicts of a file signature on other flows for this many seconds" },
+
+    { "verdict_cache_negative_timeout", Parameter::PT_INT, "0:max31", "60",
+      "reuse unknown and clean verdicts of a file signature on other flows for this many seconds" },
+
+    { "verdict_prefix_depth", Parameter::PT_INT, "0:max31", "0",
+      "block later downloads of blocked files longer than this once this many bytes match, 0 disables" },
+
     { "max_files_per_flow", Parameter::PT_INT, "1:max53", "128",
       "maximal number of files able to be concurrently processed per flow" },
 
@@ -99,6 +136,9 @@ static const Parameter file_id_params[] =
     { "decompress_buffer_size", Parameter::PT_INT, "1024:max31", "100000",
       "file decompression buffer size" },
 
+    { "vba_window_size", Parameter::PT_INT, "4096:max31", "65536",
+      "most bytes of an OLE file kept while extracting its VBA macros" },
+
     { nullptr, Parameter::PT_MAX, nullptr, nullptr, nullptr }
 };
 
@@ -109,6 +149,44 @@ static const PegInfo file_pegs[] =
     { CountType::SUM, "cache_failures", "number of file cache add failures" },
     { CountType::SUM, "files_not_processed", "number of files not processed due to per-flow limit" },
     { CountType::MAX, "max_concurrent_files", "maximum files processed concurrently on a flow" },
+    { CountType::SUM, "signature_segments_offloaded",
+        "number of file segments queued to signature threads" },
+    { CountType::SUM, "signature_segments_inline",
+        "number of file segments hashed inline because the signature queue was full" },
+    { CountType::SUM, "signature_waits",
+        "number of times a packet thread waited for a file signature" },
+    { CountType::SUM, "capture_files_queued", "number of captured files queued for storage" },
+    { CountType::MAX, "capture_queue_max", "maximum number of captured files waiting for storage" },
+    { CountType::SUM, "capture_cache_hits",
+        "number of capture buffers allocated from the thread cache" },
+    { CountType::SUM, "capture_cache_misses",
+        "number of capture buffers allocated from the shared pool" },
+    { CountType::SUM, "decompress_bytes_in", "number of compressed file bytes decompressed" },
+    { CountType::SUM, "decompress_pdf_bytes", "number of bytes output by PDF decompression" },
+    { CountType::SUM, "decompress_swf_bytes", "number of bytes output by SWF decompression" },
+    { CountType::SUM, "decompress_zip_bytes", "number of bytes output by ZIP decompression" },
+    { CountType::SUM, "decompress_usecs",
+        "microseconds spent decompressing files; divide output bytes by this for throughput" },
+    { CountType::SUM, "decompress_deflate64_streams",
+        "number of ZIP entries decompressed with deflate64" },
+    { CountType::SUM, "verdict_cache_hits",
+        "number of file signature verdicts found in the shared verdict cache" },
+    { CountType::SUM, "verdict_cache_negative_hits",
+        "number of verdict cache hits for unknown or clean files" },
+    { CountType::SUM, "verdict_cache_misses",
+        "number of file signatures not found in the shared verdict cache" },
+    { CountType::SUM, "verdict_cache_prefix_hits",
+        "number of files blocked from the digest of their first bytes" },
+    { CountType::SUM, "decompress_ole_sectors_dropped",
+        "number of OLE sectors dropped from the VBA extraction window" },
+    { CountType::SUM, "pdf_offload_pdus",
+        "number of PDF file PDUs queued to PDF threads" },
+    { CountType::SUM, "pdf_offload_inline",
+        "number of PDF file PDUs extracted on the packet thread at the end of the file" },
+    { CountType::SUM, "pdf_offload_waits",
+        "number of times a packet thread waited at the end of a PDF for a PDF thread" },
+    { CountType::SUM, "pdf_offload_limited",
+        "number of PDF files not fully extracted due to the depth or time limit" },
     { CountType::END, nullptr, nullptr }
 };
 
@@ -149,9 +227,24 @@ const RuleMap* FileIdModule::get_rules() const
     return file_id_rules;
 }
 
+// decompression is shared by HTTP and MIME so it keeps its own counts
+static void sum_decomp_stats()
+{
+    file_counts.decompress_bytes_in += file_decomp_stats.bytes_in;
+    file_counts.decompress_pdf_bytes += file_decomp_stats.pdf_bytes_out;
+    file_counts.decompress_swf_bytes += file_decomp_stats.swf_bytes_out;
+    file_counts.decompress_zip_bytes += file_decomp_stats.zip_bytes_out;
+    file_counts.decompress_usecs += file_decomp_stats.usecs;
+    file_counts.decompress_deflate64_streams += file_decomp_stats.zip_deflate64_streams;
+    file_counts.decompress_ole_sectors_dropped += file_decomp_stats.ole_sectors_dropped;
+
+    memset(&file_decomp_stats, 0, sizeof(file_decomp_stats));
+}
+
 void FileIdModule::sum_stats(bool dump_stats)
 {
     file_stats_sum();
+    sum_decomp_stats();
     Module::sum_stats(dump_stats);
 }
 
@@ -163,9 +256,28 @@ bool FileIdModule::set(const char*, Value& v, SnortConfig*)
     if ( v.is("type_depth") )
         fc->file_type_depth = v.get_int64();
 
+    else if ( v.is("magic_table") )
+        fc->magic_table = v.get_bool();
+
     else if ( v.is("signature_depth") )
         fc->file_signature_depth = v.get_int64();
 
+    else if ( v.is("signature_threads") )
+        fc->signature_threads = v.get_uint32();
+
+    else if ( v.is("signature_queue_memcap") )
+        fc->signature_queue_memcap = v.get_int64();
+
+    else if ( v.is("pdf_threads") )
+        fc->pdf_threads = v.get_uint32();
+
+    else if ( v.is("pdf_depth") )
+        fc->pdf_depth = v.get_int64();
+
+    else if ( v.is("pdf_time") )
+        fc->pdf_time = v.get_uint32();
+
+
     else if ( v.is("block_timeout") )
         fc->file_block_timeout = v.get_int64();
 
@@ -187,9 +299,27 @@ bool FileIdModule::set(const char*, Value& v, SnortConfig*)
     else if ( v.is("capture_block_size") )
         fc->capture_block_size = v.get_int64();
 
+    else if ( v.is("capture_writers") )
+        fc->capture_writers = v.get_uint32();
+
+    else if ( v.is("capture_direct_io") )
+        fc->capture_direct_io = v.get_bool();
+
     else if ( v.is("max_files_cached") )
         fc->max_files_cached = v.get_int64();
 
+    else if ( v.is("max_verdicts_cached") )
+        fc->max_verdicts_cached = v.get_uint32();
+
+    else if ( v.is("verdict_cache_timeout") )
+        fc->verdict_cache_timeout = v.get_int64();
+
+    else if ( v.is("verdict_cache_negative_timeout") )
+        fc->verdict_cache_negative_timeout = v.get_int64();
+
+    else if ( v.is("verdict_prefix_depth") )
+        fc->verdict_prefix_depth = v.get_uint32();
+
     else if ( v.is("max_files_per_flow") )
         fc->max_files_per_flow = v.get_uint64();
 
@@ -208,6 +338,9 @@ bool FileIdModule::set(const char*, Value& v, SnortConfig*)
     else if ( v.is("decompress_buffer_size") )
         FileService::decode_conf.set_decompress_buffer_size(v.get_uint32());
 
+    else if ( v.is("vba_window_size") )
+        FileService::decode_conf.set_vba_window_size(v.get_uint32());
+
     else if ( v.is("rules_file") )
     {
         magic_file = "include ";
@@ -238,6 +371,7 @@ void FileIdModule::show_dynamic_stats()
 void FileIdModule::reset_stats()
 {
     file_stats_clear();
+    memset(&file_decomp_stats, 0, sizeof(file_decomp_stats));
     Module::reset_stats();
 }
 
@@ -29,6 +29,8 @@
 
 #include "file_service.h"
 
+#include "decompress/file_decomp.h"
+#include "js_norm/pdf_offload.h"
 #include "log/messages.h"
 #include "main/snort_config.h"
 #include "mime/file_mime_process.h"
@@ -37,7 +39,9 @@
 #include "file_cache.h"
 #include "file_capture.h"
 #include "file_flows.h"
+#include "file_hasher.h"
 #include "file_stats.h"
+#include "file_verdict_cache.h"
 
 using namespace snort;
 
@@ -47,12 +51,21 @@ bool FileService::file_capture_enabled = false;
 bool FileService::file_processing_initiated = false;
 
 FileCache* FileService::file_cache = nullptr;
+FileVerdictCache* FileService::verdict_cache = nullptr;
 DecodeConfig FileService::decode_conf;
 
 // FIXIT-L make these params reloadable
 static int64_t max_files_cached = 0;
+static uint32_t max_verdicts_cached = 0;
 static int64_t capture_memcap = 0;
 static int64_t capture_block_size = 0;
+static uint32_t capture_writers = 0;
+static bool capture_direct_io = false;
+static uint32_t signature_threads = 0;
+static int64_t signature_queue_memcap = 0;
+static uint32_t pdf_threads = 0;
+static int64_t pdf_depth = 0;
+static uint32_t pdf_time = 0;
 
 void FileService::init()
 {
@@ -76,11 +89,37 @@ void FileService::post_init()
         file_cache->set_lookup_timeout(conf->file_lookup_timeout);
     }
 
+    if (file_signature_enabled and conf->max_verdicts_cached and !verdict_cache)
+    {
+        verdict_cache = new FileVerdictCache(conf->max_verdicts_cached);
+        max_verdicts_cached = conf->max_verdicts_cached;
+        verdict_cache->set_timeouts(conf->verdict_cache_timeout,
+            conf->verdict_cache_negative_timeout);
+    }
+
     if (file_capture_enabled)
     {
-        FileCapture::init(conf->capture_memcap, conf->capture_block_size);
+        FileCapture::init(conf->capture_memcap, conf->capture_block_size,
+            conf->capture_writers, conf->capture_direct_io);
         capture_memcap = conf->capture_memcap;
         capture_block_size = conf->capture_block_size;
+        capture_writers = conf->capture_writers;
+        capture_direct_io = conf->capture_direct_io;
+    }
+
+    if (file_signature_enabled and conf->signature_threads)
+    {
+        FileHasher::init(conf->signature_threads, conf->signature_queue_memcap);
+        signature_threads = conf->signature_threads;
+        signature_queue_memcap = conf->signature_queue_memcap;
+    }
+
+    if (conf->pdf_threads)
+    {
+        PDFOffload::init(conf->pdf_threads, conf->pdf_depth, conf->pdf_time);
+        pdf_threads = conf->pdf_threads;
+        pdf_depth = conf->pdf_depth;
+        pdf_time = conf->pdf_time;
     }
     const SnortConfig* sc = SnortConfig::get_conf();
     conf->snort_protocol_id = sc->proto_ref->find("file_id");
@@ -102,8 +141,29 @@ void FileService::verify_reload(const SnortConfig* sc)
             ReloadError("Changing file_id.capture_memcap requires a restart.\n");
         if (capture_block_size != conf->capture_block_size)
             ReloadError("Changing file_id.capture_block_size requires a restart.\n");
+        if (capture_writers != conf->capture_writers)
+            ReloadError("Changing file_id.capture_writers requires a restart.\n");
+        if (capture_direct_io != conf->capture_direct_io)
+            ReloadError("Changing file_id.capture_direct_io requires a restart.\n");
     }
 
+    if (file_signature_enabled)
+    {
+        if (signature_threads != conf->signature_threads)
+            ReloadError("Changing file_id.signature_threads requires a restart.\n");
+        if (signature_threads and signature_queue_memcap != conf->signature_queue_memcap)
+            ReloadError("Changing file_id.signature_queue_memcap requires a restart.\n");
+        if (max_verdicts_cached != conf->max_verdicts_cached)
+            ReloadError("Changing file_id.max_verdicts_cached requires a restart.\n");
+    }
+
+    if (pdf_threads != conf->pdf_threads)
+        ReloadError("Changing file_id.pdf_threads requires a restart.\n");
+    if (pdf_threads and pdf_depth != conf->pdf_depth)
+        ReloadError("Changing file_id.pdf_depth requires a restart.\n");
+    if (pdf_threads and pdf_time != conf->pdf_time)
+        ReloadError("Changing file_id.pdf_time requires a restart.\n");
+
     if (conf->snort_protocol_id == UNKNOWN_PROTOCOL_ID)
     {
         conf->snort_protocol_id = sc->proto_ref->find("file_id");
@@ -115,15 +175,24 @@ void FileService::close()
     if (file_cache)
         delete file_cache;
 
+    delete verdict_cache;
+    verdict_cache = nullptr;
+
     MimeSession::exit();
     FileCapture::exit();
+    FileHasher::exit();
+    PDFOffload::exit();
 }
 
 void FileService::thread_init()
 { file_stats_init(); }
 
 void FileService::thread_term()
-{ file_stats_term(); }
+{
+    FileCapture::thread_term();
+    File_Decomp_Thread_Term();
+    file_stats_term();
+}
 
 void FileService::enable_file_type()
 {
@@ -30,6 +30,7 @@
 
 class FileEnforcer;
 class FileCache;
+class FileVerdictCache;
 
 namespace snort
 {
@@ -62,6 +63,7 @@ public:
     static void reset_depths();
 
     static FileCache* get_file_cache() { return file_cache; }
+    static FileVerdictCache* get_verdict_cache() { return verdict_cache; }
     static DecodeConfig decode_conf;
 
 private:
@@ -70,6 +72,7 @@ private:
     static bool file_capture_enabled;
     static bool file_processing_initiated;
     static FileCache* file_cache;
+    static FileVerdictCache* verdict_cache;
 };
 } // namespace snort
 #endif
@@ -37,6 +37,28 @@ struct FileCounts
     PegCount cache_add_fails;
     PegCount files_over_flow_limit_not_processed;
     PegCount max_concurrent_files_per_flow;
+    PegCount signature_segments_offloaded;
+    PegCount signature_segments_inline;
+    PegCount signature_waits;
+    PegCount capture_files_queued;
+    PegCount capture_queue_max;
+    PegCount capture_cache_hits;
+    PegCount capture_cache_misses;
+    PegCount decompress_bytes_in;
+    PegCount decompress_pdf_bytes;
+    PegCount decompress_swf_bytes;
+    PegCount decompress_zip_bytes;
+    PegCount decompress_usecs;
+    PegCount decompress_deflate64_streams;
+    PegCount verdict_cache_hits;
+    PegCount verdict_cache_negative_hits;
+    PegCount verdict_cache_misses;
+    PegCount verdict_cache_prefix_hits;
+    PegCount decompress_ole_sectors_dropped;
+    PegCount pdf_offload_pdus;
+    PegCount pdf_offload_inline;
+    PegCount pdf_offload_waits;
+    PegCount pdf_offload_limited;
     PegCount files_buffered_total;
     PegCount files_released_total;
     PegCount files_freed_total;
@@ -0,0 +1,258 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2023-2023 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// file_verdict_cache.cc
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "file_verdict_cache.h"
+
+#include <cstring>
+
+#include "hash/hash_defs.h"
+#include "hash/xhash.h"
+#include "time/packet_time.h"
+
+#include "file_stats.h"
+
+#ifdef UNIT_TEST
+#include "catch/snort_catch.h"
+#endif
+
+using namespace snort;
+
+FileVerdictCache::FileVerdictCache(unsigned max_verdicts)
+{
+    verdicts = new XHash(max_verdicts, sizeof(VerdictKey), sizeof(VerdictNode), 0);
+    verdicts->set_max_nodes(max_verdicts);
+}
+
+FileVerdictCache::~FileVerdictCache()
+{
+    delete verdicts;
+}
+
+void FileVerdictCache::set_timeouts(int64_t timeout, int64_t negative)
+{
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    verdict_timeout = timeout;
+    negative_timeout = negative;
+}
+
+static void make_key(FileVerdictCache::VerdictKey& key, const uint8_t* sha256,
+    uint32_t policy_id, uint32_t prefix_depth)
+{
+    memcpy(key.sha256, sha256, sizeof(key.sha256));
+    key.prefix_depth = prefix_depth;
+    key.policy_id = policy_id;
+}
+
+bool FileVerdictCache::find(const uint8_t* sha256, uint32_t policy_id, uint32_t prefix_depth,
+    FileVerdict& verdict)
+{
+    VerdictKey key;
+    make_key(key, sha256, policy_id, prefix_depth);
+
+    std::lock_guard<std::mutex> lock(cache_mutex);
+
+    HashNode* hash_node = verdicts->find_node(&key);
+    if ( hash_node )
+    {
+        VerdictNode* node = (VerdictNode*)hash_node->data;
+
+        if ( node->expire_time > packet_time() )
+        {
+            verdict = node->verdict;
+
+            if ( prefix_depth )
+                file_counts.verdict_cache_prefix_hits++;
+            else
+            {
+                file_counts.verdict_cache_hits++;
+                if ( !is_blocking(verdict) )
+                    file_counts.verdict_cache_negative_hits++;
+            }
+            return true;
+        }
+        verdicts->release_node(hash_node);
+    }
+
+    if ( !prefix_depth )
+        file_counts.verdict_cache_misses++;
+
+    return false;
+}
+
+void FileVerdictCache::insert(const uint8_t* sha256, uint32_t policy_id, uint32_t prefix_depth,
+    FileVerdict verdict)
+{
+    switch ( verdict )
+    {
+    case FILE_VERDICT_UNKNOWN:
+    case FILE_VERDICT_LOG:
+    case FILE_VERDICT_STOP:
+        if ( prefix_depth )
+            return;
+        break;
+    case FILE_VERDICT_BLOCK:
+    case FILE_VERDICT_REJECT:
+        break;
+    default:
+        // pending lookups and capture control are not results
+        return;
+    }
+
+    VerdictKey key;
+    make_key(key, sha256, policy_id, prefix_depth);
+
+    std::lock_guard<std::mutex> lock(cache_mutex);
+
+    int64_t timeout = is_blocking(verdict) ? verdict_timeout : negative_timeout;
+    if ( !timeout )
+        return;
+
+    VerdictNode new_node;
+    new_node.expire_time = packet_time() + timeout;
+    new_node.verdict = verdict;
+
+    if ( verdicts->insert(&key, &new_node) == HASH_INTABLE )
+    {
+        // a newer result replaces the old one, eg unknown becoming block
+        VerdictNode* node = (VerdictNode*)verdicts->get_user_data();
+        *node = new_node;
+    }
+}
+
+//--------------------------------------------------------------------------
+// unit tests
+//--------------------------------------------------------------------------
+
+#ifdef UNIT_TEST
+static void set_time(time_t sec)
+{
+    struct timeval tv = { sec, 0 };
+    packet_time_update(&tv);
+}
+
+TEST_CASE("verdicts are shared by digest and policy", "[file_verdict_cache]")
+{
+    uint8_t sha[SHA256_HASH_SIZE];
+    memset(sha, 0xa5, sizeof(sha));
+
+    FileVerdictCache cache(16);
+    cache.set_timeouts(100, 10);
+    set_time(1000);
+
+    FileVerdict v = FILE_VERDICT_MAX;
+    CHECK(!cache.find(sha, 1, 0, v));
+
+    cache.insert(sha, 1, 0, FILE_VERDICT_BLOCK);
+    CHECK(cache.find(sha, 1, 0, v));
+    CHECK(v == FILE_VERDICT_BLOCK);
+
+    CHECK(!cache.find(sha, 2, 0, v));
+    CHECK(!cache.find(sha, 1, 4096, v));
+
+    sha[0] = 0;
+    CHECK(!cache.find(sha, 1, 0, v));
+}
+
+TEST_CASE("negative verdicts expire first", "[file_verdict_cache]")
+{
+    uint8_t clean[SHA256_HASH_SIZE];
+    uint8_t bad[SHA256_HASH_SIZE];
+    memset(clean, 1, sizeof(clean));
+    memset(bad, 2, sizeof(bad));
+
+    FileVerdictCache cache(16);
+    cache.set_timeouts(100, 10);
+    set_time(1000);
+
+    cache.insert(clean, 0, 0, FILE_VERDICT_UNKNOWN);
+    cache.insert(bad, 0, 0, FILE_VERDICT_REJECT);
+
+    FileVerdict v = FILE_VERDICT_MAX;
+    set_time(1009);
+    CHECK(cache.find(clean, 0, 0, v));
+    CHECK(v == FILE_VERDICT_UNKNOWN);
+
+    set_time(1010);
+    CHECK(!cache.find(clean, 0, 0, v));
+    CHECK(cache.find(bad, 0, 0, v));
+    CHECK(v == FILE_VERDICT_REJECT);
+
+    set_time(1100);
+    CHECK(!cache.find(bad, 0, 0, v));
+}
+
+TEST_CASE("only results are cached", "[file_verdict_cache]")
+{
+    uint8_t sha[SHA256_HASH_SIZE] = { };
+    FileVerdictCache cache(16);
+    cache.set_timeouts(100, 10);
+    set_time(1000);
+
+    FileVerdict v = FILE_VERDICT_MAX;
+
+    SECTION("pending")
+    {
+        cache.insert(sha, 0, 0, FILE_VERDICT_PENDING);
+        CHECK(!cache.find(sha, 0, 0, v));
+    }
+    SECTION("clean prefix")
+    {
+        cache.insert(sha, 0, 4096, FILE_VERDICT_LOG);
+        CHECK(!cache.find(sha, 0, 4096, v));
+    }
+    SECTION("negative caching disabled")
+    {
+        cache.set_timeouts(100, 0);
+        cache.insert(sha, 0, 0, FILE_VERDICT_STOP);
+        CHECK(!cache.find(sha, 0, 0, v));
+    }
+    SECTION("unknown becomes block")
+    {
+        cache.insert(sha, 0, 0, FILE_VERDICT_UNKNOWN);
+        cache.insert(sha, 0, 0, FILE_VERDICT_BLOCK);
+        CHECK(cache.find(sha, 0, 0, v));
+        CHECK(v == FILE_VERDICT_BLOCK);
+    }
+}
+
+TEST_CASE("least recently used verdicts are replaced", "[file_verdict_cache]")
+{
+    FileVerdictCache cache(4);
+    cache.set_timeouts(100, 100);
+    set_time(1000);
+
+    uint8_t sha[SHA256_HASH_SIZE] = { };
+    for ( uint8_t i = 0; i < 8; ++i )
+    {
+        sha[0] = i;
+        cache.insert(sha, 0, 0, FILE_VERDICT_LOG);
+    }
+
+    FileVerdict v;
+    sha[0] = 0;
+    CHECK(!cache.find(sha, 0, 0, v));
+    sha[0] = 7;
+    CHECK(cache.find(sha, 0, 0, v));
+}
+#endif
+
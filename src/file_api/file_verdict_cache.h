@@ -0,0 +1,87 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2023-2023 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// file_verdict_cache.h
+
+#ifndef FILE_VERDICT_CACHE_H
+#define FILE_VERDICT_CACHE_H
+
+// FileVerdictCache remembers signature lookup verdicts by file content so
+// the same file seen again on any flow by any packet thread is resolved
+// without another lookup.  Entries are keyed by SHA-256 and file policy.
+// Blocking verdicts are kept for the verdict timeout; unknown and clean
+// verdicts are negative results, kept for the shorter negative timeout so
+// a lookup service that learns about the file is asked again soon.
+//
+// A blocked file longer than the prefix depth is also keyed by the digest
+// of its first prefix depth bytes, so a later download of it can be blocked
+// before the rest is hashed.  Prefix entries only hold blocking verdicts.
+
+#include <ctime>
+#include <mutex>
+
+#include "hash/hashes.h"
+#include "utils/cpp_macros.h"
+
+#include "file_api.h"
+
+namespace snort
+{
+class XHash;
+}
+
+class FileVerdictCache
+{
+public:
+    FileVerdictCache(unsigned max_verdicts);
+    ~FileVerdictCache();
+
+    void set_timeouts(int64_t verdict_timeout, int64_t negative_timeout);
+
+    // prefix_depth is 0 for digests of whole files
+    bool find(const uint8_t* sha256, uint32_t policy_id, uint32_t prefix_depth,
+        FileVerdict&);
+    void insert(const uint8_t* sha256, uint32_t policy_id, uint32_t prefix_depth,
+        FileVerdict);
+
+    static bool is_blocking(FileVerdict v)
+    { return v == FILE_VERDICT_BLOCK or v == FILE_VERDICT_REJECT; }
+
+PADDING_GUARD_BEGIN
+    struct VerdictKey
+    {
+        uint8_t sha256[SHA256_HASH_SIZE];
+        uint32_t prefix_depth;
+        uint32_t policy_id;
+    };
+PADDING_GUARD_END
+
+    struct VerdictNode
+    {
+        time_t expire_time;
+        FileVerdict verdict;
+    };
+
+private:
+    snort::XHash* verdicts;
+    int64_t verdict_timeout = 0;
+    int64_t negative_timeout = 0;
+    std::mutex cache_mutex;
+};
+
+#endif
+
@@ -0,0 +1,268 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2023-2023 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+// file_magic_benchmark.cc
+
+// Compares the compiled magic table with a 256-way trie of the kind the
+// table replaced, using the shipped file_magic.rules.  Each sample is the
+// first 1460 bytes of a file carrying one rule's magics.
+
+#ifdef BENCHMARK_TEST
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <regex>
+#include <string>
+
+#include "catch/catch.hpp"
+
+#include "file_api/file_identifier.h"
+
+namespace snort
+{
+void ParseError(const char*, ...) { }
+
+#ifdef UNIT_TEST
+class TestCaseInstaller
+{
+public:
+    TestCaseInstaller(void(*)(), const char*);
+    TestCaseInstaller(void(*)(), const char*, const char*);
+};
+TestCaseInstaller::TestCaseInstaller(void(*)(), const char*) { }
+TestCaseInstaller::TestCaseInstaller(void(*)(), const char*, const char*) { }
+#endif
+}
+
+#define SAMPLE_SIZE 1460
+
+static std::string unhex(const std::string& s)
+{
+    std::string out;
+    bool hex = false;
+
+    for ( size_t i = 0; i < s.size(); ++i )
+    {
+        if ( s[i] == '|' )
+            hex = !hex;
+
+        else if ( !hex )
+            out += s[i];
+
+        else if ( isxdigit(s[i]) )
+        {
+            out += (char)std::stoi(s.substr(i, 2), nullptr, 16);
+            ++i;
+        }
+    }
+    return out;
+}
+
+static std::vector<FileMagicRule> load_rules()
+{
+    std::vector<FileMagicRule> rules;
+    std::ifstream in(FILE_MAGIC_RULES);
+    std::string line;
+
+    const std::regex id_re("file_meta:[^;]*\\bid (\\d+)");
+    const std::regex content_re("content:\"([^\"]*)\"[^;]*?offset (\\d+)");
+
+    while ( std::getline(in, line) )
+    {
+        std::smatch m;
+
+        if ( line.compare(0, 7, "file_id") or !std::regex_search(line, m, id_re) )
+            continue;
+
+        FileMagicRule rule;
+        rule.id = std::stoul(m[1]);
+
+        for ( std::sregex_iterator it(line.begin(), line.end(), content_re), end; it != end; ++it )
+            rule.magics.push_back({ (uint32_t)std::stoul((*it)[2]), unhex((*it)[1]) });
+
+        rules.emplace_back(rule);
+    }
+    return rules;
+}
+
+//--------------------------------------------------------------------------
+// reference trie
+// one 256-way trie per leading magic offset; remaining magics are verified
+//--------------------------------------------------------------------------
+
+struct TrieNode
+{
+    std::vector<const FileMagicRule*> rules;
+    TrieNode* next[256] = { };
+};
+
+class MagicTrie
+{
+public:
+    MagicTrie(const std::vector<FileMagicRule>&);
+    uint32_t find(const uint8_t*, unsigned) const;
+    size_t memory_usage() const { return nodes.size() * sizeof(TrieNode); }
+
+private:
+    TrieNode* new_node();
+
+    std::map<uint32_t, TrieNode*> roots;
+    std::vector<std::unique_ptr<TrieNode>> nodes;
+};
+
+TrieNode* MagicTrie::new_node()
+{
+    nodes.emplace_back(new TrieNode);
+    return nodes.back().get();
+}
+
+MagicTrie::MagicTrie(const std::vector<FileMagicRule>& rules)
+{
+    for ( const auto& r : rules )
+    {
+        TrieNode*& root = roots[r.magics[0].offset];
+
+        if ( !root )
+            root = new_node();
+
+        TrieNode* n = root;
+
+        for ( auto c : r.magics[0].content )
+        {
+            TrieNode*& next = n->next[(uint8_t)c];
+
+            if ( !next )
+                next = new_node();
+
+            n = next;
+        }
+        n->rules.emplace_back(&r);
+    }
+}
+
+uint32_t MagicTrie::find(const uint8_t* buf, unsigned len) const
+{
+    uint32_t id = 0;
+    size_t best = 0;
+
+    for ( const auto& root : roots )
+    {
+        const TrieNode* n = root.second;
+
+        for ( unsigned off = root.first; n and off < len; ++off )
+        {
+            n = n->next[buf[off]];
+
+            if ( !n )
+                break;
+
+            for ( const auto* r : n->rules )
+            {
+                bool match = true;
+                size_t total = 0;
+
+                for ( const auto& m : r->magics )
+                {
+                    total += m.content.size();
+
+                    if ( m.offset + m.content.size() > len or
+                        memcmp(buf + m.offset, m.content.data(), m.content.size()) )
+                        match = false;
+                }
+
+                if ( match and (total > best or (total == best and r->id < id)) )
+                {
+                    id = r->id;
+                    best = total;
+                }
+            }
+        }
+    }
+    return id;
+}
+
+//--------------------------------------------------------------------------
+// benchmarks
+//--------------------------------------------------------------------------
+
+TEST_CASE("file magic table vs trie", "[file_magic]")
+{
+    std::vector<FileMagicRule> rules = load_rules();
+    REQUIRE(!rules.empty());
+
+    FileIdentifier table;
+
+    for ( const auto& r : rules )
+        table.add_magic_rule(r);
+
+    table.compile_magic_rules();
+
+    MagicTrie trie(rules);
+
+    std::vector<std::string> samples;
+
+    for ( const auto& r : rules )
+    {
+        std::string s(SAMPLE_SIZE, '\x5a');
+
+        for ( const auto& m : r.magics )
+        {
+            if ( m.offset + m.content.size() <= s.size() )
+                s.replace(m.offset, m.content.size(), m.content);
+        }
+        samples.emplace_back(s);
+    }
+    samples.emplace_back(std::string(SAMPLE_SIZE, '\0'));
+
+    for ( const auto& s : samples )
+    {
+        uint32_t id = table.find_file_type_id((const uint8_t*)s.data(), s.size(), 0);
+
+        if ( id == SNORT_FILE_TYPE_UNKNOWN or id == SNORT_FILE_TYPE_CONTINUE )
+            id = 0;
+
+        CHECK(id == trie.find((const uint8_t*)s.data(), s.size()));
+    }
+
+    printf("%zu rules: table %zu bytes, trie %zu bytes\n", rules.size(),
+        table.memory_usage(), trie.memory_usage());
+
+    BENCHMARK("table")
+    {
+        uint32_t sum = 0;
+        for ( const auto& s : samples )
+            sum += table.find_file_type_id((const uint8_t*)s.data(), s.size(), 0);
+        return sum;
+    };
+
+    BENCHMARK("trie")
+    {
+        uint32_t sum = 0;
+        for ( const auto& s : samples )
+            sum += trie.find((const uint8_t*)s.data(), s.size());
+        return sum;
+    };
+}
+
+#endif
@@ -466,6 +466,7 @@ public:  // FIXIT-M privatize if possible
     uint32_t tenant = 0;
     uint32_t default_session_timeout = 0;
     uint32_t idle_timeout = 0;
+    uint32_t offload_time = 0;      // packet time of the last offload request
     int32_t client_intf = 0;
     int32_t server_intf = 0;
 
@@ -501,6 +502,7 @@ public:  // FIXIT-M privatize if possible
         bool retry_queued : 1; // Set if a packet was queued for retry for this flow
         bool ha_flow : 1; // Set if this flow was created by an HA message
         bool ips_event_suppressed : 1; // Set if event filters have suppressed ips event
+        bool offloaded : 1; // Set if the DAQ was asked to pass or drop the rest of this flow
     } flags = {};
 
     FlowState flow_state = FlowState::SETUP;
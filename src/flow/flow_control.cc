@@ -438,6 +438,7 @@ static inline void restart_inspection(Flow* flow, Packet* p)
 {
     p->disable_inspect = false;
     flow->flags.disable_inspect = false;
+    flow->flags.offloaded = false;
     flow->flow_state = Flow::FlowState::SETUP;
     flow->last_verdict = MAX_DAQ_VERDICT;
 }
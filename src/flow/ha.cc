@@ -23,6 +23,8 @@
 
 #include "ha.h"
 
+#include <chrono>
+
 #include "framework/counts.h"
 #include "log/messages.h"
 #include "packet_io/active.h"
@@ -42,7 +44,8 @@ using namespace snort;
 enum HAEvent
 {
     HA_DELETE_EVENT = 1,
-    HA_UPDATE_EVENT = 2
+    HA_UPDATE_EVENT = 2,
+    HA_BATCH_EVENT = 3
 };
 
 struct __attribute__((__packed__)) HAMessageHeader
@@ -69,12 +72,13 @@ typedef std::array<FlowHAClient*, MAX_CLIENTS> ClientMap;
 class HighAvailability
 {
 public:
-    HighAvailability(PortBitSet*,bool);
+    HighAvailability(PortBitSet*, bool, uint32_t batch_size, const struct timeval& batch_interval);
     ~HighAvailability();
 
     void process_update(Flow*, Packet*);
     void process_deletion(Flow&);
     void process_receive();
+    void flush_batch();
 
     Flow* process_daq_import(Packet&, FlowKey&);
 
@@ -84,9 +88,23 @@ public:
     uint8_t handle_counter = 1; // stream client (index == 0) always exists
     bool shutting_down = false;
 
+private:
+    uint8_t* batch_reserve(uint32_t);
+    void batch_commit(const HAMessage&);
+    void batch_timeout();
+
 private:
     SideChannel* sc = nullptr;
     bool use_daq_channel;
+
+    // side channel messages are coalesced here when batch_size is set
+    uint8_t* batch = nullptr;
+    uint32_t batch_size = 0;
+    uint32_t batch_pos = 0;
+    unsigned batch_msgs = 0;
+    // wall clock since packet time stops when the link is idle
+    std::chrono::steady_clock::duration batch_interval;
+    std::chrono::steady_clock::time_point batch_deadline;
 };
 
 static constexpr uint8_t HA_MESSAGE_VERSION = 3;
@@ -107,6 +125,8 @@ static constexpr uint8_t SESSION_HA_CLIENT_INDEX = 0;
 
 PortBitSet* HighAvailabilityManager::ports = nullptr;
 bool HighAvailabilityManager::use_daq_channel = false;
+uint32_t HighAvailabilityManager::batch_size = 0;
+struct timeval HighAvailabilityManager::batch_interval = { };
 
 struct timeval FlowHAState::min_session_lifetime;
 struct timeval FlowHAState::min_sync_interval;
@@ -375,6 +395,211 @@ static void write_update_msg_content(Flow& flow, HAMessage& msg, bool full)
     }
 }
 
+//-------------------------------------------------------------------------
+// batches
+//
+// A batch is an HAMessageHeader with event HA_BATCH_EVENT and no key,
+// followed by records.  Each record is a varint length and then:
+//
+//     lead byte: event << 4 | key type
+//     compact key: the addresses as in the unbatched key, the ports,
+//         labels, groups and vlan as varints, then protocol, packet type,
+//         version and flags bytes
+//     for updates, the client sections exactly as in an unbatched message
+//
+// Most keys shrink from 40 to about 16 bytes and the per message header
+// from 5 bytes to 2.  Client content is opaque here and is not re-encoded.
+//-------------------------------------------------------------------------
+
+// a record is less than 2^21 bytes so its length takes at most 3
+static constexpr uint32_t MAX_VARINT_LEN = 3;
+static constexpr uint32_t MAX_COMPACT_KEY_SIZE = 1 + 32 + 2 * 5 + 5 * 3 + 4;
+static constexpr uint32_t MAX_BATCH_LEN = UINT16_MAX;
+
+static inline uint8_t* put_varint(uint8_t* p, uint32_t v)
+{
+    while ( v >= 0x80 )
+    {
+        *p++ = (uint8_t)v | 0x80;
+        v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+static bool get_varint(HAMessage& msg, uint32_t& v)
+{
+    v = 0;
+
+    for ( unsigned shift = 0; shift < 35; shift += 7 )
+    {
+        if ( !msg.fits(1) )
+            return false;
+
+        uint8_t b = *msg.cursor;
+        msg.advance_cursor(1);
+        v |= (uint32_t)(b & 0x7f) << shift;
+
+        if ( !(b & 0x80) )
+            return true;
+    }
+    return false;
+}
+
+// the caller has reserved MAX_COMPACT_KEY_SIZE
+static void write_compact_key(const Flow& flow, HAEvent event, HAMessage& msg)
+{
+    const FlowKey* key = flow.key;
+    assert(key);
+
+    uint8_t* p = msg.cursor;
+    bool ip6 = is_ip6_key(key);
+    *p++ = (uint8_t)(event << 4) | (ip6 ? KEY_TYPE_IP6 : KEY_TYPE_IP4);
+
+    if ( ip6 )
+    {
+        memcpy(p, key->ip_l, sizeof(key->ip_l));
+        p += sizeof(key->ip_l);
+        memcpy(p, key->ip_h, sizeof(key->ip_h));
+        p += sizeof(key->ip_h);
+    }
+    else
+    {
+        memcpy(p, &key->ip_l[3], sizeof(key->ip_l[3]));
+        p += sizeof(key->ip_l[3]);
+        memcpy(p, &key->ip_h[3], sizeof(key->ip_h[3]));
+        p += sizeof(key->ip_h[3]);
+    }
+
+    p = put_varint(p, key->mplsLabel);
+    p = put_varint(p, key->addressSpaceId);
+    p = put_varint(p, key->port_l);
+    p = put_varint(p, key->port_h);
+    p = put_varint(p, (uint16_t)key->group_l);
+    p = put_varint(p, (uint16_t)key->group_h);
+    p = put_varint(p, key->vlan_tag);
+
+    *p++ = key->ip_protocol;
+    *p++ = (uint8_t)key->pkt_type;
+    *p++ = key->version;
+    memcpy(p++, &key->flags, 1);
+
+    msg.advance_cursor(p - msg.cursor);
+}
+
+static bool read_compact_key(HAMessage& msg, uint8_t key_type, FlowKey& key)
+{
+    key = { };
+
+    if ( key_type == KEY_TYPE_IP6 )
+    {
+        if ( !msg.fits(sizeof(key.ip_l) + sizeof(key.ip_h)) )
+            return false;
+
+        memcpy(key.ip_l, msg.cursor, sizeof(key.ip_l));
+        msg.advance_cursor(sizeof(key.ip_l));
+        memcpy(key.ip_h, msg.cursor, sizeof(key.ip_h));
+        msg.advance_cursor(sizeof(key.ip_h));
+    }
+    else
+    {
+        if ( !msg.fits(sizeof(key.ip_l[3]) + sizeof(key.ip_h[3])) )
+            return false;
+
+        memcpy(&key.ip_l[3], msg.cursor, sizeof(key.ip_l[3]));
+        key.ip_l[2] = htonl(0xFFFF);
+        msg.advance_cursor(sizeof(key.ip_l[3]));
+        memcpy(&key.ip_h[3], msg.cursor, sizeof(key.ip_h[3]));
+        key.ip_h[2] = htonl(0xFFFF);
+        msg.advance_cursor(sizeof(key.ip_h[3]));
+    }
+
+    uint32_t v[7];
+
+    for ( auto& f : v )
+    {
+        if ( !get_varint(msg, f) )
+            return false;
+    }
+
+    key.mplsLabel = v[0];
+    key.addressSpaceId = v[1];
+    key.port_l = v[2];
+    key.port_h = v[3];
+    key.group_l = (int16_t)v[4];
+    key.group_h = (int16_t)v[5];
+    key.vlan_tag = v[6];
+
+    if ( !msg.fits(4) )
+        return false;
+
+    key.ip_protocol = msg.cursor[0];
+    key.pkt_type = (PktType)msg.cursor[1];
+    key.version = msg.cursor[2];
+    memcpy(&key.flags, msg.cursor + 3, 1);
+    msg.advance_cursor(4);
+
+    return true;
+}
+
+static Flow* consume_ha_update_message(HAMessage&, const FlowKey&, Packet*);
+
+// records are consumed in place; nothing is allocated per record
+static void consume_ha_batch(HAMessage& msg)
+{
+    ha_stats.batches_recv++;
+    const uint8_t* end = msg.buffer + msg.buffer_length;
+
+    while ( msg.cursor < end )
+    {
+        uint32_t len;
+
+        if ( !get_varint(msg, len) or !len or !msg.fits(len) )
+        {
+            ha_stats.truncated_msgs++;
+            return;
+        }
+
+        HAMessage rec(msg.cursor, len);
+        msg.advance_cursor(len);
+
+        uint8_t lead = *rec.cursor;
+        rec.advance_cursor(1);
+
+        uint8_t key_type = lead & 0xF;
+
+        if ( key_type != KEY_TYPE_IP6 and key_type != KEY_TYPE_IP4 )
+        {
+            ha_stats.unknown_key_type++;
+            continue;
+        }
+
+        FlowKey key;
+
+        if ( !read_compact_key(rec, key_type, key) )
+        {
+            ha_stats.truncated_msgs++;
+            continue;
+        }
+
+        switch ( lead >> 4 )
+        {
+        case HA_DELETE_EVENT:
+            Stream::delete_flow(&key);
+            ha_stats.delete_msgs_consumed++;
+            break;
+
+        case HA_UPDATE_EVENT:
+        {
+            HAMessage content(rec.cursor, rec.buffer_length - rec.cursor_position());
+            consume_ha_update_message(content, key, nullptr);
+            ha_stats.update_msgs_recv++;
+            break;
+        }
+        }
+    }
+}
+
 static void consume_ha_delete_message(HAMessage&, const FlowKey& key)
 {
     Stream::delete_flow(&key);
@@ -488,6 +713,14 @@ static Flow* consume_ha_message(HAMessage& msg,
 
     msg.advance_cursor(sizeof(HAMessageHeader));
 
+    if (hdr->event == HA_BATCH_EVENT)
+    {
+        // batches only come over the side channel
+        if (!packet_key)
+            consume_ha_batch(msg);
+        return nullptr;
+    }
+
     FlowKey key;
     if (read_flow_key(msg, hdr, key) == 0)
         return nullptr;
@@ -531,7 +764,8 @@ static void ha_sc_receive_handler(SCMessage* sc_msg)
     sc_msg->sc->discard_message(sc_msg);
 }
 
-HighAvailability::HighAvailability(PortBitSet* ports, bool daq_channel)
+HighAvailability::HighAvailability(PortBitSet* ports, bool daq_channel,
+    uint32_t batch_sz, const struct timeval& batch_ivl)
 {
     using namespace std::placeholders;
 
@@ -559,14 +793,97 @@ HighAvailability::HighAvailability(PortBitSet* ports, bool daq_channel)
         }
     }
     use_daq_channel = daq_channel;
+
+    if (sc && batch_sz)
+    {
+        batch = new uint8_t[MAX_BATCH_LEN];
+        batch_size = batch_sz;
+        batch_pos = sizeof(HAMessageHeader);
+        batch_interval = std::chrono::seconds(batch_ivl.tv_sec) +
+            std::chrono::microseconds(batch_ivl.tv_usec);
+    }
 }
 
 HighAvailability::~HighAvailability()
 {
+    if (batch)
+    {
+        flush_batch();
+        delete[] batch;
+    }
+
     if (sc)
         sc->unregister_receive_handler();
 }
 
+// Return where to write a record of up to len bytes, sending the batch
+// first if the record would take it past batch_size.  The record is
+// written after room for its length.
+uint8_t* HighAvailability::batch_reserve(uint32_t len)
+{
+    len += MAX_VARINT_LEN;
+
+    if (batch_msgs && batch_pos + len > batch_size)
+        flush_batch();
+
+    assert(batch_pos + len <= MAX_BATCH_LEN);
+
+    if (!batch_msgs)
+        batch_deadline = std::chrono::steady_clock::now() + batch_interval;
+
+    return batch + batch_pos + MAX_VARINT_LEN;
+}
+
+// Prefix the record written to msg with its length and send the batch if
+// it is full.
+void HighAvailability::batch_commit(const HAMessage& msg)
+{
+    uint32_t len = msg.cursor_position();
+    uint8_t* p = put_varint(batch + batch_pos, len);
+
+    memmove(p, msg.buffer, len);
+    batch_pos = (p + len) - batch;
+    batch_msgs++;
+
+    if (batch_pos >= batch_size)
+        flush_batch();
+}
+
+void HighAvailability::batch_timeout()
+{
+    if (!batch_msgs)
+        return;
+
+    if (std::chrono::steady_clock::now() >= batch_deadline)
+        flush_batch();
+}
+
+void HighAvailability::flush_batch()
+{
+    if (!batch_msgs)
+        return;
+
+    HAMessageHeader* hdr = (HAMessageHeader*) batch;
+    hdr->event = HA_BATCH_EVENT;
+    hdr->version = HA_MESSAGE_VERSION;
+    hdr->total_length = batch_pos;
+    hdr->key_type = 0;
+
+    SCMessage* sc_msg = sc->alloc_transmit_message(batch_pos);
+
+    if (sc_msg)
+    {
+        memcpy(sc_msg->content, batch, batch_pos);
+        sc->transmit_message(sc_msg);
+
+        ha_stats.batches_sent++;
+        ha_stats.batched_msgs += batch_msgs;
+    }
+
+    batch_pos = sizeof(HAMessageHeader);
+    batch_msgs = 0;
+}
+
 static void send_sc_update_message(Flow& flow, SideChannel& sc)
 {
     const uint16_t header_len = calculate_msg_header_length(flow);
@@ -615,7 +932,21 @@ void HighAvailability::process_update(Flow* flow, Packet* p)
             flow->ha_state->check_any(FlowHAState::NEW) ) )
         return;
 
-    if (sc)
+    uint32_t len = 0;
+
+    if (batch)
+        len = MAX_COMPACT_KEY_SIZE + calculate_update_msg_content_length(*flow, false);
+
+    // a record that would fill a batch by itself goes out on its own
+    if (batch and sizeof(HAMessageHeader) + MAX_VARINT_LEN + len <= batch_size)
+    {
+        HAMessage ha_msg(batch_reserve(len), len);
+
+        write_compact_key(*flow, HA_UPDATE_EVENT, ha_msg);
+        write_update_msg_content(*flow, ha_msg, false);
+        batch_commit(ha_msg);
+    }
+    else if (sc)
         send_sc_update_message(*flow, *sc);
 
     if (use_daq_channel && p && p->daq_msg)
@@ -647,7 +978,13 @@ void HighAvailability::process_deletion(Flow& flow)
         return;
 
     // Only produce deletion messages when using a side channel
-    if (sc)
+    if (batch)
+    {
+        HAMessage ha_msg(batch_reserve(MAX_COMPACT_KEY_SIZE), MAX_COMPACT_KEY_SIZE);
+        write_compact_key(flow, HA_DELETE_EVENT, ha_msg);
+        batch_commit(ha_msg);
+    }
+    else if (sc)
         send_sc_deletion_message(flow, *sc);
 
     flow.ha_state->add(FlowHAState::DELETED);
@@ -657,6 +994,8 @@ void HighAvailability::process_receive()
 {
     if (sc)
         sc->process(DISPATCH_ALL_RECEIVE);
+
+    batch_timeout();
 }
 
 Flow* HighAvailability::process_daq_import(Packet& p, FlowKey& key)
@@ -725,6 +1064,8 @@ void HighAvailabilityManager::configure(HighAvailabilityConfig* config)
     FlowHAState::config_timers(config->min_session_lifetime, config->min_sync_interval);
 
     use_daq_channel = config->daq_channel;
+    batch_size = config->batch_size;
+    batch_interval = config->batch_interval;
 }
 
 // Called within the packet thread prior to packet processing
@@ -732,7 +1073,7 @@ void HighAvailabilityManager::thread_init()
 {
     // create a a thread local instance iff we are configured to operate.
     if (ports || use_daq_channel)
-        ha = new HighAvailability(ports, use_daq_channel);
+        ha = new HighAvailability(ports, use_daq_channel, batch_size, batch_interval);
     else
         ha = nullptr;
 }
@@ -740,7 +1081,10 @@ void HighAvailabilityManager::thread_init()
 void HighAvailabilityManager::thread_term_beginning()
 {
     if (ha)
+    {
+        ha->flush_batch();
         ha->shutting_down = true;
+    }
 }
 
 // Called in the packet thread at run-down
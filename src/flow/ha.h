@@ -171,6 +171,8 @@ private:
     HighAvailabilityManager() = delete;
     static bool use_daq_channel;
     static PortBitSet* ports;
+    static uint32_t batch_size;
+    static struct timeval batch_interval;
 };
 }
 
@@ -53,6 +53,12 @@ static const Parameter ha_params[] =
     { "min_sync", Parameter::PT_INT, "0:max32", "0",
       "minimum interval in milliseconds between HA updates" },
 
+    { "batch_size", Parameter::PT_INT, "0:65535", "0",
+      "coalesce side channel messages into batches of up to this many bytes; peers must support batches (0 is off)" },
+
+    { "batch_interval", Parameter::PT_INT, "0:max32", "10",
+      "maximum time in milliseconds a message waits in a batch" },
+
     { nullptr, Parameter::PT_MAX, nullptr, nullptr, nullptr }
 };
 
@@ -72,6 +78,9 @@ static const PegInfo ha_pegs[] =
     { CountType::SUM, "unknown_key_type", "messages received with an unknown flow key type" },
     { CountType::SUM, "unknown_client_idx", "messages received with an unknown client index" },
     { CountType::SUM, "client_consume_errors", "client data consume failure count" },
+    { CountType::SUM, "batches_sent", "batched side channel messages sent" },
+    { CountType::SUM, "batched_msgs", "updates and deletions sent in batches" },
+    { CountType::SUM, "batches_recv", "batched side channel messages received" },
     { CountType::END, nullptr, nullptr }
 };
 
@@ -117,6 +126,7 @@ bool HighAvailabilityModule::begin(const char*, int, SnortConfig*)
 {
     assert(!config);
     config = new HighAvailabilityConfig();
+    convert_milliseconds_to_timeval(10, &config->batch_interval);
 
     return true;
 }
@@ -145,6 +155,14 @@ bool HighAvailabilityModule::set(const char*, Value& v, SnortConfig*)
     {
         convert_milliseconds_to_timeval(v.get_uint32(), &config->min_sync_interval);
     }
+    else if ( v.is("batch_size") )
+    {
+        config->batch_size = v.get_uint16();
+    }
+    else if ( v.is("batch_interval") )
+    {
+        convert_milliseconds_to_timeval(v.get_uint32(), &config->batch_interval);
+    }
 
     return true;
 }
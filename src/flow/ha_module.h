@@ -38,6 +38,8 @@ struct HighAvailabilityConfig
     PortBitSet* ports = nullptr;
     struct timeval min_session_lifetime;
     struct timeval min_sync_interval;
+    uint32_t batch_size = 0;
+    struct timeval batch_interval = { };
 };
 
 class HighAvailabilityModule : public snort::Module
@@ -78,6 +80,9 @@ struct HAStats
     PegCount unknown_key_type;
     PegCount unknown_client_idx;
     PegCount client_consume_errors;
+    PegCount batches_sent;
+    PegCount batched_msgs;
+    PegCount batches_recv;
 };
 
 extern THREAD_LOCAL HAStats ha_stats;
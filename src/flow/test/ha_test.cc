@@ -502,6 +502,112 @@ TEST(high_availability_test, transmit_update_both_update)
     HighAvailabilityManager::process_update(&s_flow, &s_pkt);
 }
 
+TEST(high_availability_test, batch_deletion)
+{
+    HighAvailabilityManager::thread_term();
+    HighAvailabilityManager::term();
+    hac.batch_size = 512;
+    hac.batch_interval = { 0, 0 };
+    HighAvailabilityManager::configure(&hac);
+    HighAvailabilityManager::thread_init();
+
+    flow_key.port_l = 1234;
+    flow_key.port_h = 80;
+    flow_key.ip_protocol = 6;
+
+    HighAvailabilityManager::process_deletion(s_flow);
+    HighAvailabilityManager::process_deletion(s_flow);
+    mock().checkExpectations();
+
+    // the interval has passed without a packet
+    mock().expectNCalls(1, "transmit_message");
+    HighAvailabilityManager::process_receive();
+    mock().checkExpectations();
+    CHECK(ha_stats.batches_sent == 1);
+    CHECK(ha_stats.batched_msgs == 2);
+
+    mock().expectNCalls(2, "delete_flow");
+    HighAvailabilityManager::process_receive();
+    mock().checkExpectations();
+    CHECK(ha_stats.batches_recv == 1);
+    CHECK(ha_stats.delete_msgs_consumed == 2);
+    MEMCMP_EQUAL_TEXT(&flow_key, &s_flow_key, sizeof(flow_key), "flow key should round trip");
+}
+
+TEST(high_availability_test, batch_size_exceeded)
+{
+    HighAvailabilityManager::thread_term();
+    HighAvailabilityManager::term();
+    hac.batch_size = 20;
+    HighAvailabilityManager::configure(&hac);
+    HighAvailabilityManager::thread_init();
+
+    mock().expectNCalls(1, "transmit_message");
+    HighAvailabilityManager::process_deletion(s_flow);
+    mock().checkExpectations();
+    CHECK(ha_stats.batched_msgs == 1);
+}
+
+TEST(high_availability_test, batch_update_with_content)
+{
+    HighAvailabilityManager::thread_term();
+    HighAvailabilityManager::term();
+    hac.batch_size = 512;
+    hac.batch_interval = { 0, 0 };
+    HighAvailabilityManager::configure(&hac);
+    HighAvailabilityManager::thread_init();
+
+    flow_key.port_l = 1234;
+    flow_key.port_h = 80;
+    flow_key.ip_protocol = 6;
+
+    mock().setData("stream_update_required", (int)true);
+    mock().setData("other_update_required", (int)true);
+    s_flow.ha_state->set_pending(s_other_ha_client->handle);
+    HighAvailabilityManager::process_update(&s_flow, &s_pkt);
+    mock().checkExpectations();
+
+    mock().expectNCalls(1, "transmit_message");
+    HighAvailabilityManager::process_receive();
+    mock().checkExpectations();
+    CHECK(ha_stats.batches_sent == 1);
+    CHECK(ha_stats.batched_msgs == 1);
+
+    mock().expectNCalls(1, "get_flow");
+    mock().expectNCalls(1, "consume");
+    mock().expectNCalls(1, "other_consume");
+    HighAvailabilityManager::process_receive();
+    mock().checkExpectations();
+    CHECK(ha_stats.batches_recv == 1);
+    CHECK(ha_stats.update_msgs_consumed == 1);
+    CHECK(mock().getData("stream_consume_size").getIntValue() == 10);
+    CHECK(mock().getData("other_consume_size").getIntValue() == 5);
+    MEMCMP_EQUAL_TEXT(&flow_key, &s_flow_key, sizeof(flow_key), "flow key should round trip");
+}
+
+TEST(high_availability_test, batch_update_too_big)
+{
+    HighAvailabilityManager::thread_term();
+    HighAvailabilityManager::term();
+    hac.batch_size = 40;
+    HighAvailabilityManager::configure(&hac);
+    HighAvailabilityManager::thread_init();
+
+    mock().setData("stream_update_required", (int)true);
+    mock().expectNCalls(1, "transmit_message");
+    HighAvailabilityManager::process_update(&s_flow, &s_pkt);
+    mock().checkExpectations();
+    CHECK(ha_stats.batches_sent == 0);
+    CHECK(ha_stats.batched_msgs == 0);
+
+    mock().expectNCalls(1, "get_flow");
+    mock().expectNCalls(1, "consume");
+    HighAvailabilityManager::process_receive();
+    mock().checkExpectations();
+    CHECK(ha_stats.batches_recv == 0);
+    CHECK(ha_stats.update_msgs_consumed == 1);
+}
+
 TEST(high_availability_test, read_flow_key_error_v4)
 {
     HAMessageHeader hdr = { 0, 0, 0, KEY_TYPE_IP4 };
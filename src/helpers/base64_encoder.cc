@@ -52,6 +52,15 @@ unsigned Base64Encoder::encode(
         {
             uint8_t fragment;
     case step_A:
+            // whole groups of 3 bytes
+            while (data_end - data >= 3)
+            {
+                *p++ = b64(data[0] >> 2);
+                *p++ = b64(((data[0] & 0x03) << 4) | (data[1] >> 4));
+                *p++ = b64(((data[1] & 0x0f) << 2) | (data[2] >> 6));
+                *p++ = b64(data[2] & 0x3f);
+                data += 3;
+            }
             if (data == data_end)
             {
                 step = step_A;
@@ -30,6 +30,14 @@
 using namespace jsn;
 using namespace snort;
 
+PDFJSNorm::~PDFJSNorm()
+{
+    if (offload)
+        PDFOffload::release(offload);
+
+    delete[] offload_js;
+}
+
 bool PDFJSNorm::pre_proc()
 {
     if (src_ptr >= src_end)
@@ -49,6 +57,9 @@ bool PDFJSNorm::pre_proc()
             "PDF continues\n");
     }
 
+    if (offload)
+        return offload_proc();
+
     buf_pdf_in.pubsetbuf(nullptr, 0)
         ->pubsetbuf(const_cast<char*>((const char*)src_ptr), src_end - src_ptr);
     pdf_out.clear();
@@ -76,6 +87,27 @@ bool PDFJSNorm::pre_proc()
     return true;
 }
 
+// the PDU is queued to PDF threads and the script they extracted from
+// earlier PDUs is normalized in its place
+bool PDFJSNorm::offload_proc()
+{
+    PDFOffload::update(offload, src_ptr, src_end - src_ptr, file_end);
+
+    delete[] offload_js;
+    uint32_t len;
+    PDFOffload::take(offload, offload_js, len);
+
+    if (!offload_js)
+    {
+        src_ptr = src_end = nullptr;
+        return false;
+    }
+
+    src_ptr = offload_js;
+    src_end = src_ptr + len;
+    return true;
+}
+
 bool PDFJSNorm::post_proc(int ret)
 {
     src_ptr = src_end; // one time per PDU, even if JS Normalizer has not finished
@@ -24,6 +24,7 @@
 #include <cstring>
 
 #include "js_norm/js_norm.h"
+#include "js_norm/pdf_offload.h"
 #include "js_norm/pdf_tokenizer.h"
 #include "utils/streambuf.h"
 
@@ -41,19 +42,32 @@ public:
     }
 
     PDFJSNorm(JSNormConfig* cfg) :
-        JSNorm(cfg), pdf_in(&buf_pdf_in), pdf_out(&buf_pdf_out), extractor(pdf_in, pdf_out)
+        JSNorm(cfg), pdf_in(&buf_pdf_in), pdf_out(&buf_pdf_out), extractor(pdf_in, pdf_out),
+        offload(PDFOffload::is_enabled() ? PDFOffload::create() : nullptr)
     { }
 
+    ~PDFJSNorm() override;
+
+    // the next PDU ends the file, so script still on PDF threads has no
+    // later PDU to be picked up on
+    void set_file_end(bool end)
+    { file_end = end; }
+
 protected:
     bool pre_proc() override;
     bool post_proc(int) override;
 
 private:
+    bool offload_proc();
+
     snort::istreambuf_glue buf_pdf_in;
     snort::ostreambuf_infl buf_pdf_out;
     std::istream pdf_in;
     std::ostream pdf_out;
     jsn::PDFTokenizer extractor;
+    PDFOffloadState* offload;
+    uint8_t* offload_js = nullptr;
+    bool file_end = false;
 };
 
 }
@@ -0,0 +1,531 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2023-2023 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// pdf_offload.cc
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "pdf_offload.h"
+
+#include <FlexLexer.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+
+#include "decompress/file_decomp.h"
+#include "file_api/file_stats.h"
+#include "utils/streambuf.h"
+
+#include "pdf_tokenizer.h"
+
+#ifdef UNIT_TEST
+#include <zlib.h>
+
+#include "catch/snort_catch.h"
+#endif
+
+using namespace snort;
+
+// inflated output is grown by this much when the decompressor blocks on it
+#define PDF_INFLATE_CHUNK 65536
+
+struct PDFSegment
+{
+    uint8_t* data;
+    unsigned len;
+};
+
+class PDFOffloadState
+{
+public:
+    PDFOffloadState() :
+        pdf_in(&buf_pdf_in), pdf_out(&buf_pdf_out), extractor(pdf_in, pdf_out)
+    {
+        fd = File_Decomp_New();
+        fd->Modes = FILE_PDF_DEFL_BIT;
+        File_Decomp_Init(fd);
+    }
+
+    ~PDFOffloadState()
+    {
+        if ( fd )
+            File_Decomp_StopFree(fd);
+    }
+
+    // helper only
+    istreambuf_glue buf_pdf_in;
+    ostreambuf_infl buf_pdf_out;
+    std::istream pdf_in;
+    std::ostream pdf_out;
+    jsn::PDFTokenizer extractor;
+    fd_session_t* fd;
+    std::vector<uint8_t> inflated;
+    uint64_t usecs = 0;
+
+    // under the lock
+    std::deque<PDFSegment> pending;
+    std::string js;
+    uint64_t bytes = 0;
+    bool queued = false;    // on the ready list or held by a helper
+    bool held = false;      // held by a helper
+    bool finishing = false; // owner waits to extract the rest itself
+    bool released = false;  // owner is gone, helper must delete
+    bool timed_out = false; // helper time is over the limit
+    bool limited = false;   // no more PDUs are queued
+};
+
+std::vector<std::thread*> PDFOffload::workers;
+
+static std::mutex pdf_mutex;
+static std::condition_variable work_cv;
+static std::condition_variable done_cv;
+static std::deque<PDFOffloadState*> ready;
+static uint64_t depth_limit = 0;
+static uint32_t time_limit = 0;
+static bool running = false;
+
+// streams already inflated by the inspector have their filter nulled and
+// pass through unchanged, as does anything that is not a PDF
+static void inflate(PDFOffloadState* state, const uint8_t* data, unsigned len)
+{
+    std::vector<uint8_t>& out = state->inflated;
+    out.clear();
+
+    fd_session_t* fd = state->fd;
+
+    if ( !fd )
+    {
+        out.assign(data, data + len);
+        return;
+    }
+
+    fd->Next_In = data;
+    fd->Avail_In = len;
+
+    while ( true )
+    {
+        size_t used = out.size();
+        out.resize(used + len + PDF_INFLATE_CHUNK);
+
+        fd->Next_Out = out.data() + used;
+        fd->Avail_Out = out.size() - used;
+
+        fd_status_t ret = File_Decomp(fd);
+        out.resize(fd->Next_Out - out.data());
+
+        if ( ret == File_Decomp_BlockOut )
+            continue;
+
+        if ( ret == File_Decomp_NoSig or ret == File_Decomp_Error or
+            ret == File_Decomp_DecompError )
+        {
+            out.insert(out.end(), fd->Next_In, fd->Next_In + fd->Avail_In);
+            File_Decomp_StopFree(fd);
+            state->fd = nullptr;
+        }
+        break;
+    }
+}
+
+// returns false once the file is over its helper time
+static bool extract(PDFOffloadState* state, const PDFSegment& seg, std::string& js)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    inflate(state, seg.data, seg.len);
+
+    if ( !state->inflated.empty() )
+    {
+        state->buf_pdf_in.pubsetbuf(nullptr, 0)
+            ->pubsetbuf((char*)state->inflated.data(), state->inflated.size());
+        state->pdf_out.clear();
+
+        // a failed PDU is skipped the same as when extracting inline
+        if ( state->extractor.process() == jsn::PDFTokenizer::PDFRet::EOS )
+            js.append(state->buf_pdf_out.data(), state->buf_pdf_out.data_len());
+
+        delete[] state->buf_pdf_out.take_data();
+    }
+
+    state->usecs += std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+
+    return !time_limit or state->usecs <= (uint64_t)time_limit * 1000;
+}
+
+void PDFOffload::worker()
+{
+    std::unique_lock<std::mutex> lk(pdf_mutex);
+
+    while ( true )
+    {
+        work_cv.wait(lk, [] { return !running or !ready.empty(); });
+
+        if ( ready.empty() )
+            break;
+
+        PDFOffloadState* state = ready.front();
+        ready.pop_front();
+        state->held = true;
+
+        std::deque<PDFSegment> segs;
+        segs.swap(state->pending);
+        bool over = state->timed_out;
+        lk.unlock();
+
+        std::string js;
+
+        for ( auto& seg : segs )
+        {
+            if ( !over )
+                over = !extract(state, seg, js);
+            delete[] seg.data;
+        }
+
+        lk.lock();
+        state->js.append(js);
+        state->timed_out = over;
+        state->held = false;
+
+        if ( state->released )
+            delete state;
+
+        else if ( !state->pending.empty() and !state->finishing )
+            ready.emplace_back(state);
+
+        else
+        {
+            state->queued = false;
+            done_cv.notify_all();
+        }
+    }
+}
+
+// at the end of the file the packet thread takes the file back and
+// extracts the PDUs still queued, and the last one, itself; a helper that
+// holds the file is waited for, which is bounded by the time limit
+static void finish(PDFOffloadState* state, const uint8_t* data, unsigned len,
+    std::unique_lock<std::mutex>& lk)
+{
+    if ( state->queued and !state->held )
+    {
+        ready.erase(std::find(ready.begin(), ready.end(), state));
+        state->queued = false;
+    }
+    else if ( state->queued )
+    {
+        state->finishing = true;
+        file_counts.pdf_offload_waits++;
+        done_cv.wait(lk, [state] { return !state->queued; });
+        state->finishing = false;
+    }
+
+    std::deque<PDFSegment> segs;
+    segs.swap(state->pending);
+    bool over = state->timed_out;
+    file_counts.pdf_offload_inline += segs.size() + (data ? 1 : 0);
+    lk.unlock();
+
+    std::string js;
+
+    for ( auto& seg : segs )
+    {
+        if ( !over )
+            over = !extract(state, seg, js);
+        delete[] seg.data;
+    }
+
+    if ( data and !over )
+        over = !extract(state, { const_cast<uint8_t*>(data), len }, js);
+
+    lk.lock();
+    state->js.append(js);
+    state->timed_out = over;
+}
+
+void PDFOffload::init(unsigned num_threads, uint64_t depth, uint32_t time)
+{
+    depth_limit = depth;
+    time_limit = time;
+    running = true;
+
+    for ( unsigned i = 0; i < num_threads; ++i )
+        workers.emplace_back(new std::thread(worker));
+}
+
+void PDFOffload::exit()
+{
+    {
+        std::lock_guard<std::mutex> lk(pdf_mutex);
+        running = false;
+    }
+    work_cv.notify_all();
+
+    for ( auto* t : workers )
+    {
+        t->join();
+        delete t;
+    }
+    workers.clear();
+}
+
+PDFOffloadState* PDFOffload::create()
+{ return new PDFOffloadState; }
+
+void PDFOffload::update(PDFOffloadState* state, const uint8_t* data, unsigned len, bool end)
+{
+    std::unique_lock<std::mutex> lk(pdf_mutex);
+
+    if ( !running )
+        return;
+
+    if ( !state->limited and
+        (state->timed_out or (depth_limit and state->bytes + len > depth_limit)) )
+    {
+        state->limited = true;
+        file_counts.pdf_offload_limited++;
+    }
+
+    // PDUs queued before the file went over its limits are still extracted
+    if ( end )
+    {
+        finish(state, state->limited ? nullptr : data, len, lk);
+        return;
+    }
+
+    if ( state->limited )
+        return;
+
+    uint8_t* copy = new uint8_t[len];
+    memcpy(copy, data, len);
+
+    state->pending.push_back({ copy, len });
+    state->bytes += len;
+    file_counts.pdf_offload_pdus++;
+
+    if ( !state->queued )
+    {
+        state->queued = true;
+        ready.emplace_back(state);
+        work_cv.notify_one();
+    }
+}
+
+void PDFOffload::take(PDFOffloadState* state, uint8_t*& js, uint32_t& len)
+{
+    std::lock_guard<std::mutex> lk(pdf_mutex);
+
+    if ( state->js.empty() )
+    {
+        js = nullptr;
+        len = 0;
+        return;
+    }
+
+    len = state->js.size();
+    js = new uint8_t[len];
+    memcpy(js, state->js.data(), len);
+    state->js.clear();
+}
+
+void PDFOffload::release(PDFOffloadState* state)
+{
+    std::lock_guard<std::mutex> lk(pdf_mutex);
+
+    for ( auto& seg : state->pending )
+        delete[] seg.data;
+    state->pending.clear();
+
+    if ( state->queued )
+        state->released = true;
+    else
+        delete state;
+}
+
+//--------------------------------------------------------------------------
+// unit tests
+//--------------------------------------------------------------------------
+
+#ifdef UNIT_TEST
+static std::string make_pdf(const std::string& script)
+{
+    uLongf zlen = compressBound(script.size());
+    std::string z(zlen, '\0');
+    compress((Bytef*)&z[0], &zlen, (const Bytef*)script.data(), script.size());
+    z.resize(zlen);
+
+    return "%PDF-1.4\n"
+        "1 0 obj\n"
+        "<</S /JavaScript /JS 2 0 R>>\n"
+        "endobj\n"
+        "2 0 obj\n"
+        "<</Length " + std::to_string(zlen) + " /Filter /FlateDecode>>\n"
+        "stream\n" + z + "\n"
+        "endstream\n"
+        "endobj\n"
+        "%%EOF\n";
+}
+
+static std::string extract_pdf(const std::string& pdf, unsigned pdu_len)
+{
+    PDFOffloadState* state = PDFOffload::create();
+    std::string js;
+
+    for ( unsigned off = 0; off < pdf.size(); off += pdu_len )
+    {
+        unsigned len = std::min(pdu_len, (unsigned)pdf.size() - off);
+        bool end = off + len == pdf.size();
+        PDFOffload::update(state, (const uint8_t*)pdf.data() + off, len, end);
+
+        uint8_t* buf;
+        uint32_t buf_len;
+        PDFOffload::take(state, buf, buf_len);
+
+        if ( buf )
+        {
+            js.append((const char*)buf, buf_len);
+            delete[] buf;
+        }
+    }
+
+    PDFOffload::release(state);
+    return js;
+}
+
+TEST_CASE("compressed script is extracted", "[pdf_offload]")
+{
+    const std::string script(5000, 'a');
+    const std::string pdf = make_pdf("var x = '" + script + "';");
+
+    PDFOffload::init(2, 0, 0);
+
+    SECTION("whole file")
+    {
+        CHECK(extract_pdf(pdf, pdf.size()) == "var x = '" + script + "';\n");
+    }
+    SECTION("small PDUs")
+    {
+        CHECK(extract_pdf(pdf, 100) == "var x = '" + script + "';\n");
+    }
+
+    PDFOffload::exit();
+}
+
+TEST_CASE("depth limit", "[pdf_offload]")
+{
+    const std::string pdf = make_pdf("var x = 1;");
+
+    PDFOffload::init(1, 64, 0);
+    CHECK(extract_pdf(pdf, 32).empty());
+    PDFOffload::exit();
+}
+
+TEST_CASE("script in the last PDU", "[pdf_offload]")
+{
+    const std::string pdf = make_pdf("var x = 1;");
+    const unsigned head_len = strlen("%PDF-1.4\n");
+
+    // the first PDU has only the header and the last one the whole script
+    PDFOffload::init(1, 0, 0);
+
+    PDFOffloadState* state = PDFOffload::create();
+    uint8_t* buf;
+    uint32_t buf_len;
+
+    PDFOffload::update(state, (const uint8_t*)pdf.data(), head_len, false);
+    PDFOffload::take(state, buf, buf_len);
+    CHECK(!buf);
+
+    PDFOffload::update(state, (const uint8_t*)pdf.data() + head_len, pdf.size() - head_len, true);
+    PDFOffload::take(state, buf, buf_len);
+
+    REQUIRE(buf);
+    CHECK(std::string((const char*)buf, buf_len) == "var x = 1;\n");
+    delete[] buf;
+
+    PDFOffload::release(state);
+    PDFOffload::exit();
+}
+
+TEST_CASE("single PDU file is extracted without waiting", "[pdf_offload]")
+{
+    const std::string pdf = make_pdf("var x = 1;");
+    PDFOffload::init(1, 0, 0);
+
+    PegCount waits = file_counts.pdf_offload_waits;
+    PegCount inline_files = file_counts.pdf_offload_inline;
+
+    CHECK(extract_pdf(pdf, pdf.size()) == "var x = 1;\n");
+    CHECK(file_counts.pdf_offload_waits == waits);
+    CHECK(file_counts.pdf_offload_inline == inline_files + 1);
+
+    PDFOffload::exit();
+}
+
+TEST_CASE("end of file extracts the queued PDUs", "[pdf_offload]")
+{
+    const std::string script(5000, 'a');
+    const std::string pdf = make_pdf("var x = '" + script + "';");
+    const unsigned pdu_len = 100;
+    PDFOffload::init(1, 0, 0);
+
+    // nothing is taken before the end, so the script of every PDU the
+    // helper has not reached is extracted on this thread
+    PDFOffloadState* state = PDFOffload::create();
+    unsigned off = 0;
+
+    for ( ; off + pdu_len < pdf.size(); off += pdu_len )
+        PDFOffload::update(state, (const uint8_t*)pdf.data() + off, pdu_len, false);
+
+    PegCount inline_pdus = file_counts.pdf_offload_inline;
+    PDFOffload::update(state, (const uint8_t*)pdf.data() + off, pdf.size() - off, true);
+    CHECK(file_counts.pdf_offload_inline > inline_pdus);
+
+    uint8_t* buf;
+    uint32_t buf_len;
+    PDFOffload::take(state, buf, buf_len);
+
+    REQUIRE(buf);
+    CHECK(std::string((const char*)buf, buf_len) == "var x = '" + script + "';\n");
+    delete[] buf;
+
+    PDFOffload::release(state);
+    PDFOffload::exit();
+}
+
+TEST_CASE("release with queued PDUs", "[pdf_offload]")
+{
+    const std::string pdf = make_pdf("var x = 1;");
+    PDFOffload::init(1, 0, 0);
+
+    PDFOffloadState* state = PDFOffload::create();
+    for ( int i = 0; i < 64; ++i )
+        PDFOffload::update(state, (const uint8_t*)pdf.data(), pdf.size(), false);
+    PDFOffload::release(state);
+
+    PDFOffload::exit();
+    CHECK(!PDFOffload::is_enabled());
+}
+#endif
+
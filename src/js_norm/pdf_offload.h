@@ -0,0 +1,69 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2023-2023 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// pdf_offload.h
+
+#ifndef PDF_OFFLOAD_H
+#define PDF_OFFLOAD_H
+
+// PDFOffload inflates the streams of PDF files and extracts their
+// JavaScript on helper threads, leaving the packet thread to copy the PDU
+// and normalize what was extracted.  Each PDF owns a PDFOffloadState which
+// is held by at most one helper at a time, so the PDUs of a file are
+// processed in order while different files are processed in parallel.
+// Extracted script is returned on a later PDU of the file.  On the PDU that
+// ends the file the packet thread takes the file back from the helpers and
+// extracts what they have not, so all of the script is returned by then.
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+class PDFOffloadState;
+
+class PDFOffload
+{
+public:
+    // these must be called during snort init and exit; depth is in bytes
+    // and time in milliseconds of extraction time per file, 0 is unlimited
+    static void init(unsigned num_threads, uint64_t depth, uint32_t time);
+    static void exit();
+
+    static bool is_enabled() { return !workers.empty(); }
+
+    static PDFOffloadState* create();
+
+    // queue a copy of the PDU; dropped once the file is over its limits;
+    // the PDU that ends the file is extracted by the caller along with any
+    // PDUs still queued, after waiting for a helper already working on them
+    static void update(PDFOffloadState*, const uint8_t* data, unsigned len, bool end);
+
+    // take the script extracted so far; the caller owns the buffer,
+    // nullptr if there is none
+    static void take(PDFOffloadState*, uint8_t*& js, uint32_t& len);
+
+    // discard any queued PDUs and free the state
+    static void release(PDFOffloadState*);
+
+private:
+    static void worker();
+
+    static std::vector<std::thread*> workers;
+};
+
+#endif
+
@@ -0,0 +1,250 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2023-2023 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// alert_store.h
+
+#ifndef ALERT_STORE_H
+#define ALERT_STORE_H
+
+// Alert store segment format shared by the alert_store logger and the
+// alert_store_query tool.  A segment is one file holding a bounded number of
+// events.  It is written once, when sealed, and laid out to be used in place
+// with mmap:
+//
+//     header | columns | indexes | snippets
+//
+// Each column holds one value per event in arrival order.  Each index is the
+// event numbers sorted by a key so a reader can binary search it instead of
+// scanning the columns.  Integers are in host order; readers check the
+// endian field.  Every section starts on an 8 byte boundary.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace AlertStore
+{
+static const char magic[8] = { 'S', 'N', 'O', 'R', 'T', 'A', 'S', 'T' };
+static const uint32_t version = 1;
+static const uint32_t endian = 0x01020304;
+
+enum Section
+{
+    SEC_SECONDS,        // uint32_t
+    SEC_USECONDS,       // uint32_t
+    SEC_EVENT_ID,       // uint32_t
+    SEC_GID,            // uint32_t
+    SEC_SID,            // uint32_t
+    SEC_REV,            // uint32_t
+    SEC_SRC_ADDR,       // uint32_t[4]; ip4 is mapped into ip6 as with SfIp
+    SEC_DST_ADDR,       // uint32_t[4]
+    SEC_SRC_PORT,       // uint16_t; icmp type
+    SEC_DST_PORT,       // uint16_t; icmp code
+    SEC_PROTO,          // uint8_t
+    SEC_ACTION,         // uint8_t; Active::ActiveActionType
+    SEC_FLOW_HASH,      // uint32_t; see flow_hash()
+    SEC_SNIP_OFF,       // uint32_t; offset into SEC_SNIPPETS
+    SEC_SNIP_LEN,       // uint16_t
+    SEC_TIME_IDX,       // uint32_t; event numbers by seconds, useconds
+    SEC_SID_IDX,        // uint32_t; event numbers by sid, gid
+    SEC_FLOW_IDX,       // uint32_t; event numbers by flow hash
+    SEC_SNIPPETS,       // uint8_t; packet data from the start of the payload
+    SEC_MAX
+};
+
+// bytes per event in each section; snippets vary
+static const uint8_t element_size[SEC_MAX] =
+{ 4, 4, 4, 4, 4, 4, 16, 16, 2, 2, 1, 1, 4, 4, 2, 4, 4, 4, 0 };
+
+struct SectionInfo
+{
+    uint64_t offset;    // from the start of the file
+    uint64_t length;    // in bytes
+};
+
+struct Header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t endian;
+    uint32_t count;
+    uint32_t min_seconds;
+    uint32_t max_seconds;
+    uint32_t reserved;
+    SectionInfo sections[SEC_MAX];
+};
+
+// a segment mapped by a reader; nothing else may be used unless valid()
+// passes since the file may be truncated or corrupt
+struct Segment
+{
+    const uint8_t* base;
+    const Header* hdr;
+    size_t size;
+
+    template<typename T>
+    const T* get(Section s) const
+    { return (const T*)(base + hdr->sections[s].offset); }
+
+    bool valid() const;
+
+    // the range of an index holding the events with the given key
+    void find_sid(uint32_t sid, const uint32_t*& lo, const uint32_t*& hi) const;
+    void find_flow(uint32_t hash, const uint32_t*& lo, const uint32_t*& hi) const;
+    void find_time(const uint32_t* from, const uint32_t* to,
+        const uint32_t*& lo, const uint32_t*& hi) const;
+
+    // nullptr if the snippet is not within the snippet section
+    const uint8_t* get_snippet(uint32_t i, uint16_t& len) const;
+};
+
+inline bool Segment::valid() const
+{
+    if ( size < sizeof(*hdr) or memcmp(hdr->magic, magic, sizeof(magic)) )
+        return false;
+
+    if ( hdr->version != version or hdr->endian != endian )
+        return false;
+
+    for ( unsigned i = 0; i < SEC_MAX; ++i )
+    {
+        const SectionInfo& sec = hdr->sections[i];
+
+        if ( sec.offset % 8 or sec.offset > size or sec.length > size - sec.offset )
+            return false;
+
+        if ( sec.length < (uint64_t)hdr->count * element_size[i] )
+            return false;
+    }
+
+    // index entries are used to subscript the columns
+    for ( Section idx : { SEC_TIME_IDX, SEC_SID_IDX, SEC_FLOW_IDX } )
+    {
+        const uint32_t* p = get<uint32_t>(idx);
+
+        for ( uint32_t i = 0; i < hdr->count; ++i )
+            if ( p[i] >= hdr->count )
+                return false;
+    }
+    return true;
+}
+
+inline void Segment::find_sid(uint32_t key, const uint32_t*& lo, const uint32_t*& hi) const
+{
+    const uint32_t* sid = get<uint32_t>(SEC_SID);
+    const uint32_t* idx = get<uint32_t>(SEC_SID_IDX);
+    uint32_t n = hdr->count;
+
+    lo = std::lower_bound(idx, idx + n, key,
+        [sid](uint32_t i, uint32_t v) { return sid[i] < v; });
+    hi = std::upper_bound(lo, idx + n, key,
+        [sid](uint32_t v, uint32_t i) { return v < sid[i]; });
+}
+
+inline void Segment::find_flow(uint32_t key, const uint32_t*& lo, const uint32_t*& hi) const
+{
+    const uint32_t* fh = get<uint32_t>(SEC_FLOW_HASH);
+    const uint32_t* idx = get<uint32_t>(SEC_FLOW_IDX);
+    uint32_t n = hdr->count;
+
+    lo = std::lower_bound(idx, idx + n, key,
+        [fh](uint32_t i, uint32_t v) { return fh[i] < v; });
+    hi = std::upper_bound(lo, idx + n, key,
+        [fh](uint32_t v, uint32_t i) { return v < fh[i]; });
+}
+
+// from and to are inclusive and either may be null for no limit
+inline void Segment::find_time(const uint32_t* from, const uint32_t* to,
+    const uint32_t*& lo, const uint32_t*& hi) const
+{
+    const uint32_t* sec = get<uint32_t>(SEC_SECONDS);
+    const uint32_t* idx = get<uint32_t>(SEC_TIME_IDX);
+    uint32_t n = hdr->count;
+
+    lo = idx;
+    hi = idx + n;
+
+    if ( from )
+        lo = std::lower_bound(idx, idx + n, *from,
+            [sec](uint32_t i, uint32_t v) { return sec[i] < v; });
+
+    if ( to )
+        hi = std::upper_bound(lo, idx + n, *to,
+            [sec](uint32_t v, uint32_t i) { return v < sec[i]; });
+}
+
+inline const uint8_t* Segment::get_snippet(uint32_t i, uint16_t& len) const
+{
+    uint64_t off = get<uint32_t>(SEC_SNIP_OFF)[i];
+    len = get<uint16_t>(SEC_SNIP_LEN)[i];
+
+    if ( off + len > hdr->sections[SEC_SNIPPETS].length )
+    {
+        len = 0;
+        return nullptr;
+    }
+    return get<uint8_t>(SEC_SNIPPETS) + off;
+}
+
+// both directions of a flow get the same hash so a query can give the
+// addresses and ports in either order
+inline uint32_t flow_hash(
+    const uint32_t* a, uint16_t ap, const uint32_t* b, uint16_t bp, uint8_t proto)
+{
+    bool swap = false;
+
+    for ( int i = 0; i < 4; ++i )
+    {
+        if ( a[i] != b[i] )
+        {
+            swap = a[i] > b[i];
+            break;
+        }
+        if ( i == 3 )
+            swap = ap > bp;
+    }
+
+    if ( swap )
+    {
+        const uint32_t* t = a;
+        a = b;
+        b = t;
+
+        uint16_t tp = ap;
+        ap = bp;
+        bp = tp;
+    }
+
+    // fnv-1a over the words
+    uint32_t h = 2166136261u;
+
+    for ( int i = 0; i < 4; ++i )
+        h = (h ^ a[i]) * 16777619u;
+
+    for ( int i = 0; i < 4; ++i )
+        h = (h ^ b[i]) * 16777619u;
+
+    h = (h ^ (((uint32_t)ap << 16) | bp)) * 16777619u;
+    h = (h ^ proto) * 16777619u;
+
+    return h;
+}
+}
+
+#endif
+
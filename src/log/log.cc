@@ -70,13 +70,18 @@ void CreateTCPFlagString(const tcp::TCPHdr* const tcph, char* flagBuffer)
  ***************************************************************************/
 FILE* OpenAlertFile(const char* filearg)
 {
-    FILE* file;
-
     if ( !filearg )
         filearg = "alert.txt";
 
     std::string name;
-    const char* filename = get_instance_file(name, filearg);
+    return OpenAlertPath(get_instance_file(name, filearg));
+}
+
+// as above but the path is already resolved; this doesn't depend on the
+// calling thread so it can be used by the log writer thread
+FILE* OpenAlertPath(const char* filename)
+{
+    FILE* file;
 
     if ((file = fopen(filename, "a")) == nullptr)
     {
@@ -102,15 +107,18 @@ FILE* OpenAlertFile(const char* filearg)
  ***************************************************************************/
 int RollAlertFile(const char* filearg)
 {
-    char newname[STD_BUF+1];
-    time_t now = time(nullptr);
-
     if ( !filearg )
         filearg = "alert.txt";
 
     std::string name;
     get_instance_file(name, filearg);
-    const char* oldname = name.c_str();
+    return RollAlertPath(name.c_str());
+}
+
+int RollAlertPath(const char* oldname)
+{
+    char newname[STD_BUF+1];
+    time_t now = time(nullptr);
 
     SnortSnprintf(newname, sizeof(newname)-1, "%s.%lu", oldname, (unsigned long)now);
 
@@ -36,6 +36,10 @@ SO_PUBLIC void CreateTCPFlagString(const tcp::TCPHdr* const, char*);
 FILE* OpenAlertFile(const char*);
 int RollAlertFile(const char*);
 
+// for paths already resolved with get_instance_file()
+FILE* OpenAlertPath(const char*);
+int RollAlertPath(const char*);
+
 void OpenLogger();
 void CloseLogger();
 void LogIPPkt(snort::Packet*);
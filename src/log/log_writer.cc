@@ -0,0 +1,361 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2023-2023 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// log_writer.cc
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "log_writer.h"
+
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <thread>
+
+#include "time/packet_time.h"
+#include "utils/util.h"
+
+namespace snort
+{
+THREAD_LOCAL LogQueueStats log_queue_stats;
+
+// queues with a handoff created on this thread
+static THREAD_LOCAL std::vector<LogQueue*>* thread_producers = nullptr;
+static THREAD_LOCAL time_t last_check = 0;
+
+const PegInfo log_queue_pegs[] =
+{
+    { CountType::SUM, "log_buffers", "log buffers queued for the writer thread" },
+    { CountType::MAX, "log_queue_max", "maximum log buffers waiting to be written" },
+    { CountType::SUM, "log_waits", "times a full log queue was waited on" },
+    { CountType::SUM, "log_drops", "log buffers dropped from a full queue" },
+    { CountType::END, nullptr, nullptr }
+};
+
+//--------------------------------------------------------------------------
+// writer thread
+//--------------------------------------------------------------------------
+
+// The thread runs while any queue exists.  queues_mutex is held while a pass
+// writes so a queue can't be removed from under it; producers only take
+// signal_mutex to wake it.  A pass also runs each second without a signal
+// to tick the sinks.
+class LogWriter
+{
+public:
+    static void add(LogQueue*);
+    static void remove(LogQueue*);
+    static void notify();
+
+private:
+    static void run();
+    static void write(LogQueue*);
+
+    static std::mutex life_mutex;
+    static std::mutex queues_mutex;
+    static std::mutex signal_mutex;
+    static std::condition_variable signal;
+    static std::vector<LogQueue*> queues;
+    static std::thread* thread;
+    static bool signaled;
+    static bool stop;
+};
+
+std::mutex LogWriter::life_mutex;
+std::mutex LogWriter::queues_mutex;
+std::mutex LogWriter::signal_mutex;
+std::condition_variable LogWriter::signal;
+std::vector<LogQueue*> LogWriter::queues;
+std::thread* LogWriter::thread = nullptr;
+bool LogWriter::signaled = false;
+bool LogWriter::stop = false;
+
+void LogWriter::add(LogQueue* q)
+{
+    std::lock_guard<std::mutex> life(life_mutex);
+    {
+        std::lock_guard<std::mutex> lk(queues_mutex);
+        queues.emplace_back(q);
+    }
+
+    if ( !thread )
+    {
+        stop = false;
+        thread = new std::thread(run);
+    }
+}
+
+void LogWriter::remove(LogQueue* q)
+{
+    std::lock_guard<std::mutex> life(life_mutex);
+    bool last;
+    {
+        std::lock_guard<std::mutex> lk(queues_mutex);
+        queues.erase(std::remove(queues.begin(), queues.end(), q), queues.end());
+        last = queues.empty();
+    }
+
+    if ( !last or !thread )
+        return;
+
+    {
+        std::lock_guard<std::mutex> lk(signal_mutex);
+        stop = true;
+    }
+    signal.notify_one();
+
+    thread->join();
+    delete thread;
+    thread = nullptr;
+}
+
+void LogWriter::notify()
+{
+    {
+        std::lock_guard<std::mutex> lk(signal_mutex);
+        signaled = true;
+    }
+    signal.notify_one();
+}
+
+void LogWriter::run()
+{
+    time_t last_tick = time(nullptr);
+
+    while ( true )
+    {
+        {
+            std::unique_lock<std::mutex> lk(signal_mutex);
+            signal.wait_for(lk, std::chrono::seconds(1), [] { return signaled or stop; });
+
+            if ( stop )
+                break;
+
+            signaled = false;
+        }
+
+        time_t now = time(nullptr);
+        bool tick = (now != last_tick);
+        last_tick = now;
+
+        std::lock_guard<std::mutex> lk(queues_mutex);
+
+        for ( auto* q : queues )
+        {
+            write(q);
+
+            if ( tick )
+                q->sink->tick(now);
+        }
+    }
+}
+
+void LogWriter::write(LogQueue* q)
+{
+    std::unique_lock<std::mutex> lk(q->mutex);
+
+    if ( q->pending.empty() )
+        return;
+
+    q->writing = true;
+
+    while ( !q->pending.empty() )
+    {
+        LogQueue::Pending p = q->pending.front();
+        q->pending.pop_front();
+        lk.unlock();
+
+        q->sink->write(p.buf, p.len);
+
+        lk.lock();
+        q->free_bufs.emplace_back(p.buf);
+        q->space.notify_all();
+    }
+
+    lk.unlock();
+    q->sink->flush();
+
+    lk.lock();
+    q->writing = false;
+    q->space.notify_all();
+}
+
+//--------------------------------------------------------------------------
+// queue
+//--------------------------------------------------------------------------
+
+LogQueue::LogQueue(LogSink* s, unsigned depth, size_t size, bool drop,
+    std::function<void()> h) : sink(s), buf_size(size), drop_oldest(drop), handoff(std::move(h))
+{
+    assert(depth);
+
+    for ( unsigned i = 0; i < depth; ++i )
+        free_bufs.emplace_back((char*)snort_alloc(buf_size));
+
+    last_swap = time(nullptr);
+
+    if ( handoff )
+    {
+        if ( !thread_producers )
+            thread_producers = new std::vector<LogQueue*>;
+
+        producers = thread_producers;
+        producers->emplace_back(this);
+    }
+
+    LogWriter::add(this);
+}
+
+LogQueue::~LogQueue()
+{
+    if ( producers )
+    {
+        producers->erase(std::remove(producers->begin(), producers->end(), this),
+            producers->end());
+
+        if ( producers->empty() and producers == thread_producers )
+        {
+            delete thread_producers;
+            thread_producers = nullptr;
+        }
+    }
+
+    drain();
+    LogWriter::remove(this);
+
+    for ( auto* buf : free_bufs )
+        snort_free(buf);
+}
+
+char* LogQueue::swap(char* buf, size_t len)
+{
+    std::unique_lock<std::mutex> lk(mutex);
+
+    if ( free_bufs.empty() )
+    {
+        if ( drop_oldest and !pending.empty() )
+        {
+            free_bufs.emplace_back(pending.front().buf);
+            pending.pop_front();
+            log_queue_stats.drops++;
+        }
+        else
+        {
+            log_queue_stats.waits++;
+            space.wait(lk, [this] { return !free_bufs.empty(); });
+        }
+    }
+
+    char* next = free_bufs.back();
+    free_bufs.pop_back();
+
+    pending.push_back({ buf, len });
+    log_queue_stats.buffers++;
+    last_swap = time(nullptr);
+
+    if ( pending.size() > log_queue_stats.max_depth )
+        log_queue_stats.max_depth = pending.size();
+
+    lk.unlock();
+    LogWriter::notify();
+
+    return next;
+}
+
+void LogQueue::handoff_stale()
+{
+    if ( !thread_producers )
+        return;
+
+    time_t t = packet_time();
+
+    if ( t == last_check )
+        return;
+
+    last_check = t;
+    time_t now = time(nullptr);
+
+    for ( auto* q : *thread_producers )
+    {
+        if ( q->stale(now) )
+            q->handoff();
+    }
+}
+
+void LogQueue::drain()
+{
+    std::unique_lock<std::mutex> lk(mutex);
+
+    if ( pending.empty() and !writing )
+        return;
+
+    lk.unlock();
+    LogWriter::notify();
+
+    lk.lock();
+    space.wait(lk, [this] { return pending.empty() and !writing; });
+}
+
+//--------------------------------------------------------------------------
+// sink helpers
+//--------------------------------------------------------------------------
+
+int log_write(int fd, const char* buf, size_t len)
+{
+    iovec iov = { const_cast<char*>(buf), len };
+    return log_write(fd, &iov, 1);
+}
+
+int log_write(int fd, iovec* iov, int cnt)
+{
+    unsigned retries = log_write_retries;
+
+    while ( cnt )
+    {
+        ssize_t n = writev(fd, iov, std::min(cnt, IOV_MAX));
+
+        if ( n < 0 )
+        {
+            if ( errno == EINTR and retries-- > 0 )
+                continue;
+
+            return errno;
+        }
+        retries = log_write_retries;
+
+        while ( cnt and (size_t)n >= iov->iov_len )
+        {
+            n -= iov->iov_len;
+            ++iov;
+            --cnt;
+        }
+
+        if ( cnt )
+        {
+            iov->iov_base = (uint8_t*)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return 0;
+}
+}
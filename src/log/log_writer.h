@@ -0,0 +1,136 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2023-2023 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// log_writer.h
+
+#ifndef LOG_WRITER_H
+#define LOG_WRITER_H
+
+// LogQueue moves log file I/O off the thread that formats the records.  The
+// thread fills a buffer and swaps it for an empty one; a single writer
+// thread shared by all queues hands the full buffers to the queue's LogSink
+// in order.  Each queue owns a fixed number of buffers.  When all are
+// waiting to be written, the thread either waits for the writer or takes
+// back the oldest, dropping its records.
+//
+// Producers that hold a partial buffer give the queue a handoff function.
+// Packet threads call LogQueue::handoff_stale() as they run and when idle so
+// a partial buffer is swapped within about a second even if no more records
+// arrive.  The writer thread likewise ticks each sink about once a second so
+// sinks can apply their own time limits.
+
+#include <condition_variable>
+#include <ctime>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "framework/counts.h"
+#include "main/snort_types.h"
+#include "main/thread.h"
+
+struct iovec;
+
+namespace snort
+{
+class SO_PUBLIC LogSink
+{
+public:
+    virtual ~LogSink() = default;
+
+    // these are called on the writer thread only
+    virtual void write(const char*, size_t) = 0;
+    virtual void flush() { }
+    virtual void tick(time_t /* now */) { }
+};
+
+// for sinks writing to a plain fd: these return 0 or errno.  Partial writes
+// are continued where they left off, and iov is updated as they are.  EINTR
+// is retried, but if it happens log_write_retries times in a row EINTR is
+// returned.
+constexpr unsigned log_write_retries = 3;
+
+SO_PUBLIC int log_write(int fd, const char*, size_t);
+SO_PUBLIC int log_write(int fd, iovec*, int cnt);
+
+class SO_PUBLIC LogQueue
+{
+public:
+    // depth is the number of buffers queued; the caller holds one more.
+    // handoff is called on this thread to swap a partial buffer once the
+    // queue is stale.
+    LogQueue(LogSink*, unsigned depth, size_t buf_size, bool drop_oldest,
+        std::function<void()> handoff = nullptr);
+
+    // waits for everything queued to be written; doesn't delete the sink
+    ~LogQueue();
+
+    // returns an empty buffer of buf_size in exchange for buf
+    char* swap(char* buf, size_t len);
+
+    // waits for everything queued to be written
+    void drain();
+
+    // true if nothing has been swapped for a second
+    bool stale(time_t now) const
+    { return now - last_swap >= 1; }
+
+    // runs the handoff of this thread's stale queues; called by packet
+    // threads for each packet and when idle, so it checks at most once a
+    // second of packet time
+    static void handoff_stale();
+
+private:
+    friend class LogWriter;
+
+    struct Pending
+    {
+        char* buf;
+        size_t len;
+    };
+
+    LogSink* sink;
+    size_t buf_size;
+    bool drop_oldest;
+    bool writing = false;
+
+    // these are only used on the thread that created the queue
+    std::function<void()> handoff;
+    std::vector<LogQueue*>* producers = nullptr;
+    time_t last_swap;
+
+    std::mutex mutex;
+    std::condition_variable space;
+    std::deque<Pending> pending;
+    std::vector<char*> free_bufs;
+};
+
+struct LogQueueStats
+{
+    PegCount buffers;
+    PegCount max_depth;
+    PegCount waits;
+    PegCount drops;
+};
+
+extern THREAD_LOCAL LogQueueStats log_queue_stats;
+extern const PegInfo log_queue_pegs[];
+}
+
+#endif
+
@@ -36,10 +36,13 @@
 
 #include <algorithm>
 #include <cstdarg>
+#include <string>
 
+#include "main/snort_config.h"
 #include "utils/util.h"
 
 #include "log.h"
+#include "log_writer.h"
 
 using namespace snort;
 
@@ -47,27 +50,51 @@ using namespace snort;
 #define MIN_BUF  (4* K_BYTES)
 #define STDLOG_FILENO 3
 
-struct TextLog
+/*-------------------------------------------------------------------
+ * TextLogFile: the file end of the log; this runs on the packet
+ * thread or, if the log is queued, on the writer thread
+ *-------------------------------------------------------------------
+ */
+class TextLogFile : public LogSink
 {
-/* private:
-   file attributes: */
+public:
+    TextLogFile(const char* name, size_t maxFile);
+    ~TextLogFile() override;
+
+    void write(const char*, size_t) override;
+    void flush() override;
+
+    bool is_stdout() const
+    { return path.empty(); }
+
+    bool ok = true;
+
+private:
+    void roll();
+
     FILE* file;
-    char* name;
+    std::string path;   // resolved at init; empty for stdout
     size_t size;
     size_t maxFile;
     time_t last;
+};
+
+struct TextLog
+{
+    TextLogFile* file;
+    LogQueue* queue;
 
 /* buffer attributes: */
     unsigned int pos;
     unsigned int maxBuf;
-    char buf[1];
+    char* buf;
 };
 
 /*-------------------------------------------------------------------
  * TextLog_Open/Close: open/close associated log file
  *-------------------------------------------------------------------
  */
-static FILE* TextLog_Open(const char* name)
+static FILE* TextLog_Open(const char* name, std::string& path)
 {
     if ( name && !strcasecmp(name, "stdout") )
     {
@@ -79,7 +106,11 @@ static FILE* TextLog_Open(const char* name)
 #endif
     }
 
-    return OpenAlertFile(name);
+    if ( !name )
+        name = "alert.txt";
+
+    get_instance_file(path, name);
+    return OpenAlertPath(path.c_str());
 }
 
 static void TextLog_Close(FILE* file)
@@ -98,6 +129,55 @@ static size_t TextLog_Size(FILE* file)
     return err ? 0 : sbuf.st_size;
 }
 
+TextLogFile::TextLogFile(const char* name, size_t max) : maxFile(max)
+{
+    file = TextLog_Open(name, path);
+    size = TextLog_Size(file);
+    last = time(nullptr);
+}
+
+TextLogFile::~TextLogFile()
+{
+    TextLog_Close(file);
+}
+
+/*-------------------------------------------------------------------
+ * TextLogFile::roll: start writing to new file
+ * but don't roll over stdout or any sooner
+ * than resolution of filename discriminator
+ *-------------------------------------------------------------------
+ */
+void TextLogFile::roll()
+{
+    if ( is_stdout() )
+        return;
+    if ( last >= time(nullptr) )
+        return;
+
+    TextLog_Close(file);
+    RollAlertPath(path.c_str());
+    file = OpenAlertPath(path.c_str());
+
+    last = time(nullptr);
+    size = 0;
+}
+
+void TextLogFile::write(const char* buf, size_t len)
+{
+    if ( maxFile and size + len > maxFile )
+        roll();
+
+    ok = fwrite(buf, len, 1, file) == 1;
+
+    if ( ok )
+        size += len;
+}
+
+void TextLogFile::flush()
+{
+    fflush(file);
+}
+
 namespace snort
 {
 int TextLog_Avail(TextLog* const txt)
@@ -111,6 +191,20 @@ void TextLog_Reset(TextLog* const txt)
     txt->buf[txt->pos] = '\0';
 }
 
+/*-------------------------------------------------------------------
+ * TextLog_Handoff: queue the buffer for the writer thread
+ *-------------------------------------------------------------------
+ */
+static bool TextLog_Handoff(TextLog* const txt)
+{
+    if ( !txt->queue or !txt->pos )
+        return false;
+
+    txt->buf = txt->queue->swap(txt->buf, txt->pos);
+    TextLog_Reset(txt);
+    return true;
+}
+
 /*-------------------------------------------------------------------
  * TextLog_Init: constructor
  *-------------------------------------------------------------------
@@ -118,22 +212,25 @@ void TextLog_Reset(TextLog* const txt)
 TextLog* TextLog_Init(
     const char* name, unsigned int maxBuf, size_t maxFile)
 {
-    TextLog* txt;
-
     if ( maxBuf < MIN_BUF )
         maxBuf = MIN_BUF;
 
-    txt = (TextLog*)snort_alloc(sizeof(TextLog)+maxBuf);
+    TextLog* txt = new TextLog;
 
-    txt->name = name ? snort_strdup(name) : nullptr;
-    txt->file = TextLog_Open(txt->name);
-    txt->size = TextLog_Size(txt->file);
-    txt->last = time(nullptr);
-    txt->maxFile = maxFile;
+    txt->file = new TextLogFile(name, maxFile);
+    txt->queue = nullptr;
 
     txt->maxBuf = maxBuf;
+    txt->buf = (char*)snort_alloc(maxBuf);
     TextLog_Reset(txt);
 
+    // stdout is shared with other output so it stays synchronous
+    const SnortConfig* sc = SnortConfig::get_conf();
+
+    if ( sc and sc->log_buffers and !txt->file->is_stdout() )
+        txt->queue = new LogQueue(txt->file, sc->log_buffers, maxBuf, sc->log_drop_oldest,
+            [txt]() { TextLog_Handoff(txt); });
+
     return txt;
 }
 
@@ -146,60 +243,62 @@ void TextLog_Term(TextLog* const txt)
     if ( !txt )
         return;
 
-    TextLog_Flush(txt);
-    TextLog_Close(txt->file);
-
-    if ( txt->name )
-        snort_free(txt->name);
-    snort_free(txt);
-}
-
-/*-------------------------------------------------------------------
- * TextLog_Flush: start writing to new file
- * but don't roll over stdout or any sooner
- * than resolution of filename discriminator
- *-------------------------------------------------------------------
- */
-static void TextLog_Roll(TextLog* const txt)
-{
-    if ( txt->file == stdout )
-        return;
-    if ( txt->last >= time(nullptr) )
-        return;
-
-    TextLog_Close(txt->file);
-    RollAlertFile(txt->name);
-    txt->file = TextLog_Open(txt->name);
+    if ( txt->queue )
+    {
+        TextLog_Handoff(txt);
+        delete txt->queue;  // waits for the writer
+    }
+    else
+        TextLog_Flush(txt);
 
-    txt->last = time(nullptr);
-    txt->size = 0;
+    delete txt->file;
+    snort_free(txt->buf);
+    delete txt;
 }
 
 /*-------------------------------------------------------------------
  * TextLog_Flush: write buffered stream to file
+ * with a queue, the buffer is handed off when it is half full or
+ * the queue is stale so loggers that flush every event don't queue
+ * a buffer per event; the packet thread hands off a stale partial
+ * buffer if no more events come
  *-------------------------------------------------------------------
  */
 bool TextLog_Flush(TextLog* const txt)
 {
-    int ok;
-
     if ( !txt->pos )
         return false;
 
-    if ( txt->maxFile and txt->size + txt->pos > txt->maxFile )
-        TextLog_Roll(txt);
+    if ( txt->queue )
+    {
+        if ( txt->pos < txt->maxBuf / 2 and !txt->queue->stale(time(nullptr)) )
+            return true;
+
+        return TextLog_Handoff(txt);
+    }
 
-    ok = fwrite(txt->buf, txt->pos, 1, txt->file);
+    txt->file->write(txt->buf, txt->pos);
 
-    if ( ok == 1 )
+    if ( txt->file->ok )
     {
-        txt->size += txt->pos;
         TextLog_Reset(txt);
         return true;
     }
     return false;
 }
 
+/*-------------------------------------------------------------------
+ * TextLog_Full: make room in a full buffer
+ *-------------------------------------------------------------------
+ */
+static bool TextLog_Full(TextLog* const txt)
+{
+    if ( txt->queue )
+        return TextLog_Handoff(txt);
+
+    return TextLog_Flush(txt);
+}
+
 /*-------------------------------------------------------------------
  * TextLog_Putc: append char to buffer
  *-------------------------------------------------------------------
@@ -208,7 +307,7 @@ bool TextLog_Putc(TextLog* const txt, char c)
 {
     if ( TextLog_Avail(txt) < 1 )
     {
-        TextLog_Flush(txt);
+        TextLog_Full(txt);
     }
     txt->buf[txt->pos++] = c;
     txt->buf[txt->pos] = '\0';
@@ -222,25 +321,28 @@ bool TextLog_Putc(TextLog* const txt, char c)
  */
 bool TextLog_Write(TextLog* const txt, const char* str, int len)
 {
-    do
+    // like the %.*s this replaces, don't take a string with an embedded nul
+    if ( len > 0 and memchr(str, '\0', len) )
+        return false;
+
+    while ( len > 0 )
     {
         int avail = TextLog_Avail(txt);
-        int n = snprintf(txt->buf+txt->pos, avail, "%.*s", len, str);
-        if ( n < avail and n < len )
-            return false;
-
-        // actual bytes written:
-        // 1) if avail is a limit, auto-appended '\0' should be truncated
-        // 2) avail could be zero from the start, keep it as 0
-        int l = std::min(n, avail > 0 ? avail - 1 : 0);
-        txt->pos += l;
-        str += l;
-        len -= l;
-
-        if ( n >= avail )
-            TextLog_Flush(txt);
+
+        if ( avail <= 0 )
+        {
+            if ( !TextLog_Full(txt) )
+                return false;
+            continue;
+        }
+        int n = std::min(len, avail);
+        memcpy(txt->buf + txt->pos, str, n);
+
+        txt->pos += n;
+        str += n;
+        len -= n;
     }
-    while ( len > 0 );
+    txt->buf[txt->pos] = '\0';
 
     return true;
 }
@@ -261,7 +363,7 @@ bool TextLog_Print(TextLog* const txt, const char* fmt, ...)
 
     if ( len >= avail )
     {
-        TextLog_Flush(txt);
+        TextLog_Full(txt);
         avail = TextLog_Avail(txt);
 
         va_start(ap, fmt);
@@ -60,6 +60,101 @@ static THREAD_LOCAL TextLog* json_log;
 #define S_NAME "alert_json"
 #define F_NAME S_NAME ".txt"
 
+//-------------------------------------------------------------------------
+// output primitives
+// these append to json_log without going through printf
+//-------------------------------------------------------------------------
+
+// writes the decimal digits of n ending at end and returns the first
+static char* fmt_uint(char* end, uint64_t n)
+{
+    do
+    {
+        *--end = '0' + n % 10;
+        n /= 10;
+    }
+    while ( n );
+
+    return end;
+}
+
+static void put_uint(uint64_t n)
+{
+    char buf[20];
+    char* end = buf + sizeof(buf);
+    char* s = fmt_uint(end, n);
+    TextLog_Write(json_log, s, end - s);
+}
+
+static void put_int(int64_t n)
+{
+    if ( n < 0 )
+    {
+        TextLog_Putc(json_log, '-');
+        put_uint(0 - (uint64_t)n);
+    }
+    else
+        put_uint(n);
+}
+
+// writes the address without quotes; ip4 is formatted here and ip6 is left
+// to ntop
+static void put_addr(const SfIp* ip)
+{
+    if ( !ip->is_ip4() )
+    {
+        SfIpString ip_str;
+        TextLog_Puts(json_log, ip->ntop(ip_str));
+        return;
+    }
+    const uint8_t* b = (const uint8_t*)ip->get_ip4_ptr();
+    char buf[16];
+    char* end = buf + sizeof(buf);
+    char* s = end;
+
+    for ( int i = 3; i >= 0; --i )
+    {
+        s = fmt_uint(s, b[i]);
+
+        if ( i )
+            *--s = '.';
+    }
+    TextLog_Write(json_log, s, end - s);
+}
+
+// "addr:port"
+static void put_addr_port(const SfIp* ip, unsigned port)
+{
+    TextLog_Putc(json_log, '"');
+
+    if ( ip )
+        put_addr(ip);
+
+    TextLog_Putc(json_log, ':');
+    put_uint(port);
+    TextLog_Putc(json_log, '"');
+}
+
+static const char hex_digits[] = "0123456789ABCDEF";
+
+static void put_mac(const uint8_t* mac)
+{
+    char buf[19];
+    char* s = buf;
+    *s++ = '"';
+
+    for ( int i = 0; i < 6; ++i )
+    {
+        if ( i )
+            *s++ = ':';
+
+        *s++ = hex_digits[mac[i] >> 4];
+        *s++ = hex_digits[mac[i] & 0xF];
+    }
+    *s++ = '"';
+    TextLog_Write(json_log, buf, s - buf);
+}
+
 //-------------------------------------------------------------------------
 // field formatting functions
 //-------------------------------------------------------------------------
@@ -69,20 +164,18 @@ struct Args
     Packet* pkt;
     const char* msg;
     const Event& event;
-    bool comma;
+    const string* label;
 };
 
-static void print_label(const Args& a, const char* label)
+// the label is built with its leading comma when the fields are configured
+static void print_label(const Args& a)
 {
-    if ( a.comma )
-        TextLog_Print(json_log, ",");
-
-    TextLog_Print(json_log, " \"%s\" : ", label);
+    TextLog_Write(json_log, a.label->data(), a.label->size());
 }
 
 static bool ff_action(const Args& a)
 {
-    print_label(a, "action");
+    print_label(a);
     TextLog_Quote(json_log, a.pkt->active->get_action_string());
     return true;
 }
@@ -94,7 +187,7 @@ static bool ff_class(const Args& a)
     if ( a.event.sig_info->class_type and !a.event.sig_info->class_type->text.empty() )
         cls = a.event.sig_info->class_type->text.c_str();
 
-    print_label(a, "class");
+    print_label(a);
     TextLog_Quote(json_log, cls);
     return true;
 }
@@ -111,7 +204,7 @@ static bool ff_b64_data(const Args& a)
     unsigned nin = 0;
     Base64Encoder b64;
 
-    print_label(a, "b64_data");
+    print_label(a);
     TextLog_Putc(json_log, '"');
 
     while ( nin < a.pkt->dsize )
@@ -133,8 +226,8 @@ static bool ff_client_bytes(const Args& a)
 {
     if (a.pkt->flow)
     {
-        print_label(a, "client_bytes");
-        TextLog_Print(json_log, "%" PRIu64, a.pkt->flow->flowstats.client_bytes);
+        print_label(a);
+        put_uint(a.pkt->flow->flowstats.client_bytes);
         return true;
     }
     return false;
@@ -144,8 +237,8 @@ static bool ff_client_pkts(const Args& a)
 {
     if (a.pkt->flow)
     {
-        print_label(a, "client_pkts");
-        TextLog_Print(json_log, "%" PRIu64, a.pkt->flow->flowstats.client_pkts);
+        print_label(a);
+        put_uint(a.pkt->flow->flowstats.client_pkts);
         return true;
     }
     return false;
@@ -162,7 +255,7 @@ static bool ff_dir(const Args& a)
     else
         dir = "UNK";
 
-    print_label(a, "dir");
+    print_label(a);
     TextLog_Quote(json_log, dir);
     return true;
 }
@@ -171,9 +264,10 @@ static bool ff_dst_addr(const Args& a)
 {
     if ( a.pkt->has_ip() or a.pkt->is_data() )
     {
-        SfIpString ip_str;
-        print_label(a, "dst_addr");
-        TextLog_Quote(json_log, a.pkt->ptrs.ip_api.get_dst()->ntop(ip_str));
+        print_label(a);
+        TextLog_Putc(json_log, '"');
+        put_addr(a.pkt->ptrs.ip_api.get_dst());
+        TextLog_Putc(json_log, '"');
         return true;
     }
     return false;
@@ -181,17 +275,17 @@ static bool ff_dst_addr(const Args& a)
 
 static bool ff_dst_ap(const Args& a)
 {
-    SfIpString addr = "";
+    const SfIp* addr = nullptr;
     unsigned port = 0;
 
     if ( a.pkt->has_ip() or a.pkt->is_data() )
-        a.pkt->ptrs.ip_api.get_dst()->ntop(addr);
+        addr = a.pkt->ptrs.ip_api.get_dst();
 
     if ( a.pkt->proto_bits & (PROTO_BIT__TCP|PROTO_BIT__UDP) )
         port = a.pkt->ptrs.dp;
 
-    print_label(a, "dst_ap");
-    TextLog_Print(json_log, "\"%s:%u\"", addr, port);
+    print_label(a);
+    put_addr_port(addr, port);
     return true;
 }
 
@@ -199,8 +293,8 @@ static bool ff_dst_port(const Args& a)
 {
     if ( a.pkt->proto_bits & (PROTO_BIT__TCP|PROTO_BIT__UDP) )
     {
-        print_label(a, "dst_port");
-        TextLog_Print(json_log, "%u", a.pkt->ptrs.dp);
+        print_label(a);
+        put_uint(a.pkt->ptrs.dp);
         return true;
     }
     return false;
@@ -211,12 +305,10 @@ static bool ff_eth_dst(const Args& a)
     if ( !(a.pkt->proto_bits & PROTO_BIT__ETH) )
         return false;
 
-    print_label(a, "eth_dst");
+    print_label(a);
     const eth::EtherHdr* eh = layer::get_eth_layer(a.pkt);
 
-    TextLog_Print(json_log, "\"%02X:%02X:%02X:%02X:%02X:%02X\"", eh->ether_dst[0],
-        eh->ether_dst[1], eh->ether_dst[2], eh->ether_dst[3],
-        eh->ether_dst[4], eh->ether_dst[5]);
+    put_mac(eh->ether_dst);
 
     return true;
 }
@@ -226,8 +318,8 @@ static bool ff_eth_len(const Args& a)
     if ( !(a.pkt->proto_bits & PROTO_BIT__ETH) )
         return false;
 
-    print_label(a, "eth_len");
-    TextLog_Print(json_log, "%u", a.pkt->pkth->pktlen);
+    print_label(a);
+    put_uint(a.pkt->pkth->pktlen);
     return true;
 }
 
@@ -236,12 +328,10 @@ static bool ff_eth_src(const Args& a)
     if ( !(a.pkt->proto_bits & PROTO_BIT__ETH) )
         return false;
 
-    print_label(a, "eth_src");
+    print_label(a);
     const eth::EtherHdr* eh = layer::get_eth_layer(a.pkt);
 
-    TextLog_Print(json_log, "\"%02X:%02X:%02X:%02X:%02X:%02X\"", eh->ether_src[0],
-        eh->ether_src[1], eh->ether_src[2], eh->ether_src[3],
-        eh->ether_src[4], eh->ether_src[5]);
+    put_mac(eh->ether_src);
     return true;
 }
 
@@ -252,8 +342,24 @@ static bool ff_eth_type(const Args& a)
 
     const eth::EtherHdr* eh = layer::get_eth_layer(a.pkt);
 
-    print_label(a, "eth_type");
-    TextLog_Print(json_log, "\"0x%X\"", ntohs(eh->ether_type));
+    print_label(a);
+    uint16_t type = ntohs(eh->ether_type);
+    char buf[8];
+    char* end = buf + sizeof(buf);
+    char* s = end;
+
+    *--s = '"';
+    do
+    {
+        *--s = hex_digits[type & 0xF];
+        type >>= 4;
+    }
+    while ( type );
+
+    *--s = 'x';
+    *--s = '0';
+    *--s = '"';
+    TextLog_Write(json_log, s, end - s);
     return true;
 }
 
@@ -261,8 +367,8 @@ static bool ff_flowstart_time(const Args& a)
 {
     if (a.pkt->flow)
     {
-        print_label(a, "flowstart_time");
-        TextLog_Print(json_log, "%ld", a.pkt->flow->flowstats.start_time.tv_sec);
+        print_label(a);
+        put_int(a.pkt->flow->flowstats.start_time.tv_sec);
         return true;
     }
     return false;
@@ -272,16 +378,16 @@ static bool ff_geneve_vni(const Args& a)
 {
     if (a.pkt->proto_bits & PROTO_BIT__GENEVE)
     {
-        print_label(a, "geneve_vni");
-        TextLog_Print(json_log, "%u", a.pkt->get_flow_geneve_vni());
+        print_label(a);
+        put_uint(a.pkt->get_flow_geneve_vni());
     }
     return true;
 }
 
 static bool ff_gid(const Args& a)
 {
-    print_label(a, "gid");
-    TextLog_Print(json_log, "%u",  a.event.sig_info->gid);
+    print_label(a);
+    put_uint(a.event.sig_info->gid);
     return true;
 }
 
@@ -289,8 +395,8 @@ static bool ff_icmp_code(const Args& a)
 {
     if (a.pkt->ptrs.icmph )
     {
-        print_label(a, "icmp_code");
-        TextLog_Print(json_log, "%u", a.pkt->ptrs.icmph->code);
+        print_label(a);
+        put_uint(a.pkt->ptrs.icmph->code);
         return true;
     }
     return false;
@@ -300,8 +406,8 @@ static bool ff_icmp_id(const Args& a)
 {
     if (a.pkt->ptrs.icmph )
     {
-        print_label(a, "icmp_id");
-        TextLog_Print(json_log, "%u", ntohs(a.pkt->ptrs.icmph->s_icmp_id));
+        print_label(a);
+        put_uint(ntohs(a.pkt->ptrs.icmph->s_icmp_id));
         return true;
     }
     return false;
@@ -311,8 +417,8 @@ static bool ff_icmp_seq(const Args& a)
 {
     if (a.pkt->ptrs.icmph )
     {
-        print_label(a, "icmp_seq");
-        TextLog_Print(json_log, "%u", ntohs(a.pkt->ptrs.icmph->s_icmp_seq));
+        print_label(a);
+        put_uint(ntohs(a.pkt->ptrs.icmph->s_icmp_seq));
         return true;
     }
     return false;
@@ -322,8 +428,8 @@ static bool ff_icmp_type(const Args& a)
 {
     if (a.pkt->ptrs.icmph )
     {
-        print_label(a, "icmp_type");
-        TextLog_Print(json_log, "%u", a.pkt->ptrs.icmph->type);
+        print_label(a);
+        put_uint(a.pkt->ptrs.icmph->type);
         return true;
     }
     return false;
@@ -331,7 +437,7 @@ static bool ff_icmp_type(const Args& a)
 
 static bool ff_iface(const Args& a)
 {
-    print_label(a, "iface");
+    print_label(a);
     TextLog_Quote(json_log, SFDAQ::get_input_spec());
     return true;
 }
@@ -340,8 +446,8 @@ static bool ff_ip_id(const Args& a)
 {
     if (a.pkt->has_ip())
     {
-        print_label(a, "ip_id");
-        TextLog_Print(json_log, "%u", a.pkt->ptrs.ip_api.id());
+        print_label(a);
+        put_uint(a.pkt->ptrs.ip_api.id());
         return true;
     }
     return false;
@@ -351,8 +457,8 @@ static bool ff_ip_len(const Args& a)
 {
     if (a.pkt->has_ip())
     {
-        print_label(a, "ip_len");
-        TextLog_Print(json_log, "%u", a.pkt->ptrs.ip_api.pay_len());
+        print_label(a);
+        put_uint(a.pkt->ptrs.ip_api.pay_len());
         return true;
     }
     return false;
@@ -360,7 +466,7 @@ static bool ff_ip_len(const Args& a)
 
 static bool ff_msg(const Args& a)
 {
-    print_label(a, "msg");
+    print_label(a);
     TextLog_Puts(json_log, a.msg);
     return true;
 }
@@ -378,72 +484,82 @@ static bool ff_mpls(const Args& a)
     else
         return false;
 
-    print_label(a, "mpls");
-    TextLog_Print(json_log, "%u", mpls);
+    print_label(a);
+    put_uint(mpls);
     return true;
 }
 
 static bool ff_pkt_gen(const Args& a)
 {
-    print_label(a, "pkt_gen");
+    print_label(a);
     TextLog_Quote(json_log, a.pkt->get_pseudo_type());
     return true;
 }
 
 static bool ff_pkt_len(const Args& a)
 {
-    print_label(a, "pkt_len");
+    print_label(a);
 
     if (a.pkt->has_ip())
-        TextLog_Print(json_log, "%u", a.pkt->ptrs.ip_api.dgram_len());
+        put_uint(a.pkt->ptrs.ip_api.dgram_len());
     else
-        TextLog_Print(json_log, "%u", a.pkt->dsize);
+        put_uint(a.pkt->dsize);
 
     return true;
 }
 
 static bool ff_pkt_num(const Args& a)
 {
-    print_label(a, "pkt_num");
-    TextLog_Print(json_log, STDu64, a.pkt->context->packet_number);
+    print_label(a);
+    put_uint(a.pkt->context->packet_number);
     return true;
 }
 
 static bool ff_priority(const Args& a)
 {
-    print_label(a, "priority");
-    TextLog_Print(json_log, "%u", a.event.sig_info->priority);
+    print_label(a);
+    put_uint(a.event.sig_info->priority);
     return true;
 }
 
 static bool ff_proto(const Args& a)
 {
-    print_label(a, "proto");
+    print_label(a);
     TextLog_Quote(json_log, a.pkt->get_type());
     return true;
 }
 
 static bool ff_rev(const Args& a)
 {
-    print_label(a, "rev");
-    TextLog_Print(json_log, "%u",  a.event.sig_info->rev);
+    print_label(a);
+    put_uint(a.event.sig_info->rev);
     return true;
 }
 
 static bool ff_rule(const Args& a)
 {
-    print_label(a, "rule");
+    print_label(a);
+
+    char buf[34];
+    char* end = buf + sizeof(buf);
+    char* s = end;
 
-    TextLog_Print(json_log, "\"%u:%u:%u\"",
-        a.event.sig_info->gid, a.event.sig_info->sid, a.event.sig_info->rev);
+    *--s = '"';
+    s = fmt_uint(s, a.event.sig_info->rev);
+    *--s = ':';
+    s = fmt_uint(s, a.event.sig_info->sid);
+    *--s = ':';
+    s = fmt_uint(s, a.event.sig_info->gid);
+    *--s = '"';
+    TextLog_Write(json_log, s, end - s);
 
     return true;
 }
 
 static bool ff_seconds(const Args& a)
 {
-    print_label(a, "seconds");
-    TextLog_Print(json_log, "%ld",  a.pkt->pkth->ts.tv_sec);
+    print_label(a);
+    put_int(a.pkt->pkth->ts.tv_sec);
     return true;
 }
 
@@ -451,8 +567,8 @@ static bool ff_server_bytes(const Args& a)
 {
     if (a.pkt->flow)
     {
-        print_label(a, "server_bytes");
-        TextLog_Print(json_log, "%" PRIu64, a.pkt->flow->flowstats.server_bytes);
+        print_label(a);
+        put_uint(a.pkt->flow->flowstats.server_bytes);
         return true;
     }
     return false;
@@ -462,8 +578,8 @@ static bool ff_server_pkts(const Args& a)
 {
     if (a.pkt->flow)
     {
-        print_label(a, "server_pkts");
-        TextLog_Print(json_log, "%" PRIu64, a.pkt->flow->flowstats.server_pkts);
+        print_label(a);
+        put_uint(a.pkt->flow->flowstats.server_pkts);
         return true;
     }
     return false;
@@ -476,7 +592,7 @@ static bool ff_service(const Args& a)
     if ( a.pkt->flow and a.pkt->flow->service )
         svc = a.pkt->flow->service;
 
-    print_label(a, "service");
+    print_label(a);
     TextLog_Quote(json_log, svc);
     return true;
 }
@@ -486,8 +602,8 @@ static bool ff_sgt(const Args& a)
     if (a.pkt->proto_bits & PROTO_BIT__CISCO_META_DATA)
     {
         const cisco_meta_data::CiscoMetaDataHdr* cmdh = layer::get_cisco_meta_data_layer(a.pkt);
-        print_label(a, "sgt");
-        TextLog_Print(json_log, "%hu", cmdh->sgt_val());
+        print_label(a);
+        put_uint(cmdh->sgt_val());
         return true;
     }
     return false;
@@ -495,8 +611,8 @@ static bool ff_sgt(const Args& a)
 
 static bool ff_sid(const Args& a)
 {
-    print_label(a, "sid");
-    TextLog_Print(json_log, "%u",  a.event.sig_info->sid);
+    print_label(a);
+    put_uint(a.event.sig_info->sid);
     return true;
 }
 
@@ -504,9 +620,10 @@ static bool ff_src_addr(const Args& a)
 {
     if ( a.pkt->has_ip() or a.pkt->is_data() )
     {
-        SfIpString ip_str;
-        print_label(a, "src_addr");
-        TextLog_Quote(json_log, a.pkt->ptrs.ip_api.get_src()->ntop(ip_str));
+        print_label(a);
+        TextLog_Putc(json_log, '"');
+        put_addr(a.pkt->ptrs.ip_api.get_src());
+        TextLog_Putc(json_log, '"');
         return true;
     }
     return false;
@@ -514,17 +631,17 @@ static bool ff_src_addr(const Args& a)
 
 static bool ff_src_ap(const Args& a)
 {
-    SfIpString addr = "";
+    const SfIp* addr = nullptr;
     unsigned port = 0;
 
     if ( a.pkt->has_ip() or a.pkt->is_data() )
-        a.pkt->ptrs.ip_api.get_src()->ntop(addr);
+        addr = a.pkt->ptrs.ip_api.get_src();
 
     if ( a.pkt->proto_bits & (PROTO_BIT__TCP|PROTO_BIT__UDP) )
         port = a.pkt->ptrs.sp;
 
-    print_label(a, "src_ap");
-    TextLog_Print(json_log, "\"%s:%u\"", addr, port);
+    print_label(a);
+    put_addr_port(addr, port);
     return true;
 }
 
@@ -532,8 +649,8 @@ static bool ff_src_port(const Args& a)
 {
     if ( a.pkt->proto_bits & (PROTO_BIT__TCP|PROTO_BIT__UDP) )
     {
-        print_label(a, "src_port");
-        TextLog_Print(json_log, "%u", a.pkt->ptrs.sp);
+        print_label(a);
+        put_uint(a.pkt->ptrs.sp);
         return true;
     }
     return false;
@@ -541,19 +658,21 @@ static bool ff_src_port(const Args& a)
 
 static bool ff_target(const Args& a)
 {
-    SfIpString addr = "";
+    const SfIp* addr;
 
     if ( a.event.sig_info->target == TARGET_SRC )
-        a.pkt->ptrs.ip_api.get_src()->ntop(addr);
+        addr = a.pkt->ptrs.ip_api.get_src();
 
     else if ( a.event.sig_info->target == TARGET_DST )
-        a.pkt->ptrs.ip_api.get_dst()->ntop(addr);
+        addr = a.pkt->ptrs.ip_api.get_dst();
 
     else
         return false;
 
-    print_label(a, "target");
-    TextLog_Quote(json_log, addr);
+    print_label(a);
+    TextLog_Putc(json_log, '"');
+    put_addr(addr);
+    TextLog_Putc(json_log, '"');
     return true;
 }
 
@@ -561,8 +680,8 @@ static bool ff_tcp_ack(const Args& a)
 {
     if (a.pkt->ptrs.tcph )
     {
-        print_label(a, "tcp_ack");
-        TextLog_Print(json_log, "%u", ntohl(a.pkt->ptrs.tcph->th_ack));
+        print_label(a);
+        put_uint(ntohl(a.pkt->ptrs.tcph->th_ack));
         return true;
     }
     return false;
@@ -575,7 +694,7 @@ static bool ff_tcp_flags(const Args& a)
         char tcpFlags[9];
         CreateTCPFlagString(a.pkt->ptrs.tcph, tcpFlags);
 
-        print_label(a, "tcp_flags");
+        print_label(a);
         TextLog_Quote(json_log, tcpFlags);
         return true;
     }
@@ -586,8 +705,8 @@ static bool ff_tcp_len(const Args& a)
 {
     if (a.pkt->ptrs.tcph )
     {
-        print_label(a, "tcp_len");
-        TextLog_Print(json_log, "%u", (a.pkt->ptrs.tcph->off()));
+        print_label(a);
+        put_uint((a.pkt->ptrs.tcph->off()));
         return true;
     }
     return false;
@@ -597,8 +716,8 @@ static bool ff_tcp_seq(const Args& a)
 {
     if (a.pkt->ptrs.tcph )
     {
-        print_label(a, "tcp_seq");
-        TextLog_Print(json_log, "%u", ntohl(a.pkt->ptrs.tcph->th_seq));
+        print_label(a);
+        put_uint(ntohl(a.pkt->ptrs.tcph->th_seq));
         return true;
     }
     return false;
@@ -608,8 +727,8 @@ static bool ff_tcp_win(const Args& a)
 {
     if (a.pkt->ptrs.tcph )
     {
-        print_label(a, "tcp_win");
-        TextLog_Print(json_log, "%u", ntohs(a.pkt->ptrs.tcph->th_win));
+        print_label(a);
+        put_uint(ntohs(a.pkt->ptrs.tcph->th_win));
         return true;
     }
     return false;
@@ -617,7 +736,7 @@ static bool ff_tcp_win(const Args& a)
 
 static bool ff_timestamp(const Args& a)
 {
-    print_label(a, "timestamp");
+    print_label(a);
     TextLog_Putc(json_log, '"');
     LogTimeStamp(json_log, a.pkt);
     TextLog_Putc(json_log, '"');
@@ -628,8 +747,8 @@ static bool ff_tos(const Args& a)
 {
     if (a.pkt->has_ip())
     {
-        print_label(a, "tos");
-        TextLog_Print(json_log, "%u", a.pkt->ptrs.ip_api.tos());
+        print_label(a);
+        put_uint(a.pkt->ptrs.ip_api.tos());
         return true;
     }
     return false;
@@ -639,8 +758,8 @@ static bool ff_ttl(const Args& a)
 {
     if (a.pkt->has_ip())
     {
-        print_label(a, "ttl");
-        TextLog_Print(json_log, "%u",a.pkt->ptrs.ip_api.ttl());
+        print_label(a);
+        put_uint(a.pkt->ptrs.ip_api.ttl());
         return true;
     }
     return false;
@@ -650,8 +769,8 @@ static bool ff_udp_len(const Args& a)
 {
     if (a.pkt->ptrs.udph )
     {
-        print_label(a, "udp_len");
-        TextLog_Print(json_log, "%u", ntohs(a.pkt->ptrs.udph->uh_len));
+        print_label(a);
+        put_uint(ntohs(a.pkt->ptrs.udph->uh_len));
         return true;
     }
     return false;
@@ -659,8 +778,8 @@ static bool ff_udp_len(const Args& a)
 
 static bool ff_vlan(const Args& a)
 {
-    print_label(a, "vlan");
-    TextLog_Print(json_log, "%hu", a.pkt->get_flow_vlan_id());
+    print_label(a);
+    put_uint(a.pkt->get_flow_vlan_id());
     return true;
 }
 
@@ -670,6 +789,14 @@ static bool ff_vlan(const Args& a)
 
 typedef bool (*JsonFunc)(const Args&);
 
+// the configured fields are compiled into this list once; each label
+// includes the separator so the alert loop only copies it
+struct JsonField
+{
+    JsonFunc func;
+    string label;
+};
+
 static const JsonFunc json_func[] =
 {
     ff_action, ff_class, ff_b64_data, ff_client_bytes, ff_client_pkts, ff_dir,
@@ -730,9 +857,28 @@ public:
     bool file = false;
     size_t limit = 0;
     string sep;
-    vector<JsonFunc> fields;
+    vector<JsonField> fields;
+
+private:
+    void add_field(const string&);
 };
 
+void JsonModule::add_field(const string& tok)
+{
+    int i = Parameter::index(json_range, tok.c_str());
+
+    if ( i < 0 )
+        return;
+
+    // as before, every field after the first is preceded by a comma whether
+    // or not the previous one was output
+    string label = fields.empty() ? " \"" : ", \"";
+    label += tok;
+    label += "\" : ";
+
+    fields.push_back({ json_func[i], label });
+}
+
 bool JsonModule::set(const char*, Value& v, SnortConfig*)
 {
     if ( v.is("file") )
@@ -745,11 +891,7 @@ bool JsonModule::set(const char*, Value& v, SnortConfig*)
         fields.clear();
 
         while ( v.get_next_token(tok) )
-        {
-            int i = Parameter::index(json_range, tok.c_str());
-            if ( i >= 0 )
-                fields.emplace_back(json_func[i]);
-        }
+            add_field(tok);
     }
 
     else if ( v.is("limit") )
@@ -774,11 +916,7 @@ bool JsonModule::begin(const char*, int, SnortConfig*)
         v.set_first_token();
 
         while ( v.get_next_token(tok) )
-        {
-            int i = Parameter::index(json_range, tok.c_str());
-            if ( i >= 0 )
-                fields.emplace_back(json_func[i]);
-        }
+            add_field(tok);
     }
     return true;
 }
@@ -800,7 +938,7 @@ public:
 public:
     string file;
     unsigned long limit;
-    vector<JsonFunc> fields;
+    vector<JsonField> fields;
     string sep;
 };
 
@@ -820,16 +958,16 @@ void JsonLogger::close()
 
 void JsonLogger::alert(Packet* p, const char* msg, const Event& event)
 {
-    Args a = { p, msg, event, false };
+    Args a = { p, msg, event, nullptr };
     TextLog_Putc(json_log, '{');
 
-    for ( JsonFunc f : fields )
+    for ( const auto& f : fields )
     {
-        f(a);
-        a.comma = true;
+        a.label = &f.label;
+        f.func(a);
     }
 
-    TextLog_Print(json_log, " }\n");
+    TextLog_Write(json_log, " }\n", 3);
     TextLog_Flush(json_log);
 }
 
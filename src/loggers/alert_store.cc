@@ -0,0 +1,726 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2023-2023 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// alert_store.cc
+
+// alert_store writes events into indexed segment files that can be queried
+// in place with tools/alert_store_query; the format is in log/alert_store.h.
+//
+// The packet thread only appends a fixed size row plus a snippet of packet
+// data to a batch, about the same work unified2 does for an event.  The
+// rows are turned into columns and the segment is indexed and written by
+// StoreFile, which always runs on the log writer thread; sealing a segment
+// sorts and writes megabytes, which the packet thread can't afford.  The
+// queue has output.async_log_buffers buffers, or STORE_BUFFERS if that is
+// not set.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <ctime>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "detection/signature.h"
+#include "events/event.h"
+#include "framework/logger.h"
+#include "framework/module.h"
+#include "log/alert_store.h"
+#include "log/log_writer.h"
+#include "log/messages.h"
+#include "log/obfuscator.h"
+#include "main/snort_config.h"
+#include "packet_io/active.h"
+#include "protocols/icmp4.h"
+#include "protocols/packet.h"
+#include "utils/util.h"
+
+#ifdef UNIT_TEST
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "catch/snort_catch.h"
+#endif
+
+using namespace snort;
+using namespace std;
+
+#define S_NAME "alert_store"
+#define F_NAME S_NAME
+
+/* queue depth when output.async_log_buffers is not set */
+#define STORE_BUFFERS 4
+
+//-------------------------------------------------------------------------
+// batch rows
+//-------------------------------------------------------------------------
+
+// each row is followed by snip_len bytes of packet data padded to 4 bytes
+struct Row
+{
+    uint32_t seconds;
+    uint32_t useconds;
+    uint32_t event_id;
+    uint32_t gid;
+    uint32_t sid;
+    uint32_t rev;
+    uint32_t src_addr[4];
+    uint32_t dst_addr[4];
+    uint16_t src_port;
+    uint16_t dst_port;
+    uint16_t snip_len;
+    uint8_t proto;
+    uint8_t action;
+};
+
+static inline size_t row_size(uint16_t snip_len)
+{ return sizeof(Row) + ((snip_len + 3u) & ~3u); }
+
+//-------------------------------------------------------------------------
+// segment builder
+//-------------------------------------------------------------------------
+
+class StoreFile : public LogSink
+{
+public:
+    StoreFile(const char* path, uint32_t events, uint32_t secs) :
+        base(path), max_events(events), max_secs(secs) { }
+
+    ~StoreFile() override
+    { seal(); }
+
+    void write(const char*, size_t) override;
+    void tick(time_t) override;
+
+private:
+    void add(const Row&, const uint8_t* snip);
+    void seal();
+    void clear();
+
+private:
+    string base;
+    uint32_t max_events;
+    uint32_t max_secs;
+    unsigned seq = 0;
+    time_t started = 0;
+
+    vector<uint32_t> seconds;
+    vector<uint32_t> useconds;
+    vector<uint32_t> event_id;
+    vector<uint32_t> gid;
+    vector<uint32_t> sid;
+    vector<uint32_t> rev;
+    vector<uint32_t> src_addr;
+    vector<uint32_t> dst_addr;
+    vector<uint16_t> src_port;
+    vector<uint16_t> dst_port;
+    vector<uint8_t> proto;
+    vector<uint8_t> action;
+    vector<uint32_t> flow_hash;
+    vector<uint32_t> snip_off;
+    vector<uint16_t> snip_len;
+    vector<uint8_t> snippets;
+};
+
+// a quiet segment is sealed on time by the writer thread's tick
+void StoreFile::tick(time_t now)
+{
+    if ( !seconds.empty() and now - started >= (time_t)max_secs )
+        seal();
+}
+
+void StoreFile::write(const char* buf, size_t len)
+{
+    tick(time(nullptr));
+
+    while ( len >= sizeof(Row) )
+    {
+        Row r;
+        memcpy(&r, buf, sizeof(r));
+
+        size_t n = row_size(r.snip_len);
+        assert(n <= len);
+
+        add(r, (const uint8_t*)buf + sizeof(r));
+
+        if ( seconds.size() >= max_events )
+            seal();
+
+        buf += n;
+        len -= n;
+    }
+}
+
+void StoreFile::add(const Row& r, const uint8_t* snip)
+{
+    if ( seconds.empty() )
+        started = time(nullptr);
+
+    seconds.emplace_back(r.seconds);
+    useconds.emplace_back(r.useconds);
+    event_id.emplace_back(r.event_id);
+    gid.emplace_back(r.gid);
+    sid.emplace_back(r.sid);
+    rev.emplace_back(r.rev);
+    src_addr.insert(src_addr.end(), r.src_addr, r.src_addr + 4);
+    dst_addr.insert(dst_addr.end(), r.dst_addr, r.dst_addr + 4);
+    src_port.emplace_back(r.src_port);
+    dst_port.emplace_back(r.dst_port);
+    proto.emplace_back(r.proto);
+    action.emplace_back(r.action);
+
+    flow_hash.emplace_back(AlertStore::flow_hash(
+        r.src_addr, r.src_port, r.dst_addr, r.dst_port, r.proto));
+
+    snip_off.emplace_back(snippets.size());
+    snip_len.emplace_back(r.snip_len);
+    snippets.insert(snippets.end(), snip, snip + r.snip_len);
+}
+
+void StoreFile::clear()
+{
+    seconds.clear();
+    useconds.clear();
+    event_id.clear();
+    gid.clear();
+    sid.clear();
+    rev.clear();
+    src_addr.clear();
+    dst_addr.clear();
+    src_port.clear();
+    dst_port.clear();
+    proto.clear();
+    action.clear();
+    flow_hash.clear();
+    snip_off.clear();
+    snip_len.clear();
+    snippets.clear();
+}
+
+// the segment is written to a temporary name and renamed when complete so
+// readers never see a partial segment
+void StoreFile::seal()
+{
+    uint32_t n = seconds.size();
+
+    if ( !n )
+        return;
+
+    vector<uint32_t> time_idx(n);
+    iota(time_idx.begin(), time_idx.end(), 0);
+
+    vector<uint32_t> sid_idx(time_idx);
+    vector<uint32_t> flow_idx(time_idx);
+
+    stable_sort(time_idx.begin(), time_idx.end(), [this](uint32_t a, uint32_t b)
+        { return seconds[a] < seconds[b] or
+            (seconds[a] == seconds[b] and useconds[a] < useconds[b]); });
+
+    stable_sort(sid_idx.begin(), sid_idx.end(), [this](uint32_t a, uint32_t b)
+        { return sid[a] < sid[b] or (sid[a] == sid[b] and gid[a] < gid[b]); });
+
+    stable_sort(flow_idx.begin(), flow_idx.end(), [this](uint32_t a, uint32_t b)
+        { return flow_hash[a] < flow_hash[b]; });
+
+    AlertStore::Header hdr = { };
+    memcpy(hdr.magic, AlertStore::magic, sizeof(hdr.magic));
+    hdr.version = AlertStore::version;
+    hdr.endian = AlertStore::endian;
+    hdr.count = n;
+    hdr.min_seconds = seconds[time_idx[0]];
+    hdr.max_seconds = seconds[time_idx[n - 1]];
+
+    struct { const void* data; size_t len; } secs[AlertStore::SEC_MAX] =
+    {
+        { seconds.data(), n * sizeof(uint32_t) },
+        { useconds.data(), n * sizeof(uint32_t) },
+        { event_id.data(), n * sizeof(uint32_t) },
+        { gid.data(), n * sizeof(uint32_t) },
+        { sid.data(), n * sizeof(uint32_t) },
+        { rev.data(), n * sizeof(uint32_t) },
+        { src_addr.data(), n * 4 * sizeof(uint32_t) },
+        { dst_addr.data(), n * 4 * sizeof(uint32_t) },
+        { src_port.data(), n * sizeof(uint16_t) },
+        { dst_port.data(), n * sizeof(uint16_t) },
+        { proto.data(), n },
+        { action.data(), n },
+        { flow_hash.data(), n * sizeof(uint32_t) },
+        { snip_off.data(), n * sizeof(uint32_t) },
+        { snip_len.data(), n * sizeof(uint16_t) },
+        { time_idx.data(), n * sizeof(uint32_t) },
+        { sid_idx.data(), n * sizeof(uint32_t) },
+        { flow_idx.data(), n * sizeof(uint32_t) },
+        { snippets.data(), snippets.size() },
+    };
+
+    static const uint8_t pad[8] = { };
+    iovec iov[2 * AlertStore::SEC_MAX + 1];
+    int cnt = 0;
+
+    static_assert(sizeof(hdr) % 8 == 0, "segment header must keep sections aligned");
+    iov[cnt++] = { &hdr, sizeof(hdr) };
+    uint64_t off = sizeof(hdr);
+
+    for ( unsigned i = 0; i < AlertStore::SEC_MAX; ++i )
+    {
+        hdr.sections[i] = { off, secs[i].len };
+        iov[cnt++] = { const_cast<void*>(secs[i].data), secs[i].len };
+        off += secs[i].len;
+
+        if ( size_t extra = (8 - off % 8) % 8 )
+        {
+            iov[cnt++] = { const_cast<uint8_t*>(pad), extra };
+            off += extra;
+        }
+    }
+
+    string name = base + "." + to_string(time(nullptr)) + "." + to_string(seq++);
+    string tmp = name + ".tmp";
+
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    int error = (fd < 0) ? errno : log_write(fd, iov, cnt);
+
+    if ( fd >= 0 )
+        close(fd);
+
+    // a segment that can't be written is dropped rather than stopping
+    if ( error or rename(tmp.c_str(), name.c_str()) )
+    {
+        ErrorMessage("alert_store could not write %s: %s\n",
+            name.c_str(), get_error(error ? error : errno));
+        unlink(tmp.c_str());
+    }
+
+    clear();
+}
+
+//-------------------------------------------------------------------------
+// module stuff
+//-------------------------------------------------------------------------
+
+static const Parameter s_params[] =
+{
+    { "events", Parameter::PT_INT, "1:16777216", "65536",
+      "maximum number of events per segment" },
+
+    { "seconds", Parameter::PT_INT, "1:max32", "300",
+      "seal a segment once its first event is this old" },
+
+    { "snaplen", Parameter::PT_INT, "0:65535", "128",
+      "number of payload bytes stored with each event" },
+
+    { nullptr, Parameter::PT_MAX, nullptr, nullptr, nullptr }
+};
+
+#define s_help \
+    "output events to indexed segment files for alert_store_query"
+
+class StoreModule : public Module
+{
+public:
+    StoreModule() : Module(S_NAME, s_help, s_params) { }
+
+    bool set(const char*, Value&, SnortConfig*) override;
+    bool begin(const char*, int, SnortConfig*) override;
+
+    Usage get_usage() const override
+    { return GLOBAL; }
+
+public:
+    uint32_t events = 0;
+    uint32_t seconds = 0;
+    uint16_t snaplen = 0;
+};
+
+bool StoreModule::set(const char*, Value& v, SnortConfig*)
+{
+    if ( v.is("events") )
+        events = v.get_uint32();
+
+    else if ( v.is("seconds") )
+        seconds = v.get_uint32();
+
+    else if ( v.is("snaplen") )
+        snaplen = v.get_uint16();
+
+    return true;
+}
+
+bool StoreModule::begin(const char*, int, SnortConfig*)
+{
+    events = 65536;
+    seconds = 300;
+    snaplen = 128;
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// logger stuff
+//-------------------------------------------------------------------------
+
+struct Store
+{
+    StoreFile* file;
+    LogQueue* queue;
+
+    // the batch being filled
+    char* batch;
+    size_t pos;
+};
+
+static THREAD_LOCAL Store store;
+
+class StoreLogger : public Logger
+{
+public:
+    StoreLogger(StoreModule*);
+
+    void open() override;
+    void close() override;
+
+    void alert(Packet*, const char* msg, const Event&) override;
+
+private:
+    void handoff();
+
+private:
+    uint32_t events;
+    uint32_t seconds;
+    uint16_t snaplen;
+    size_t batch_sz;
+};
+
+StoreLogger::StoreLogger(StoreModule* m) :
+    events(m->events), seconds(m->seconds), snaplen(m->snaplen)
+{
+    // a batch holds many rows but at least one of the largest
+    batch_sz = max((size_t)256 * 1024, row_size(snaplen));
+}
+
+void StoreLogger::open()
+{
+    string name;
+    get_instance_file(name, F_NAME);
+
+    store.file = new StoreFile(name.c_str(), events, seconds);
+    store.queue = nullptr;
+    store.batch = (char*)snort_alloc(batch_sz);
+    store.pos = 0;
+
+    const SnortConfig* sc = SnortConfig::get_conf();
+    unsigned depth = sc->log_buffers ? sc->log_buffers : STORE_BUFFERS;
+
+    store.queue = new LogQueue(store.file, depth, batch_sz, sc->log_drop_oldest,
+        [this]() { handoff(); });
+}
+
+void StoreLogger::close()
+{
+    handoff();
+    delete store.queue;  // waits for the writer
+    store.queue = nullptr;
+
+    delete store.file;  // seals the last segment
+    store.file = nullptr;
+
+    snort_free(store.batch);
+    store.batch = nullptr;
+}
+
+void StoreLogger::handoff()
+{
+    if ( !store.pos )
+        return;
+
+    store.batch = store.queue->swap(store.batch, store.pos);
+    store.pos = 0;
+}
+
+void StoreLogger::alert(Packet* p, const char*, const Event& event)
+{
+    uint16_t snip_len = min((unsigned)p->dsize, (unsigned)snaplen);
+    size_t len = row_size(snip_len);
+
+    if ( store.pos + len > batch_sz )
+        handoff();
+
+    char* buf = store.batch + store.pos;
+
+    Row r = { };
+    r.seconds = event.ref_time.tv_sec;
+    r.useconds = event.ref_time.tv_usec;
+    r.event_id = event.get_event_id();
+    r.gid = event.sig_info->gid;
+    r.sid = event.sig_info->sid;
+    r.rev = event.sig_info->rev;
+
+    if ( p->has_ip() )
+    {
+        memcpy(r.src_addr, p->ptrs.ip_api.get_src()->get_ip6_ptr(), sizeof(r.src_addr));
+        memcpy(r.dst_addr, p->ptrs.ip_api.get_dst()->get_ip6_ptr(), sizeof(r.dst_addr));
+        r.proto = (uint8_t)p->get_ip_proto_next();
+    }
+
+    if ( p->proto_bits & (PROTO_BIT__TCP|PROTO_BIT__UDP) )
+    {
+        r.src_port = p->ptrs.sp;
+        r.dst_port = p->ptrs.dp;
+    }
+    else if ( p->ptrs.icmph )
+    {
+        r.src_port = p->ptrs.icmph->type;
+        r.dst_port = p->ptrs.icmph->code;
+    }
+
+    r.snip_len = snip_len;
+    r.action = p->active->get_action();
+
+    memcpy(buf, &r, sizeof(r));
+    uint8_t* snip = (uint8_t*)buf + sizeof(r);
+
+    if ( snip_len )
+    {
+        memcpy(snip, p->data, snip_len);
+
+        if ( p->obfuscator and p->obfuscator->select_buffer("pkt_data") )
+        {
+            for ( const auto& b : *p->obfuscator )
+            {
+                if ( b.offset < snip_len )
+                    memset(snip + b.offset, p->obfuscator->get_mask_char(),
+                        min((size_t)b.length, (size_t)(snip_len - b.offset)));
+            }
+        }
+    }
+
+    store.pos += len;
+
+    if ( store.pos >= batch_sz / 2 or store.queue->stale(time(nullptr)) )
+        handoff();
+}
+
+//-------------------------------------------------------------------------
+// api stuff
+//-------------------------------------------------------------------------
+
+static Module* mod_ctor()
+{ return new StoreModule; }
+
+static void mod_dtor(Module* m)
+{ delete m; }
+
+static Logger* store_ctor(Module* mod)
+{ return new StoreLogger((StoreModule*)mod); }
+
+static void store_dtor(Logger* p)
+{ delete p; }
+
+static LogApi store_api
+{
+    {
+        PT_LOGGER,
+        sizeof(LogApi),
+        LOGAPI_VERSION,
+        0,
+        API_RESERVED,
+        API_OPTIONS,
+        S_NAME,
+        s_help,
+        mod_ctor,
+        mod_dtor
+    },
+    OUTPUT_TYPE_FLAG__ALERT,
+    store_ctor,
+    store_dtor
+};
+
+#ifdef BUILDING_SO
+SO_PUBLIC const BaseApi* snort_plugins[] =
+#else
+const BaseApi* alert_store[] =
+#endif
+{
+    &store_api.base,
+    nullptr
+};
+
+
+//-------------------------------------------------------------------------
+// unit tests
+//-------------------------------------------------------------------------
+
+#ifdef UNIT_TEST
+static void add_row(string& batch, uint32_t secs, uint32_t sid,
+    uint32_t a, uint16_t ap, uint32_t b, uint16_t bp, const char* snip)
+{
+    Row r = { };
+    r.seconds = secs;
+    r.gid = 1;
+    r.sid = sid;
+    r.src_addr[2] = htonl(0xffff);
+    r.src_addr[3] = htonl(a);
+    r.dst_addr[2] = htonl(0xffff);
+    r.dst_addr[3] = htonl(b);
+    r.src_port = ap;
+    r.dst_port = bp;
+    r.proto = 6;
+    r.snip_len = strlen(snip);
+
+    size_t pos = batch.size();
+    batch.resize(pos + row_size(r.snip_len));
+    memcpy(&batch[pos], &r, sizeof(r));
+    memcpy(&batch[pos + sizeof(r)], snip, r.snip_len);
+}
+
+// maps the only segment in dir
+static AlertStore::Segment map_segment(const char* dir, string& name)
+{
+    DIR* d = opendir(dir);
+    REQUIRE(d);
+
+    while ( dirent* de = readdir(d) )
+    {
+        if ( de->d_name[0] != '.' )
+            name = string(dir) + "/" + de->d_name;
+    }
+    closedir(d);
+
+    struct stat st;
+    int fd = open(name.c_str(), O_RDONLY);
+    REQUIRE(fd >= 0);
+    REQUIRE(!fstat(fd, &st));
+
+    void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    REQUIRE(map != MAP_FAILED);
+
+    return { (const uint8_t*)map, (const AlertStore::Header*)map, (size_t)st.st_size };
+}
+
+TEST_CASE("segment written by StoreFile can be queried", "[alert_store]")
+{
+    char dir[] = "/tmp/alert_store_XXXXXX";
+    REQUIRE(mkdtemp(dir));
+
+    const uint32_t a = 0x0a000001, b = 0x0a000002, c = 0x0a000003;
+    string batch;
+
+    // out of time order so the time index is not the arrival order
+    add_row(batch, 1005, 2000, a, 1234, b, 80, "GET / HTTP/1.1");
+    add_row(batch, 1001, 1000, b, 80, a, 1234, "HTTP/1.1 200 OK");
+    add_row(batch, 1003, 2000, c, 5555, b, 80, "");
+    add_row(batch, 1009, 3000, a, 1234, b, 80, "x");
+
+    {
+        StoreFile sf((string(dir) + "/seg").c_str(), 100, 300);
+        sf.write(batch.data(), batch.size());
+    }
+
+    string name;
+    AlertStore::Segment s = map_segment(dir, name);
+    REQUIRE(s.valid());
+    CHECK(s.hdr->count == 4);
+    CHECK(s.hdr->min_seconds == 1001);
+    CHECK(s.hdr->max_seconds == 1009);
+
+    const uint32_t* lo;
+    const uint32_t* hi;
+
+    SECTION("sid")
+    {
+        s.find_sid(2000, lo, hi);
+        REQUIRE(hi - lo == 2);
+        CHECK(s.get<uint32_t>(AlertStore::SEC_SECONDS)[lo[0]] == 1005);
+        CHECK(s.get<uint32_t>(AlertStore::SEC_SECONDS)[lo[1]] == 1003);
+
+        s.find_sid(4000, lo, hi);
+        CHECK(lo == hi);
+    }
+    SECTION("flow in either direction")
+    {
+        uint32_t x[4] = { 0, 0, htonl(0xffff), htonl(a) };
+        uint32_t y[4] = { 0, 0, htonl(0xffff), htonl(b) };
+
+        s.find_flow(AlertStore::flow_hash(x, 1234, y, 80, 6), lo, hi);
+        CHECK(hi - lo == 3);
+
+        s.find_flow(AlertStore::flow_hash(y, 80, x, 1234, 6), lo, hi);
+        CHECK(hi - lo == 3);
+    }
+    SECTION("time")
+    {
+        const uint32_t from = 1002, to = 1005;
+        s.find_time(&from, &to, lo, hi);
+        REQUIRE(hi - lo == 2);
+        CHECK(s.get<uint32_t>(AlertStore::SEC_SECONDS)[lo[0]] == 1003);
+        CHECK(s.get<uint32_t>(AlertStore::SEC_SECONDS)[lo[1]] == 1005);
+
+        s.find_time(nullptr, nullptr, lo, hi);
+        CHECK(hi - lo == 4);
+    }
+    SECTION("snippet")
+    {
+        uint16_t len;
+        const uint8_t* snip = s.get_snippet(1, len);
+        REQUIRE(snip);
+        CHECK(string((const char*)snip, len) == "HTTP/1.1 200 OK");
+    }
+    SECTION("corrupt segments are rejected")
+    {
+        vector<uint8_t> copy(s.base, s.base + s.size);
+        AlertStore::Header* hdr = (AlertStore::Header*)copy.data();
+        AlertStore::Segment bad = { copy.data(), hdr, copy.size() };
+
+        hdr->count = 1000000;
+        CHECK(!bad.valid());
+
+        hdr->count = 4;
+        bad.size = hdr->sections[AlertStore::SEC_SNIPPETS].offset;
+        CHECK(!bad.valid());
+
+        bad.size = copy.size();
+        ((uint32_t*)(copy.data() + hdr->sections[AlertStore::SEC_SID_IDX].offset))[0] = 4;
+        CHECK(!bad.valid());
+    }
+    SECTION("snippets outside the segment are not returned")
+    {
+        vector<uint8_t> copy(s.base, s.base + s.size);
+        AlertStore::Header* hdr = (AlertStore::Header*)copy.data();
+        AlertStore::Segment bad = { copy.data(), hdr, copy.size() };
+
+        ((uint32_t*)(copy.data() + hdr->sections[AlertStore::SEC_SNIP_OFF].offset))[0] = 1u << 30;
+        REQUIRE(bad.valid());
+
+        uint16_t len;
+        CHECK(!bad.get_snippet(0, len));
+        CHECK(len == 0);
+    }
+
+    munmap((void*)s.base, s.size);
+    unlink(name.c_str());
+    rmdir(dir);
+}
+#endif
@@ -29,7 +29,11 @@
 #include "config.h"
 #endif
 
+#include <fcntl.h>
+#include <unistd.h>
+
 #include <cassert>
+#include <string>
 
 #include "detection/signature.h"
 #include "detection/detection_util.h"
@@ -37,6 +41,7 @@
 #include "events/event.h"
 #include "framework/logger.h"
 #include "framework/module.h"
+#include "log/log_writer.h"
 #include "log/messages.h"
 #include "log/obfuscator.h"
 #include "log/unified2.h"
@@ -68,13 +73,48 @@ struct Unified2Config
     bool legacy_events;
 };
 
+//-------------------------------------------------------------------------
+// U2File owns the output file; it rolls the file when the next write would
+// exceed the limit.  Without a queue it is called on the packet thread for
+// each record, so rolls happen there too.  With a queue it gets whole
+// batches on the writer thread; batches never straddle a roll boundary so
+// rolling there happens at the same record it would have synchronously.
+//-------------------------------------------------------------------------
+
+class U2File : public LogSink
+{
+public:
+    U2File(const char* path, const Unified2Config* c) : config(c), base(path)
+    { init(); }
+
+    ~U2File() override;
+
+    void write(const char*, size_t) override;
+
+private:
+    void init();
+    void term();
+    void roll();
+
+private:
+    const Unified2Config* config;
+    std::string base;
+    std::string name;
+    size_t size = 0;
+    int fd = -1;
+};
+
 struct U2
 {
-    FILE* stream;
-    unsigned int current;
+    U2File* file;
+    LogQueue* queue;
+
+    // the batch being filled when queued
+    char* batch;
+    size_t pos;
+    size_t current;     // bytes the file will have once the batch is written
+
     int base_proto;
-    uint32_t timestamp;
-    char filepath[STD_BUF];
 };
 
 /* -------------------- Global Variables ----------------------*/
@@ -86,67 +126,62 @@ static THREAD_LOCAL U2 u2;
 constexpr unsigned u2_buf_sz =
     sizeof(Serial_Unified2_Header) + sizeof(Unified2Event) + IP_MAXPACKET;
 
+/* batches hold many records; at least one of the largest */
+constexpr unsigned u2_batch_sz = 16 * u2_buf_sz;
+
 static THREAD_LOCAL uint8_t* write_pkt_buffer = nullptr;
 
 #define MAX_XDATA_WRITE_BUF_LEN \
     (MAX_XFF_WRITE_BUF_LENGTH - \
     sizeof(struct in6_addr) + DECODE_BLEN)
 
-/* This buffer is used in lieu of the underlying default stream buf to
- * prevent flushing in the middle of a record.  Every write is force
- * flushed to disk immediately after the entire record is written so
- * spoolers get an entire record */
-
-/* use the size of the buffer we copy record data into */
-static THREAD_LOCAL char* io_buffer = nullptr;
-
 /* -------------------- Local Functions -----------------------*/
 
 static void Unified2Write(uint8_t*, uint32_t, Unified2Config*);
 
-static void Unified2InitFile(Unified2Config* config)
+void U2File::init()
 {
-    assert(config);
-
-    char filepath[STD_BUF];
-    char* fname_ptr;
-
-    u2.timestamp = (uint32_t)time(nullptr);
-
     if (!config->nostamp)
-    {
-        if (SnortSnprintf(filepath, sizeof(filepath), "%s.%u",
-            u2.filepath, u2.timestamp) != SNORT_SNPRINTF_SUCCESS)
-        {
-            FatalError("unified2 failed to copy file path.\n");
-        }
-
-        fname_ptr = filepath;
-    }
+        name = base + "." + std::to_string((uint32_t)time(nullptr));
     else
-    {
-        fname_ptr = u2.filepath;
-    }
+        name = base;
 
-    if ((u2.stream = fopen(fname_ptr, "wb")) == nullptr)
+    if ((fd = open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0)
     {
-        FatalError("unified2 could not open %s: %s\n", fname_ptr, get_error(errno));
+        FatalError("unified2 could not open %s: %s\n", name.c_str(), get_error(errno));
     }
+    size = 0;
 
-    /* Set buffer to size of record buffer so the system doesn't flush
-     * part of a record if it's greater than BUFSIZ */
-    if (setvbuf(u2.stream, io_buffer, _IOFBF, u2_buf_sz) != 0)
-    {
-        ErrorMessage("unified2 could not set I/O buffer: %s. "
-            "Using system default.\n", get_error(errno));
-    }
+#ifdef FALLOC_FL_KEEP_SIZE
+    /* reserve the blocks up front without changing the file size so
+     * readers still see only whole records; failure is harmless */
+    if ( config->limit )
+        (void)fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, config->limit);
+#endif
+}
+
+void U2File::term()
+{
+    if ( fd < 0 )
+        return;
+
+    // give back the part of the reservation that wasn't written
+    if ( config->limit )
+        (void)ftruncate(fd, size);
+
+    close(fd);
+    fd = -1;
+}
+
+U2File::~U2File()
+{
+    term();
 }
 
-static inline void Unified2RotateFile(Unified2Config* config)
+void U2File::roll()
 {
-    fclose(u2.stream);
-    u2.current = 0;
-    Unified2InitFile(config);
+    term();
+    init();
 }
 
 static inline unsigned get_version(const SfIp& addr)
@@ -230,9 +265,6 @@ static void alert_event(Packet* p, const char*, Unified2Config* config, const Ev
     Serial_Unified2_Header hdr;
     uint32_t write_len = sizeof(hdr) + sizeof(u2_event);
 
-    if ( config->limit && (u2.current + write_len) > config->limit )
-        Unified2RotateFile(config);
-
     hdr.length = htonl(sizeof(Unified2Event));
     hdr.type = htonl(UNIFIED2_EVENT3);
 
@@ -300,9 +332,6 @@ static void _WriteExtraData(Unified2Config* config,
     if (write_len > sizeof(write_buffer))
         return;
 
-    if ( config->limit && (u2.current + write_len) > config->limit )
-        Unified2RotateFile(config);
-
     hdr.length = htonl(write_len - sizeof(hdr));
     hdr.type = htonl(UNIFIED2_EXTRA_DATA);
 
@@ -388,9 +417,6 @@ static void _Unified2LogPacketAlert(
     logheader.packet_length = htonl(pkt_length + u2h_len);
     write_len += pkt_length + u2h_len;
 
-    if ( config->limit && (u2.current + write_len) > config->limit )
-        Unified2RotateFile(config);
-
     hdr.length = htonl(sizeof(Serial_Unified2Packet) - 4 + pkt_length + u2h_len);
     hdr.type = htonl(u2_type);
 
@@ -433,7 +459,7 @@ static void _Unified2LogPacketAlert(
 }
 
 /******************************************************************************
- * Function: Unified2Write()
+ * Function: U2File::write()
  *
  * Main function for writing to the unified2 file.
  *
@@ -452,148 +478,84 @@ static void _Unified2LogPacketAlert(
  * added to the current amount of total data written thus far to the
  * unified2 file.
  *
- * Arguments
- *  uint8_t *
- *      The buffer containing the data to write
- *  uint32_t
- *      The length of the data to write
- *  Unified2Config *
- *      A pointer to the unified2 configuration data
- *
- * Returns: None
- *
  ******************************************************************************/
-static void Unified2Write(uint8_t* buf, uint32_t buf_len, Unified2Config* config)
+void U2File::write(const char* buf, size_t len)
 {
-    size_t fwcount = 0;
-
-    /* Nothing to write or nothing to write to */
-    if ((buf == nullptr) || (config == nullptr) || (u2.stream == nullptr))
-        return;
+    if ( config->limit and size and size + len > config->limit )
+        roll();
 
     /* Don't use fsync().  It is a total performance killer */
-    if (((fwcount = fwrite(buf, (size_t)buf_len, 1, u2.stream)) != 1) ||
-        (fflush(u2.stream) != 0))
+    int error = log_write(fd, buf, len);
+
+    if ( error == EIO )
     {
-        /* errno is saved just to avoid other intervening calls
-         * (e.g. ErrorMessage) potentially resetting it to something else. */
-        int error = errno;
-        int max_retries = 3;
-
-        /* On iterations other than the first, the only non-zero error will be
-         * EINTR or interrupt.  Only iterate a maximum of max_retries times so
-         * there is no chance of infinite looping if for some reason the write
-         * is constantly interrupted */
-        while ((error != 0) && (max_retries != 0))
-        {
-            if (config->nostamp)
-            {
-                ErrorMessage("unified2 failed to write to file (%s): %s\n",
-                    u2.filepath, get_error(error));
-            }
-            else
-            {
-                ErrorMessage("unified2 failed to write to file (%s.%u): %s\n",
-                    u2.filepath, u2.timestamp, get_error(error));
-            }
+        ErrorMessage("unified2 failed to write to file (%s): %s\n",
+            name.c_str(), get_error(error));
 
-            while ((error == EINTR) && (max_retries != 0))
-            {
-                max_retries--;
-
-                /* Supposedly an interrupt can only occur before anything
-                 * has been written.  Try again */
-                if (fwcount != 1)
-                {
-                    /* fwrite() failed.  Redo fwrite and fflush */
-                    if (((fwcount = fwrite(buf, (size_t)buf_len, 1, u2.stream)) == 1) &&
-                        fflush(u2.stream) == 0)
-                    {
-                        error = 0;
-                        break;
-                    }
-                }
-                else if (fflush(u2.stream) == 0)
-                {
-                    error = 0;
-                    break;
-                }
-
-                error = errno;
-            }
+        ErrorMessage("unified2 file is possibly corrupt. "
+            "Closing this unified2 file and creating a new one.\n");
 
-            /* If we've reached the maximum number of interrupt retries,
-             * just bail out of the main while loop */
-            if (max_retries == 0)
-                continue;
+        roll();
+        ErrorMessage("unified2 rotated file: %s\n", name.c_str());
 
-            switch (error)
-            {
-            case 0:
-                break;
-
-            case EIO:
-                ErrorMessage("unified2 file is possibly corrupt. "
-                    "Closing this unified2 file and creating a new one.\n");
-
-                Unified2RotateFile(config);
-
-                if (config->nostamp)
-                {
-                    ErrorMessage("unified2 rotated file: %s\n", u2.filepath);
-                }
-                else
-                {
-                    ErrorMessage("unified2 rotated file: %s.%u\n", u2.filepath, u2.timestamp);
-                }
-
-                if (((fwcount = fwrite(buf, (size_t)buf_len, 1, u2.stream)) == 1) &&
-                    fflush(u2.stream) == 0)
-                {
-                    error = 0;
-                    break;
-                }
-
-                error = errno;
-
-                /* Loop again if interrupt */
-                if (error == EINTR)
-                    break;
-
-                /* Write out error message again, then fall through and fatal */
-                if (config->nostamp)
-                {
-                    ErrorMessage("unified2 failed to write to file (%s): %s\n",
-                        u2.filepath, get_error(error));
-                }
-                else
-                {
-                    ErrorMessage("unified2 failed to write to file (%s.%u): %s\n",
-                        u2.filepath, u2.timestamp, get_error(error));
-                }
-
-            /* Fall through */
-
-            case EAGAIN:      /* We're not in non-blocking mode */
-            case EBADF:
-            case EFAULT:
-            case EFBIG:
-            case EINVAL:
-            case ENOSPC:
-            case EPIPE:
-            default:
-                FatalError("unified2 cannot write to device.\n");
-            }
-        }
+        error = log_write(fd, buf, len);
+    }
 
-        if ((max_retries == 0) && (error != 0))
-        {
-            FatalError("unified2 cannot write to device. "
-                "Maximum number of interrupts exceeded.\n");
-        }
+    if ( error == EINTR )
+    {
+        FatalError("unified2 cannot write to device. "
+            "Maximum number of interrupts exceeded.\n");
+    }
+    else if ( error )
+    {
+        ErrorMessage("unified2 failed to write to file (%s): %s\n",
+            name.c_str(), get_error(error));
+
+        FatalError("unified2 cannot write to device.\n");
     }
 
+    size += len;
+}
+
+static void Unified2Handoff()
+{
+    if ( !u2.pos )
+        return;
+
+    u2.batch = u2.queue->swap(u2.batch, u2.pos);
+    u2.pos = 0;
+}
+
+// without a queue each record is written immediately as before so spoolers
+// see it right away; with one, records are batched and the batch is cut at
+// roll boundaries so the writer rolls at the same record
+static void Unified2Write(uint8_t* buf, uint32_t buf_len, Unified2Config* config)
+{
+    /* Nothing to write or nothing to write to */
+    if ((buf == nullptr) || (config == nullptr) || (u2.file == nullptr))
+        return;
+
+    if ( !u2.queue )
+    {
+        u2.file->write((const char*)buf, buf_len);
+        return;
+    }
+
+    if ( config->limit and u2.current and u2.current + buf_len > config->limit )
+    {
+        Unified2Handoff();
+        u2.current = 0;
+    }
+
+    if ( u2.pos + buf_len > u2_batch_sz )
+        Unified2Handoff();
+
+    memcpy(u2.batch + u2.pos, buf, buf_len);
+    u2.pos += buf_len;
     u2.current += buf_len;
+
+    if ( u2.pos >= u2_batch_sz / 2 or u2.queue->stale(time(nullptr)) )
+        Unified2Handoff();
 }
 
 //--------------------------------------------------------------------------
@@ -700,9 +662,6 @@ static void _AlertIP4_v2(Packet* p, const char*, Unified2Config* config, const E
                 app_name, strlen(app_name) + 1);
     }
 
-    if ( config->limit && (u2.current + write_len) > config->limit )
-        Unified2RotateFile(config);
-
     hdr.length = htonl(sizeof(alertdata));
     hdr.type = htonl(UNIFIED2_IDS_EVENT_VLAN);
 
@@ -789,9 +748,6 @@ static void _AlertIP6_v2(Packet* p, const char*, Unified2Config* config, const E
                 app_name, strlen(app_name) + 1);
     }
 
-    if ( config->limit && (u2.current + write_len) > config->limit )
-        Unified2RotateFile(config);
-
     hdr.length = htonl(sizeof(Unified2IDSEventIPv6));
     hdr.type = htonl(UNIFIED2_IDS_EVENT_IPV6_VLAN);
 
@@ -897,38 +853,45 @@ U2Logger::U2Logger(U2Module* m)
 
 void U2Logger::open()
 {
-    int status;
-
     std::string name;
     get_instance_file(name, F_NAME);
 
-    status = SnortSnprintf(
-        u2.filepath, sizeof(u2.filepath), "%s", name.c_str());
-
-    if (status != SNORT_SNPRINTF_SUCCESS)
-    {
-        FatalError("unified2 failed to copy file name\n");
-    }
     u2.base_proto = htonl(SFDAQ::get_base_protocol());
-
     write_pkt_buffer = new uint8_t[u2_buf_sz];
-    io_buffer = new char[u2_buf_sz];
 
-    Unified2InitFile(&config);
+    u2.file = new U2File(name.c_str(), &config);
+    u2.queue = nullptr;
+    u2.batch = nullptr;
+    u2.pos = u2.current = 0;
+
+    const SnortConfig* sc = SnortConfig::get_conf();
+
+    if ( sc->log_buffers )
+    {
+        u2.queue = new LogQueue(u2.file, sc->log_buffers, u2_batch_sz, sc->log_drop_oldest,
+            Unified2Handoff);
+        u2.batch = (char*)snort_alloc(u2_batch_sz);
+    }
 
     Stream::reg_xtra_data_log(AlertExtraData, &config);
 }
 
 void U2Logger::close()
 {
-    if ( u2.stream )
-        fclose(u2.stream);
+    if ( u2.queue )
+    {
+        Unified2Handoff();
+        delete u2.queue;  // waits for the writer
+        snort_free(u2.batch);
+        u2.queue = nullptr;
+        u2.batch = nullptr;
+    }
 
-    delete[] write_pkt_buffer;
-    delete[] io_buffer;
+    delete u2.file;
+    u2.file = nullptr;
 
+    delete[] write_pkt_buffer;
     write_pkt_buffer = nullptr;
-    io_buffer = nullptr;
 }
 
 void U2Logger::alert_legacy(Packet* p, const char* msg, const Event& event)
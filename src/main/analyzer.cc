@@ -46,6 +46,7 @@
 #include "framework/data_bus.h"
 #include "latency/packet_latency.h"
 #include "latency/rule_latency.h"
+#include "log/log_writer.h"
 #include "log/messages.h"
 #include "main/swapper.h"
 #include "main.h"
@@ -301,6 +302,40 @@ static DAQ_Verdict distill_verdict(Packet* p)
     return verdict;
 }
 
+// Trusted and blocked flows are handed to the DAQ when it can pass or drop
+// them itself.  Packets of an offloaded flow may still arrive, queued before
+// the offload or after the DAQ gave it up, so it is requested again at most
+// once a second.
+static void offload_flow(Packet* p, DAQ_Verdict verdict)
+{
+    Flow* flow = p->flow;
+    uint32_t now = (uint32_t)packet_time();
+
+    if ( flow->flags.offloaded )
+    {
+        daq_stats.offload_packets++;
+
+        if ( now - flow->offload_time < 1 )
+            return;
+    }
+
+    bool drop = (verdict == DAQ_VERDICT_BLACKLIST);
+
+    if ( !p->daq_instance->offload_flow(p->daq_msg, drop, flow->idle_timeout) )
+        return;
+
+    if ( !flow->flags.offloaded )
+    {
+        if ( drop )
+            daq_stats.offloaded_drop++;
+        else
+            daq_stats.offloaded_bypass++;
+
+        flow->flags.offloaded = true;
+    }
+    flow->offload_time = now;
+}
+
 static void packet_trace_dump(Packet* p, DAQ_Verdict verdict, bool msg_was_held)
 {
     PacketTracer::log("Policies: Network %" PRIu64 ", Inspection %" PRIu64 ", Detection %" PRIu64 "\n",
@@ -334,6 +369,9 @@ void Analyzer::post_process_daq_pkt_msg(Packet* p)
 
     DAQ_Verdict verdict = MAX_DAQ_VERDICT;
 
+    // flows that were already trusted or blocked don't wait for the batch
+    const bool early = p->flow and is_sticky_verdict(p->flow->last_verdict);
+
     if (p->active->packet_retry_requested())
     {
         add_to_retry_queue(p->daq_msg, p->flow);
@@ -374,6 +412,9 @@ void Analyzer::post_process_daq_pkt_msg(Packet* p)
         if (verdict == DAQ_VERDICT_BLOCK or verdict == DAQ_VERDICT_BLACKLIST)
             p->active->send_reason_to_daq(*p);
 
+        if (p->flow and (verdict == DAQ_VERDICT_WHITELIST or verdict == DAQ_VERDICT_BLACKLIST))
+            offload_flow(p, verdict);
+
         oops_handler->set_current_message(nullptr, nullptr);
         p->pkth = nullptr;  // No longer avail after finalize_message.
 
@@ -381,6 +422,10 @@ void Analyzer::post_process_daq_pkt_msg(Packet* p)
             // cppcheck-suppress unreadVariable
             Profile profile(daqPerfStats);
             p->daq_instance->finalize_message(p->daq_msg, verdict);
+
+            // only counted when this verdict would otherwise have been held
+            if (early and p->daq_instance->flush_verdicts())
+                daq_stats.early_verdicts++;
         }
     }
     else
@@ -444,6 +489,7 @@ void Analyzer::process_daq_pkt_msg(DAQ_Msg_h msg, bool retry)
     // We must ensure that a context is available when one is needed.
     Stream::handle_timeouts(false);
     HighAvailabilityManager::process_receive();
+    LogQueue::handoff_stale();
 }
 
 void Analyzer::process_daq_msg(DAQ_Msg_h msg, bool retry)
@@ -600,6 +646,8 @@ void Analyzer::idle()
 
     HighAvailabilityManager::process_receive();
 
+    LogQueue::handoff_stale();
+
     handle_uncompleted_commands();
 
     idling = false;
@@ -44,6 +44,7 @@
 #include "host_tracker/host_cache_module.h"
 #include "js_norm/js_norm_module.h"
 #include "latency/latency_module.h"
+#include "log/log_writer.h"
 #include "log/messages.h"
 #include "managers/module_manager.h"
 #include "managers/plugin_manager.h"
@@ -540,6 +541,12 @@ static const Parameter output_event_trace_params[] =
 
 static const Parameter output_params[] =
 {
+    { "async_log_buffers", Parameter::PT_INT, "0:1024", "0",
+      "number of buffers queued per text log for the writer thread; 0 writes on the packet thread" },
+
+    { "async_log_overflow", Parameter::PT_ENUM, "block | drop_oldest", "block",
+      "wait for the writer or drop the oldest queued buffer when a log queue is full" },
+
     { "dump_chars_only", Parameter::PT_BOOL, nullptr, "false",
       "turns on character dumps (same as -C)" },
 
@@ -603,11 +610,23 @@ public:
 
     const RuleMap* get_rules() const override
     { return output_rules; }
+
+    const PegInfo* get_pegs() const override
+    { return log_queue_pegs; }
+
+    PegCount* get_counts() const override
+    { return (PegCount*)&log_queue_stats; }
 };
 
 bool OutputModule::set(const char*, Value& v, SnortConfig* sc)
 {
-    if ( v.is("dump_chars_only") )
+    if ( v.is("async_log_buffers") )
+        sc->log_buffers = v.get_uint16();
+
+    else if ( v.is("async_log_overflow") )
+        sc->log_drop_oldest = v.get_uint8() == 1;
+
+    else if ( v.is("dump_chars_only") )
         v.update_mask(sc->output_flags, OUTPUT_FLAG__CHAR_DATA);
 
     else if ( v.is("dump_payload") )
@@ -205,6 +205,8 @@ public:
 #endif
     uint32_t tagged_packet_limit = 256;
     uint16_t event_trace_max = 0;
+    uint16_t log_buffers = 0;       // per log; 0 writes on the packet thread
+    bool log_drop_oldest = false;
 
     std::string log_dir;
 
@@ -543,6 +543,9 @@ static const Parameter s_params[] =
     { "--pcap-show", Parameter::PT_IMPLIED, nullptr, nullptr,
       "print a line saying what pcap is currently being read" },
 
+    { "--pcap-split", Parameter::PT_IMPLIED, nullptr, nullptr,
+      "read each pcap with all packet threads; use with a DAQ that splits a pcap by flow such as pcap_split" },
+
     { "--pedantic", Parameter::PT_IMPLIED, nullptr, nullptr,
       "warnings are fatal" },
 
@@ -1109,6 +1112,9 @@ bool SnortModule::set(const char*, Value& v, SnortConfig* sc)
     else if ( is(v, "--pcap-show") )
         sc->run_flags |= RUN_FLAG__PCAP_SHOW;
 
+    else if ( is(v, "--pcap-split") )
+        Trough::set_split(true);
+
     else if ( is(v, "--plugin-path") )
         sc->add_plugin_path(v.get_string());
 
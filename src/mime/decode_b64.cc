@@ -24,115 +24,215 @@
 
 #include "decode_b64.h"
 
-#include "utils/util_unfold.h"
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define B64_SIMD
+#endif
+
+#include "file_mime_config.h"
 
-#include "decode_buffer.h"
+#ifdef UNIT_TEST
+#include <cstring>
+#include <string>
+
+#include "catch/snort_catch.h"
+#endif
 
 using namespace snort;
 
-void B64Decode::reset_decode_state()
+uint8_t sf_decode64tab[256] =
 {
-    reset_decoded_bytes();
-    buffer->reset_saved();
-}
+    100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,
+    100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,
+    100,100,100,100,100,100,100,100,100,100,100,62,100,100,100, 63,
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61,100,100,100, 99,100,100,
+    100,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25,100,100,100,100,100,
+    100, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51,100,100,100,100,100,
+    100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,
+    100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,
+    100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,
+    100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,
+    100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,
+    100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,
+    100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,
+    100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,100
+};
 
-DecodeResult B64Decode::decode_data(const uint8_t* start, const uint8_t* end, uint8_t* decode_buf)
+//--------------------------------------------------------------------------
+// bulk decoders
+// each decodes whole groups of 4 base64 alphabet characters and stops at the
+// first group containing anything else, including '=', returning the number
+// of input bytes consumed.  3 bytes are written per group and never more
+// than out_len bytes.
+//--------------------------------------------------------------------------
+
+static unsigned decode_quads_scalar(
+    const uint8_t* in, unsigned in_len, uint8_t* out, unsigned out_len)
 {
-    uint32_t act_encode_size = 0, act_decode_size = 0;
-    uint32_t i = 0;
+    unsigned done = 0;
 
-    if (!buffer->check_restore_buffer() || !decode_buf)
+    while ( in_len - done >= 4 and out_len >= 3 )
     {
-        reset_decode_state();
-        return DECODE_EXCEEDED;
+        uint8_t a = sf_decode64tab[in[done]];
+        uint8_t b = sf_decode64tab[in[done + 1]];
+        uint8_t c = sf_decode64tab[in[done + 2]];
+        uint8_t d = sf_decode64tab[in[done + 3]];
+
+        if ( (a | b | c | d) & 0xc0 )
+            break;
+
+        *out++ = (a << 2) | (b >> 4);
+        *out++ = (b << 4) | (c >> 2);
+        *out++ = (c << 6) | d;
+
+        out_len -= 3;
+        done += 4;
     }
+    return done;
+}
 
-    uint32_t encode_avail = buffer->get_encode_avail() - buffer->get_prev_encoded_bytes();
+#ifdef B64_SIMD
+// Wojciech Mula's pshufb range lookup: the low and high nibble of each
+// character select bit masks that only overlap for characters outside the
+// alphabet, and the high nibble (or the '/' compare) selects the offset that
+// maps the character to its 6 bit value.  The values are then packed 4 to 3.
 
-    if (sf_strip_CRLF(start, (end-start), buffer->get_encode_buff() + buffer->get_prev_encoded_bytes(),
-        encode_avail, &act_encode_size) != 0)
+__attribute__((target("ssse3")))
+static unsigned decode_quads_ssse3(
+    const uint8_t* in, unsigned in_len, uint8_t* out, unsigned out_len)
+{
+    const __m128i lut_lo = _mm_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m128i lut_hi = _mm_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lut_roll = _mm_setr_epi8(
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask_2f = _mm_set1_epi8(0x2f);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i pack = _mm_setr_epi8(
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+    unsigned done = 0;
+
+    // 16 bytes are stored for each 12 decoded
+    while ( in_len - done >= 16 and out_len >= 16 )
     {
-        reset_decode_state();
-        return DECODE_FAIL;
-    }
+        __m128i str = _mm_loadu_si128((const __m128i*)(in + done));
 
-    act_encode_size = act_encode_size + buffer->get_prev_encoded_bytes();
+        __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(str, 4), mask_2f);
+        __m128i lo_nibbles = _mm_and_si128(str, mask_2f);
+        __m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+        __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
 
-    i = (act_encode_size)%4;
+        if ( _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo, hi), zero)) != 0xffff )
+            break;
 
-    /* Encoded data should be in multiples of 4. Then we need to wait for the remainder encoded data to
-     * successfully decode the base64 data. This happens when base64 data is spanned across packets*/
-    if (i)
-    {
-        act_encode_size = act_encode_size - i;
-        buffer->save_buffer(buffer->get_encode_buff() + act_encode_size, i);
-    }
-    else
-        buffer->reset_saved();
+        __m128i eq_2f = _mm_cmpeq_epi8(str, mask_2f);
+        __m128i roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_2f, hi_nibbles));
+        str = _mm_add_epi8(str, roll);
 
-    if (sf_base64decode(buffer->get_encode_buff(), act_encode_size,
-        decode_buf, buffer->get_decode_avail(), &act_decode_size) != 0)
-    {
-        reset_decode_state();
-        return DECODE_FAIL;
-    }
-    else if (!act_decode_size && !encode_avail)
-    {
-        reset_decode_state();
-        return DECODE_FAIL;
-    }
+        str = _mm_maddubs_epi16(str, _mm_set1_epi32(0x01400140));
+        str = _mm_madd_epi16(str, _mm_set1_epi32(0x00011000));
+        str = _mm_shuffle_epi8(str, pack);
 
-    decoded_bytes = act_decode_size;
-    decodePtr = decode_buf;
-    buffer->update_buffer(act_encode_size, act_decode_size);
-    decode_bytes_read = buffer->get_decode_bytes_read();
-    return DECODE_SUCCESS;
+        _mm_storeu_si128((__m128i*)out, str);
+        out += 12;
+        out_len -= 12;
+        done += 16;
+    }
+    return done;
 }
 
-B64Decode::B64Decode(int max_depth, int detect_depth) : DataDecode(max_depth, detect_depth)
+__attribute__((target("avx2")))
+static unsigned decode_quads_avx2(
+    const uint8_t* in, unsigned in_len, uint8_t* out, unsigned out_len)
 {
-    buffer = new DecodeBuffer(max_depth);
+    const __m256i lut_lo = _mm256_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m256i lut_hi = _mm256_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i lut_roll = _mm256_setr_epi8(
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i mask_2f = _mm256_set1_epi8(0x2f);
+    const __m256i pack = _mm256_setr_epi8(
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, -1, -1);
+
+    unsigned done = 0;
+
+    // 32 bytes are stored for each 24 decoded
+    while ( in_len - done >= 32 and out_len >= 32 )
+    {
+        __m256i str = _mm256_loadu_si256((const __m256i*)(in + done));
+
+        __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(str, 4), mask_2f);
+        __m256i lo_nibbles = _mm256_and_si256(str, mask_2f);
+        __m256i lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+        __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+
+        if ( !_mm256_testz_si256(lo, hi) )
+            break;
+
+        __m256i eq_2f = _mm256_cmpeq_epi8(str, mask_2f);
+        __m256i roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(eq_2f, hi_nibbles));
+        str = _mm256_add_epi8(str, roll);
+
+        str = _mm256_maddubs_epi16(str, _mm256_set1_epi32(0x01400140));
+        str = _mm256_madd_epi16(str, _mm256_set1_epi32(0x00011000));
+        str = _mm256_shuffle_epi8(str, pack);
+        str = _mm256_permutevar8x32_epi32(str, lanes);
+
+        _mm256_storeu_si256((__m256i*)out, str);
+        out += 24;
+        out_len -= 24;
+        done += 32;
+    }
+    return done;
 }
+#endif
+
+typedef unsigned (*DecodeQuads)(const uint8_t*, unsigned, uint8_t*, unsigned);
 
-B64Decode::~B64Decode()
+static DecodeQuads select_decode_quads()
 {
-    if (buffer)
-        delete buffer;
+#ifdef B64_SIMD
+    __builtin_cpu_init();
+
+    if ( __builtin_cpu_supports("avx2") )
+        return decode_quads_avx2;
+
+    if ( __builtin_cpu_supports("ssse3") )
+        return decode_quads_ssse3;
+#endif
+    return decode_quads_scalar;
 }
 
-uint8_t sf_decode64tab[256] =
-{
-    100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,
-    100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,
-    100,100,100,100,100,100,100,100,100,100,100,62,100,100,100, 63,
-    52, 53, 54, 55, 56, 57, 58, 59, 60, 61,100,100,100, 99,100,100,
-    100,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
-    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25,100,100,100,100,100,
-    100, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
-    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51,100,100,100,100,100,
-    100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,
-    100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,
-    100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,
-    100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,
-    100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,
-    100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,
-    100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,
-    100,100,100,100,100,100,100,100,100,100,100,100,100,100,100,100
-};
+static const DecodeQuads decode_quads_vector = select_decode_quads();
 
-namespace snort
+static unsigned decode_quads(const uint8_t* in, unsigned in_len, uint8_t* out, unsigned out_len)
 {
-/* base64decode assumes the input data terminates with '=' and/or at the end of the input buffer
- * at inbuf_size.  If extra characters exist within inbuf before inbuf_size is reached, it will
- * happily decode what it can and skip over what it can't.  This is consistent with other decoders
- * out there.  So, either terminate the string, set inbuf_size correctly, or at least be sure the
- * data is valid up until the point you care about.  Note base64 data does NOT have to end with
- * '=' and won't if the number of bytes of input data is evenly divisible by 3.
-*/
-int sf_base64decode(uint8_t* inbuf, uint32_t inbuf_size, uint8_t* outbuf, uint32_t outbuf_size,
-    uint32_t* bytes_written)
+    unsigned done = decode_quads_vector(in, in_len, out, out_len);
+    unsigned written = done / 4 * 3;
+
+    return done + decode_quads_scalar(in + done, in_len - done, out + written, out_len - written);
+}
+
+static int base64_decode(const uint8_t* inbuf, uint32_t inbuf_size, uint8_t* outbuf,
+    uint32_t outbuf_size, uint32_t* bytes_written, uint32_t* bytes_read, uint32_t* line_breaks)
 {
-    uint8_t* cursor, * endofinbuf;
+    const uint8_t* cursor, * endofinbuf;
     uint8_t* outbuf_ptr;
     uint8_t base64data[4], * base64data_ptr; /* temporary holder for current base64 chunk */
     uint8_t tableval_a, tableval_b, tableval_c, tableval_d;
@@ -140,6 +240,10 @@ int sf_base64decode(uint8_t* inbuf, uint32_t inbuf_size, uint8_t* outbuf, uint32
     uint32_t n;
     uint32_t max_base64_chars; /* The max number of decoded base64 chars that fit into outbuf */
 
+    /* input consumed by complete groups and the line breaks within it */
+    const uint8_t* group_end = inbuf;
+    uint32_t breaks = 0, group_breaks = 0;
+
     int error = 0;
 
     /* This algorithm will waste up to 4 bytes but we really don't care.
@@ -157,6 +261,42 @@ int sf_base64decode(uint8_t* inbuf, uint32_t inbuf_size, uint8_t* outbuf, uint32
     outbuf_ptr = outbuf;
     while ((cursor < endofinbuf) && (n < max_base64_chars))
     {
+        /* Between groups skip line breaks and decode runs of complete groups in bulk */
+        if (base64data_ptr == base64data)
+        {
+            while ((*cursor == '\r') || (*cursor == '\n'))
+            {
+                breaks++;
+
+                if (++cursor == endofinbuf)
+                    break;
+            }
+
+            if (cursor == endofinbuf)
+                break;
+
+            uint32_t avail = endofinbuf - cursor;
+
+            if (avail > max_base64_chars - n)
+                avail = max_base64_chars - n;
+
+            uint32_t done = decode_quads(cursor, avail, outbuf_ptr, outbuf_size - *bytes_written);
+
+            cursor += done;
+            n += done;
+            outbuf_ptr += done / 4 * 3;
+            *bytes_written += done / 4 * 3;
+
+            if (done)
+            {
+                group_end = cursor;
+                group_breaks = breaks;
+            }
+
+            if ((cursor == endofinbuf) || (n >= max_base64_chars))
+                break;
+        }
+
         if (sf_decode64tab[*cursor] != 100)
         {
             *base64data_ptr++ = *cursor;
@@ -164,6 +304,8 @@ int sf_base64decode(uint8_t* inbuf, uint32_t inbuf_size, uint8_t* outbuf, uint32
             if (!(n % 4))
             {
                 /* We have four databytes upon which to operate */
+                group_end = cursor + 1;
+                group_breaks = breaks;
 
                 if ((base64data[0] == '=') || (base64data[1] == '='))
                 {
@@ -208,13 +350,400 @@ int sf_base64decode(uint8_t* inbuf, uint32_t inbuf_size, uint8_t* outbuf, uint32
                 base64data_ptr = base64data;
             }
         }
+        else if ((*cursor == '\r') || (*cursor == '\n'))
+            breaks++;
+
         cursor++;
     }
 
+    *bytes_read = group_end - inbuf;
+    *line_breaks = group_breaks;
+
     if (error)
         return(-1);
     else
         return(0);
 }
+namespace snort
+{
+/* base64decode assumes the input data terminates with '=' and/or at the end of the input buffer
+ * at inbuf_size.  If extra characters exist within inbuf before inbuf_size is reached, it will
+ * happily decode what it can and skip over what it can't.  This is consistent with other decoders
+ * out there.  So, either terminate the string, set inbuf_size correctly, or at least be sure the
+ * data is valid up until the point you care about.  Note base64 data does NOT have to end with
+ * '=' and won't if the number of bytes of input data is evenly divisible by 3.
+*/
+int sf_base64decode(uint8_t* inbuf, uint32_t inbuf_size, uint8_t* outbuf, uint32_t outbuf_size,
+    uint32_t* bytes_written)
+{
+    uint32_t bytes_read, line_breaks;
+
+    return base64_decode(inbuf, inbuf_size, outbuf, outbuf_size, bytes_written, &bytes_read,
+        &line_breaks);
+}
 } // namespace snort
 
+//--------------------------------------------------------------------------
+// attachment decoder
+//--------------------------------------------------------------------------
+
+// alphabet characters and the '=' padding, which must stay with its group
+static inline bool is_group_char(uint8_t c)
+{ return sf_decode64tab[c] != 100 or c == '='; }
+
+void B64Decode::reset_decode_state()
+{
+    reset_decoded_bytes();
+    carry_len = 0;
+}
+
+// Base64 is decoded straight from the PDU into the decode buffer, skipping
+// line breaks, so the only data kept between calls is the up to 3 characters
+// of a group split across PDUs.  Encoded bytes count towards the depth
+// without line breaks as when they were stripped into a separate buffer.
+DecodeResult B64Decode::decode_data(const uint8_t* start, const uint8_t* end, uint8_t* decode_buf)
+{
+    uint32_t encode_avail = code_depth ? code_depth - encode_bytes_read : MAX_DEPTH;
+    uint32_t decode_avail = code_depth ? code_depth - decode_bytes_read : MAX_DEPTH;
+
+    if (decode_avail > MAX_DEPTH)
+        decode_avail = MAX_DEPTH;
+
+    if (!encode_avail || !decode_avail || !decode_buf)
+    {
+        reset_decode_state();
+        return DECODE_EXCEEDED;
+    }
+
+    if (carry_len > encode_avail)
+        carry_len = encode_avail;
+
+    // limit the input to the encoded bytes left within the depth
+    uint32_t limit = encode_avail - carry_len;
+    const uint8_t* stop = end;
+
+    if ((uint32_t)(end - start) > limit)
+    {
+        uint32_t n = 0;
+
+        for (stop = start; stop < end && n < limit; ++stop)
+        {
+            if ((*stop != '\r') && (*stop != '\n'))
+                n++;
+        }
+    }
+
+    const uint8_t* ptr = start;
+    uint32_t act_encode_size = 0, act_decode_size = 0;
+
+    // complete the group split across PDUs
+    if (carry_len)
+    {
+        act_encode_size = carry_len;
+
+        while ((carry_len < 4) && (ptr < stop))
+        {
+            if ((*ptr != '\r') && (*ptr != '\n'))
+            {
+                act_encode_size++;
+
+                if (is_group_char(*ptr))
+                    carry[carry_len++] = *ptr;
+            }
+            ptr++;
+        }
+
+        if (carry_len < 4)
+        {
+            // still not a whole group, counted once it is
+            decoded_bytes = 0;
+            return DECODE_SUCCESS;
+        }
+
+        uint32_t read, breaks;
+
+        if (base64_decode(carry, 4, decode_buf, decode_avail, &act_decode_size, &read,
+            &breaks) != 0)
+        {
+            reset_decode_state();
+            return DECODE_FAIL;
+        }
+        carry_len = 0;
+    }
+
+    uint32_t written = 0, read = 0, breaks = 0;
+
+    if (base64_decode(ptr, stop - ptr, decode_buf + act_decode_size,
+        decode_avail - act_decode_size, &written, &read, &breaks) != 0)
+    {
+        reset_decode_state();
+        return DECODE_FAIL;
+    }
+
+    act_decode_size += written;
+    act_encode_size += read - breaks;
+
+    if (!act_decode_size && !limit)
+    {
+        reset_decode_state();
+        return DECODE_FAIL;
+    }
+
+    // save the characters of an incomplete last group, including any
+    // padding that arrived ahead of the rest of the group
+    for (ptr += read; (ptr < stop) && (carry_len < 3); ++ptr)
+    {
+        if (is_group_char(*ptr))
+            carry[carry_len++] = *ptr;
+    }
+
+    decoded_bytes = act_decode_size;
+    decodePtr = decode_buf;
+    encode_bytes_read += act_encode_size;
+    decode_bytes_read += act_decode_size;
+    return DECODE_SUCCESS;
+}
+
+B64Decode::B64Decode(int max_depth, int detect_depth) : DataDecode(max_depth, detect_depth)
+{
+    code_depth = max_depth;
+}
+
+//--------------------------------------------------------------------------
+// unit tests
+//--------------------------------------------------------------------------
+
+#ifdef UNIT_TEST
+static std::string encode(const std::string& s)
+{
+    static const char* abc = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    size_t i = 0;
+
+    for ( ; i + 3 <= s.size(); i += 3 )
+    {
+        uint32_t v = ((uint8_t)s[i] << 16) | ((uint8_t)s[i + 1] << 8) | (uint8_t)s[i + 2];
+        for ( int j = 18; j >= 0; j -= 6 )
+            out += abc[(v >> j) & 0x3f];
+    }
+    if ( i + 1 == s.size() )
+    {
+        uint32_t v = (uint8_t)s[i] << 16;
+        out += abc[v >> 18];
+        out += abc[(v >> 12) & 0x3f];
+        out += "==";
+    }
+    else if ( i + 2 == s.size() )
+    {
+        uint32_t v = ((uint8_t)s[i] << 16) | ((uint8_t)s[i + 1] << 8);
+        out += abc[v >> 18];
+        out += abc[(v >> 12) & 0x3f];
+        out += abc[(v >> 6) & 0x3f];
+        out += '=';
+    }
+    return out;
+}
+
+static std::string decode(std::string in, uint32_t out_size)
+{
+    std::string out(out_size, '\0');
+    uint32_t n = 0;
+    REQUIRE(sf_base64decode((uint8_t*)&in[0], in.size(), (uint8_t*)&out[0], out_size, &n) == 0);
+    out.resize(n);
+    return out;
+}
+
+static std::string make_binary(unsigned size)
+{
+    std::string s;
+    for ( unsigned i = 0; i < size; ++i )
+        s += (char)(i * 2654435761u >> 24);
+    return s;
+}
+
+TEST_CASE("base64 bulk decoders agree", "[base64]")
+{
+    const std::string plain = make_binary(3000);
+    const std::string code = encode(plain);
+
+    std::string expected(plain.size(), '\0');
+    unsigned done = decode_quads_scalar(
+        (const uint8_t*)code.data(), code.size(), (uint8_t*)&expected[0], expected.size());
+
+    CHECK(done == code.size());
+    CHECK(expected == plain);
+
+#ifdef B64_SIMD
+    for ( unsigned off : { 0u, 4u, 16u, 36u } )
+    {
+        std::string out(plain.size() + 32, '\0');
+        unsigned len = code.size() - off;
+
+        if ( __builtin_cpu_supports("ssse3") )
+        {
+            done = decode_quads_ssse3((const uint8_t*)code.data() + off, len,
+                (uint8_t*)&out[0], out.size());
+            CHECK(done > 0);
+            CHECK(!memcmp(out.data(), plain.data() + off / 4 * 3, done / 4 * 3));
+        }
+        if ( __builtin_cpu_supports("avx2") )
+        {
+            done = decode_quads_avx2((const uint8_t*)code.data() + off, len,
+                (uint8_t*)&out[0], out.size());
+            CHECK(done > 0);
+            CHECK(!memcmp(out.data(), plain.data() + off / 4 * 3, done / 4 * 3));
+        }
+    }
+#endif
+}
+
+TEST_CASE("base64 bulk decoders stop at other characters", "[base64]")
+{
+    std::string code = encode(make_binary(300));
+
+    for ( char c : { '=', '\r', '\n', '-', '\x80', '\0' } )
+    {
+        for ( size_t pos : { 0ul, 5ul, 17ul, 38ul, 99ul } )
+        {
+            std::string bad = code;
+            bad[pos] = c;
+
+            std::string out(400, '\0');
+            unsigned done = decode_quads((const uint8_t*)bad.data(), bad.size(),
+                (uint8_t*)&out[0], out.size());
+            CHECK(done == pos / 4 * 4);
+        }
+    }
+}
+
+TEST_CASE("base64 decode with line breaks and padding", "[base64]")
+{
+    for ( unsigned size : { 0u, 1u, 2u, 3u, 57u, 58u, 59u, 1000u, 4097u } )
+    {
+        const std::string plain = make_binary(size);
+        const std::string code = encode(plain);
+
+        std::string lines;
+        for ( size_t i = 0; i < code.size(); i += 76 )
+            lines += code.substr(i, 76) + "\r\n";
+
+        CHECK(decode(code, size + 4) == plain);
+        CHECK(decode(lines, size + 4) == plain);
+
+        // output is truncated at the buffer size
+        if ( size > 2 )
+            CHECK(decode(lines, size - 2) == plain.substr(0, size - 2));
+    }
+}
+
+TEST_CASE("base64 decode invalid", "[base64]")
+{
+    uint8_t out[16];
+    uint32_t n;
+
+    uint8_t pad_first[] = "QUJD=BCD";
+    CHECK(sf_base64decode(pad_first, 8, out, sizeof(out), &n) == -1);
+    CHECK(n == 3);
+
+    uint8_t skipped[] = "QU!JD*QU\nJD";
+    CHECK(sf_base64decode(skipped, 11, out, sizeof(out), &n) == 0);
+    CHECK(n == 6);
+    CHECK(!memcmp(out, "ABCABC", 6));
+}
+
+static std::string decode_chunks(B64Decode& b64, const std::string& code, unsigned seed,
+    DecodeResult& result)
+{
+    static uint8_t decode_buf[MAX_DEPTH];
+    std::string out;
+    size_t off = 0;
+
+    result = DECODE_SUCCESS;
+
+    while ( off < code.size() and result == DECODE_SUCCESS )
+    {
+        seed = seed * 1103515245 + 12345;
+        size_t len = std::min<size_t>(1 + (seed >> 16) % 300, code.size() - off);
+
+        const uint8_t* start = (const uint8_t*)code.data() + off;
+        result = b64.decode_data(start, start + len, decode_buf);
+
+        const uint8_t* buf;
+        uint32_t size;
+
+        if ( result == DECODE_SUCCESS and b64.get_decoded_data(&buf, &size) )
+            out.append((const char*)buf, size);
+
+        off += len;
+    }
+    return out;
+}
+
+TEST_CASE("base64 attachment split across PDUs", "[base64]")
+{
+    const std::string plain = make_binary(20000);
+    const std::string code = encode(plain);
+
+    std::string lines;
+    for ( size_t i = 0; i < code.size(); i += 76 )
+        lines += code.substr(i, 76) + "\r\n";
+
+    for ( unsigned seed : { 1u, 2u, 3u } )
+    {
+        B64Decode b64(0, 0);
+        DecodeResult result;
+
+        CHECK(decode_chunks(b64, lines, seed, result) == plain);
+        CHECK(result == DECODE_SUCCESS);
+    }
+}
+
+TEST_CASE("base64 padding split across PDUs", "[base64]")
+{
+    static uint8_t decode_buf[MAX_DEPTH];
+
+    for ( unsigned size : { 4u, 5u, 61u, 62u } )
+    {
+        const std::string plain = make_binary(size);
+        const std::string code = encode(plain) + "\r\n";
+
+        // split at each point of the padded last group and its line break
+        for ( size_t split = code.size() - 6; split < code.size(); ++split )
+        {
+            B64Decode b64(0, 0);
+            std::string out;
+
+            for ( auto& pdu : { code.substr(0, split), code.substr(split) } )
+            {
+                const uint8_t* start = (const uint8_t*)pdu.data();
+                CHECK(b64.decode_data(start, start + pdu.size(), decode_buf) == DECODE_SUCCESS);
+
+                const uint8_t* buf;
+                uint32_t len;
+
+                if ( b64.get_decoded_data(&buf, &len) )
+                    out.append((const char*)buf, len);
+            }
+            CHECK(out == plain);
+        }
+    }
+}
+
+TEST_CASE("base64 attachment depth", "[base64]")
+{
+    const std::string plain = make_binary(20000);
+    const std::string code = encode(plain);
+
+    std::string lines;
+    for ( size_t i = 0; i < code.size(); i += 76 )
+        lines += code.substr(i, 76) + "\r\n";
+
+    // the depth is in encoded bytes without line breaks
+    B64Decode b64(1000, 0);
+    DecodeResult result;
+
+    std::string out = decode_chunks(b64, lines, 7, result);
+    CHECK(out == plain.substr(0, 750));
+    CHECK(result == DECODE_EXCEEDED);
+}
+#endif
@@ -29,7 +29,6 @@ class B64Decode : public DataDecode
 {
 public:
     B64Decode(int max_depth, int detect_depth);
-    ~B64Decode() override;
 
     // Main function to decode file data
     DecodeResult decode_data(const uint8_t* start, const uint8_t* end, uint8_t* decode_buf) override;
@@ -37,7 +36,12 @@ public:
     void reset_decode_state() override;
 
 private:
-    class DecodeBuffer* buffer = nullptr;
+    int code_depth;
+    uint32_t encode_bytes_read = 0;
+
+    // characters of a group split across calls
+    uint8_t carry[4];
+    uint8_t carry_len = 0;
 };
 
 namespace snort
@@ -24,9 +24,6 @@
 
 #include "decode_qp.h"
 
-#include <cctype>
-#include <cstdlib>
-
 #include "utils/util_unfold.h"
 
 #include "decode_buffer.h"
@@ -99,77 +96,117 @@ QPDecode::~QPDecode()
         delete buffer;
 }
 
+// characters copied as is: printable, blank, CR and LF
+static const bool qp_literal[256] =
+{
+    false, false, false, false, false, false, false, false,
+    false, true,  true,  false, false, true,  false, false,
+    false, false, false, false, false, false, false, false,
+    false, false, false, false, false, false, false, false,
+    true,  true,  true,  true,  true,  true,  true,  true,
+    true,  true,  true,  true,  true,  true,  true,  true,
+    true,  true,  true,  true,  true,  true,  true,  true,
+    true,  true,  true,  true,  true,  true,  true,  true,
+    true,  true,  true,  true,  true,  true,  true,  true,
+    true,  true,  true,  true,  true,  true,  true,  true,
+    true,  true,  true,  true,  true,  true,  true,  true,
+    true,  true,  true,  true,  true,  true,  true,  true,
+    true,  true,  true,  true,  true,  true,  true,  true,
+    true,  true,  true,  true,  true,  true,  true,  true,
+    true,  true,  true,  true,  true,  true,  true,  true,
+    true,  true,  true,  true,  true,  true,  true,  false,
+};
+
+// hex digit values, 0xff if not a hex digit
+static const uint8_t qp_hex[256] =
+{
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+};
+
 int sf_qpdecode(const char* src, uint32_t slen, char* dst, uint32_t dlen, uint32_t* bytes_read,
     uint32_t* bytes_copied)
 {
     if (!src || !slen || !dst || !dlen || !bytes_read || !bytes_copied )
         return -1;
 
-    *bytes_read = 0;
-    *bytes_copied = 0;
+    // work on locals so the compiler can keep them in registers
+    const uint8_t* in = (const uint8_t*)src;
+    uint32_t read = 0;
+    uint32_t copied = 0;
 
-    while ( (*bytes_read < slen) && (*bytes_copied < dlen))
+    while ( (read < slen) && (copied < dlen) )
     {
-        char ch = src[*bytes_read];
-        *bytes_read += 1;
+        // copy a run of literal characters, dropping others
+        const uint8_t* p = in + read;
+        const uint8_t* end = in + slen;
+
+        while ( p < end && *p != '=' && copied < dlen )
+        {
+            if ( qp_literal[*p] )
+                dst[copied++] = (char)*p;
+            ++p;
+        }
+        read = p - in;
+
+        if ( p == end || copied == dlen )
+            break;
+
+        // soft line break or escaped character
+        read += 1;
+
+        if ( read >= slen )
+        {
+            read -= 1;
+            break;
+        }
+
+        if ( in[read] == '\n' )
+        {
+            read += 1;
+            continue;
+        }
 
-        if ( ch == '=' )
+        if ( read >= slen - 1 )
         {
-            if ( (*bytes_read < slen))
-            {
-                if (src[*bytes_read] == '\n')
-                {
-                    *bytes_read += 1;
-                    continue;
-                }
-                else if ( *bytes_read < (slen - 1) )
-                {
-                    char ch1 = src[*bytes_read];
-                    char ch2 = src[*bytes_read + 1];
-                    if ( ch1 == '\r' && ch2 == '\n')
-                    {
-                        *bytes_read += 2;
-                        continue;
-                    }
-                    if (isxdigit((int)ch1) && isxdigit((int)ch2))
-                    {
-                        char hexBuf[3];
-                        char* eptr;
-                        hexBuf[0] = ch1;
-                        hexBuf[1] = ch2;
-                        hexBuf[2] = '\0';
-                        dst[*bytes_copied]= (char)strtoul(hexBuf, &eptr, 16);
-                        if ((*eptr != '\0'))
-                        {
-                            return -1;
-                        }
-                        *bytes_read += 2;
-                        *bytes_copied +=1;
-                        continue;
-                    }
-                    dst[*bytes_copied] = ch;
-                    *bytes_copied +=1;
-                    continue;
-                }
-                else
-                {
-                    *bytes_read -= 1;
-                    return 0;
-                }
-            }
-            else
-            {
-                *bytes_read -= 1;
-                return 0;
-            }
+            read -= 1;
+            break;
         }
-        else if ( isprint(ch) || isblank(ch) || ch == '\r' || ch == '\n' )
+
+        uint8_t ch1 = in[read];
+        uint8_t ch2 = in[read + 1];
+
+        if ( ch1 == '\r' && ch2 == '\n' )
         {
-            dst[*bytes_copied] = ch;
-            *bytes_copied +=1;
+            read += 2;
+            continue;
         }
+
+        if ( qp_hex[ch1] != 0xff && qp_hex[ch2] != 0xff )
+        {
+            dst[copied++] = (char)((qp_hex[ch1] << 4) | qp_hex[ch2]);
+            read += 2;
+            continue;
+        }
+
+        dst[copied++] = '=';
     }
 
+    *bytes_read = read;
+    *bytes_copied = copied;
     return 0;
 }
-
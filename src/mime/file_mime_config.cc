@@ -131,6 +131,16 @@ uint32_t DecodeConfig::get_decompress_buffer_size() const
     return decompress_buffer_size;
 }
 
+void DecodeConfig::set_vba_window_size(uint32_t size)
+{
+    vba_window_size = size;
+}
+
+uint32_t DecodeConfig::get_vba_window_size() const
+{
+    return vba_window_size;
+}
+
 int64_t DecodeConfig::get_file_depth() const
 {
     return file_depth;
@@ -183,5 +193,6 @@ void DecodeConfig::show(bool full) const
     ConfigLogger::log_flag("decompress_zip", decompress_zip);
     ConfigLogger::log_flag("decompress_vba", decompress_vba);
     ConfigLogger::log_value("decompress_buffer_size", decompress_buffer_size);
+    ConfigLogger::log_value("vba_window_size", vba_window_size);
 }
 
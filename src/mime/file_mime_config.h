@@ -28,6 +28,7 @@
 #define DEFAULT_MIME_MEMCAP           838860
 #define DEFAULT_DEPTH                 0
 #define DEFAULT_DECOMP                100000
+#define DEFAULT_VBA_WINDOW            65536
 #define MAX_LOG_MEMCAP                104857600
 #define MIN_LOG_MEMCAP                3276
 #define MIN_MIME_MEM                  3276
@@ -69,6 +70,9 @@ public:
     void set_decompress_buffer_size(uint32_t);
     uint32_t get_decompress_buffer_size() const;
 
+    void set_vba_window_size(uint32_t);
+    uint32_t get_vba_window_size() const;
+
     int64_t get_file_depth() const;
     bool is_decoding_enabled() const;
     void sync_all_depths();
@@ -86,6 +90,7 @@ private:
     bool decompress_zip = false;
     bool decompress_vba = false;
     uint32_t decompress_buffer_size = DEFAULT_DECOMP;
+    uint32_t vba_window_size = DEFAULT_VBA_WINDOW;
     int64_t file_depth = MIN_DEPTH;
     bool decode_enabled = true;
 };
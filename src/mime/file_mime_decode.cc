@@ -24,7 +24,8 @@
 
 #include "file_mime_decode.h"
 
-#include "decompress/file_olefile.h"
+#include "decompress/file_decomp.h"
+#include "file_api/file_service.h"
 #include "utils/util_cstring.h"
 
 #include "decode_b64.h"
@@ -190,65 +191,37 @@ DecodeResult MimeDecode::decompress_data(const uint8_t* buf_in, uint32_t size_in
     default:
         buf_out = decompress_buf;
         size_out = fd_state->Next_Out - decompress_buf;
-        get_ole_data();
+        get_vba_data();
         break;
     }
 
     return result;
 }
 
-void MimeDecode::get_ole_data()
+// The VBA is extracted as the OLE file is inflated and is available from
+// the call that inflates the end of it.
+void MimeDecode::get_vba_data()
 {
-    uint8_t* ole_data_ptr;
-    uint32_t ole_len;
+    uint8_t* buf;
+    uint32_t buf_len;
 
-    fd_state->get_ole_data(ole_data_ptr, ole_len);
-
-    if (ole_data_ptr)
-    {
-        ole_data.set(ole_len, ole_data_ptr, false);
-
-        //Reset the ole data ptr once it is stored in msg body
-        fd_state->ole_data_reset();
-    }
+    if ( fd_state->get_vba_data(buf, buf_len) and buf )
+        decompressed_vba_data.set(buf_len, buf, true);
 }
 
 const BufferData& MimeDecode::get_decomp_vba_data()
 {
-    if (decompressed_vba_data.length() > 0)
-        return decompressed_vba_data;
-
-    if (ole_data.length() <= 0)
+    if (decompressed_vba_data.length() <= 0)
         return BufferData::buffer_null;
 
-    uint8_t* buf = nullptr;
-    uint32_t buf_len = 0;
-
-    VBA_DEBUG(vba_data_trace, DEFAULT_TRACE_OPTION_ID, TRACE_INFO_LEVEL, CURRENT_PACKET,
-               "Found OLE file. Sending %d bytes for the processing.\n",
-                ole_data.length());
-
-    oleprocess(ole_data.data_ptr(), ole_data.length(), buf, buf_len);
-
-    if (buf && buf_len)
-        decompressed_vba_data.set(buf_len, buf, true);
-
     return decompressed_vba_data;
 }
 
 void MimeDecode::clear_decomp_vba_data()
 {
-    ole_data.reset();
     decompressed_vba_data.reset();
 }
 
-const BufferData& MimeDecode::_get_ole_buf()
-{
-    if (ole_data.length() <= 0)
-        return BufferData::buffer_null;
-    return ole_data;
-}
-
 void MimeDecode::file_decomp_reset()
 {
     if ( fd_state == nullptr )
@@ -283,6 +256,7 @@ void MimeDecode::file_decomp_init()
     fd_state->Alert_Context = nullptr;
     fd_state->Compr_Depth = 0;
     fd_state->Decompr_Depth = 0;
+    fd_state->ole_window = FileService::decode_conf.get_vba_window_size();
 
     (void)File_Decomp_Init(fd_state);
 }
@@ -81,19 +81,17 @@ public:
 
     DecodeResult decompress_data(const uint8_t* buf_in, uint32_t size_in,
                                  const uint8_t*& buf_out, uint32_t& size_out);
-    const BufferData& _get_ole_buf();
     const BufferData& get_decomp_vba_data();
     void clear_decomp_vba_data();
 
     static void init();
 
 private:
-    void get_ole_data();
+    void get_vba_data();
     DecodeType decode_type = DECODE_NONE;
     const snort::DecodeConfig* config;
     DataDecode* decoder = nullptr;
     fd_session_t* fd_state = nullptr;
-    BufferData ole_data;
     BufferData decompressed_vba_data;
 };
 
@@ -735,14 +735,6 @@ void MimeSession::set_mime_stats(MimeStats* stats)
     mime_stats = stats;
 }
 
-const BufferData& MimeSession::get_ole_buf()
-{
-    if (!decode_state)
-        return BufferData::buffer_null;
-
-    return decode_state->_get_ole_buf();
-}
-
 const BufferData& MimeSession::get_vba_inspect_buf()
 {
     if (!decode_state)
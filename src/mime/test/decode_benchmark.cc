@@ -0,0 +1,455 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2023-2023 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+
+// decode_benchmark.cc
+
+// Compares the MIME base64 and quoted-printable decoders with the byte at a
+// time versions they replaced on a 1 MiB attachment encoded with 76
+// character lines, the line length mail clients use.
+
+#ifdef BENCHMARK_TEST
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "catch/catch.hpp"
+
+#include "mime/decode_b64.h"
+#include "mime/decode_qp.h"
+#include "utils/util_unfold.h"
+
+using namespace snort;
+
+#define ATTACHMENT_SIZE (1024 * 1024)
+#define LINE_LENGTH 76
+
+extern uint8_t sf_decode64tab[256];
+
+//--------------------------------------------------------------------------
+// reference decoders
+//--------------------------------------------------------------------------
+
+static int legacy_base64decode(uint8_t* inbuf, uint32_t inbuf_size, uint8_t* outbuf,
+    uint32_t outbuf_size, uint32_t* bytes_written)
+{
+    uint8_t* cursor, * endofinbuf;
+    uint8_t* outbuf_ptr;
+    uint8_t base64data[4], * base64data_ptr;
+    uint8_t tableval_a, tableval_b, tableval_c, tableval_d;
+
+    uint32_t n;
+    uint32_t max_base64_chars;
+
+    int error = 0;
+
+    max_base64_chars = (outbuf_size / 3) * 4 + 4;
+
+    base64data_ptr = base64data;
+    endofinbuf = inbuf + inbuf_size;
+
+    n = 0;
+    *bytes_written = 0;
+    cursor = inbuf;
+    outbuf_ptr = outbuf;
+    while ((cursor < endofinbuf) && (n < max_base64_chars))
+    {
+        if (sf_decode64tab[*cursor] != 100)
+        {
+            *base64data_ptr++ = *cursor;
+            n++;
+            if (!(n % 4))
+            {
+                if ((base64data[0] == '=') || (base64data[1] == '='))
+                {
+                    error = 1;
+                    break;
+                }
+
+                tableval_a = sf_decode64tab[base64data[0]];
+                tableval_b = sf_decode64tab[base64data[1]];
+                tableval_c = sf_decode64tab[base64data[2]];
+                tableval_d = sf_decode64tab[base64data[3]];
+
+                if (*bytes_written < outbuf_size)
+                {
+                    *outbuf_ptr++ = (tableval_a << 2) | (tableval_b >> 4);
+                    (*bytes_written)++;
+                }
+
+                if ((base64data[2] != '=') && (*bytes_written < outbuf_size))
+                {
+                    *outbuf_ptr++ = (tableval_b << 4) | (tableval_c >> 2);
+                    (*bytes_written)++;
+                }
+                else
+                    break;
+
+                if ((base64data[3] != '=') && (*bytes_written < outbuf_size))
+                {
+                    *outbuf_ptr++ = (tableval_c << 6) | tableval_d;
+                    (*bytes_written)++;
+                }
+                else
+                    break;
+
+                base64data_ptr = base64data;
+            }
+        }
+        cursor++;
+    }
+
+    return error ? -1 : 0;
+}
+
+static void legacy_strip_CRLF(const uint8_t* inbuf, uint32_t inbuf_size, uint8_t* outbuf,
+    uint32_t outbuf_size, uint32_t* output_bytes)
+{
+    const uint8_t* cursor = inbuf;
+    const uint8_t* endofinbuf = inbuf + inbuf_size;
+    uint8_t* outbuf_ptr = outbuf;
+    uint32_t n = 0;
+
+    while ((cursor < endofinbuf) && (n < outbuf_size))
+    {
+        if ((*cursor != '\n') && (*cursor != '\r'))
+        {
+            *outbuf_ptr++ = *cursor;
+            n++;
+        }
+        cursor++;
+    }
+    *output_bytes = outbuf_ptr - outbuf;
+}
+
+static int legacy_qpdecode(const char* src, uint32_t slen, char* dst, uint32_t dlen,
+    uint32_t* bytes_read, uint32_t* bytes_copied)
+{
+    if (!src || !slen || !dst || !dlen || !bytes_read || !bytes_copied )
+        return -1;
+
+    *bytes_read = 0;
+    *bytes_copied = 0;
+
+    while ( (*bytes_read < slen) && (*bytes_copied < dlen))
+    {
+        char ch = src[*bytes_read];
+        *bytes_read += 1;
+
+        if ( ch == '=' )
+        {
+            if ( (*bytes_read < slen))
+            {
+                if (src[*bytes_read] == '\n')
+                {
+                    *bytes_read += 1;
+                    continue;
+                }
+                else if ( *bytes_read < (slen - 1) )
+                {
+                    char ch1 = src[*bytes_read];
+                    char ch2 = src[*bytes_read + 1];
+                    if ( ch1 == '\r' && ch2 == '\n')
+                    {
+                        *bytes_read += 2;
+                        continue;
+                    }
+                    if (isxdigit((int)ch1) && isxdigit((int)ch2))
+                    {
+                        char hexBuf[3];
+                        char* eptr;
+                        hexBuf[0] = ch1;
+                        hexBuf[1] = ch2;
+                        hexBuf[2] = '\0';
+                        dst[*bytes_copied]= (char)strtoul(hexBuf, &eptr, 16);
+                        if ((*eptr != '\0'))
+                            return -1;
+                        *bytes_read += 2;
+                        *bytes_copied +=1;
+                        continue;
+                    }
+                    dst[*bytes_copied] = ch;
+                    *bytes_copied +=1;
+                    continue;
+                }
+                else
+                {
+                    *bytes_read -= 1;
+                    return 0;
+                }
+            }
+            else
+            {
+                *bytes_read -= 1;
+                return 0;
+            }
+        }
+        else if ( isprint(ch) || isblank(ch) || ch == '\r' || ch == '\n' )
+        {
+            dst[*bytes_copied] = ch;
+            *bytes_copied +=1;
+        }
+    }
+
+    return 0;
+}
+
+//--------------------------------------------------------------------------
+// samples
+//--------------------------------------------------------------------------
+
+static uint32_t rng = 12345;
+
+static uint8_t next_byte()
+{
+    rng = rng * 1103515245 + 12345;
+    return rng >> 16;
+}
+
+static std::string make_base64(unsigned size)
+{
+    static const char* abc = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string code;
+
+    for ( unsigned i = 0; i < size / 3 * 4; ++i )
+        code += abc[next_byte() & 0x3f];
+
+    code += "AB==";
+
+    std::string lines;
+    for ( size_t i = 0; i < code.size(); i += LINE_LENGTH )
+        lines += code.substr(i, LINE_LENGTH) + "\r\n";
+
+    return lines;
+}
+
+// mostly text with some escaped bytes, as for a non-ASCII document
+static std::string make_qp(unsigned size)
+{
+    static const char* hex = "0123456789ABCDEF";
+    std::string qp;
+    unsigned col = 0;
+
+    while ( qp.size() < size )
+    {
+        uint8_t b = next_byte();
+
+        if ( b < 0x10 )
+        {
+            qp += '=';
+            qp += hex[b >> 4];
+            qp += hex[b & 0xf];
+            col += 3;
+        }
+        else
+        {
+            qp += (char)(' ' + b % 94);
+            col += 1;
+        }
+
+        if ( col >= LINE_LENGTH - 4 )
+        {
+            qp += "=\r\n";
+            col = 0;
+        }
+    }
+    return qp;
+}
+
+// random bytes biased towards the special characters
+static std::string make_noise(unsigned size, const char* special)
+{
+    std::string s;
+    unsigned n = strlen(special);
+
+    for ( unsigned i = 0; i < size; ++i )
+    {
+        uint8_t b = next_byte();
+        s += (b & 1) ? special[(b >> 1) % n] : (char)next_byte();
+    }
+    return s;
+}
+
+//--------------------------------------------------------------------------
+// benchmarks
+//--------------------------------------------------------------------------
+
+TEST_CASE("base64 decode", "[mime_decode]")
+{
+    std::string lines = make_base64(ATTACHMENT_SIZE);
+    std::string out(ATTACHMENT_SIZE + 4, '\0');
+    std::string ref(ATTACHMENT_SIZE + 4, '\0');
+    uint32_t n, ref_n;
+
+    std::string stripped(lines.size(), '\0');
+    uint32_t stripped_len = 0;
+    sf_strip_CRLF((const uint8_t*)lines.data(), lines.size(), (uint8_t*)&stripped[0],
+        stripped.size(), &stripped_len);
+    stripped.resize(stripped_len);
+
+    SECTION("same as reference")
+    {
+        for ( std::string* in : { &lines, &stripped } )
+        {
+            int rc = sf_base64decode((uint8_t*)&(*in)[0], in->size(), (uint8_t*)&out[0],
+                out.size(), &n);
+            int ref_rc = legacy_base64decode((uint8_t*)&(*in)[0], in->size(), (uint8_t*)&ref[0],
+                ref.size(), &ref_n);
+
+            CHECK(rc == ref_rc);
+            REQUIRE(n == ref_n);
+            CHECK(out == ref);
+        }
+
+        for ( unsigned i = 0; i < 2000; ++i )
+        {
+            std::string noise = make_base64(next_byte()) +
+                make_noise(next_byte(), "A+/=\r\n-") + make_base64(next_byte());
+            uint32_t size = next_byte();
+
+            int rc = sf_base64decode((uint8_t*)&noise[0], noise.size(), (uint8_t*)&out[0],
+                size, &n);
+            int ref_rc = legacy_base64decode((uint8_t*)&noise[0], noise.size(),
+                (uint8_t*)&ref[0], size, &ref_n);
+
+            CHECK(rc == ref_rc);
+            REQUIRE(n == ref_n);
+            CHECK(!memcmp(out.data(), ref.data(), n));
+
+            sf_strip_CRLF((uint8_t*)noise.data(), noise.size(), (uint8_t*)&out[0], size, &n);
+            legacy_strip_CRLF((uint8_t*)noise.data(), noise.size(), (uint8_t*)&ref[0], size,
+                &ref_n);
+
+            REQUIRE(n == ref_n);
+            CHECK(!memcmp(out.data(), ref.data(), n));
+        }
+    }
+
+    // stripping line breaks into a separate buffer first
+    BENCHMARK("strip and decode")
+    {
+        sf_strip_CRLF((const uint8_t*)lines.data(), lines.size(), (uint8_t*)&stripped[0],
+            stripped.size(), &stripped_len);
+        return sf_base64decode((uint8_t*)&stripped[0], stripped_len, (uint8_t*)&out[0],
+            out.size(), &n);
+    };
+
+    // the attachment decoder in 16 KiB PDUs
+    BENCHMARK("attachment decode")
+    {
+        B64Decode b64(0, 0);
+        uint32_t total = 0;
+
+        for ( size_t off = 0; off < lines.size(); off += 16384 )
+        {
+            const uint8_t* start = (const uint8_t*)lines.data() + off;
+            const uint8_t* end = start + std::min<size_t>(16384, lines.size() - off);
+            const uint8_t* buf;
+
+            b64.decode_data(start, end, (uint8_t*)&out[0]);
+            total += b64.get_decoded_data(&buf, &n);
+        }
+        return total;
+    };
+
+    BENCHMARK("reference strip and decode")
+    {
+        legacy_strip_CRLF((const uint8_t*)lines.data(), lines.size(), (uint8_t*)&stripped[0],
+            stripped.size(), &stripped_len);
+        return legacy_base64decode((uint8_t*)&stripped[0], stripped_len, (uint8_t*)&out[0],
+            out.size(), &n);
+    };
+
+    BENCHMARK("decode lines")
+    {
+        return sf_base64decode((uint8_t*)&lines[0], lines.size(), (uint8_t*)&out[0],
+            out.size(), &n);
+    };
+
+    BENCHMARK("reference decode lines")
+    {
+        return legacy_base64decode((uint8_t*)&lines[0], lines.size(), (uint8_t*)&out[0],
+            out.size(), &n);
+    };
+
+    BENCHMARK("decode stripped")
+    {
+        return sf_base64decode((uint8_t*)&stripped[0], stripped.size(), (uint8_t*)&out[0],
+            out.size(), &n);
+    };
+
+    BENCHMARK("reference decode stripped")
+    {
+        return legacy_base64decode((uint8_t*)&stripped[0], stripped.size(), (uint8_t*)&out[0],
+            out.size(), &n);
+    };
+}
+
+TEST_CASE("quoted-printable decode", "[mime_decode]")
+{
+    std::string qp = make_qp(ATTACHMENT_SIZE);
+    std::string out(qp.size(), '\0');
+    std::string ref(qp.size(), '\0');
+    uint32_t read, n, ref_read, ref_n;
+
+    SECTION("same as reference")
+    {
+        sf_qpdecode(qp.data(), qp.size(), &out[0], out.size(), &read, &n);
+        legacy_qpdecode(qp.data(), qp.size(), &ref[0], ref.size(), &ref_read, &ref_n);
+
+        CHECK(read == ref_read);
+        REQUIRE(n == ref_n);
+        CHECK(out == ref);
+
+        for ( unsigned i = 0; i < 2000; ++i )
+        {
+            std::string noise = make_noise(next_byte(), "=\r\n0aFz \t");
+            uint32_t size = next_byte() + 1;
+
+            if ( noise.empty() )
+                continue;
+
+            sf_qpdecode(noise.data(), noise.size(), &out[0], size, &read, &n);
+            legacy_qpdecode(noise.data(), noise.size(), &ref[0], size, &ref_read, &ref_n);
+
+            CHECK(read == ref_read);
+            REQUIRE(n == ref_n);
+            CHECK(!memcmp(out.data(), ref.data(), n));
+        }
+    }
+
+    BENCHMARK("decode")
+    {
+        sf_qpdecode(qp.data(), qp.size(), &out[0], out.size(), &read, &n);
+        return n;
+    };
+
+    BENCHMARK("reference decode")
+    {
+        legacy_qpdecode(qp.data(), qp.size(), &out[0], out.size(), &read, &n);
+        return n;
+    };
+}
+
+#endif
@@ -24,6 +24,7 @@
 #include "norm.h"
 #include "norm_stats.h"
 
+#include "codecs/ip/checksum.h"
 #include "detection/ips_context.h"
 #include "main/snort_config.h"
 #include "packet_io/sfdaq.h"
@@ -68,6 +69,7 @@ int Norm_Packet(NormalizerConfig* c, Packet* p)
 
     if ( changes > 0 )
     {
+        p->set_cksums_adjusted();
         p->packet_flags |= PKT_MODIFIED;
         return 1;
     }
@@ -84,9 +86,10 @@ int Norm_Packet(NormalizerConfig* c, Packet* p)
 // avoided to ensure that we don't get tripped up by nested protocols.
 // TCP options count and length are a notable exception.
 //
-// also note that checksums are not calculated here.  they are only
-// calculated once after all normalizations are done (here, stream)
-// and any replacements are made.
+// also note that checksums are not calculated here.  they are updated
+// incrementally for the modified words of each header and only calculated
+// again after all normalizations are done (here, stream) if the packet is
+// tunneled, resized, or has replacements.
 //-----------------------------------------------------------------------
 
 #if 0
@@ -103,6 +106,9 @@ static int Norm_Eth(Packet* p, uint8_t layer, int changes)
 #define IP4_FLAG_DF 0x4000
 #define IP4_FLAG_MF 0x2000
 
+// ip4 and tcp header lengths are given in 4 byte words with 4 bits
+#define MAX_HDR_LEN 60
+
 // TBD support configurable minimum length / obtain from DAQ
 // ether header + min payload (excludes FCS, which makes it 64 total)
 #define ETH_MIN_LEN 60
@@ -128,6 +134,13 @@ static int Norm_IP4(
     uint16_t origbits = fragbits;
     const NormMode mode = get_norm_mode(p);
 
+    const uint16_t hlen = p->layers[layer].length;
+    const int orig_changes = changes;
+    uint8_t orig[MAX_HDR_LEN];
+
+    if ( mode == NORM_MODE_ON )
+        memcpy(orig, h, hlen);
+
     if ( Norm_IsEnabled(c, NORM_IP4_TRIM) && (layer == 1) )
     {
         uint32_t len = p->layers[0].length + ntohs(h->ip_len);
@@ -217,6 +230,9 @@ static int Norm_IP4(
         }
         norm_stats[PC_IP4_OPTS][mode]++;
     }
+    if ( changes > orig_changes )
+        checksum::update_cksum(h->ip_csum, orig, h, hlen);
+
     return changes;
 }
 
@@ -233,7 +249,10 @@ static int Norm_ICMP4(
     {
         if ( mode == NORM_MODE_ON )
         {
+            uint8_t orig[2];
+            memcpy(orig, h, sizeof(orig));
             h->code = icmp::IcmpCode::ECHO_CODE;
+            checksum::update_cksum(h->csum, orig, h, sizeof(orig));
             changes++;
         }
         norm_stats[PC_ICMP4_ECHO][mode]++;
@@ -282,7 +301,10 @@ static int Norm_ICMP6(
 
         if ( mode == NORM_MODE_ON )
         {
+            uint8_t orig[2];
+            memcpy(orig, h, sizeof(orig));
             h->code = static_cast<icmp::IcmpCode>(0);
+            checksum::update_cksum(h->csum, orig, h, sizeof(orig));
             changes++;
         }
         norm_stats[PC_ICMP6_ECHO][mode]++;
@@ -449,6 +471,13 @@ static int Norm_TCP(
     tcp::TCPHdr* h = reinterpret_cast<tcp::TCPHdr*>(const_cast<uint8_t*>(p->layers[layer].start));
     const NormMode mode = get_norm_mode(p);
 
+    const uint16_t hlen = h->hlen();
+    const int orig_changes = changes;
+    uint8_t orig[MAX_HDR_LEN];
+
+    if ( mode == NORM_MODE_ON )
+        memcpy(orig, h, hlen);
+
     if ( Norm_IsEnabled(c, NORM_TCP_RSV) )
     {
         if ( h->th_offx2 & TH_RSV )
@@ -555,6 +584,9 @@ static int Norm_TCP(
                 tcp_options_len, valid_opts_len, changes);
         }
     }
+    if ( changes > orig_changes )
+        checksum::update_cksum(h->th_sum, orig, h, hlen);
+
     return changes;
 }
 
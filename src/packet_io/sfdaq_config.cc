@@ -127,5 +127,9 @@ void SFDAQConfig::overlay(const SFDAQConfig* other)
         batch_size = other->batch_size;
     if (other->mru_size != SNAPLEN_UNSET)
         mru_size = other->mru_size;
+    if (other->prefetch_depth != PREFETCH_DEPTH_UNSET)
+        prefetch_depth = other->prefetch_depth;
+    if (other->batch_verdicts)
+        batch_verdicts = true;
     timeout = other->timeout;
 }
@@ -62,6 +62,8 @@ struct SFDAQConfig
 
     uint32_t get_batch_size() const { return (batch_size == BATCH_SIZE_UNSET) ? BATCH_SIZE_DEFAULT : batch_size; }
     uint32_t get_mru_size() const { return (mru_size == SNAPLEN_UNSET) ? SNAPLEN_DEFAULT : mru_size; }
+    unsigned get_prefetch_depth() const
+    { return (prefetch_depth == PREFETCH_DEPTH_UNSET) ? PREFETCH_DEPTH_DEFAULT : prefetch_depth; }
 
     void overlay(const SFDAQConfig*);
 
@@ -72,13 +74,17 @@ struct SFDAQConfig
     uint32_t batch_size;
     int mru_size;
     unsigned int timeout;
+    int prefetch_depth = PREFETCH_DEPTH_UNSET;
+    bool batch_verdicts = false;
     std::vector<SFDAQModuleConfig*> module_configs;
 
     /* Constants */
     static constexpr uint32_t BATCH_SIZE_UNSET = 0;
     static constexpr int SNAPLEN_UNSET = -1;
+    static constexpr int PREFETCH_DEPTH_UNSET = -1;
     static constexpr uint32_t BATCH_SIZE_DEFAULT = 64;
     static constexpr int SNAPLEN_DEFAULT = 1518;
+    static constexpr int PREFETCH_DEPTH_DEFAULT = 2;
     static constexpr unsigned TIMEOUT_DEFAULT = 1000;
 };
 
@@ -26,6 +26,7 @@
 
 #include <daq.h>
 
+#include "daqs/daq_user.h"
 #include "log/messages.h"
 #include "main/snort_config.h"
 #include "protocols/packet.h"
@@ -44,11 +45,16 @@ SFDAQInstance::SFDAQInstance(const char* input, unsigned id, const SFDAQConfig*
     instance_id = id + 1;
     batch_size = cfg->get_batch_size();
     daq_msgs = new DAQ_Msg_h[batch_size];
+    prefetch_depth = cfg->get_prefetch_depth();
+
+    if (cfg->batch_verdicts)
+        held_verdicts = new HeldVerdict[batch_size];
 }
 
 SFDAQInstance::~SFDAQInstance()
 {
     delete[] daq_msgs;
+    delete[] held_verdicts;
     if (instance)
         daq_instance_destroy(instance);
 }
@@ -187,6 +193,8 @@ DAQ_RecvStatus SFDAQInstance::receive_messages(unsigned max_recv)
 {
     assert(max_recv <= batch_size);
 
+    flush_verdicts();
+
     if (max_recv > pool_available)
         max_recv = pool_available;
 
@@ -194,18 +202,103 @@ DAQ_RecvStatus SFDAQInstance::receive_messages(unsigned max_recv)
     curr_batch_size = daq_instance_msg_receive(instance, max_recv, daq_msgs, &rstat);
     pool_available -= curr_batch_size;
     curr_batch_idx = 0;
+    batch_time = SnortClock::now();
+
+    for (unsigned i = 0; i < prefetch_depth; i++)
+        prefetch(i);
 
     return rstat;
 }
 
+// Packet data is usually cold when first touched, having just been written by
+// the NIC, so it is prefetched prefetch_depth messages ahead of processing.
+// Reading the data pointer touches the message descriptor, so descriptors
+// are prefetched twice as far ahead.
+void SFDAQInstance::prefetch(unsigned idx)
+{
+    unsigned desc_idx = idx + prefetch_depth;
+
+    if (desc_idx < curr_batch_size)
+    {
+        __builtin_prefetch(daq_msgs[desc_idx]);
+        daq_stats.prefetched_descs++;
+    }
+
+    if (idx < curr_batch_size)
+    {
+        const DAQ_Msg_t* msg = daq_msgs[idx];
+        __builtin_prefetch(msg->hdr);
+        __builtin_prefetch(msg->data);
+        __builtin_prefetch(msg->data + 64);
+        daq_stats.prefetched_data++;
+    }
+}
+
+void SFDAQInstance::record_latency(hr_time now)
+{
+    auto usecs = clock_usecs(TO_USECS(now - batch_time));
+
+    if (usecs < 10)
+        daq_stats.verdict_latency[0]++;
+    else if (usecs < 100)
+        daq_stats.verdict_latency[1]++;
+    else if (usecs < 1000)
+        daq_stats.verdict_latency[2]++;
+    else if (usecs < 10000)
+        daq_stats.verdict_latency[3]++;
+    else
+        daq_stats.verdict_latency[4]++;
+}
+
+// latency is only known for the message most recently taken from the
+// current batch, which is the usual case; held, retried, and other
+// messages are not counted
 int SFDAQInstance::finalize_message(DAQ_Msg_h msg, DAQ_Verdict verdict)
 {
+    bool timed = is_current(msg);
+
+    if (held_verdicts)
+    {
+        if (num_held == batch_size)
+            flush_verdicts();
+
+        held_verdicts[num_held++] = { msg, verdict, timed };
+        return DAQ_SUCCESS;
+    }
+
     int rval = daq_instance_msg_finalize(instance, msg, verdict);
     if (rval == DAQ_SUCCESS)
         pool_available++;
+
+    if (timed)
+        record_latency(SnortClock::now());
+
     return rval;
 }
 
+bool SFDAQInstance::flush_verdicts()
+{
+    if (!num_held)
+        return false;
+
+    hr_time now = SnortClock::now();
+
+    for (unsigned i = 0; i < num_held; i++)
+    {
+        const HeldVerdict& hv = held_verdicts[i];
+
+        if (daq_instance_msg_finalize(instance, hv.msg, hv.verdict) == DAQ_SUCCESS)
+            pool_available++;
+
+        if (hv.timed)
+            record_latency(now);
+    }
+
+    daq_stats.batched_verdicts += num_held;
+    num_held = 0;
+    return true;
+}
+
 const char* SFDAQInstance::get_error()
 {
     return daq_instance_get_error(instance);
@@ -257,6 +350,7 @@ bool SFDAQInstance::was_started() const
 
 bool SFDAQInstance::stop()
 {
+    flush_verdicts();
     assert(pool_size == pool_available);
 
     if (!was_started())
@@ -311,6 +405,25 @@ int SFDAQInstance::modify_flow_opaque(DAQ_Msg_h msg, uint32_t opaque)
     return daq_instance_ioctl(instance, DIOCTL_SET_FLOW_OPAQUE, &d_sfo, sizeof(d_sfo));
 }
 
+bool SFDAQInstance::offload_flow(DAQ_Msg_h msg, bool drop, uint32_t timeout)
+{
+    if (!offload_supported)
+        return false;
+
+    DIOCTL_SetFlowOffload d_sfo;
+
+    d_sfo.msg = msg;
+    d_sfo.action = drop ? DAQ_OFFLOAD_DROP : DAQ_OFFLOAD_BYPASS;
+    d_sfo.timeout = timeout;
+
+    int rval = daq_instance_ioctl(instance, DIOCTL_SET_FLOW_OFFLOAD, &d_sfo, sizeof(d_sfo));
+
+    if (rval == DAQ_ERROR_NOTSUP)
+        offload_supported = false;
+
+    return rval == DAQ_SUCCESS;
+}
+
 int SFDAQInstance::set_packet_verdict_reason(DAQ_Msg_h msg, uint8_t verdict_reason)
 {
     DIOCTL_SetPacketVerdictReason d_spvr;
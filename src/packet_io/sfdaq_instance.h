@@ -28,6 +28,7 @@
 
 #include "main/snort_types.h"
 #include "protocols/protocol_ids.h"
+#include "time/clock_defs.h"
 
 struct SFDAQConfig;
 
@@ -53,10 +54,18 @@ public:
     DAQ_Msg_h next_message()
     {
         if (curr_batch_idx < curr_batch_size)
+        {
+            if (prefetch_depth)
+                prefetch(curr_batch_idx + prefetch_depth);
             return daq_msgs[curr_batch_idx++];
+        }
         return nullptr;
     }
+    // verdicts may be held and submitted in order when the next batch is
+    // received; flush_verdicts() submits any that are held now and returns
+    // false if there were none
     int finalize_message(DAQ_Msg_h msg, DAQ_Verdict verdict);
+    bool flush_verdicts();
     const char* get_error();
 
     int get_base_protocol() const;
@@ -76,6 +85,10 @@ public:
 
     SO_PUBLIC int ioctl(DAQ_IoctlCmd cmd, void *arg, size_t arglen);
     SO_PUBLIC int modify_flow_opaque(DAQ_Msg_h, uint32_t opaque);
+    // ask the DAQ to pass or drop the rest of the flow of msg itself until
+    // it is idle for timeout secs; false if it can't, and after the first
+    // DAQ_ERROR_NOTSUP it isn't asked again
+    bool offload_flow(DAQ_Msg_h, bool drop, uint32_t timeout);
     int set_packet_verdict_reason(DAQ_Msg_h msg, uint8_t verdict_reason);
     int set_packet_trace_data(DAQ_Msg_h, uint8_t* buff, uint32_t buff_len);
     int add_expected(const Packet* ctrlPkt, const SfIp* cliIP, uint16_t cliPort,
@@ -84,7 +97,18 @@ public:
     bool get_tunnel_bypass(uint16_t proto);
 
 private:
+    struct HeldVerdict
+    {
+        DAQ_Msg_h msg;
+        DAQ_Verdict verdict;
+        bool timed;
+    };
+
     void get_tunnel_capabilities();
+    void prefetch(unsigned idx);
+    bool is_current(DAQ_Msg_h msg) const
+    { return curr_batch_idx and daq_msgs[curr_batch_idx - 1] == msg; }
+    void record_latency(hr_time now);
 
     std::string input_spec;
     uint32_t instance_id;
@@ -92,12 +116,17 @@ private:
     DAQ_Msg_h* daq_msgs;
     unsigned curr_batch_size = 0;
     unsigned curr_batch_idx = 0;
+    hr_time batch_time;
+    HeldVerdict* held_verdicts = nullptr;
+    unsigned num_held = 0;
     uint32_t batch_size;
+    unsigned prefetch_depth;
     uint32_t pool_size = 0;
     uint32_t pool_available = 0;
     int dlt = -1;
     DAQ_Stats_t daq_instance_stats = { };
     uint16_t daq_tunnel_mask = 0;
+    bool offload_supported = true;
 };
 }
 #endif
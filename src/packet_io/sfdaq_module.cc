@@ -26,12 +26,14 @@
 
 #include <cassert>
 
+#include "daqs/daq_user.h"
 #include "log/messages.h"
 #include "main/snort_config.h"
 
 #include "active.h"
 #include "sfdaq.h"
 #include "sfdaq_config.h"
+#include "sfdaq_instance.h"
 #include "trough.h"
 
 using namespace snort;
@@ -78,6 +80,8 @@ static const Parameter s_params[] =
     { "inputs", Parameter::PT_LIST, input_list_param, nullptr, "input sources" },
     { "snaplen", Parameter::PT_INT, "0:65535", "1518", "set snap length (same as -s)" },
     { "batch_size", Parameter::PT_INT, "1:", "64", "set receive batch size (same as --daq-batch-size)" },
+    { "prefetch_depth", Parameter::PT_INT, "0:16", "2", "prefetch packets this many messages ahead of processing (0 to disable)" },
+    { "batch_verdicts", Parameter::PT_BOOL, nullptr, "false", "hold verdicts and submit them together before the next receive" },
     { "modules", Parameter::PT_LIST, daq_module_param, nullptr, "DAQ modules to use" },
 
     { nullptr, Parameter::PT_MAX, nullptr, nullptr, nullptr }
@@ -122,6 +126,14 @@ bool SFDAQModule::set(const char* fqn, Value& v, SnortConfig*)
     {
         config->set_batch_size(v.get_uint32());
     }
+    else if (!strcmp(fqn, "daq.prefetch_depth"))
+    {
+        config->prefetch_depth = v.get_int32();
+    }
+    else if (!strcmp(fqn, "daq.batch_verdicts"))
+    {
+        config->batch_verdicts = v.get_bool();
+    }
     else if (!strcmp(fqn, "daq.modules.name"))
     {
         module_config->name = v.get_string();
@@ -206,11 +218,28 @@ const PegInfo daq_names[] =
     { CountType::SUM, "sof_messages", "start of flow messages received from DAQ" },
     { CountType::SUM, "eof_messages", "end of flow messages received from DAQ" },
     { CountType::SUM, "other_messages", "messages received from DAQ with unrecognized message type" },
+    { CountType::SUM, "batched_verdicts", "verdicts held and submitted with the next receive" },
+    { CountType::SUM, "early_verdicts", "held verdicts of trusted or blocked flows submitted without waiting for the next receive" },
+    { CountType::SUM, "offloaded_bypass", "trusted flows offloaded to the DAQ to be passed" },
+    { CountType::SUM, "offloaded_drop", "blocked flows offloaded to the DAQ to be dropped" },
+    { CountType::SUM, "offload_packets", "packets of offloaded flows still received from DAQ" },
+    { CountType::SUM, "prefetched_descs", "message descriptors prefetched ahead of their packet data" },
+    { CountType::SUM, "prefetched_data", "packet headers and data prefetched ahead of processing" },
+    { CountType::SUM, "ring_drops", "messages passed uninspected by the rss DAQ because a ring was full" },
+    { CountType::MAX, "ring_imbalance", "percent the busiest rss DAQ ring is above the mean" },
+
+    // Must align with DAQStats::verdict_latency
+    { CountType::SUM, "verdicts_under_10us", "verdicts submitted within 10 usecs of receipt" },
+    { CountType::SUM, "verdicts_under_100us", "verdicts submitted within 100 usecs of receipt" },
+    { CountType::SUM, "verdicts_under_1ms", "verdicts submitted within 1 msec of receipt" },
+    { CountType::SUM, "verdicts_under_10ms", "verdicts submitted within 10 msecs of receipt" },
+    { CountType::SUM, "verdicts_over_10ms", "verdicts submitted 10 msecs or more after receipt" },
     { CountType::END, nullptr, nullptr }
 };
 
 THREAD_LOCAL DAQStats daq_stats;
 static THREAD_LOCAL DAQ_Stats_t prev_daq_stats;
+static THREAD_LOCAL uint64_t prev_ring_drops;
 
 const PegInfo* SFDAQModule::get_pegs() const
 {
@@ -275,6 +304,18 @@ void SFDAQModule::prep_counts(bool dump_stats)
     if ( daq_stats.outstanding > daq_stats.outstanding_max )
         daq_stats.outstanding_max = daq_stats.outstanding;
 
+    // only the rss DAQ supports this
+    DIOCTL_GetRssStats rss;
+
+    if ( SFDAQ::get_local_instance()->ioctl(DIOCTL_GET_RSS_STATS, &rss, sizeof(rss)) == DAQ_SUCCESS )
+    {
+        daq_stats.ring_drops = rss.ring_drops - prev_ring_drops;
+        daq_stats.ring_imbalance = rss.imbalance;
+
+        if ( !dump_stats )
+            prev_ring_drops = rss.ring_drops;
+    }
+
     if ( !dump_stats )
         prev_daq_stats = new_daq_stats;
 }
@@ -285,6 +326,11 @@ void SFDAQModule::reset_stats()
     {
         DAQ_Stats_t new_daq_stats = *SFDAQ::get_stats();
         prev_daq_stats = new_daq_stats;
+
+        DIOCTL_GetRssStats rss;
+
+        if ( SFDAQ::get_local_instance()->ioctl(DIOCTL_GET_RSS_STATS, &rss, sizeof(rss)) == DAQ_SUCCESS )
+            prev_ring_drops = rss.ring_drops;
     }
     Trough::clear_file_count();
     Module::reset_stats();
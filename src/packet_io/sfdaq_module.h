@@ -79,6 +79,16 @@ struct DAQStats
     PegCount sof_messages;
     PegCount eof_messages;
     PegCount other_messages;
+    PegCount batched_verdicts;
+    PegCount early_verdicts;
+    PegCount offloaded_bypass;
+    PegCount offloaded_drop;
+    PegCount offload_packets;
+    PegCount prefetched_descs;
+    PegCount prefetched_data;
+    PegCount ring_drops;
+    PegCount ring_imbalance;
+    PegCount verdict_latency[5];
 };
 
 extern THREAD_LOCAL DAQStats daq_stats;
@@ -32,6 +32,7 @@
 #include "helpers/directory.h"
 #include "log/messages.h"
 #include "main/snort_config.h"
+#include "main/thread_config.h"
 #include "utils/util.h"
 
 using namespace snort;
@@ -42,6 +43,10 @@ std::string Trough::pcap_filter = "*.*cap*";
 std::vector<std::string>::const_iterator Trough::pcap_queue_iter;
 
 unsigned Trough::pcap_loop_count = 0;
+bool Trough::pcap_split = false;
+unsigned Trough::pcap_split_count = 0;
+unsigned Trough::pcap_split_pending = 0;
+const char* Trough::pcap_split_source = nullptr;
 std::atomic<unsigned> Trough::file_count{0};
 
 bool Trough::add_pcaps_dir(const std::string& dirname, const std::string& filter)
@@ -229,18 +234,30 @@ void Trough::setup()
         pcap_queue_iter = pcap_queue.cbegin();
     }
     pcap_filter.clear();
+
+    if (pcap_split)
+        pcap_split_count = ThreadConfig::get_instance_max();
 }
 
 void Trough::cleanup()
 {
     /* clean up pcap queues */
     pcap_queue.clear();
+    pcap_split_pending = 0;
+    pcap_split_source = nullptr;
 }
 
 const char* Trough::get_next()
 {
     const char* pcap = nullptr;
 
+    /* The same pcap goes to each packet thread before moving on. */
+    if (pcap_split_pending)
+    {
+        pcap_split_pending--;
+        return pcap_split_source;
+    }
+
     if (pcap_queue.empty() || pcap_queue_iter == pcap_queue.cend())
         return nullptr;
 
@@ -254,12 +271,19 @@ const char* Trough::get_next()
         pcap_queue_iter = pcap_queue.cbegin();
     }
 
+    if (pcap_split_count > 1)
+    {
+        pcap_split_pending = pcap_split_count - 1;
+        pcap_split_source = pcap;
+    }
+
     file_count++;
     return pcap;
 }
 
 bool Trough::has_next()
 {
-    return (!pcap_queue.empty() && pcap_queue_iter != pcap_queue.cend());
+    return (pcap_split_pending ||
+        (!pcap_queue.empty() && pcap_queue_iter != pcap_queue.cend()));
 }
 
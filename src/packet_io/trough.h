@@ -40,6 +40,12 @@ public:
     {
         pcap_loop_count = c;
     }
+    // hand each pcap to every packet thread, for DAQs that divide a
+    // capture among the threads reading it
+    static void set_split(bool s)
+    {
+        pcap_split = s;
+    }
     static void set_filter(const char *f);
     static void add_source(SourceType type, const char *list);
     static void setup();
@@ -81,6 +87,10 @@ private:
     static std::string pcap_filter;
 
     static unsigned pcap_loop_count;
+    static bool pcap_split;
+    static unsigned pcap_split_count;
+    static unsigned pcap_split_pending;
+    static const char* pcap_split_source;
     static std::atomic<unsigned> file_count;
 };
 
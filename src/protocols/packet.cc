@@ -108,6 +108,35 @@ void Packet::release_helpers()
     }
 }
 
+void Packet::set_cksums_adjusted()
+{
+    if ( (packet_flags & PKT_MODIFIED) and !cksums_adjusted() )
+        return;
+
+    // checksums of outer layers may cover the modified headers
+    unsigned ip_layers = 0;
+
+    for ( unsigned i = 0; i < num_layers; ++i )
+    {
+        switch ( layers[i].prot_id )
+        {
+        case ProtocolId::ETHERTYPE_IPV4:
+        case ProtocolId::ETHERTYPE_IPV6:
+        case ProtocolId::IPIP:
+        case ProtocolId::IPV6:
+            ++ip_layers;
+            break;
+        default:
+            break;
+        }
+    }
+
+    if ( ip_layers == 1 )
+        ts_packet_flags |= TS_PKT_CKSUMS_ADJUSTED;
+    else
+        clear_cksums_adjusted();
+}
+
 bool Packet::get_ip_proto_next(uint8_t& lyr, IpProtocol& proto) const
 {
     if (lyr > num_layers)
@@ -87,6 +87,7 @@ class SFDAQInstance;
 #define PKT_TCP_PSEUDO_EST        0x80000000 // A one-sided or bidirectional without LWS TCP session was detected
 
 #define TS_PKT_OFFLOADED          0x01
+#define TS_PKT_CKSUMS_ADJUSTED    0x02  // modifications so far kept checksums current
 
 #define PKT_PDU_FULL (PKT_PDU_HEAD | PKT_PDU_TAIL)
 
@@ -324,6 +325,17 @@ struct SO_PUBLIC Packet
     void clear_offloaded()
     { ts_packet_flags &= (~TS_PKT_OFFLOADED); }
 
+    // header modifications which update checksums incrementally say so
+    // before setting PKT_MODIFIED so the checksums needn't be recomputed;
+    // any other modification of the packet clears this
+    void set_cksums_adjusted();
+
+    bool cksums_adjusted() const
+    { return (ts_packet_flags & TS_PKT_CKSUMS_ADJUSTED) != 0; }
+
+    void clear_cksums_adjusted()
+    { ts_packet_flags &= (~TS_PKT_CKSUMS_ADJUSTED); }
+
     bool has_parent() const
     { return (packet_flags & PKT_HAS_PARENT) != 0; }
 
@@ -24,22 +24,36 @@
 #include "packet_manager.h"
 
 #include <daq.h>
+#include <algorithm>
+#include <cstring>
 #include <mutex>
 
 #include "codecs/codec_module.h"
 #include "codecs/ip/checksum.h"
 #include "detection/detection_engine.h"
 #include "log/text_log.h"
+#include "main/policy.h"
 #include "main/snort_config.h"
 #include "packet_io/active.h"
 #include "packet_io/sfdaq.h"
 #include "profiler/profiler_defs.h"
 #include "stream/stream.h"
 #include "trace/trace_api.h"
+#include "utils/util.h"
 
 #include "eth.h"
 #include "icmp4.h"
 #include "icmp6.h"
+#include "ipv4.h"
+#include "ipv6.h"
+#include "tcp.h"
+#include "tcp_options.h"
+#include "vlan.h"
+
+#ifdef BENCHMARK_TEST
+#include "catch/snort_catch.h"
+#include "detection/ips_context.h"
+#endif
 
 using namespace snort;
 
@@ -64,16 +78,37 @@ const std::array<const char*, PacketManager::stat_offset> PacketManager::stat_na
         "total",
         "other",
         "discards",
-        "depth_exceeded"
+        "depth_exceeded",
+        "fast_decodes"
     }
 };
 
 // Encoder Foo
 static THREAD_LOCAL std::array<uint8_t, Codec::PKT_MAX>* s_pkt;
 
+// set when the codecs the fast path stands in for are the built-in ones
+static THREAD_LOCAL bool s_fast_decode = false;
+
+static bool is_codec(Codec* cd, const char* name)
+{ return cd and !strcmp(cd->get_name(), name); }
+
+bool PacketManager::fast_codecs()
+{
+    const auto& map = CodecManager::s_proto_map;
+    const auto& cds = CodecManager::s_protocols;
+
+    return
+        is_codec(cds[CodecManager::grinder], "eth") and
+        is_codec(cds[map[to_utype(ProtocolId::ETHERTYPE_8021Q)]], "vlan") and
+        is_codec(cds[map[to_utype(ProtocolId::ETHERTYPE_IPV4)]], "ipv4") and
+        is_codec(cds[map[to_utype(ProtocolId::ETHERTYPE_IPV6)]], "ipv6") and
+        is_codec(cds[map[to_utype(ProtocolId::TCP)]], "tcp");
+}
+
 void PacketManager::thread_init()
 {
     s_pkt = new std::array<uint8_t, Codec::PKT_MAX>{ {0} };
+    s_fast_decode = fast_codecs();
 }
 
 void PacketManager::thread_term()
@@ -197,6 +232,379 @@ static inline bool payload_offset_from_daq_mismatch(const uint8_t* pkt, const Ra
     return false;
 }
 
+//-------------------------------------------------------------------------
+// fast path
+//
+// Each of these decodes one layer of a plain Eth / VLAN / IP / TCP stack
+// exactly as the built-in codec would, but only when the codec would raise
+// no event, count no peg, and take no special branch.  Anything else
+// returns false without touching the packet and the codec decodes the
+// layer instead.  UDP is left to its codec because the choice of tunnel
+// decoder after it depends on that codec's port configuration.
+//-------------------------------------------------------------------------
+
+static inline bool fast_eth(const RawData& raw, CodecData& codec)
+{
+    if ( raw.len < eth::ETH_HEADER_LEN )
+        return false;
+
+    const eth::EtherHdr* eh = reinterpret_cast<const eth::EtherHdr*>(raw.data);
+    const ProtocolId next = eh->ethertype();
+
+    if ( next != ProtocolId::ETHERTYPE_IPV4 and next != ProtocolId::ETHERTYPE_IPV6 and
+        next != ProtocolId::ETHERTYPE_8021Q )
+        return false;
+
+    codec.next_prot_id = next;
+    codec.lyr_len = eth::ETH_HEADER_LEN;
+    codec.proto_bits |= PROTO_BIT__ETH;
+    return true;
+}
+
+static inline bool fast_vlan(const RawData& raw, CodecData& codec)
+{
+    if ( raw.len < sizeof(vlan::VlanTagHdr) )
+        return false;
+
+    if ( daq_msg_get_pkthdr(raw.daq_msg)->flags & DAQ_PKT_FLAG_IGNORE_VLAN )
+        return false;
+
+    const vlan::VlanTagHdr* vh = reinterpret_cast<const vlan::VlanTagHdr*>(raw.data);
+    const ProtocolId next = (ProtocolId)vh->proto();
+    const uint16_t vid = vh->vid();
+
+    if ( next != ProtocolId::ETHERTYPE_IPV4 and next != ProtocolId::ETHERTYPE_IPV6 )
+        return false;
+
+    if ( vid == 0 or vid == 4095 )
+        return false;
+
+    codec.next_prot_id = next;
+    codec.lyr_len = sizeof(vlan::VlanTagHdr);
+    codec.proto_bits |= PROTO_BIT__VLAN;
+    return true;
+}
+
+static inline bool fast_ip4(RawData& raw, CodecData& codec, DecodeData& snort)
+{
+    if ( raw.len < ip::IP4_HEADER_LEN or snort.ip_api.is_ip() )
+        return false;
+
+    if ( codec.conf->hit_ip_maxlayers(codec.ip_layer_cnt) )
+        return false;
+
+    const ip::IP4Hdr* iph = reinterpret_cast<const ip::IP4Hdr*>(raw.data);
+    const uint32_t ip_len = iph->len();
+
+    // no options, no fragments, no reserved bit
+    if ( iph->ver() != 4 or iph->hlen() != ip::IP4_HEADER_LEN )
+        return false;
+
+    if ( ip_len > raw.len or ip_len < ip::IP4_HEADER_LEN )
+        return false;
+
+    if ( iph->off_w_flags() & ~0x4000 )
+        return false;
+
+    if ( to_utype(iph->proto()) >= to_utype(ProtocolId::MIN_UNASSIGNED_IP_PROTO) )
+        return false;
+
+    // the address tests of the codec, all of which alert
+    if ( iph->ip_src == iph->ip_dst or iph->is_src_broadcast() or iph->is_dst_broadcast() )
+        return false;
+
+    const uint8_t msb_src = reinterpret_cast<const uint8_t*>(&iph->ip_src)[0];
+    const uint8_t msb_dst = reinterpret_cast<const uint8_t*>(&iph->ip_dst)[0];
+
+    if ( msb_src == ip::IP4_LOOPBACK or msb_dst == ip::IP4_LOOPBACK or
+        msb_src == ip::IP4_THIS_NET or msb_dst == ip::IP4_THIS_NET or
+        (msb_src >> 4) == ip::IP4_MULTICAST )
+        return false;
+
+    if ( codec.conf->is_address_anomaly_check_enabled() )
+        return false;
+
+    if ( get_network_policy()->ip_checksums() and
+        checksum::ip_cksum((const uint16_t*)iph, ip::IP4_HEADER_LEN) )
+        return false;
+
+    ++codec.ip_layer_cnt;
+    snort.ip_api.set(iph);
+    codec.codec_flags &= ~(CODEC_IPOPT_FLAGS);
+    raw.len = ip_len;
+
+    if ( iph->off_w_flags() & 0x4000 )
+    {
+        codec.codec_flags |= CODEC_DF;
+        snort.decode_flags |= DECODE_DF;
+    }
+    snort.decode_flags &= ~DECODE_FRAG;
+
+    snort.set_pkt_type(PktType::IP);
+    codec.proto_bits |= PROTO_BIT__IP;
+    codec.lyr_len = ip::IP4_HEADER_LEN;
+    codec.curr_ip6_extension = 0;
+    codec.ip6_extension_count = 0;
+    codec.next_prot_id = (ProtocolId)iph->proto();
+    return true;
+}
+
+static inline bool fast_ip6(RawData& raw, CodecData& codec, DecodeData& snort)
+{
+    if ( raw.len < ip::IP6_HEADER_LEN or snort.ip_api.is_ip() )
+        return false;
+
+    if ( codec.conf->hit_ip_maxlayers(codec.ip_layer_cnt) )
+        return false;
+
+    const ip::IP6Hdr* ip6h = reinterpret_cast<const ip::IP6Hdr*>(raw.data);
+    const uint32_t len = ip6h->len() + ip::IP6_HEADER_LEN;
+
+    if ( ip6h->ver() != 6 or len > raw.len )
+        return false;
+
+    // extension headers and everything but tcp and udp go to the codec
+    if ( ip6h->next() != IpProtocol::TCP and ip6h->next() != IpProtocol::UDP )
+        return false;
+
+    if ( ip6h->is_src_multicast() or ip6h->is_dst_multicast() )
+        return false;
+
+    // loopback, unspecified and v4 mapped addresses all start with 80 zero bits
+    const ip::snort_in6_addr& src = ip6h->ip6_src;
+    const ip::snort_in6_addr& dst = ip6h->ip6_dst;
+
+    if ( !(src.u6_addr32[0] or src.u6_addr32[1] or src.u6_addr16[4]) or
+        !(dst.u6_addr32[0] or dst.u6_addr32[1] or dst.u6_addr16[4]) )
+        return false;
+
+    if ( !memcmp(&src, &dst, sizeof(src)) )
+        return false;
+
+    if ( codec.conf->is_address_anomaly_check_enabled() )
+        return false;
+
+    codec.ip_layer_cnt++;
+    snort.ip_api.set(ip6h);
+    raw.len = len;
+    snort.set_pkt_type(PktType::IP);
+    codec.next_prot_id = (ProtocolId)ip6h->next();
+    codec.lyr_len = ip::IP6_HEADER_LEN;
+    codec.curr_ip6_extension = 0;
+    codec.ip6_extension_count = 0;
+    codec.ip6_csum_proto = ip6h->next();
+    codec.codec_flags &= ~CODEC_ROUTING_SEEN;
+    codec.proto_bits |= PROTO_BIT__IP;
+    return true;
+}
+
+// only the options a normal established connection carries
+static inline bool fast_tcp_options(const uint8_t* opt, const uint8_t* end, DecodeData& snort)
+{
+    uint16_t flags = 0;
+
+    while ( opt < end )
+    {
+        const tcp::TcpOptCode code = (tcp::TcpOptCode)opt[0];
+
+        if ( code == tcp::TcpOptCode::NOP )
+        {
+            ++opt;
+            continue;
+        }
+        if ( end - opt < 2 )
+            return false;
+
+        const uint8_t len = opt[1];
+
+        if ( len < 2 or opt + len > end )
+            return false;
+
+        switch ( code )
+        {
+        case tcp::TcpOptCode::MAXSEG:
+            if ( len != tcp::TCPOLEN_MAXSEG )
+                return false;
+            flags |= DECODE_TCP_MSS;
+            break;
+
+        case tcp::TcpOptCode::SACKOK:
+            if ( len != tcp::TCPOLEN_SACKOK )
+                return false;
+            break;
+
+        case tcp::TcpOptCode::WSCALE:
+            if ( len != tcp::TCPOLEN_WSCALE or opt[2] > 14 )
+                return false;
+            flags |= DECODE_TCP_WS;
+            break;
+
+        case tcp::TcpOptCode::TIMESTAMP:
+            if ( len != tcp::TCPOLEN_TIMESTAMP )
+                return false;
+            flags |= DECODE_TCP_TS;
+            break;
+
+        case tcp::TcpOptCode::SACK:
+            break;
+
+        default:
+            return false;
+        }
+        opt += len;
+    }
+    snort.decode_flags |= flags;
+    return true;
+}
+
+static inline bool fast_tcp(const RawData& raw, CodecData& codec, DecodeData& snort)
+{
+    if ( raw.len < tcp::TCP_MIN_HEADER_LEN )
+        return false;
+
+    const tcp::TCPHdr* tcph = reinterpret_cast<const tcp::TCPHdr*>(raw.data);
+    const uint16_t hlen = tcph->hlen();
+
+    if ( hlen < tcp::TCP_MIN_HEADER_LEN or hlen > raw.len )
+        return false;
+
+    // established traffic: every flag test of the codec passes
+    if ( !(tcph->th_flags & TH_ACK) or (tcph->th_flags & (TH_SYN|TH_URG)) )
+        return false;
+
+    const uint16_t sp = tcph->src_port();
+    const uint16_t dp = tcph->dst_port();
+
+    if ( !sp or !dp )
+        return false;
+
+    if ( get_network_policy()->tcp_checksums() )
+    {
+        uint16_t csum;
+
+        if ( snort.ip_api.is_ip4() )
+        {
+            const ip::IP4Hdr* ip4h = snort.ip_api.get_ip4h();
+            checksum::Pseudoheader ph;
+            ph.hdr.sip = ip4h->get_src();
+            ph.hdr.dip = ip4h->get_dst();
+            ph.hdr.zero = 0;
+            ph.hdr.protocol = IpProtocol::TCP;
+            ph.hdr.len = htons((uint16_t)raw.len);
+            csum = checksum::tcp_cksum((const uint16_t*)raw.data, raw.len, ph);
+        }
+        else
+        {
+            const ip::IP6Hdr* ip6h = snort.ip_api.get_ip6h();
+            checksum::Pseudoheader6 ph6;
+            COPY4(ph6.hdr.sip, ip6h->get_src()->u6_addr32);
+            COPY4(ph6.hdr.dip, ip6h->get_dst()->u6_addr32);
+            ph6.hdr.zero = 0;
+            ph6.hdr.protocol = codec.ip6_csum_proto;
+            ph6.hdr.len = htons((uint16_t)raw.len);
+            csum = checksum::tcp_cksum((const uint16_t*)raw.data, raw.len, ph6);
+        }
+        if ( csum )
+            return false;
+    }
+
+    const uint8_t* opts = raw.data + tcp::TCP_MIN_HEADER_LEN;
+
+    if ( !fast_tcp_options(opts, raw.data + hlen, snort) )
+        return false;
+
+    codec.lyr_len = hlen;
+    codec.proto_bits |= PROTO_BIT__TCP;
+    snort.set_pkt_type(PktType::TCP);
+    snort.tcph = tcph;
+    snort.sp = sp;
+    snort.dp = dp;
+    return true;
+}
+
+// the per layer record keeping of the decode() loop for a layer that
+// needs none of its special cases
+inline void PacketManager::fast_layer(
+    Packet* p, RawData& raw, CodecData& codec_data,
+    ProtocolIndex& mapped_prot, ProtocolId& prev_prot_id)
+{
+    debug_logf(decode_trace, nullptr,
+        "Codec %s (0x%0*hx) starts at %u, length is %hu\n",
+        CodecManager::s_protocols[mapped_prot]->get_name(),
+        (static_cast<uint16_t>(prev_prot_id) < 0xFF) ? 2 : 4,
+        static_cast<uint16_t>(prev_prot_id),
+        p->pktlen - raw.len, codec_data.lyr_len);
+
+    if ( codec_data.proto_bits & PROTO_BIT__IP )
+        p->ip_proto_next = convert_protocolid_to_ipprotocol(codec_data.next_prot_id);
+
+    if ( push_layer(p, codec_data, prev_prot_id, raw.data, codec_data.lyr_len) and
+        codec_data.proto_bits == PROTO_BIT__VLAN )
+        p->vlan_idx = p->num_layers - 1;
+
+    s_stats[mapped_prot + stat_offset]++;
+    mapped_prot = CodecManager::s_proto_map[to_utype(codec_data.next_prot_id)];
+    prev_prot_id = codec_data.next_prot_id;
+
+    raw.len -= codec_data.lyr_len;
+    raw.data += codec_data.lyr_len;
+
+    p->proto_bits |= codec_data.proto_bits;
+
+    codec_data.next_prot_id = ProtocolId::FINISHED_DECODE;
+    codec_data.lyr_len = 0;
+    codec_data.proto_bits = 0;
+}
+
+// decodes as many leading layers as it can; decode() picks up from
+// wherever this stops, so a bail out costs only the checks made so far
+void PacketManager::decode_fast(
+    Packet* p, RawData& raw, CodecData& codec_data,
+    ProtocolIndex& mapped_prot, ProtocolId& prev_prot_id)
+{
+    // hardware decode hints and NAPT translation are handled by the codecs
+    if ( daq_msg_get_meta(raw.daq_msg, DAQ_PKT_META_DECODE_DATA) or
+        daq_msg_get_meta(raw.daq_msg, DAQ_PKT_META_NAPT_INFO) )
+        return;
+
+    if ( !fast_eth(raw, codec_data) )
+        return;
+
+    bool ok;
+
+    do
+    {
+        fast_layer(p, raw, codec_data, mapped_prot, prev_prot_id);
+
+        switch ( prev_prot_id )
+        {
+        case ProtocolId::ETHERTYPE_8021Q:
+            ok = fast_vlan(raw, codec_data);
+            break;
+
+        case ProtocolId::ETHERTYPE_IPV4:
+            ok = fast_ip4(raw, codec_data, p->ptrs);
+            break;
+
+        case ProtocolId::ETHERTYPE_IPV6:
+            ok = fast_ip6(raw, codec_data, p->ptrs);
+            break;
+
+        case ProtocolId::TCP:
+            ok = fast_tcp(raw, codec_data, p->ptrs);
+            break;
+
+        case ProtocolId::FINISHED_DECODE:
+            s_stats[fast_decodes]++;
+            // fallthrough
+        default:
+            ok = false;
+            break;
+        }
+    }
+    while ( ok );
+}
+
 //-------------------------------------------------------------------------
 // Initialization and setup
 //-------------------------------------------------------------------------
@@ -238,6 +646,9 @@ void PacketManager::decode(
 
     s_stats[total_processed]++;
 
+    if ( s_fast_decode and !cooked )
+        decode_fast(p, raw, codec_data, mapped_prot, prev_prot_id);
+
     // loop until the protocol id is no longer valid
     while (CodecManager::s_protocols[mapped_prot]->decode(raw, codec_data, p->ptrs))
     {
@@ -835,6 +1246,10 @@ static inline void add_flag(
 
 void PacketManager::encode_update(Packet* p)
 {
+    // headers were modified in place and their checksums updated as they were
+    if ( p->cksums_adjusted() and !(p->packet_flags & (PKT_RESIZED|PKT_PSEUDO|PKT_REBUILT_FRAG)) )
+        return;
+
     uint32_t len = p->dsize;
 
     UpdateFlags flags = 0;
@@ -972,3 +1387,137 @@ void PacketManager::log_protocols(TextLog* const text_log,
         }
     }
 }
+
+//-------------------------------------------------------------------------
+// benchmarks
+//-------------------------------------------------------------------------
+
+#ifdef BENCHMARK_TEST
+
+bool PacketManager::bench_init(const SnortConfig* sc, bool fast)
+{
+    CodecManager::max_layers = sc->num_layers;
+
+    for ( int i = 0; CodecManager::s_protocols[i]; i++ )
+    {
+        std::vector<int> dlts;
+        CodecManager::s_protocols[i]->get_data_link_type(dlts);
+
+        if ( std::find(dlts.begin(), dlts.end(), DLT_EN10MB) == dlts.end() )
+            continue;
+
+        std::vector<ProtocolId> ids;
+        CodecManager::s_protocols[i]->get_protocol_ids(ids);
+
+        CodecManager::grinder_id = !ids.empty() ? ids[0] : ProtocolId::FINISHED_DECODE;
+        CodecManager::grinder = (ProtocolIndex)i;
+    }
+    s_fast_decode = fast and fast_codecs();
+    return s_fast_decode == fast;
+}
+
+// eth / ipv4 / tcp with timestamps, acking 64 bytes of data
+static uint32_t make_frame(uint8_t* frame)
+{
+    const uint16_t dsize = 64;
+    const uint16_t tcp_len = tcp::TCP_MIN_HEADER_LEN + 12;
+    const uint16_t ip_len = ip::IP4_HEADER_LEN + tcp_len + dsize;
+
+    const uint8_t eth[] =
+    { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0x08, 0x00 };
+    memcpy(frame, eth, sizeof(eth));
+
+    ip::IP4Hdr* iph = reinterpret_cast<ip::IP4Hdr*>(frame + sizeof(eth));
+    iph->ip_verhl = 0x45;
+    iph->ip_tos = 0;
+    iph->ip_len = htons(ip_len);
+    iph->ip_id = htons(1);
+    iph->ip_off = htons(0x4000);
+    iph->ip_ttl = 64;
+    iph->ip_proto = IpProtocol::TCP;
+    iph->ip_csum = 0;
+    iph->ip_src = htonl(0x0a010101);
+    iph->ip_dst = htonl(0x0a020202);
+    iph->ip_csum = checksum::ip_cksum((const uint16_t*)iph, ip::IP4_HEADER_LEN);
+
+    uint8_t* tcp = frame + sizeof(eth) + ip::IP4_HEADER_LEN;
+    tcp::TCPHdr* tcph = reinterpret_cast<tcp::TCPHdr*>(tcp);
+    tcph->th_sport = htons(40000);
+    tcph->th_dport = htons(80);
+    tcph->th_seq = htonl(1000);
+    tcph->th_ack = htonl(2000);
+    tcph->th_offx2 = (tcp_len / 4) << 4;
+    tcph->th_flags = TH_ACK | TH_PUSH;
+    tcph->th_win = htons(512);
+    tcph->th_sum = 0;
+    tcph->th_urp = 0;
+
+    const uint8_t opts[] = { 0x01, 0x01, 0x08, 0x0a, 0, 0, 0, 1, 0, 0, 0, 2 };
+    memcpy(tcp + tcp::TCP_MIN_HEADER_LEN, opts, sizeof(opts));
+    memset(tcp + tcp_len, 'x', dsize);
+
+    checksum::Pseudoheader ph;
+    ph.hdr.sip = iph->ip_src;
+    ph.hdr.dip = iph->ip_dst;
+    ph.hdr.zero = 0;
+    ph.hdr.protocol = IpProtocol::TCP;
+    ph.hdr.len = htons(tcp_len + dsize);
+    tcph->th_sum = checksum::tcp_cksum((const uint16_t*)tcp, tcp_len + dsize, ph);
+
+    return sizeof(eth) + ip_len;
+}
+
+TEST_CASE("decode eth ipv4 tcp", "[packet_manager]")
+{
+    const SnortConfig* sc = SnortConfig::get_conf();
+    set_default_policy(sc);
+
+    if ( !PacketManager::bench_init(sc, true) )
+        return;
+
+    uint8_t frame[256];
+    const uint32_t len = make_frame(frame);
+
+    DAQ_PktHdr_t pkth = { };
+    pkth.pktlen = len;
+
+    DAQ_Msg_t msg = { };
+    msg.hdr = &pkth;
+    msg.data = frame;
+    msg.data_len = len;
+
+    IpsContext ctx;
+    Packet* p = ctx.packet;
+    p->daq_msg = &msg;
+    p->active = p->active_inst;
+
+    PacketManager::decode(p, &pkth, frame, len);
+    const uint32_t fast_bits = p->proto_bits;
+    const uint8_t fast_layers = p->num_layers;
+    const uint16_t fast_dsize = p->dsize;
+
+    PacketManager::bench_init(sc, false);
+    PacketManager::decode(p, &pkth, frame, len);
+
+    // the fast path must leave the packet just as the codecs do
+    REQUIRE(fast_bits == p->proto_bits);
+    REQUIRE(fast_layers == p->num_layers);
+    REQUIRE(fast_dsize == p->dsize);
+    REQUIRE(p->dsize == 64);
+
+    BENCHMARK("codecs")
+    {
+        PacketManager::decode(p, &pkth, frame, len);
+        return p->dsize;
+    };
+
+    PacketManager::bench_init(sc, true);
+
+    BENCHMARK("fast path")
+    {
+        PacketManager::decode(p, &pkth, frame, len);
+        return p->dsize;
+    };
+}
+
+#endif
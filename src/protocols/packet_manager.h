@@ -60,6 +60,12 @@ public:
     static void thread_init();
     static void thread_term();
 
+#ifdef BENCHMARK_TEST
+    // decode ethernet on this thread without a daq instance, with or
+    // without the fast path; false if the fast path can't be used
+    static bool bench_init(const SnortConfig*, bool fast);
+#endif
+
     // decode this packet and set all relevant packet fields.
     static void decode(Packet*, const struct _daq_pkt_hdr*, const uint8_t* pkt,
         uint32_t pktlen, bool cooked = false, bool retry = false);
@@ -138,6 +144,9 @@ private:
     static Codec* get_layer_codec(const Layer&, int idx);
     static void pop_teredo(Packet*, RawData&);
     static void handle_decode_failure(Packet*, RawData&, const CodecData&, const DecodeData&, ProtocolId);
+    static bool fast_codecs();
+    static void decode_fast(Packet*, RawData&, CodecData&, ProtocolIndex&, ProtocolId&);
+    static void fast_layer(Packet*, RawData&, CodecData&, ProtocolIndex&, ProtocolId&);
 
     static bool encode(const Packet*, EncodeFlags,
         uint8_t lyr_start, IpProtocol next_prot, Buffer& buf);
@@ -148,7 +157,8 @@ private:
     static const uint8_t other_codecs = 1;
     static const uint8_t discards = 2;
     static const uint8_t depth_exceeded = 3;
-    static const uint8_t stat_offset = 4;
+    static const uint8_t fast_decodes = 4;
+    static const uint8_t stat_offset = 5;
 
     // declared in header so it can access s_protocols
     static THREAD_LOCAL std::array<PegCount, stat_offset +
@@ -51,6 +51,9 @@ public:
     uint64_t get_trans_num() const
     { return trans_num; }
 
+    // the data to normalize next ends the file; only PDF cares
+    virtual void set_file_end(bool) { }
+
 protected:
     const uint8_t* page_start = nullptr;
     HttpEventGen* http_events = nullptr;
@@ -105,6 +108,9 @@ public:
     snort::JSNorm& ctx() override
     { return *this; }
 
+    void set_file_end(bool end) override
+    { PDFJSNorm::set_file_end(end); }
+
 protected:
     bool pre_proc() override;
     bool post_proc(int) override;
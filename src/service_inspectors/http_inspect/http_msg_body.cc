@@ -23,7 +23,7 @@
 
 #include "http_msg_body.h"
 
-#include "decompress/file_olefile.h"
+#include "decompress/file_decomp.h"
 #include "file_api/file_flows.h"
 #include "file_api/file_service.h"
 #include "helpers/buffer_data.h"
@@ -229,7 +229,8 @@ void HttpMsgBody::analyze()
                 attach_buf = new uint8_t[attach_length];
                 memcpy(attach_buf, latest_attachment.data, latest_attachment.length);
             }
-            const BufferData& vba_buf = session_data->mime_state[source_id]->get_ole_buf();
+            const BufferData& vba_buf =
+                session_data->mime_state[source_id]->get_vba_inspect_buf();
             if (vba_buf.data_ptr() != nullptr)
             {
                 uint8_t* my_vba_buf = new uint8_t[vba_buf.length()];
@@ -356,22 +357,6 @@ void HttpMsgBody::do_utf_decoding(const Field& input, Field& output)
     }
 }
 
-void HttpMsgBody::get_ole_data()
-{
-    uint8_t* ole_data_ptr;
-    uint32_t ole_len;
-
-    session_data->fd_state[source_id]->get_ole_data(ole_data_ptr, ole_len);
-
-    if (ole_data_ptr)
-    {
-        ole_data.set(ole_len, ole_data_ptr, false);
-
-        // Reset the ole data ptr once it is stored in msg body
-        session_data->fd_state[source_id]->ole_data_reset();
-    }
-}
-
 void HttpMsgBody::do_file_decompression(const Field& input, Field& output)
 {
     if (session_data->fd_state[source_id] == nullptr)
@@ -379,8 +364,9 @@ void HttpMsgBody::do_file_decompression(const Field& input, Field& output)
         output.set(input);
         return;
     }
+    // decompress into the shared per thread buffer and keep only what was produced
     const uint32_t buffer_size = session_data->file_decomp_buffer_size_remaining[source_id];
-    uint8_t* buffer = new uint8_t[buffer_size];
+    uint8_t* buffer = File_Decomp_Buffer(buffer_size);
     session_data->fd_alert_context[source_id].infractions = transaction->get_infractions(source_id);
     session_data->fd_alert_context[source_id].events = session_data->events[source_id];
     session_data->fd_state[source_id]->Next_In = input.start();
@@ -398,7 +384,6 @@ void HttpMsgBody::do_file_decompression(const Field& input, Field& output)
         // Fall through
     case File_Decomp_NoSig:
     case File_Decomp_Error:
-        delete[] buffer;
         output.set(input);
         File_Decomp_StopFree(session_data->fd_state[source_id]);
         session_data->fd_state[source_id] = nullptr;
@@ -409,11 +394,23 @@ void HttpMsgBody::do_file_decompression(const Field& input, Field& output)
         // Fall through
     default:
         const uint32_t output_length = session_data->fd_state[source_id]->Next_Out - buffer;
-        output.set(output_length, buffer, true);
+        uint8_t* decompressed = new uint8_t[output_length];
+        memcpy(decompressed, buffer, output_length);
+        output.set(output_length, decompressed, true);
         assert((uint64_t)session_data->file_decomp_buffer_size_remaining[source_id] >=
             output_length);
         session_data->file_decomp_buffer_size_remaining[source_id] -= output_length;
-        get_ole_data();
+
+        // VBA is extracted as the OLE file is inflated and is ready once it ends
+        uint8_t* vba_buf;
+        uint32_t vba_len;
+        if ( session_data->fd_state[source_id]->get_vba_data(vba_buf, vba_len) )
+        {
+            if ( vba_buf )
+                decompressed_vba_data.set(vba_len, vba_buf, true);
+            else
+                decompressed_vba_data.set(STAT_NOT_PRESENT);
+        }
 
         break;
     }
@@ -739,9 +736,10 @@ bool HttpMsgBody::run_detection(snort::Packet* p)
                 count or mb->file.is_accumulated(),
                 std::next(mb) != mime_bufs->end() or last_attachment_complete);
             if (mb->vba.length() > 0)
-                ole_data.set(mb->vba.length(), mb->vba.start());
+                decompressed_vba_data.set(mb->vba.length(), mb->vba.start());
             decompressed_file_body.reset();
             decompressed_file_body.set(mb->file.length(), mb->file.start());
+            file_data_end = std::next(mb) != mime_bufs->end() or last_attachment_complete;
 
             js_ctx_tmp = session_data->js_ctx[source_id];
             session_data->js_ctx[source_id] = acquire_js_ctx_mime();
@@ -758,7 +756,6 @@ bool HttpMsgBody::run_detection(snort::Packet* p)
 
             session_data->js_ctx[source_id] = js_ctx_tmp;
 
-            ole_data.reset();
             decompressed_vba_data.reset();
             decompressed_file_body.reset();
         }
@@ -769,7 +766,12 @@ bool HttpMsgBody::run_detection(snort::Packet* p)
         }
     }
     else
+    {
+        // using the trick that cutter is deleted when the body is complete
+        file_data_end = !session_data->partial_flush[source_id] and
+            ((session_data->cutter[source_id] == nullptr) or tcp_close);
         DetectionEngine::detect(p);
+    }
     return true;
 }
 
@@ -849,28 +851,9 @@ const Field& HttpMsgBody::get_classic_client_body()
 
 const Field& HttpMsgBody::get_decomp_vba_data()
 {
-    if (decompressed_vba_data.length() != STAT_NOT_COMPUTE)
-        return decompressed_vba_data;
-
-    if (ole_data.length() <= 0)
-    {
+    // set by file decompression or a MIME attachment when an OLE file ended
+    if (decompressed_vba_data.length() == STAT_NOT_COMPUTE)
         decompressed_vba_data.set(STAT_NO_SOURCE);
-        return decompressed_vba_data;
-    }
-
-    uint8_t* buf = nullptr;
-    uint32_t buf_len = 0;
-
-    VBA_DEBUG(vba_data_trace, DEFAULT_TRACE_OPTION_ID, TRACE_INFO_LEVEL, CURRENT_PACKET,
-               "Found OLE file. Sending %d bytes for the processing.\n",
-                ole_data.length());
-
-    oleprocess(ole_data.start(), ole_data.length(), buf, buf_len);
-
-    if (buf && buf_len)
-        decompressed_vba_data.set(buf_len, buf, true);
-    else
-        decompressed_vba_data.set(STAT_NOT_PRESENT);
 
     return decompressed_vba_data;
 }
@@ -910,6 +893,7 @@ const Field& HttpMsgBody::get_norm_js_data()
     bool back = !session_data->partial_flush[source_id];
 
     jsn->link(src, session_data->events[source_id], infractions);
+    jsn->set_file_end(file_data_end);
     jsn->ctx().normalize(src, src_len, dst, dst_len);
 
     debug_logf(4, js_trace, TRACE_PROC, DetectionEngine::get_current_packet(),
@@ -943,18 +927,10 @@ void HttpMsgBody::print_body_section(FILE* output, const char* body_type_str)
         for (MimeBufs& mb : *mime_bufs)
         {
             mb.file.print(output, "MIME data");
-            mb.vba.print(output, "MIME OLE data");
-            if (mb.vba.length() > 0)
-                ole_data.set(mb.vba.length(), mb.vba.start());
-            get_decomp_vba_data().print(output, "MIME Decompressed VBA data");
-            ole_data.reset();
-            decompressed_vba_data.reset();
+            mb.vba.print(output, "MIME Decompressed VBA data");
         }
     else
-    {
-        ole_data.print(output, "OLE data");
         get_decomp_vba_data().print(output, "Decompressed VBA data");
-    }
     get_classic_buffer(HTTP_BUFFER_CLIENT_BODY, 0, 0).print(output,
         HttpApi::classic_buffer_names[HTTP_BUFFER_CLIENT_BODY-1]);
     get_classic_buffer(HTTP_BUFFER_RAW_BODY, 0, 0).print(output,
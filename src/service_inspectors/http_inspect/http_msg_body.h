@@ -83,7 +83,6 @@ private:
         int32_t detect_length);
     void get_file_info( FileDirection dir, const uint8_t*& filename_buffer,
         uint32_t& filename_length, const uint8_t*& uri_buffer, uint32_t& uri_length);
-    void get_ole_data();
 
     Field msg_text_new;
     Field decoded_body;
@@ -97,10 +96,12 @@ private:
 
     // MIME buffers
     Field decompressed_vba_data;
-    Field ole_data;
     std::list<MimeBufs>* mime_bufs = nullptr;
     bool last_attachment_complete = true;
 
+    // the file data being inspected ends the file
+    bool file_data_end = false;
+
     int32_t publish_length = HttpCommon::STAT_NOT_PRESENT;
 };
 
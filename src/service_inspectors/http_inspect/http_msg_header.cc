@@ -714,6 +714,8 @@ void HttpMsgHeader::setup_file_decompression()
     session_data->fd_state[source_id]->Alert_Context = &session_data->fd_alert_context[source_id];
     session_data->fd_state[source_id]->Compr_Depth = 0;
     session_data->fd_state[source_id]->Decompr_Depth = 0;
+    session_data->fd_state[source_id]->ole_window =
+        FileService::decode_conf.get_vba_window_size();
 
     (void)File_Decomp_Init(session_data->fd_state[source_id]);
 }
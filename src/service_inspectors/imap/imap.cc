@@ -834,6 +834,7 @@ bool Imap::get_buf(InspectionBuffer::Type ibt, Packet* p, InspectionBuffer& b)
             jsn->get_data(dst, dst_len);
             if (dst and dst_len)
                 break;
+            jsn->set_file_end(imap_ssn->mime_ssn->get_attachment().finished);
             jsn->normalize(dp.data, dp.len, dst, dst_len);
         }
         break;
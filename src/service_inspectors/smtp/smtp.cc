@@ -1645,6 +1645,7 @@ bool Smtp::get_fp_buf(InspectionBuffer::Type ibt, Packet* p, InspectionBuffer& b
             jsn->get_data(dst, dst_len);
             if (dst and dst_len)
                 break;
+            jsn->set_file_end(smtp_ssn->mime_ssn->get_attachment().finished);
             jsn->normalize(dp.data, dp.len, dst, dst_len);
         }
         break;
@@ -25,6 +25,8 @@
 
 #include "tcp_normalizer.h"
 
+#include "codecs/ip/checksum.h"
+
 #include "tcp_module.h"
 #include "tcp_stream_session.h"
 #include "tcp_stream_tracker.h"
@@ -58,8 +60,20 @@ bool TcpNormalizer::strip_tcp_timestamp(
 
     if (mode == NORM_MODE_ON)
     {
+        // options may be at any offset so the checksum is updated for the
+        // whole words around this one
+        tcp::TCPHdr* tcph = const_cast<tcp::TCPHdr*>(tsd.get_tcph());
+        uint8_t* hdr = reinterpret_cast<uint8_t*>(tcph);
+        unsigned start = ((const uint8_t*)opt - hdr) & ~1u;
+        unsigned end = ((const uint8_t*)opt - hdr + tcp::TCPOLEN_TIMESTAMP + 1) & ~1u;
+        uint8_t orig[tcp::TCPOLEN_TIMESTAMP + 2];
+        memcpy(orig, hdr + start, end - start);
+
         // set raw option bytes to nops
         memset((void*)opt, (uint32_t)tcp::TcpOptCode::NOP, tcp::TCPOLEN_TIMESTAMP);
+        checksum::update_cksum(tcph->th_sum, orig, hdr + start, end - start);
+
+        tsd.get_pkt()->set_cksums_adjusted();
         tsd.set_packet_flags(PKT_MODIFIED);
         return true;
     }
@@ -150,7 +164,13 @@ void TcpNormalizer::ecn_stripper(
     {
         if (tns.strip_ecn == NORM_MODE_ON)
         {
-            (const_cast<tcp::TCPHdr*>(tcph))->th_flags &= ~(TH_ECE | TH_CWR);
+            tcp::TCPHdr* h = const_cast<tcp::TCPHdr*>(tcph);
+            uint8_t orig[2] = { h->th_offx2, h->th_flags };
+
+            h->th_flags &= ~(TH_ECE | TH_CWR);
+            checksum::update_cksum(h->th_sum, orig, &h->th_offx2, sizeof(orig));
+
+            tsd.get_pkt()->set_cksums_adjusted();
             tsd.set_packet_flags(PKT_MODIFIED);
         }
 
@@ -153,6 +153,7 @@ public:
     void rewrite_payload(uint16_t offset, uint8_t* from, uint16_t length)
     {
         memcpy(const_cast<uint8_t*>(pkt->data + offset), from, length);
+        pkt->clear_cksums_adjusted();
         set_packet_flags(PKT_MODIFIED);
     }
 
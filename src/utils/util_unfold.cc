@@ -24,6 +24,8 @@
 
 #include "util_unfold.h"
 
+#include <cstring>
+
 namespace snort
 {
 /* Given a string, removes header folding (\r\n followed by linear whitespace)
@@ -118,14 +120,36 @@ int sf_strip_CRLF(const uint8_t* inbuf, uint32_t inbuf_size, uint8_t* outbuf,
     cursor = inbuf;
     endofinbuf = inbuf + inbuf_size;
     outbuf_ptr = outbuf;
+
+    /* copy the runs between line breaks */
     while ((cursor < endofinbuf) && (n < outbuf_size))
     {
-        if ((*cursor != '\n') && (*cursor != '\r'))
+        const uint8_t* eol = (const uint8_t*)memchr(cursor, '\n', endofinbuf - cursor);
+
+        if (!eol)
+            eol = endofinbuf;
+
+        while ((cursor < eol) && (n < outbuf_size))
         {
-            *outbuf_ptr++ = *cursor;
-            n++;
+            const uint8_t* cr = (const uint8_t*)memchr(cursor, '\r', eol - cursor);
+
+            if (!cr)
+                cr = eol;
+
+            uint32_t len = cr - cursor;
+
+            if (len > outbuf_size - n)
+                len = outbuf_size - n;
+
+            memcpy(outbuf_ptr, cursor, len);
+            outbuf_ptr += len;
+            n += len;
+            cursor += len;
+
+            if ((cursor == cr) && (cr < eol))
+                cursor++;
         }
-        cursor++;
+        cursor = eol + 1;
     }
 
     if (output_bytes)
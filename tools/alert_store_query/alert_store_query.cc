@@ -0,0 +1,377 @@
+//--------------------------------------------------------------------------
+// Copyright (C) 2023-2023 Cisco and/or its affiliates. All rights reserved.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License Version 2 as published
+// by the Free Software Foundation.  You may not use, modify or distribute
+// this program under any other version of the GNU General Public License.
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+//--------------------------------------------------------------------------
+// alert_store_query.cc
+
+// print the events in alert_store segments that match the given keys.
+// each segment is mapped and only the index and the columns needed to check
+// the candidates it yields are touched; segments outside the time range are
+// skipped on the header alone.
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "log/alert_store.h"
+
+using namespace AlertStore;
+
+struct Query
+{
+    bool has_from = false;
+    bool has_to = false;
+    bool has_gid = false;
+    bool has_sid = false;
+    bool has_src = false;
+    bool has_dst = false;
+    bool has_sport = false;
+    bool has_dport = false;
+    bool has_proto = false;
+    bool either = false;    // match the addresses and ports in both directions
+    bool dump = false;
+
+    uint32_t from = 0;
+    uint32_t to = 0;
+    uint32_t gid = 0;
+    uint32_t sid = 0;
+    uint32_t src[4] = { };
+    uint32_t dst[4] = { };
+    uint16_t sport = 0;
+    uint16_t dport = 0;
+    uint8_t proto = 0;
+
+    bool full_flow() const
+    { return has_src and has_dst and has_sport and has_dport and has_proto; }
+};
+
+//-------------------------------------------------------------------------
+// output
+//-------------------------------------------------------------------------
+
+static const char* get_action(uint8_t act)
+{
+    const char* acts[] = { "trust", "pass", "hold", "retry", "rewrite", "drop", "block", "reset" };
+
+    if ( act < sizeof(acts)/sizeof(acts[0]) )
+        return acts[act];
+
+    static char buf[8];
+    snprintf(buf, sizeof(buf), "%u", act);
+    return buf;
+}
+
+static const uint32_t* mapped_prefix()
+{
+    static uint32_t pfx[3] = { 0, 0, 0 };
+    pfx[2] = htonl(0xffff);
+    return pfx;
+}
+
+static void print_addr(const uint32_t* a)
+{
+    char buf[INET6_ADDRSTRLEN];
+
+    if ( !memcmp(a, mapped_prefix(), 3 * sizeof(*a)) )
+        inet_ntop(AF_INET, a + 3, buf, sizeof(buf));
+    else
+        inet_ntop(AF_INET6, a, buf, sizeof(buf));
+
+    printf("%s", buf);
+}
+
+static void print_snippet(const uint8_t* p, unsigned n)
+{
+    for ( unsigned i = 0; i < n; i += 16 )
+    {
+        printf("\t%04x  ", i);
+
+        for ( unsigned j = i; j < i + 16; ++j )
+        {
+            if ( j < n )
+                printf("%02x ", p[j]);
+            else
+                printf("   ");
+        }
+        printf(" ");
+
+        for ( unsigned j = i; j < i + 16 and j < n; ++j )
+            putchar(isprint(p[j]) ? p[j] : '.');
+
+        printf("\n");
+    }
+}
+
+static void print_event(const Segment& s, uint32_t i, bool dump)
+{
+    const uint32_t* src = s.get<uint32_t>(SEC_SRC_ADDR) + 4 * i;
+    const uint32_t* dst = s.get<uint32_t>(SEC_DST_ADDR) + 4 * i;
+
+    printf("%u.%06u %u:%u:%u event %u proto %u ",
+        s.get<uint32_t>(SEC_SECONDS)[i], s.get<uint32_t>(SEC_USECONDS)[i],
+        s.get<uint32_t>(SEC_GID)[i], s.get<uint32_t>(SEC_SID)[i], s.get<uint32_t>(SEC_REV)[i],
+        s.get<uint32_t>(SEC_EVENT_ID)[i], s.get<uint8_t>(SEC_PROTO)[i]);
+
+    print_addr(src);
+    printf(":%u -> ", s.get<uint16_t>(SEC_SRC_PORT)[i]);
+    print_addr(dst);
+    printf(":%u %s\n", s.get<uint16_t>(SEC_DST_PORT)[i], get_action(s.get<uint8_t>(SEC_ACTION)[i]));
+
+    if ( dump )
+    {
+        uint16_t len;
+
+        if ( const uint8_t* snip = s.get_snippet(i, len) )
+            print_snippet(snip, len);
+        else
+            printf("\tsnippet is outside the segment\n");
+    }
+}
+
+//-------------------------------------------------------------------------
+// matching
+//-------------------------------------------------------------------------
+
+static bool match_dir(
+    const Query& q, const uint32_t* a, uint16_t ap, const uint32_t* b, uint16_t bp)
+{
+    if ( q.has_src and memcmp(q.src, a, sizeof(q.src)) )
+        return false;
+
+    if ( q.has_dst and memcmp(q.dst, b, sizeof(q.dst)) )
+        return false;
+
+    if ( q.has_sport and q.sport != ap )
+        return false;
+
+    if ( q.has_dport and q.dport != bp )
+        return false;
+
+    return true;
+}
+
+static bool match(const Query& q, const Segment& s, uint32_t i)
+{
+    uint32_t sec = s.get<uint32_t>(SEC_SECONDS)[i];
+
+    if ( (q.has_from and sec < q.from) or (q.has_to and sec > q.to) )
+        return false;
+
+    if ( q.has_sid and s.get<uint32_t>(SEC_SID)[i] != q.sid )
+        return false;
+
+    if ( q.has_gid and s.get<uint32_t>(SEC_GID)[i] != q.gid )
+        return false;
+
+    if ( q.has_proto and s.get<uint8_t>(SEC_PROTO)[i] != q.proto )
+        return false;
+
+    const uint32_t* src = s.get<uint32_t>(SEC_SRC_ADDR) + 4 * i;
+    const uint32_t* dst = s.get<uint32_t>(SEC_DST_ADDR) + 4 * i;
+    uint16_t sp = s.get<uint16_t>(SEC_SRC_PORT)[i];
+    uint16_t dp = s.get<uint16_t>(SEC_DST_PORT)[i];
+
+    if ( match_dir(q, src, sp, dst, dp) )
+        return true;
+
+    return q.either and match_dir(q, dst, dp, src, sp);
+}
+
+// narrow to a range of one index, most selective key first, then check
+// the remaining keys against the columns
+static unsigned query(const Query& q, const Segment& s)
+{
+    const uint32_t* lo;
+    const uint32_t* hi;
+
+    if ( q.has_sid )
+        s.find_sid(q.sid, lo, hi);
+
+    else if ( q.full_flow() )
+        s.find_flow(flow_hash(q.src, q.sport, q.dst, q.dport, q.proto), lo, hi);
+
+    else
+        s.find_time(q.has_from ? &q.from : nullptr, q.has_to ? &q.to : nullptr, lo, hi);
+
+    unsigned hits = 0;
+
+    for ( const uint32_t* p = lo; p < hi; ++p )
+    {
+        if ( match(q, s, *p) )
+        {
+            print_event(s, *p, q.dump);
+            ++hits;
+        }
+    }
+    return hits;
+}
+
+static int query_file(const Query& q, const char* file, unsigned& hits)
+{
+    int fd = open(file, O_RDONLY);
+    struct stat st;
+
+    if ( fd < 0 or fstat(fd, &st) )
+    {
+        fprintf(stderr, "ERROR: can't open %s: %s\n", file, strerror(errno));
+        if ( fd >= 0 )
+            close(fd);
+        return 1;
+    }
+
+    size_t size = st.st_size;
+    void* map = size ? mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+
+    if ( map == MAP_FAILED )
+    {
+        fprintf(stderr, "ERROR: can't map %s: %s\n", file, size ? strerror(errno) : "empty");
+        return 1;
+    }
+
+    Segment s = { (const uint8_t*)map, (const Header*)map, size };
+    int ret = 0;
+
+    if ( !s.valid() )
+    {
+        fprintf(stderr, "ERROR: %s is not an alert_store segment\n", file);
+        ret = 1;
+    }
+    else if ( !s.hdr->count or (q.has_from and s.hdr->max_seconds < q.from) or
+        (q.has_to and s.hdr->min_seconds > q.to) )
+        ;  // nothing in range
+
+    else
+        hits += query(q, s);
+
+    munmap(map, size);
+    return ret;
+}
+
+//-------------------------------------------------------------------------
+// main
+//-------------------------------------------------------------------------
+
+static void usage()
+{
+    puts("usage: alert_store_query [options] <segment> ...");
+    puts("  -f, --from <secs>     events at or after this time");
+    puts("  -t, --to <secs>       events at or before this time");
+    puts("  -g, --gid <gid>       events from this generator");
+    puts("  -s, --sid <sid>       events for this signature");
+    puts("  -a, --src <addr>      events from this address");
+    puts("  -b, --dst <addr>      events to this address");
+    puts("  -p, --sport <port>    events from this port or icmp type");
+    puts("  -q, --dport <port>    events to this port or icmp code");
+    puts("  -P, --proto <num>     events with this ip protocol");
+    puts("  -e, --either          match the addresses and ports in either direction");
+    puts("  -x, --dump            dump the stored payload of each event");
+}
+
+static bool get_num(const char* s, uint32_t max, uint32_t& n)
+{
+    char* end;
+    errno = 0;
+    unsigned long v = strtoul(s, &end, 0);
+
+    if ( errno or *end or end == s or v > max )
+        return false;
+
+    n = v;
+    return true;
+}
+
+static bool get_addr(const char* s, uint32_t* a)
+{
+    if ( inet_pton(AF_INET6, s, a) == 1 )
+        return true;
+
+    memcpy(a, mapped_prefix(), 3 * sizeof(*a));
+    return inet_pton(AF_INET, s, a + 3) == 1;
+}
+
+int main(int argc, char** argv)
+{
+    static const option opts[] =
+    {
+        { "from", required_argument, nullptr, 'f' },
+        { "to", required_argument, nullptr, 't' },
+        { "gid", required_argument, nullptr, 'g' },
+        { "sid", required_argument, nullptr, 's' },
+        { "src", required_argument, nullptr, 'a' },
+        { "dst", required_argument, nullptr, 'b' },
+        { "sport", required_argument, nullptr, 'p' },
+        { "dport", required_argument, nullptr, 'q' },
+        { "proto", required_argument, nullptr, 'P' },
+        { "either", no_argument, nullptr, 'e' },
+        { "dump", no_argument, nullptr, 'x' },
+        { "help", no_argument, nullptr, 'h' },
+        { nullptr, 0, nullptr, 0 }
+    };
+
+    Query q;
+    uint32_t n = 0;
+    int c;
+    bool ok = true;
+
+    while ( ok and (c = getopt_long(argc, argv, "f:t:g:s:a:b:p:q:P:exh", opts, nullptr)) != -1 )
+    {
+        switch ( c )
+        {
+        case 'f': ok = q.has_from = get_num(optarg, UINT32_MAX, q.from); break;
+        case 't': ok = q.has_to = get_num(optarg, UINT32_MAX, q.to); break;
+        case 'g': ok = q.has_gid = get_num(optarg, UINT32_MAX, q.gid); break;
+        case 's': ok = q.has_sid = get_num(optarg, UINT32_MAX, q.sid); break;
+        case 'a': ok = q.has_src = get_addr(optarg, q.src); break;
+        case 'b': ok = q.has_dst = get_addr(optarg, q.dst); break;
+        case 'p': ok = q.has_sport = get_num(optarg, UINT16_MAX, n); q.sport = n; break;
+        case 'q': ok = q.has_dport = get_num(optarg, UINT16_MAX, n); q.dport = n; break;
+        case 'P': ok = q.has_proto = get_num(optarg, UINT8_MAX, n); q.proto = n; break;
+        case 'e': q.either = true; break;
+        case 'x': q.dump = true; break;
+        default: ok = false; break;
+        }
+    }
+
+    if ( !ok or optind >= argc )
+    {
+        usage();
+        return 1;
+    }
+
+    unsigned hits = 0;
+    int ret = 0;
+
+    for ( int i = optind; i < argc; ++i )
+        ret |= query_file(q, argv[i], hits);
+
+    fprintf(stderr, "%u events\n", hits);
+    return ret;
+}
+